@@ -0,0 +1,4 @@
+include $(config_dir)dev.mk
+
+# assert that no heap allocations are made from audio thread
+this_cxxflags += -DAUDOUT_ASSERT_NO_REALTIME_ALLOCATIONS
@@ -0,0 +1,286 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "adpcm.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+#include <utki/debug.hpp>
+
+using namespace audout;
+
+namespace {
+constexpr std::array<int16_t, 89> step_table = {
+	7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,
+	31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+	130,   143,   157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,
+	544,   598,   658,   724,   796,   876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+	2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,
+	9493,  10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+constexpr std::array<int8_t, 16> index_table = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+
+constexpr int max_step_index = int(step_table.size() - 1);
+
+constexpr size_t channel_header_size_bytes = 4;
+
+struct channel_state {
+	int predictor;
+	int step_index;
+
+	// the decoding step is branchless, so that the compiler is free to interleave
+	// independent channels' dependency chains when decoding multichannel blocks
+	void decode(unsigned code) noexcept
+	{
+		int step = step_table[this->step_index];
+
+		int diff = step >> 3;
+		diff += step & -int((code >> 2) & 1);
+		diff += (step >> 1) & -int((code >> 1) & 1);
+		diff += (step >> 2) & -int(code & 1);
+
+		// negate the difference if sign bit is set
+		int sign = -int((code >> 3) & 1);
+		diff = (diff ^ sign) - sign;
+
+		this->predictor = std::clamp(
+			this->predictor + diff,
+			int(std::numeric_limits<int16_t>::min()),
+			int(std::numeric_limits<int16_t>::max())
+		);
+		this->step_index = std::clamp(this->step_index + index_table[code], 0, max_step_index);
+	}
+
+	unsigned encode(int sample) noexcept
+	{
+		int diff = sample - this->predictor;
+
+		unsigned code = 0;
+		if (diff < 0) {
+			code = 8;
+			diff = -diff;
+		}
+
+		int step = step_table[this->step_index];
+		if (diff >= step) {
+			code |= 4;
+			diff -= step;
+		}
+		step >>= 1;
+		if (diff >= step) {
+			code |= 2;
+			diff -= step;
+		}
+		step >>= 1;
+		if (diff >= step) {
+			code |= 1;
+		}
+
+		// update predictor exactly the way decoder does
+		this->decode(code);
+
+		return code;
+	}
+};
+} // namespace
+
+size_t adpcm_clip::channel_block_size_bytes() const noexcept
+{
+	// first sample of the block is stored in the header as is
+	return channel_header_size_bytes + this->num_block_frames / 2;
+}
+
+size_t adpcm_clip::get_num_blocks() const noexcept
+{
+	return (this->num_frames + this->num_block_frames - 1) / this->num_block_frames;
+}
+
+unsigned adpcm_clip::get_num_frames(size_t block_index) const noexcept
+{
+	utki::assert(block_index < this->get_num_blocks(), SL);
+	return unsigned(std::min(
+		size_t(this->num_block_frames), //
+		this->num_frames - block_index * this->num_block_frames
+	));
+}
+
+adpcm_clip::adpcm_clip(
+	utki::span<const int16_t> pcm, //
+	unsigned num_channels,
+	unsigned num_block_frames
+) :
+	num_channels(num_channels),
+	num_block_frames(num_block_frames),
+	num_frames(num_channels == 0 ? 0 : pcm.size() / num_channels)
+{
+	if (num_channels == 0) {
+		throw std::invalid_argument("adpcm_clip::adpcm_clip(): number of channels is 0");
+	}
+	if (num_block_frames == 0) {
+		throw std::invalid_argument("adpcm_clip::adpcm_clip(): number of frames per block is 0");
+	}
+	if (pcm.size() % num_channels != 0) {
+		throw std::invalid_argument("adpcm_clip::adpcm_clip(): PCM data does not consist of whole frames");
+	}
+
+	size_t block_size_bytes = this->channel_block_size_bytes() * num_channels;
+
+	this->data.resize(this->get_num_blocks() * block_size_bytes);
+
+	std::vector<channel_state> states(num_channels, channel_state{0, 0});
+
+	for (size_t b = 0; b != this->get_num_blocks(); ++b) {
+		unsigned num_frames_in_block = this->get_num_frames(b);
+		auto block_pcm = pcm.subspan(b * this->num_block_frames * num_channels, num_frames_in_block * num_channels);
+
+		auto dst = std::next(this->data.begin(), ptrdiff_t(b * block_size_bytes));
+
+		for (unsigned c = 0; c != num_channels; ++c) {
+			auto& s = states[c];
+
+			// the step index is carried on from previous block, so that there is no adaptation lag
+			// at the beginning of each block
+			s.predictor = block_pcm[c];
+
+			auto p = uint16_t(int16_t(s.predictor));
+			*dst = uint8_t(p & 0xff);
+			++dst;
+			*dst = uint8_t(p >> 8);
+			++dst;
+			*dst = uint8_t(s.step_index);
+			++dst;
+			*dst = 0; // reserved
+			++dst;
+
+			for (unsigned i = 1; i < num_frames_in_block; i += 2) {
+				unsigned lo = s.encode(block_pcm[i * num_channels + c]);
+				unsigned hi = 0;
+				if (i + 1 < num_frames_in_block) {
+					hi = s.encode(block_pcm[(i + 1) * num_channels + c]);
+				}
+				*dst = uint8_t(lo | (hi << 4));
+				++dst;
+			}
+
+			// skip padding of the last incomplete block
+			dst += ptrdiff_t(this->channel_block_size_bytes() - channel_header_size_bytes) -
+				ptrdiff_t(num_frames_in_block / 2);
+		}
+	}
+}
+
+void adpcm_clip::decode(size_t block_index, utki::span<int16_t> dst) const noexcept
+{
+	unsigned num_frames_in_block = this->get_num_frames(block_index);
+	utki::assert(dst.size() == size_t(num_frames_in_block) * this->num_channels, SL);
+
+	size_t channel_size_bytes = this->channel_block_size_bytes();
+	const uint8_t* block = this->data.data() + block_index * channel_size_bytes * this->num_channels;
+
+	for (unsigned c = 0; c != this->num_channels; ++c) {
+		const uint8_t* src = block + c * channel_size_bytes;
+
+		channel_state s{
+			int16_t(uint16_t(src[0] | (src[1] << 8))), //
+			std::min(int(src[2]), max_step_index)
+		};
+		src += channel_header_size_bytes;
+
+		int16_t* out = dst.data() + c;
+		*out = int16_t(s.predictor);
+		out += this->num_channels;
+
+		for (unsigned i = 1; i < num_frames_in_block; i += 2, ++src) {
+			s.decode(*src & 0xf);
+			*out = int16_t(s.predictor);
+			out += this->num_channels;
+
+			if (i + 1 < num_frames_in_block) {
+				s.decode(*src >> 4);
+				*out = int16_t(s.predictor);
+				out += this->num_channels;
+			}
+		}
+	}
+}
+
+adpcm_voice::adpcm_voice(std::shared_ptr<const adpcm_clip> clip) :
+	clip(std::move(clip))
+{
+	if (!this->clip) {
+		throw std::invalid_argument("adpcm_voice::adpcm_voice(): clip is nullptr");
+	}
+	this->cache.resize(size_t(this->clip->get_num_block_frames()) * this->clip->get_num_channels());
+}
+
+void adpcm_voice::seek(size_t frame) noexcept
+{
+	this->cur_frame = std::min(frame, this->clip->get_num_frames());
+}
+
+size_t adpcm_voice::fill(utki::span<int16_t> buf) noexcept
+{
+	const auto& c = *this->clip;
+	unsigned num_channels = c.get_num_channels();
+	utki::assert(buf.size() % num_channels == 0, SL);
+
+	size_t num_frames = std::min(buf.size() / num_channels, c.get_num_frames() - this->cur_frame);
+
+	int16_t* dst = buf.data();
+
+	for (size_t frames_left = num_frames; frames_left != 0;) {
+		size_t block_index = this->cur_frame / c.get_num_block_frames();
+		unsigned offset = unsigned(this->cur_frame % c.get_num_block_frames());
+		unsigned num_frames_in_block = c.get_num_frames(block_index);
+
+		size_t n = std::min(frames_left, size_t(num_frames_in_block - offset));
+		size_t num_samples = n * num_channels;
+
+		if (offset == 0 && n == num_frames_in_block) {
+			// whole block is needed, decode it right into the destination buffer
+			c.decode(block_index, utki::make_span(dst, num_samples));
+		} else {
+			if (this->cached_block != block_index) {
+				c.decode(
+					block_index, //
+					utki::make_span(this->cache.data(), size_t(num_frames_in_block) * num_channels)
+				);
+				this->cached_block = block_index;
+			}
+			std::memcpy(dst, this->cache.data() + size_t(offset) * num_channels, num_samples * sizeof(int16_t));
+		}
+
+		dst += num_samples;
+		frames_left -= n;
+		this->cur_frame += n;
+	}
+
+	return num_frames;
+}
@@ -0,0 +1,172 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <utki/span.hpp>
+
+namespace audout {
+
+/**
+ * @brief IMA-ADPCM compressed sound clip.
+ * Keeps 16-bit PCM samples encoded with 4 bits per sample in memory.
+ * The clip is split into blocks of fixed number of frames, each block can be decoded independently
+ * of others, so only the blocks which are currently being played need to be decoded.
+ */
+class adpcm_clip
+{
+	unsigned num_channels;
+	unsigned num_block_frames;
+	size_t num_frames;
+
+	// block layout: for each channel a 4 byte header (initial predictor and step index)
+	// followed by packed 4-bit codes of the rest of the block's samples of that channel
+	std::vector<uint8_t> data;
+
+	size_t channel_block_size_bytes() const noexcept;
+
+public:
+	/**
+	 * @brief Default number of frames per block.
+	 * With this value a single channel of the block occupies exactly 512 bytes.
+	 */
+	constexpr static unsigned default_num_block_frames = 1017;
+
+	/**
+	 * @brief Encode PCM samples to IMA-ADPCM clip.
+	 * @param pcm - interleaved 16-bit PCM samples to encode.
+	 * @param num_channels - number of channels in the PCM data.
+	 * @param num_block_frames - number of frames per independently decodable block.
+	 * @throw std::invalid_argument - in case number of channels or block size is 0,
+	 *                                or the PCM data does not consist of whole frames.
+	 */
+	adpcm_clip(
+		utki::span<const int16_t> pcm, //
+		unsigned num_channels,
+		unsigned num_block_frames = default_num_block_frames
+	);
+
+	unsigned get_num_channels() const noexcept
+	{
+		return this->num_channels;
+	}
+
+	unsigned get_num_block_frames() const noexcept
+	{
+		return this->num_block_frames;
+	}
+
+	size_t get_num_frames() const noexcept
+	{
+		return this->num_frames;
+	}
+
+	size_t get_num_blocks() const noexcept;
+
+	/**
+	 * @brief Get size of the encoded data.
+	 * @return Number of bytes occupied by the encoded samples.
+	 */
+	size_t get_size_bytes() const noexcept
+	{
+		return this->data.size();
+	}
+
+	/**
+	 * @brief Get number of frames in the block.
+	 * All blocks except the last one have get_num_block_frames() frames.
+	 * @param block_index - index of the block.
+	 * @return Number of frames in the block.
+	 */
+	unsigned get_num_frames(size_t block_index) const noexcept;
+
+	/**
+	 * @brief Decode block of samples.
+	 * @param block_index - index of the block to decode.
+	 * @param dst - buffer to put decoded interleaved samples to.
+	 *              Must be exactly of get_num_frames(block_index) * get_num_channels() samples size.
+	 */
+	void decode(size_t block_index, utki::span<int16_t> dst) const noexcept;
+};
+
+/**
+ * @brief Playback cursor over IMA-ADPCM clip.
+ * Decodes the clip's blocks on the fly while playing. Blocks which are entirely covered by
+ * the destination buffer are decoded right into it, partially used blocks are decoded into
+ * the voice's single block cache.
+ * Each voice has its own cache, so several voices can play the same clip simultaneously.
+ */
+class adpcm_voice
+{
+	std::shared_ptr<const adpcm_clip> clip;
+
+	size_t cur_frame = 0;
+
+	constexpr static auto invalid_block = std::numeric_limits<size_t>::max();
+	size_t cached_block = invalid_block;
+	std::vector<int16_t> cache;
+
+public:
+	/**
+	 * @brief Create a voice.
+	 * Allocates the block cache, no allocations are made later on during playing.
+	 * @param clip - clip to play.
+	 */
+	adpcm_voice(std::shared_ptr<const adpcm_clip> clip);
+
+	/**
+	 * @brief Fill buffer with next portion of the clip's samples.
+	 * Intended to be called from within audout::listener::fill().
+	 * @param buf - buffer to fill with interleaved samples.
+	 *              The number of channels is the same as the one of the clip.
+	 * @return Number of frames written to the buffer. Less than the buffer can hold
+	 *         in case end of the clip has been reached.
+	 */
+	size_t fill(utki::span<int16_t> buf) noexcept;
+
+	/**
+	 * @brief Set playing position.
+	 * @param frame - index of the frame to continue playing from.
+	 */
+	void seek(size_t frame) noexcept;
+
+	size_t get_position() const noexcept
+	{
+		return this->cur_frame;
+	}
+
+	bool is_finished() const noexcept
+	{
+		return this->cur_frame >= this->clip->get_num_frames();
+	}
+};
+
+} // namespace audout
@@ -59,11 +59,35 @@ class audio_backend : public write_based, public utki::destructable
 
 	unsigned frame_size;
 
+	// buffer geometry set up by the constructor, it is not read back from the device
+	audout::buffer_geometry geometry;
+
 public:
-	audio_backend(audout::format format, unsigned bufferSizeFrames, audout::listener* listener) :
-		write_based(listener, bufferSizeFrames * format.num_channels()),
+	audio_backend(
+		audout::format format,
+		unsigned bufferSizeFrames,
+		audout::listener* listener,
+		audout::duplex_listener* duplexListener,
+		const std::string& deviceName
+	) :
+		write_based(listener, nullptr, format, bufferSizeFrames),
 		frame_size(format.frame_size())
 	{
+		if (duplexListener) {
+			throw std::logic_error("ALSA: full-duplex mode is not supported");
+		}
+
+		if (!deviceName.empty()) {
+			throw std::logic_error("ALSA: output device selection is not supported");
+		}
+
+		// two periods of the requested size, the device starts playing on first write, see SetHWParams()
+		// and SetSwParams()
+		this->geometry.buffer_frames = 2 * bufferSizeFrames;
+		this->geometry.num_periods = 2;
+		this->geometry.min_request_frames = bufferSizeFrames;
+		this->geometry.prebuffer_frames = 0;
+
 		//		TRACE(<< "setting HW params" << std::endl)
 
 		this->SetHWParams(bufferSizeFrames, format);
@@ -80,6 +104,34 @@ public:
 		this->startThread();
 	}
 
+	std::chrono::microseconds get_startup_latency() const noexcept
+	{
+		// not measured
+		return {};
+	}
+
+	std::chrono::microseconds get_output_latency() const noexcept
+	{
+		// not measured
+		return {};
+	}
+
+	void set_buffer_geometry(const audout::buffer_geometry&)
+	{
+		// hardware parameters cannot be changed while the audio thread writes to the device
+		throw std::logic_error("ALSA: changing buffer geometry is not supported");
+	}
+
+	void reconfigure(audout::format, uint32_t, audout::listener*)
+	{
+		throw std::logic_error("ALSA: reconfiguration is not supported");
+	}
+
+	audout::buffer_geometry get_buffer_geometry() const noexcept
+	{
+		return this->geometry;
+	}
+
 	virtual ~audio_backend() throw()
 	{
 		this->stopThread();
@@ -115,7 +167,7 @@ public:
 		return err;
 	}
 
-	void write(const utki::span<std::int16_t> buf) override
+	size_t write(utki::span<const uint8_t> buf) override
 	{
 		ASSERT(buf.size() % this->frame_size == 0)
 
@@ -141,6 +193,23 @@ public:
 			}
 			numFramesWritten += ret;
 		}
+
+		return buf.size();
+	}
+
+	static snd_pcm_format_t ToALSAFormat(audout::sample_format sampleType)
+	{
+		switch (sampleType) {
+			case audout::sample_format::int16:
+				return SND_PCM_FORMAT_S16;
+			case audout::sample_format::int24:
+				return SND_PCM_FORMAT_S24_3LE;
+			case audout::sample_format::int32:
+				return SND_PCM_FORMAT_S32;
+			case audout::sample_format::float32:
+				return SND_PCM_FORMAT_FLOAT;
+		}
+		throw std::invalid_argument("unknown sample format");
 	}
 
 	void SetHWParams(unsigned bufferSizeFrames, audout::format format)
@@ -178,7 +247,7 @@ public:
 			throw std::runtime_error("cannot set access type");
 		}
 
-		if (snd_pcm_hw_params_set_format(this->device.handle, hw.params, SND_PCM_FORMAT_S16_LE) < 0) {
+		if (snd_pcm_hw_params_set_format(this->device.handle, hw.params, ToALSAFormat(format.sample_type)) < 0) {
 			LOG([&](auto& o) {
 				o << "cannot set sample format" << std::endl;
 			})
@@ -31,6 +31,12 @@ SOFTWARE.
 #include <utki/destructable.hpp>
 
 #include "../format.hpp"
+#include "../latency.hpp"
+#include "../realtime.hpp"
+
+#include "fill.cxx"
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#include "wakeup_meter.cxx"
 
 #ifdef assert
 #	undef assert
@@ -73,6 +79,15 @@ class audio_backend : public utki::destructable
 		}
 	} audioComponent;
 
+	audout::listener* listener;
+
+	audout::sample_format sample_type;
+
+	wakeup_meter wakeups;
+
+	// the audio unit requests data by its own periods from the render callback
+	const audout::buffer_geometry geometry;
+
 	static OSStatus outputCallback(
 		void* inRefCon,
 		AudioUnitRenderActionFlags* ioActionFlags,
@@ -82,14 +97,19 @@ class audio_backend : public utki::destructable
 		AudioBufferList* ioData
 	)
 	{
-		auto listener = reinterpret_cast<audout::listener*>(inRefCon);
+		auto backend = reinterpret_cast<audio_backend*>(inRefCon);
+
+		audout::realtime_scope realtime;
+
+		backend->wakeups.tick();
 
 		for (unsigned i = 0; i != ioData->mNumberBuffers; ++i) {
 			auto& buf = ioData->mBuffers[i];
 			//			TRACE(<< "num channels = " << buf.mNumberChannels << std::endl)
-			utki::assert(buf.mDataByteSize % sizeof(std::int16_t) == 0, SL);
-			listener->fill(
-				utki::make_span(reinterpret_cast<std::int16_t*>(buf.mData), buf.mDataByteSize / sizeof(std::int16_t))
+			fill(
+				*backend->listener,
+				backend->sample_type,
+				utki::make_span(reinterpret_cast<uint8_t*>(buf.mData), size_t(buf.mDataByteSize))
 			);
 		}
 
@@ -97,8 +117,25 @@ class audio_backend : public utki::destructable
 	}
 
 public:
-	audio_backend(audout::format outputFormat, std::uint32_t bufferSizeFrames, audout::listener* listener)
+	audio_backend(
+		audout::format outputFormat,
+		std::uint32_t bufferSizeFrames,
+		audout::listener* listener,
+		audout::duplex_listener* duplexListener,
+		const std::string& deviceName
+	) :
+		listener(listener),
+		sample_type(outputFormat.sample_type),
+		geometry{bufferSizeFrames, 1, audout::buffer_geometry::backend_default, 0}
 	{
+		if (duplexListener) {
+			throw std::logic_error("CoreAudio: full-duplex mode is not supported");
+		}
+
+		if (!deviceName.empty()) {
+			throw std::logic_error("CoreAudio: output device selection is not supported");
+		}
+
 		if (AudioUnitInitialize(this->audioComponent.instance)) {
 			throw std::runtime_error("Failed to initialize audio unit instance");
 		}
@@ -106,11 +143,13 @@ public:
 		AudioStreamBasicDescription formatDesc;
 		formatDesc.mSampleRate = outputFormat.frequency();
 		formatDesc.mFormatID = kAudioFormatLinearPCM;
-		formatDesc.mFormatFlags = kAudioFormatFlagIsSignedInteger;
+		formatDesc.mFormatFlags = kAudioFormatFlagIsPacked |
+			(outputFormat.sample_type == audout::sample_format::float32 ? kAudioFormatFlagIsFloat
+																		: kAudioFormatFlagIsSignedInteger);
 		formatDesc.mFramesPerPacket = 1;
 		formatDesc.mChannelsPerFrame = outputFormat.num_channels();
-		formatDesc.mBitsPerChannel = 16;
-		formatDesc.mBytesPerFrame = formatDesc.mChannelsPerFrame * 2;
+		formatDesc.mBitsPerChannel = outputFormat.sample_size() * 8;
+		formatDesc.mBytesPerFrame = outputFormat.frame_size();
 		formatDesc.mBytesPerPacket = formatDesc.mBytesPerFrame * formatDesc.mFramesPerPacket;
 
 		if (AudioUnitSetProperty(
@@ -128,7 +167,7 @@ public:
 		AURenderCallbackStruct callback;
 		memset(&callback, 0, sizeof(callback));
 		callback.inputProc = &outputCallback;
-		callback.inputProcRefCon = listener;
+		callback.inputProcRefCon = this;
 
 		if (AudioUnitSetProperty(
 				this->audioComponent.instance,
@@ -150,6 +189,44 @@ public:
 		this->set_paused(true);
 	}
 
+	std::chrono::microseconds get_duplex_latency() const noexcept
+	{
+		// full-duplex mode is not supported
+		return {};
+	}
+
+	float get_wakeup_rate() const noexcept
+	{
+		return this->wakeups.get_rate();
+	}
+
+	std::chrono::microseconds get_startup_latency() const noexcept
+	{
+		// not measured
+		return {};
+	}
+
+	std::chrono::microseconds get_output_latency() const noexcept
+	{
+		// not measured
+		return {};
+	}
+
+	void set_buffer_geometry(const audout::buffer_geometry&)
+	{
+		throw std::logic_error("CoreAudio: changing buffer geometry is not supported");
+	}
+
+	void reconfigure(audout::format, uint32_t, audout::listener*)
+	{
+		throw std::logic_error("CoreAudio: reconfiguration is not supported");
+	}
+
+	audout::buffer_geometry get_buffer_geometry() const noexcept
+	{
+		return this->geometry;
+	}
+
 	void set_paused(bool paused)
 	{
 		if (paused) {
@@ -45,13 +45,36 @@ SOFTWARE.
 // It should be included before dsound.h.
 #include <initguid.h>
 #include <dsound.h>
+#include <mmreg.h>
+#include <ks.h>
+#include <ksmedia.h>
 
 // clang-format on
 
+#include "../latency.hpp"
 #include "../player.hpp"
+#include "../realtime.hpp"
+
+#include "fill.cxx"
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#include "wakeup_meter.cxx"
 
 namespace {
 
+DWORD get_channel_mask(audout::frame frame_type)
+{
+	switch (frame_type) {
+		case audout::frame::mono:
+			return KSAUDIO_SPEAKER_MONO;
+		case audout::frame::stereo:
+			return KSAUDIO_SPEAKER_STEREO;
+		case audout::frame::surround_5_1:
+			// same channel order as audout::frame::surround_5_1
+			return KSAUDIO_SPEAKER_5POINT1;
+	}
+	throw std::invalid_argument("DirectSound: unsupported number of channels");
+}
+
 class WinEvent : public opros::waitable
 {
 	void set_waiting_flags(utki::flags<opros::ready> wait_for) override
@@ -113,6 +136,8 @@ class audio_backend : public utki::destructable
 {
 	audout::listener* listener;
 
+	audout::sample_format sample_type;
+
 	std::thread thread;
 
 	nitki::queue queue;
@@ -158,16 +183,27 @@ class audio_backend : public utki::destructable
 		direct_sound_buffer(direct_sound& ds, unsigned bufferSizeFrames, audout::format format) :
 			halfSize(format.frame_size() * bufferSizeFrames)
 		{
-			WAVEFORMATEX wf;
-			memset(&wf, 0, sizeof(WAVEFORMATEX));
-
-			wf.nChannels = WORD(format.num_channels());
-			wf.nSamplesPerSec = format.frequency();
-
-			wf.wFormatTag = WAVE_FORMAT_PCM;
-			wf.wBitsPerSample = 16;
-			wf.nBlockAlign = wf.nChannels * (wf.wBitsPerSample / 8);
-			wf.nAvgBytesPerSec = wf.nSamplesPerSec * wf.nBlockAlign;
+			WAVEFORMATEXTENSIBLE wf;
+			memset(&wf, 0, sizeof(WAVEFORMATEXTENSIBLE));
+
+			bool is_float = format.sample_type == audout::sample_format::float32;
+
+			wf.Format.nChannels = WORD(format.num_channels());
+			wf.Format.nSamplesPerSec = format.frequency();
+
+			wf.Format.wFormatTag = is_float ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM;
+			wf.Format.wBitsPerSample = WORD(format.sample_size() * 8);
+			wf.Format.nBlockAlign = wf.Format.nChannels * (wf.Format.wBitsPerSample / 8);
+			wf.Format.nAvgBytesPerSec = wf.Format.nSamplesPerSec * wf.Format.nBlockAlign;
+
+			// plain WAVEFORMATEX has no channel layout and is ambiguous for integer samples wider than 16 bits
+			if (wf.Format.nChannels > 2 || (!is_float && wf.Format.wBitsPerSample > 16)) {
+				wf.Format.wFormatTag = WAVE_FORMAT_EXTENSIBLE;
+				wf.Format.cbSize = sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX);
+				wf.Samples.wValidBitsPerSample = wf.Format.wBitsPerSample;
+				wf.dwChannelMask = get_channel_mask(format.frame_type);
+				wf.SubFormat = is_float ? KSDATAFORMAT_SUBTYPE_IEEE_FLOAT : KSDATAFORMAT_SUBTYPE_PCM;
+			}
 
 			DSBUFFERDESC dsbdesc;
 			memset(&dsbdesc, 0, sizeof(DSBUFFERDESC));
@@ -175,7 +211,7 @@ class audio_backend : public utki::destructable
 			dsbdesc.dwSize = sizeof(DSBUFFERDESC);
 			dsbdesc.dwFlags = DSBCAPS_GETCURRENTPOSITION2 | DSBCAPS_CTRLPOSITIONNOTIFY | DSBCAPS_GLOBALFOCUS;
 			dsbdesc.dwBufferBytes = 2 * this->halfSize;
-			dsbdesc.lpwfxFormat = &wf;
+			dsbdesc.lpwfxFormat = &wf.Format;
 
 			if (dsbdesc.dwBufferBytes < DSBSIZE_MIN || DSBSIZE_MAX < dsbdesc.dwBufferBytes) {
 				throw std::invalid_argument(
@@ -245,6 +281,11 @@ class audio_backend : public utki::destructable
 
 	WinEvent event1, event2;
 
+	wakeup_meter wakeups;
+
+	// the buffer is filled by halves, playback starts right away
+	const audout::buffer_geometry geometry;
+
 	void fillDSBuffer(unsigned partNum)
 	{
 		ASSERT(partNum == 0 || partNum == 1)
@@ -271,7 +312,11 @@ class audio_backend : public utki::destructable
 		ASSERT(addr != 0)
 		ASSERT(size == this->dsb.halfSize)
 
-		this->listener->fill(utki::make_span(static_cast<std::int16_t*>(addr), size / 2));
+		{
+			audout::realtime_scope realtime;
+			this->wakeups.tick();
+			fill(*this->listener, this->sample_type, utki::make_span(static_cast<uint8_t*>(addr), size_t(size)));
+		}
 
 		// unlock the buffer
 		if (this->dsb.dsb->Unlock(addr, size, nullptr, 0) != DS_OK) {
@@ -317,6 +362,44 @@ class audio_backend : public utki::destructable
 	}
 
 public:
+	std::chrono::microseconds get_duplex_latency() const noexcept
+	{
+		// full-duplex mode is not supported
+		return {};
+	}
+
+	float get_wakeup_rate() const noexcept
+	{
+		return this->wakeups.get_rate();
+	}
+
+	std::chrono::microseconds get_startup_latency() const noexcept
+	{
+		// not measured
+		return {};
+	}
+
+	std::chrono::microseconds get_output_latency() const noexcept
+	{
+		// not measured
+		return {};
+	}
+
+	void set_buffer_geometry(const audout::buffer_geometry&)
+	{
+		throw std::logic_error("DirectSound: changing buffer geometry is not supported");
+	}
+
+	void reconfigure(audout::format, uint32_t, audout::listener*)
+	{
+		throw std::logic_error("DirectSound: reconfiguration is not supported");
+	}
+
+	audout::buffer_geometry get_buffer_geometry() const noexcept
+	{
+		return this->geometry;
+	}
+
 	void set_paused(bool pause)
 	{
 		if (pause) {
@@ -331,10 +414,26 @@ public:
 	}
 
 public:
-	audio_backend(audout::format format, unsigned bufferSizeFrames, audout::listener* listener) :
+	audio_backend(
+		audout::format format,
+		unsigned bufferSizeFrames,
+		audout::listener* listener,
+		audout::duplex_listener* duplexListener,
+		const std::string& deviceName
+	) :
 		listener(listener),
-		dsb(this->ds, bufferSizeFrames, format)
+		sample_type(format.sample_type),
+		dsb(this->ds, bufferSizeFrames, format),
+		geometry{2 * bufferSizeFrames, 2, bufferSizeFrames, 0}
 	{
+		if (duplexListener) {
+			throw std::logic_error("DirectSound: full-duplex mode is not supported");
+		}
+
+		if (!deviceName.empty()) {
+			throw std::logic_error("DirectSound: output device selection is not supported");
+		}
+
 		// set notification points
 		{
 			LPDIRECTSOUNDNOTIFY notify;
@@ -0,0 +1,377 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <utki/debug.hpp>
+#include <utki/destructable.hpp>
+#include <utki/span.hpp>
+
+#include "../convert.hpp"
+#include "../drift_compensator.hpp"
+#include "../latency.hpp"
+#include "../player.hpp"
+#include "../realtime.hpp"
+#include "../ring_buffer.hpp"
+
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#include "fill.cxx"
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#include "wakeup_meter.cxx"
+
+namespace {
+
+// Renders the listener once per period and feeds the result to several output devices.
+// Rendering is done by a separate thread paced by the monotonic clock, each output gets rendered
+// frames through its own ring buffer and resamples them to compensate the drift of its device clock
+// relatively to the monotonic clock. A slow device only overruns its own ring buffer.
+class fan_out : public utki::destructable
+{
+	class output : public audout::listener
+	{
+		const unsigned num_channels;
+		const double sampling_rate;
+
+		audout::ring_buffer<float> ring;
+
+		// ring buffer level to maintain, in samples
+		const size_t target_level;
+
+		// set when the ring buffer level reaches the target level after start or underrun
+		bool primed = false;
+
+		audout::drift_compensator drift;
+		std::vector<float> resampled_buffer;
+
+		template <typename sample_type>
+		void process(utki::span<sample_type> play_buffer) noexcept
+		{
+			if (!this->primed) {
+				if (this->ring.size() < this->target_level) {
+					std::fill(play_buffer.begin(), play_buffer.end(), audout::from_float<sample_type>(0));
+					return;
+				}
+				this->primed = true;
+				this->drift.reset();
+			}
+
+			for (auto dst = play_buffer.begin(); dst != play_buffer.end();) {
+				auto resampled = utki::make_span(
+					this->resampled_buffer.data(),
+					std::min(this->resampled_buffer.size(), size_t(std::distance(dst, play_buffer.end())))
+				);
+
+				this->drift.process(resampled, [this](utki::span<float> input) {
+					auto n = this->ring.read(input);
+					if (n != input.size()) {
+						// underrun, play the rest as silence and wait for the ring buffer to be refilled
+						std::fill(std::next(input.begin(), ptrdiff_t(n)), input.end(), 0.0f);
+						this->primed = false;
+					}
+				});
+
+				dst = std::transform(resampled.begin(), resampled.end(), dst, [](float s) {
+					return audout::from_float<sample_type>(s);
+				});
+			}
+
+			// Ring buffer level above the target means that the device consumes slower than the frames
+			// are rendered, so the consumption is to be sped up.
+			auto error = double(this->ring.size()) - double(this->target_level);
+			auto num_frames = double(play_buffer.size() / this->num_channels);
+			this->drift.control(
+				std::chrono::duration<double>(error / double(this->num_channels) / this->sampling_rate),
+				std::chrono::duration<double>(num_frames / this->sampling_rate)
+			);
+		}
+
+	public:
+		// declared last, so that the device is closed before the rest is destroyed
+		std::unique_ptr<audio_backend> backend;
+
+		output(audout::format output_format, uint32_t num_period_frames) :
+			num_channels(output_format.num_channels()),
+			sampling_rate(double(output_format.frequency())),
+			ring(size_t(num_period_frames) * ring_buffer_num_periods * output_format.num_channels()),
+			target_level(size_t(num_period_frames) * target_num_periods * output_format.num_channels()),
+			drift(output_format.num_channels(), num_period_frames),
+			resampled_buffer(size_t(num_period_frames) * output_format.num_channels())
+		{}
+
+		void write(utki::span<const float> buf) noexcept
+		{
+			// In case the device is stalled, the frames which do not fit are dropped.
+			// The ring buffer capacity is not necessarily a multiple of the frame size, so only
+			// whole frames are written, otherwise the channels would get rotated from then on.
+			// The consumer only frees space, so the free space can not shrink before the write.
+			auto n = std::min(buf.size(), this->ring.capacity() - this->ring.size());
+			n -= n % this->num_channels;
+			this->ring.write(buf.subspan(0, n));
+		}
+
+		void fill(utki::span<int16_t> play_buffer) noexcept override
+		{
+			this->process(play_buffer);
+		}
+
+		void fill(utki::span<audout::int24> play_buffer) noexcept override
+		{
+			this->process(play_buffer);
+		}
+
+		void fill(utki::span<int32_t> play_buffer) noexcept override
+		{
+			this->process(play_buffer);
+		}
+
+		void fill(utki::span<float> play_buffer) noexcept override
+		{
+			this->process(play_buffer);
+		}
+	};
+
+	// number of periods rendered ahead, i.e. the latency added by fan-out
+	constexpr static size_t target_num_periods = 2;
+	constexpr static size_t ring_buffer_num_periods = 8;
+
+	audout::listener& listener;
+
+	const std::chrono::duration<double> period;
+
+	// The listener is filled in the output sample format, so that the player's pipeline processes
+	// the samples as for a single device, e.g. dithers 16-bit output and passes the samples in the output
+	// format to the recorder. Then the samples are converted to float for the output ring buffers.
+	const audout::sample_format sample_type;
+	std::vector<uint8_t> render_buffer;
+	std::vector<float> float_buffer;
+
+	std::vector<std::unique_ptr<output>> outputs;
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool paused = true;
+	bool quit = false;
+
+	wakeup_meter wakeups;
+
+	std::thread render_thread;
+
+	void render() noexcept
+	{
+		audout::realtime_scope realtime;
+
+		this->wakeups.tick();
+
+		switch (this->sample_type) {
+			case audout::sample_format::int16:
+				this->render_to_float<int16_t>();
+				break;
+			case audout::sample_format::int24:
+				this->render_to_float<audout::int24>();
+				break;
+			case audout::sample_format::int32:
+				this->render_to_float<int32_t>();
+				break;
+			case audout::sample_format::float32:
+				this->listener.fill(utki::make_span(this->float_buffer));
+				break;
+		}
+
+		for (auto& o : this->outputs) {
+			o->write(utki::make_span(this->float_buffer));
+		}
+	}
+
+	template <typename sample_type>
+	void render_to_float() noexcept
+	{
+		fill(this->listener, this->sample_type, utki::make_span(this->render_buffer));
+
+		auto buf = utki::make_span(
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "raw buffer holds samples of output format")
+			reinterpret_cast<const sample_type*>(this->render_buffer.data()),
+			this->float_buffer.size()
+		);
+		std::transform(buf.begin(), buf.end(), this->float_buffer.begin(), [](sample_type s) {
+			return audout::to_float(s);
+		});
+	}
+
+	void run()
+	{
+		using clock = std::chrono::steady_clock;
+
+		auto period = std::chrono::duration_cast<clock::duration>(this->period);
+
+		std::unique_lock lock(this->mutex);
+		for (;;) {
+			this->wakeups.reset();
+			this->cv.wait(lock, [this]() {
+				return this->quit || !this->paused;
+			});
+			if (this->quit) {
+				break;
+			}
+
+			auto deadline = clock::now();
+
+			while (!this->quit && !this->paused) {
+				lock.unlock();
+
+				this->render();
+				deadline += period;
+
+				// in case rendering fell behind for longer than outputs can buffer, do not try to catch up
+				auto now = clock::now();
+				if (now - deadline > period * ring_buffer_num_periods) {
+					deadline = now;
+				}
+
+				lock.lock();
+				this->cv.wait_until(lock, deadline, [this]() {
+					return this->quit || this->paused;
+				});
+			}
+		}
+	}
+
+public:
+	fan_out(
+		audout::format output_format, //
+		uint32_t num_buffer_frames,
+		audout::listener& listener,
+		const std::vector<std::string>& device_names
+	) :
+		listener(listener),
+		period(double(num_buffer_frames) / double(output_format.frequency())),
+		sample_type(output_format.sample_type),
+		render_buffer(size_t(num_buffer_frames) * output_format.frame_size()),
+		float_buffer(size_t(num_buffer_frames) * output_format.num_channels())
+	{
+		if (device_names.empty()) {
+			throw std::invalid_argument("fan_out::fan_out(): no output devices given");
+		}
+
+		for (const auto& name : device_names) {
+			auto o = std::make_unique<output>(output_format, num_buffer_frames);
+			o->backend = std::make_unique<audio_backend>(
+				output_format, //
+				num_buffer_frames,
+				o.get(),
+				nullptr,
+				name
+			);
+			this->outputs.push_back(std::move(o));
+		}
+
+		this->render_thread = std::thread([this]() {
+			this->run();
+		});
+	}
+
+	fan_out(const fan_out&) = delete;
+	fan_out& operator=(const fan_out&) = delete;
+
+	fan_out(fan_out&&) = delete;
+	fan_out& operator=(fan_out&&) = delete;
+
+	~fan_out() override
+	{
+		{
+			std::lock_guard lock(this->mutex);
+			this->quit = true;
+		}
+		this->cv.notify_all();
+		this->render_thread.join();
+	}
+
+	void set_paused(bool pause)
+	{
+		{
+			std::lock_guard lock(this->mutex);
+			this->paused = pause;
+		}
+		this->cv.notify_all();
+
+		// the frames left in ring buffers are played after resuming
+		for (auto& o : this->outputs) {
+			o->backend->set_paused(pause);
+		}
+	}
+
+	std::chrono::microseconds get_duplex_latency() const noexcept
+	{
+		return {};
+	}
+
+	float get_wakeup_rate() const noexcept
+	{
+		return this->wakeups.get_rate();
+	}
+
+	std::chrono::microseconds get_startup_latency() const noexcept
+	{
+		utki::assert(!this->outputs.empty(), SL);
+		return this->outputs.front()->backend->get_startup_latency();
+	}
+
+	// reports latency of the first output device, not counting the ring buffer
+	std::chrono::microseconds get_output_latency()
+	{
+		utki::assert(!this->outputs.empty(), SL);
+		return this->outputs.front()->backend->get_output_latency();
+	}
+
+	void set_buffer_geometry(const audout::buffer_geometry&)
+	{
+		// ring buffers only hold several render periods
+		throw std::logic_error("fan-out does not support changing buffer geometry");
+	}
+
+	void reconfigure(audout::format, uint32_t, audout::listener*)
+	{
+		// output ring buffers and drift compensators are bound to the format
+		throw std::logic_error("fan-out does not support reconfiguration");
+	}
+
+	// reports geometry of the first output device
+	audout::buffer_geometry get_buffer_geometry()
+	{
+		utki::assert(!this->outputs.empty(), SL);
+		return this->outputs.front()->backend->get_buffer_geometry();
+	}
+};
+
+} // namespace
@@ -0,0 +1,65 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <utki/debug.hpp>
+#include <utki/span.hpp>
+
+#include "../player.hpp"
+
+namespace {
+
+// calls listener's fill() overload which corresponds to the sample format of the raw buffer
+inline void fill(
+	audout::listener& listener, //
+	audout::sample_format sample_type,
+	utki::span<uint8_t> buf
+) noexcept
+{
+	utki::assert(buf.size() % audout::sample_size(sample_type) == 0, SL);
+
+	// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast, "raw buffer holds samples of given format")
+	switch (sample_type) {
+		case audout::sample_format::int16:
+			listener.fill(utki::make_span(reinterpret_cast<int16_t*>(buf.data()), buf.size() / sizeof(int16_t)));
+			break;
+		case audout::sample_format::int24:
+			listener.fill(
+				utki::make_span(reinterpret_cast<audout::int24*>(buf.data()), buf.size() / sizeof(audout::int24))
+			);
+			break;
+		case audout::sample_format::int32:
+			listener.fill(utki::make_span(reinterpret_cast<int32_t*>(buf.data()), buf.size() / sizeof(int32_t)));
+			break;
+		case audout::sample_format::float32:
+			listener.fill(utki::make_span(reinterpret_cast<float*>(buf.data()), buf.size() / sizeof(float)));
+			break;
+	}
+	// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+}
+
+} // namespace
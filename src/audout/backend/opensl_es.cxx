@@ -40,7 +40,12 @@ SOFTWARE.
 
 #endif
 
+#include "../latency.hpp"
 #include "../player.hpp"
+#include "../realtime.hpp"
+
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#include "wakeup_meter.cxx"
 
 namespace {
 
@@ -48,6 +53,11 @@ class audio_backend : public utki::destructable
 {
 	audout::listener* listener;
 
+	wakeup_meter wakeups;
+
+	// two buffers are enqueued in turns, playback starts right away
+	const audout::buffer_geometry geometry;
+
 	struct Engine {
 		SLObjectItf object; // object
 		SLEngineItf engine; // engine interface
@@ -184,6 +194,8 @@ class audio_backend : public utki::destructable
 
 			// fill the second buffer to be enqueued next time the callback is called
 			ASSERT(player->bufs[1].size() % 2 == 0)
+			audout::realtime_scope realtime;
+			player->backend.wakeups.tick();
 			player->backend.listener->fill(utki::span<std::int16_t>(
 				reinterpret_cast<std::int16_t*>(&*player->bufs[1].begin()),
 				player->bufs[1].size() / 2
@@ -199,6 +211,10 @@ class audio_backend : public utki::destructable
 		) :
 			backend(backend)
 		{
+			if (format.sample_type != audout::sample_format::int16) {
+				throw std::invalid_argument("OpenSLES: only 16-bit samples are supported");
+			}
+
 			// allocate play buffers of required size
 			{
 				size_t bufSize = bufferSizeFrames * format.frame_size();
@@ -231,8 +247,7 @@ class audio_backend : public utki::destructable
 					channelMask = SL_SPEAKER_FRONT_LEFT | SL_SPEAKER_FRONT_RIGHT;
 					break;
 				default:
-					ASSERT(false)
-					break;
+					throw std::invalid_argument("OpenSLES: only mono and stereo are supported");
 			}
 			SLDataFormat_PCM audioFormat = {
 				SL_DATAFORMAT_PCM,
@@ -335,14 +350,67 @@ class audio_backend : public utki::destructable
 	} player;
 
 public:
+	std::chrono::microseconds get_duplex_latency() const noexcept
+	{
+		// full-duplex mode is not supported
+		return {};
+	}
+
+	float get_wakeup_rate() const noexcept
+	{
+		return this->wakeups.get_rate();
+	}
+
+	std::chrono::microseconds get_startup_latency() const noexcept
+	{
+		// not measured
+		return {};
+	}
+
+	std::chrono::microseconds get_output_latency() const noexcept
+	{
+		// not measured
+		return {};
+	}
+
+	void set_buffer_geometry(const audout::buffer_geometry&)
+	{
+		throw std::logic_error("OpenSLES: changing buffer geometry is not supported");
+	}
+
+	void reconfigure(audout::format, uint32_t, audout::listener*)
+	{
+		throw std::logic_error("OpenSLES: reconfiguration is not supported");
+	}
+
+	audout::buffer_geometry get_buffer_geometry() const noexcept
+	{
+		return this->geometry;
+	}
+
 	void set_paused(bool pause)
 	{
 		this->player.set_paused(pause);
 	}
 
 	// create buffered queue player
-	audio_backend(audout::format outputFormat, std::uint32_t bufferSizeFrames, audout::listener* listener) :
-		listener(listener),
+	audio_backend(
+		audout::format outputFormat,
+		std::uint32_t bufferSizeFrames,
+		audout::listener* listener,
+		audout::duplex_listener* duplexListener,
+		const std::string& deviceName
+	) :
+		listener([&]() {
+			if (duplexListener) {
+				throw std::logic_error("OpenSLES: full-duplex mode is not supported");
+			}
+			if (!deviceName.empty()) {
+				throw std::logic_error("OpenSLES: output device selection is not supported");
+			}
+			return listener;
+		}()),
+		geometry{2 * bufferSizeFrames, 2, bufferSizeFrames, 0},
 		outputMix(this->engine),
 		player(*this, this->engine, this->outputMix, bufferSizeFrames, outputFormat)
 	{
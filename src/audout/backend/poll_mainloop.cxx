@@ -0,0 +1,640 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include <opros/wait_set.hpp>
+#include <pulse/pulseaudio.h>
+#include <utki/debug.hpp>
+
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#include "wakeup_event.cxx"
+
+namespace {
+
+class poll_mainloop;
+
+// non-owning waitable for a file descriptor owned by PulseAudio
+class fd_waitable : public opros::waitable
+{
+public:
+	fd_waitable(int fd) :
+		opros::waitable(fd)
+	{}
+};
+
+struct io_event {
+	poll_mainloop* loop;
+	fd_waitable waitable;
+	pa_io_event_flags_t events;
+	pa_io_event_cb_t callback;
+	void* user_data;
+	pa_io_event_destroy_cb_t destroy_callback = nullptr;
+
+	// set if the waitable is added to the wait set
+	bool added = false;
+	bool dead = false;
+};
+
+struct time_event {
+	poll_mainloop* loop;
+	std::optional<std::chrono::steady_clock::time_point> deadline;
+	pa_time_event_cb_t callback;
+	void* user_data;
+	pa_time_event_destroy_cb_t destroy_callback = nullptr;
+	bool dead = false;
+};
+
+struct defer_event {
+	poll_mainloop* loop;
+	bool enabled = true;
+	pa_defer_event_cb_t callback;
+	void* user_data;
+	pa_defer_event_destroy_cb_t destroy_callback = nullptr;
+	bool dead = false;
+};
+
+// PulseAudio declares the event types opaque, the main loop implementation decides what they point to
+
+// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast, "opaque handles")
+io_event* to_event(pa_io_event* e) noexcept
+{
+	return reinterpret_cast<io_event*>(e);
+}
+
+time_event* to_event(pa_time_event* e) noexcept
+{
+	return reinterpret_cast<time_event*>(e);
+}
+
+defer_event* to_event(pa_defer_event* e) noexcept
+{
+	return reinterpret_cast<defer_event*>(e);
+}
+
+pa_io_event* to_pa_event(io_event* e) noexcept
+{
+	return reinterpret_cast<pa_io_event*>(e);
+}
+
+pa_time_event* to_pa_event(time_event* e) noexcept
+{
+	return reinterpret_cast<pa_time_event*>(e);
+}
+
+pa_defer_event* to_pa_event(defer_event* e) noexcept
+{
+	return reinterpret_cast<pa_defer_event*>(e);
+}
+
+// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+
+// PulseAudio main loop implementation on top of opros::wait_set.
+// The main loop thread services all PulseAudio streams of a context, so any number of streams
+// is driven by a single thread which sleeps in the wait set until some descriptor becomes ready.
+// Same as with pa_threaded_mainloop, the main loop thread holds the mutex while dispatching events,
+// other threads must lock it before calling PulseAudio functions.
+class poll_mainloop
+{
+	pa_mainloop_api api{};
+
+	std::mutex mutex;
+
+	std::vector<std::unique_ptr<io_event>> io_events;
+	std::vector<std::unique_ptr<time_event>> time_events;
+	std::vector<std::unique_ptr<defer_event>> defer_events;
+
+	// set when io events are added, changed or freed, so that the wait set is to be updated
+	bool io_events_changed = false;
+
+	// initial wait set capacity, it is grown when needed
+	constexpr static unsigned initial_wait_set_capacity = 16;
+
+	std::unique_ptr<opros::wait_set> wait_set;
+
+	audout::wakeup_event wakeup;
+
+	bool quit_flag = false;
+
+	// set by the main loop thread while it waits in the wait set without holding the mutex
+	std::atomic_bool waiting = false;
+
+	std::thread thread;
+
+	bool is_in_thread() const noexcept
+	{
+		return std::this_thread::get_id() == this->thread.get_id();
+	}
+
+	// wake up the main loop thread, so that it picks up the changes
+	void notify() noexcept
+	{
+		if (!this->is_in_thread()) {
+			this->wakeup.signal();
+		}
+	}
+
+	// Makes sure the main loop thread does not use the wait set, so that it can be changed from another thread.
+	// The mutex must be held, so the main loop thread can not start waiting again until it is released.
+	void stop_waiting() noexcept
+	{
+		if (this->is_in_thread() || !this->waiting.load(std::memory_order_relaxed)) {
+			return;
+		}
+		this->wakeup.signal();
+		while (this->waiting.load(std::memory_order_acquire)) {
+			std::this_thread::yield();
+		}
+	}
+
+	static utki::flags<opros::ready> to_ready_flags(pa_io_event_flags_t events) noexcept
+	{
+		utki::flags<opros::ready> ret;
+		ret.set(opros::ready::read, events & PA_IO_EVENT_INPUT);
+		ret.set(opros::ready::write, events & PA_IO_EVENT_OUTPUT);
+		ret.set(opros::ready::error, events & (PA_IO_EVENT_HANGUP | PA_IO_EVENT_ERROR));
+		return ret;
+	}
+
+	static pa_io_event_flags_t to_io_event_flags(utki::flags<opros::ready> flags) noexcept
+	{
+		unsigned ret = PA_IO_EVENT_NULL;
+		if (flags.get(opros::ready::read)) {
+			ret |= PA_IO_EVENT_INPUT;
+		}
+		if (flags.get(opros::ready::write)) {
+			ret |= PA_IO_EVENT_OUTPUT;
+		}
+		if (flags.get(opros::ready::error)) {
+			ret |= PA_IO_EVENT_ERROR;
+		}
+		return pa_io_event_flags_t(ret);
+	}
+
+	// PulseAudio passes either wall clock time or, in case the flag is set,
+	// monotonic clock time, see PA_TIMEVAL_RTCLOCK in pulsecore/core-rtclock.h
+	static std::chrono::steady_clock::time_point to_time_point(const struct timeval& tv)
+	{
+		constexpr decltype(tv.tv_usec) rtclock_flag = 1 << 30;
+
+		using std::chrono::microseconds;
+		using std::chrono::seconds;
+
+		if (tv.tv_usec & rtclock_flag) {
+			// steady_clock is CLOCK_MONOTONIC
+			return std::chrono::steady_clock::time_point(
+				std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+					seconds(tv.tv_sec) + microseconds(tv.tv_usec & ~rtclock_flag)
+				)
+			);
+		}
+
+		auto wall_time = std::chrono::system_clock::time_point(
+			std::chrono::duration_cast<std::chrono::system_clock::duration>(
+				seconds(tv.tv_sec) + microseconds(tv.tv_usec)
+			)
+		);
+		return std::chrono::steady_clock::now() +
+			std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				   wall_time - std::chrono::system_clock::now()
+			);
+	}
+
+	static poll_mainloop& get(pa_mainloop_api* a) noexcept
+	{
+		return *static_cast<poll_mainloop*>(a->userdata);
+	}
+
+	static pa_io_event* io_new(
+		pa_mainloop_api* a, //
+		int fd,
+		pa_io_event_flags_t events,
+		pa_io_event_cb_t cb,
+		void* user_data
+	)
+	{
+		auto& loop = get(a);
+		loop.io_events.push_back(
+			std::unique_ptr<io_event>(new io_event{&loop, fd_waitable(fd), events, cb, user_data})
+		);
+		loop.io_events_changed = true;
+		loop.notify();
+		return to_pa_event(loop.io_events.back().get());
+	}
+
+	static void io_enable(pa_io_event* pa_e, pa_io_event_flags_t events)
+	{
+		auto e = to_event(pa_e);
+		e->events = events;
+		e->loop->io_events_changed = true;
+		e->loop->notify();
+	}
+
+	static void io_free(pa_io_event* pa_e)
+	{
+		auto e = to_event(pa_e);
+		e->dead = true;
+
+		// PulseAudio closes the descriptor right after freeing the event, so the waitable is removed from
+		// the wait set now, while the descriptor is still open. The event itself is deleted later by
+		// the main loop thread, as it can be in the list of triggered events being dispatched.
+		if (e->added) {
+			e->loop->stop_waiting();
+			e->loop->wait_set->remove(e->waitable);
+			e->added = false;
+		}
+
+		e->loop->io_events_changed = true;
+		e->loop->notify();
+	}
+
+	static void io_set_destroy(pa_io_event* pa_e, pa_io_event_destroy_cb_t cb)
+	{
+		auto e = to_event(pa_e);
+		e->destroy_callback = cb;
+	}
+
+	static pa_time_event* time_new(
+		pa_mainloop_api* a, //
+		const struct timeval* tv,
+		pa_time_event_cb_t cb,
+		void* user_data
+	)
+	{
+		auto& loop = get(a);
+		loop.time_events.push_back(std::unique_ptr<time_event>(new time_event{
+			&loop,
+			tv ? std::make_optional(to_time_point(*tv)) : std::nullopt,
+			cb,
+			user_data
+		}));
+		loop.notify();
+		return to_pa_event(loop.time_events.back().get());
+	}
+
+	static void time_restart(pa_time_event* pa_e, const struct timeval* tv)
+	{
+		auto e = to_event(pa_e);
+		e->deadline = tv ? std::make_optional(to_time_point(*tv)) : std::nullopt;
+		e->loop->notify();
+	}
+
+	static void time_free(pa_time_event* pa_e)
+	{
+		auto e = to_event(pa_e);
+		e->dead = true;
+	}
+
+	static void time_set_destroy(pa_time_event* pa_e, pa_time_event_destroy_cb_t cb)
+	{
+		auto e = to_event(pa_e);
+		e->destroy_callback = cb;
+	}
+
+	static pa_defer_event* defer_new(pa_mainloop_api* a, pa_defer_event_cb_t cb, void* user_data)
+	{
+		auto& loop = get(a);
+		loop.defer_events.push_back(std::unique_ptr<defer_event>(new defer_event{&loop, true, cb, user_data}));
+		loop.notify();
+		return to_pa_event(loop.defer_events.back().get());
+	}
+
+	static void defer_enable(pa_defer_event* pa_e, int b)
+	{
+		auto e = to_event(pa_e);
+		e->enabled = b != 0;
+		e->loop->notify();
+	}
+
+	static void defer_free(pa_defer_event* pa_e)
+	{
+		auto e = to_event(pa_e);
+		e->dead = true;
+	}
+
+	static void defer_set_destroy(pa_defer_event* pa_e, pa_defer_event_destroy_cb_t cb)
+	{
+		auto e = to_event(pa_e);
+		e->destroy_callback = cb;
+	}
+
+	static void quit(pa_mainloop_api* a, [[maybe_unused]] int retval)
+	{
+		auto& loop = get(a);
+		loop.quit_flag = true;
+		loop.notify();
+	}
+
+	// remove freed events, calls destroy callbacks
+	template <typename event_type>
+	void sweep(std::vector<std::unique_ptr<event_type>>& events)
+	{
+		auto i = std::remove_if(events.begin(), events.end(), [this](const auto& e) {
+			if (!e->dead) {
+				return false;
+			}
+			if (e->destroy_callback) {
+				e->destroy_callback(&this->api, to_pa_event(e.get()), e->user_data);
+			}
+			return true;
+		});
+		events.erase(i, events.end());
+	}
+
+	void update_wait_set()
+	{
+		if (!this->io_events_changed) {
+			return;
+		}
+		this->io_events_changed = false;
+
+		auto num_waitables = unsigned(this->io_events.size()) + 1;
+
+		if (num_waitables > this->wait_set->capacity()) {
+			// wait set must be empty when destroyed
+			for (auto& e : this->io_events) {
+				if (e->added) {
+					this->wait_set->remove(e->waitable);
+					e->added = false;
+				}
+			}
+			this->wait_set->remove(this->wakeup);
+
+			this->wait_set = std::make_unique<opros::wait_set>(std::max(num_waitables, this->wait_set->capacity() * 2));
+			this->wait_set->add(this->wakeup, {opros::ready::read}, &this->wakeup);
+		}
+
+		for (auto& e : this->io_events) {
+			auto flags = to_ready_flags(e->events);
+			bool needed = !e->dead && !flags.is_clear();
+			if (e->added) {
+				if (needed) {
+					this->wait_set->change(e->waitable, flags, e.get());
+				} else {
+					this->wait_set->remove(e->waitable);
+					e->added = false;
+				}
+			} else if (needed) {
+				this->wait_set->add(e->waitable, flags, e.get());
+				e->added = true;
+			}
+		}
+
+		this->sweep(this->io_events);
+	}
+
+	// returns wait timeout in milliseconds, empty optional means infinite timeout
+	std::optional<uint32_t> get_timeout() const
+	{
+		if (std::any_of(this->defer_events.begin(), this->defer_events.end(), [](const auto& e) {
+				return e->enabled && !e->dead;
+			}))
+		{
+			return 0;
+		}
+
+		std::optional<std::chrono::steady_clock::time_point> deadline;
+		for (const auto& e : this->time_events) {
+			if (e->dead || !e->deadline.has_value()) {
+				continue;
+			}
+			if (!deadline.has_value() || *e->deadline < *deadline) {
+				deadline = e->deadline;
+			}
+		}
+
+		if (!deadline.has_value()) {
+			return {};
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		if (*deadline <= now) {
+			return 0;
+		}
+
+		// round up, so that the timer is not dispatched too early
+		auto ms = std::chrono::ceil<std::chrono::milliseconds>(*deadline - now).count();
+		return uint32_t(std::min(ms, decltype(ms)(std::numeric_limits<uint32_t>::max())));
+	}
+
+	void dispatch_defer_events()
+	{
+		// callbacks may add new events, so iterate by index
+		for (size_t i = 0; i != this->defer_events.size(); ++i) {
+			auto e = this->defer_events[i].get();
+			if (e->enabled && !e->dead) {
+				e->callback(&this->api, to_pa_event(e), e->user_data);
+			}
+		}
+		this->sweep(this->defer_events);
+	}
+
+	void dispatch_io_events()
+	{
+		for (const auto& t : this->wait_set->get_triggered()) {
+			if (t.user_data == &this->wakeup) {
+				this->wakeup.clear();
+				continue;
+			}
+
+			auto e = static_cast<io_event*>(t.user_data);
+
+			// the event could be freed or disabled by previously dispatched callbacks
+			auto events = pa_io_event_flags_t(to_io_event_flags(t.flags) & e->events);
+			if (e->dead || events == PA_IO_EVENT_NULL) {
+				continue;
+			}
+
+			e->callback(&this->api, to_pa_event(e), e->waitable.get_handle(), events, e->user_data);
+		}
+	}
+
+	void dispatch_time_events()
+	{
+		auto now = std::chrono::steady_clock::now();
+
+		for (size_t i = 0; i != this->time_events.size(); ++i) {
+			auto e = this->time_events[i].get();
+			if (e->dead || !e->deadline.has_value() || *e->deadline > now) {
+				continue;
+			}
+
+			// time events are one-shot, the callback may restart it
+			e->deadline.reset();
+
+			timeval tv{};
+			auto since_epoch = std::chrono::system_clock::now().time_since_epoch();
+			tv.tv_sec = decltype(tv.tv_sec)(std::chrono::duration_cast<std::chrono::seconds>(since_epoch).count());
+			tv.tv_usec = decltype(tv.tv_usec)(
+				std::chrono::duration_cast<std::chrono::microseconds>(since_epoch % std::chrono::seconds(1)).count()
+			);
+
+			e->callback(&this->api, to_pa_event(e), &tv, e->user_data);
+		}
+		this->sweep(this->time_events);
+	}
+
+	void run()
+	{
+		std::unique_lock lock(this->mutex);
+
+		while (!this->quit_flag) {
+			this->dispatch_defer_events();
+
+			this->update_wait_set();
+
+			auto timeout = this->get_timeout();
+
+			this->waiting.store(true, std::memory_order_relaxed);
+			lock.unlock();
+			bool triggered = true;
+			if (timeout.has_value()) {
+				triggered = this->wait_set->wait(*timeout);
+			} else {
+				this->wait_set->wait();
+			}
+			this->waiting.store(false, std::memory_order_release);
+			lock.lock();
+
+			if (triggered) {
+				this->dispatch_io_events();
+			}
+
+			this->dispatch_time_events();
+		}
+	}
+
+public:
+	poll_mainloop() :
+		wait_set(std::make_unique<opros::wait_set>(initial_wait_set_capacity))
+	{
+		this->api.userdata = this;
+		this->api.io_new = &io_new;
+		this->api.io_enable = &io_enable;
+		this->api.io_free = &io_free;
+		this->api.io_set_destroy = &io_set_destroy;
+		this->api.time_new = &time_new;
+		this->api.time_restart = &time_restart;
+		this->api.time_free = &time_free;
+		this->api.time_set_destroy = &time_set_destroy;
+		this->api.defer_new = &defer_new;
+		this->api.defer_enable = &defer_enable;
+		this->api.defer_free = &defer_free;
+		this->api.defer_set_destroy = &defer_set_destroy;
+		this->api.quit = &quit;
+
+		this->wait_set->add(this->wakeup, {opros::ready::read}, &this->wakeup);
+
+		this->thread = std::thread([this]() {
+			this->run();
+		});
+	}
+
+	poll_mainloop(const poll_mainloop&) = delete;
+	poll_mainloop& operator=(const poll_mainloop&) = delete;
+
+	poll_mainloop(poll_mainloop&&) = delete;
+	poll_mainloop& operator=(poll_mainloop&&) = delete;
+
+	~poll_mainloop()
+	{
+		{
+			std::lock_guard lock(this->mutex);
+			this->quit_flag = true;
+			this->wakeup.signal();
+		}
+		this->thread.join();
+
+		// all events are supposed to be freed by now, but PulseAudio does not guarantee that
+		for (auto& e : this->io_events) {
+			if (e->added) {
+				this->wait_set->remove(e->waitable);
+			}
+		}
+		this->wait_set->remove(this->wakeup);
+	}
+
+	pa_mainloop_api* get_api() noexcept
+	{
+		return &this->api;
+	}
+
+	/**
+	 * @brief Lock the main loop.
+	 * PulseAudio objects which use this main loop can only be accessed while the lock is held.
+	 * @return The lock.
+	 */
+	std::unique_lock<std::mutex> lock()
+	{
+		return std::unique_lock(this->mutex);
+	}
+
+	/**
+	 * @brief Condition to wait for with the main loop lock held.
+	 * Each object, e.g. a stream, has its own condition signalled from its callbacks,
+	 * so that the threads waiting for other objects of the same main loop are not woken up.
+	 */
+	class condition
+	{
+		friend class poll_mainloop;
+
+		std::condition_variable cv;
+
+	public:
+		/**
+		 * @brief Wake up threads waiting for the condition.
+		 * Called from event callbacks.
+		 */
+		void signal() noexcept
+		{
+			this->cv.notify_all();
+		}
+	};
+
+	/**
+	 * @brief Wait for the condition to be signalled from the main loop thread.
+	 * @param lock - the main loop lock.
+	 * @param c - condition to wait for.
+	 */
+	void wait(std::unique_lock<std::mutex>& lock, condition& c)
+	{
+		utki::assert(!this->is_in_thread(), SL);
+		c.cv.wait(lock);
+	}
+};
+
+} // namespace
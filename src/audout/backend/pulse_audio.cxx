@@ -26,10 +26,21 @@ SOFTWARE.
 
 #pragma once
 
-#include <pulse/error.h>
-#include <pulse/simple.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <optional>
+
+#include <pulse/pulseaudio.h>
 #include <utki/destructable.hpp>
+#include <utki/util.hpp>
 
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#include "pulse_context.cxx"
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#include "pulse_sample_format.cxx"
 // NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
 #include "write_based.cxx"
 
@@ -39,69 +50,379 @@ class audio_backend :
 	public write_based, //
 	public utki::destructable
 {
-	pa_simple* handle;
+	// startup latency is measured from the beginning of construction
+	const std::chrono::steady_clock::time_point open_time = std::chrono::steady_clock::now();
+
+	// the connection is shared by all players, so that opening a player only creates new streams
+	const std::shared_ptr<pulse_context> context;
+
+	const std::string device_name;
+
+	// Signalled from the callbacks of this backend's streams, so that the audio thread is not woken up
+	// by other streams of the shared context. Guarded by the main loop lock.
+	poll_mainloop::condition condition;
+
+	pa_sample_spec sample_spec{};
+
+	pa_stream* playback = nullptr;
+
+	// On reconfiguration the stream opened by control thread, swapped with the playback stream by
+	// the audio thread. Guarded by the main loop lock.
+	pa_stream* next_playback = nullptr;
+	pa_sample_spec next_sample_spec{};
+
+	// capture stream, only opened in full-duplex mode
+	pa_stream* capture = nullptr;
+
+	// capture fragment being read, see pa_stream_peek()
+	bool capture_fragment_peeked = false;
+	size_t capture_fragment_offset = 0;
+
+	// Set by control thread to make blocking write() and read() return immediately,
+	// until the audio thread switches to the new configuration. Guarded by the main loop lock.
+	bool interrupted = false;
+
+	// buffer geometry reported by the server, guarded by the main loop lock
+	audout::buffer_geometry geometry;
+
+	// Startup latency measurement, guarded by the main loop lock.
+	// Time spent paused by the user between construction and first resume is not counted.
+	std::chrono::steady_clock::duration open_duration{};
+	std::optional<std::chrono::steady_clock::time_point> resume_time;
+	std::optional<std::chrono::steady_clock::time_point> started_time;
+
+	std::atomic<std::chrono::microseconds> startup_latency{std::chrono::microseconds(0)};
+
+	static void request_callback(pa_stream*, size_t, void* user_data)
+	{
+		static_cast<poll_mainloop::condition*>(user_data)->signal();
+	}
+
+	static void success_callback(pa_stream*, int, void* user_data)
+	{
+		static_cast<poll_mainloop::condition*>(user_data)->signal();
+	}
+
+	// called by the main loop when the server starts playing the stream, also after underruns
+	static void started_callback(pa_stream* s, void* user_data)
+	{
+		auto self = static_cast<audio_backend*>(user_data);
+
+		if (self->started_time || !self->resume_time) {
+			return;
+		}
+		self->started_time = std::chrono::steady_clock::now();
+
+		// the first frame becomes audible once it passes through the sink
+		pulse_context::release(pa_stream_update_timing_info(s, &timing_callback, self));
+	}
+
+	static void timing_callback(pa_stream* s, int success, void* user_data)
+	{
+		auto self = static_cast<audio_backend*>(user_data);
+		utki::assert(self->started_time.has_value(), SL);
+		utki::assert(self->resume_time.has_value(), SL);
+
+		auto audible_time = *self->started_time;
+		if (success) {
+			if (const pa_timing_info* ti = pa_stream_get_timing_info(s)) {
+				audible_time += std::chrono::microseconds(ti->sink_usec);
+			}
+		}
+
+		self->startup_latency.store(
+			std::chrono::duration_cast<std::chrono::microseconds>(
+				self->open_duration + (audible_time - *self->resume_time)
+			),
+			std::memory_order_relaxed
+		);
+	}
+
+	// The audio thread fills the whole buffer at once, but writes it as soon as the server requests
+	// some data, so the server's default minimal request is used.
+	static audout::buffer_geometry make_initial_geometry(uint32_t buffer_size_frames) noexcept
+	{
+		audout::buffer_geometry g;
+		g.buffer_frames = buffer_size_frames;
+		g.num_periods = 1;
+		return g;
+	}
+
+	static pa_buffer_attr to_buffer_attr(const audout::buffer_geometry& g, const pa_sample_spec& ss) noexcept
+	{
+		auto frame_size = uint32_t(pa_frame_size(&ss));
+
+		auto to_bytes = [&](uint32_t frames) {
+			if (frames == audout::buffer_geometry::backend_default) {
+				return std::uint32_t(-1);
+			}
+			return frames * frame_size;
+		};
+
+		pa_buffer_attr ba;
+
+		// let the server choose the maximum, it is only an upper limit for the buffer
+		ba.maxlength = std::uint32_t(-1);
+
+		ba.tlength = to_bytes(g.buffer_frames);
+		ba.minreq = to_bytes(g.min_request_frames);
+		ba.prebuf = to_bytes(g.prebuffer_frames);
+
+		// capture stream delivers data in fragments of one period
+		ba.fragsize = to_bytes(g.period_frames());
+
+		return ba;
+	}
+
+	// the main loop lock must be held
+	void update_geometry(uint32_t period_frames)
+	{
+		const pa_buffer_attr* ba = pa_stream_get_buffer_attr(this->playback);
+		if (!ba) {
+			this->context->throw_error("pa_stream_get_buffer_attr(): failed");
+		}
+
+		auto frame_size = uint32_t(pa_frame_size(&this->sample_spec));
+
+		this->geometry.buffer_frames = ba->tlength / frame_size;
+		this->geometry.num_periods = std::max(
+			uint32_t(1), //
+			(this->geometry.buffer_frames + period_frames / 2) / period_frames
+		);
+		this->geometry.min_request_frames = ba->minreq / frame_size;
+		this->geometry.prebuffer_frames = ba->prebuf / frame_size;
+	}
+
+	// blocks until the whole buffer is written to the stream or the write is interrupted
+	size_t write(utki::span<const uint8_t> buf) override
+	{
+		auto lock = this->context->mainloop.lock();
+
+		size_t size = buf.size();
+
+		while (!buf.empty() && !this->interrupted) {
+			size_t num_bytes = pa_stream_writable_size(this->playback);
+			if (num_bytes == size_t(-1)) {
+				LOG([&](auto& o) {
+					o << "pa_stream_writable_size(): error (" << pa_strerror(pa_context_errno(this->context->context))
+					  << ")" << std::endl;
+				})
+				// drop the samples
+				return size;
+			}
+
+			if (num_bytes == 0) {
+				// wait for the server to request more data
+				this->context->mainloop.wait(lock, this->condition);
+				continue;
+			}
+
+			num_bytes = std::min(num_bytes, buf.size());
+			num_bytes -= num_bytes % pa_frame_size(&this->sample_spec);
+			if (num_bytes == 0) {
+				this->context->mainloop.wait(lock, this->condition);
+				continue;
+			}
+
+			if (pa_stream_write(this->playback, buf.data(), num_bytes, nullptr, 0, PA_SEEK_RELATIVE) < 0) {
+				LOG([&](auto& o) {
+					o << "pa_stream_write(): error (" << pa_strerror(pa_context_errno(this->context->context)) << ")"
+					  << std::endl;
+				})
+				// drop the samples
+				return size;
+			}
+
+			buf = buf.subspan(num_bytes);
+		}
+
+		if (this->capture) {
+			this->update_duplex_latency();
+		}
+
+		return size - buf.size();
+	}
+
+	// blocks until the whole buffer is filled with captured samples
+	void read(utki::span<uint8_t> buf) override
+	{
+		auto lock = this->context->mainloop.lock();
+
+		while (!buf.empty() && !this->interrupted) {
+			const void* data = nullptr;
+			size_t num_bytes = 0;
+
+			if (!this->capture_fragment_peeked) {
+				if (pa_stream_peek(this->capture, &data, &num_bytes) < 0) {
+					LOG([&](auto& o) {
+						o << "pa_stream_peek(): error (" << pa_strerror(pa_context_errno(this->context->context))
+						  << ")" << std::endl;
+					})
+					break;
+				}
+
+				if (num_bytes == 0) {
+					// wait for the server to send more data
+					this->context->mainloop.wait(lock, this->condition);
+					continue;
+				}
+
+				this->capture_fragment_peeked = true;
+				this->capture_fragment_offset = 0;
+			} else {
+				// peeking again returns the same fragment
+				pa_stream_peek(this->capture, &data, &num_bytes);
+			}
+
+			auto n = std::min(num_bytes - this->capture_fragment_offset, buf.size());
+
+			if (data) {
+				std::memcpy(buf.data(), static_cast<const uint8_t*>(data) + this->capture_fragment_offset, n);
+			} else {
+				// hole in the stream
+				std::fill_n(buf.begin(), n, 0);
+			}
+
+			buf = buf.subspan(n);
+
+			this->capture_fragment_offset += n;
+			if (this->capture_fragment_offset == num_bytes) {
+				pa_stream_drop(this->capture);
+				this->capture_fragment_peeked = false;
+			}
+		}
+
+		std::fill(buf.begin(), buf.end(), 0);
+	}
 
-	void write(const utki::span<std::int16_t> buf) override
+	void flush_capture() override
 	{
-		int error{};
+		auto lock = this->context->mainloop.lock();
 
-		if (pa_simple_write(this->handle, &*buf.begin(), size_t(buf.size_bytes()), &error) < 0) {
-			LOG([&](auto& o) {
-				o << "pa_simple_write(): error (" << pa_strerror(error) << ")" << std::endl;
-			})
+		if (this->capture_fragment_peeked) {
+			pa_stream_drop(this->capture);
+			this->capture_fragment_peeked = false;
+		}
+
+		pulse_context::release(pa_stream_flush(this->capture, nullptr, nullptr));
+	}
+
+	void reconfigured() override
+	{
+		auto lock = this->context->mainloop.lock();
+		this->interrupted = false;
+
+		if (this->next_playback) {
+			// from now on the audio thread writes to the new stream
+			std::swap(this->playback, this->next_playback);
+			std::swap(this->sample_spec, this->next_sample_spec);
 		}
 	}
 
+	// the main loop lock must be held
+	void update_duplex_latency() noexcept
+	{
+		// samples captured but not yet read by us plus samples written but not yet played
+		pa_usec_t capture_latency{};
+		int negative{};
+		if (pa_stream_get_latency(this->capture, &capture_latency, &negative) < 0) {
+			return;
+		}
+		if (negative) {
+			capture_latency = 0;
+		}
+
+		pa_usec_t playback_latency{};
+		if (pa_stream_get_latency(this->playback, &playback_latency, &negative) < 0) {
+			return;
+		}
+		if (negative) {
+			playback_latency = 0;
+		}
+
+		this->duplex_latency.store(
+			std::chrono::microseconds(capture_latency + playback_latency), //
+			std::memory_order_relaxed
+		);
+	}
+
 public:
-	audio_backend(audout::format output_format, uint32_t buffer_size_frames, audout::listener* listener) :
+	audio_backend(
+		audout::format output_format, //
+		uint32_t buffer_size_frames,
+		audout::listener* listener,
+		audout::duplex_listener* duplex_listener,
+		const std::string& device_name
+	) :
 		write_based(
 			listener, //
-			size_t(buffer_size_frames * output_format.num_channels())
-		)
+			duplex_listener,
+			output_format,
+			buffer_size_frames
+		),
+		context(pulse_context::get_shared()),
+		device_name(device_name)
 	{
 		LOG([&](auto& o) {
 			o << "opening device" << std::endl;
 		})
 
-		pa_sample_spec ss;
-		ss.format = PA_SAMPLE_S16NE; // native endian
-		ss.channels = output_format.num_channels();
-		ss.rate = output_format.frequency();
+		this->sample_spec.format = to_pa_sample_format(output_format.sample_type);
+		this->sample_spec.channels = output_format.num_channels();
+		this->sample_spec.rate = output_format.frequency();
 
-		unsigned buffer_size_bytes = buffer_size_frames * output_format.frame_size();
-		pa_buffer_attr ba;
-		ba.fragsize = buffer_size_bytes;
-		ba.tlength = buffer_size_bytes;
-		ba.minreq = std::uint32_t(-1);
-		ba.maxlength = std::uint32_t(-1);
-		ba.prebuf = std::uint32_t(-1);
+		auto ba = to_buffer_attr(make_initial_geometry(buffer_size_frames), this->sample_spec);
 
-		pa_channel_map cm;
-		pa_channel_map_init_auto(&cm, ss.channels, PA_CHANNEL_MAP_WAVEEX);
+		auto flags = PA_STREAM_ADJUST_LATENCY;
+		if (duplex_listener) {
+			// timing info is needed for measuring the latency
+			flags = flags | PA_STREAM_INTERPOLATE_TIMING | PA_STREAM_AUTO_TIMING_UPDATE;
+		}
 
-		int error{};
+		auto lock = this->context->mainloop.lock();
 
-		this->handle = pa_simple_new(
-			nullptr, // Use the default server.
-			"audout", // Our application's name.
+		this->playback = this->context->open_stream(
+			lock,
 			PA_STREAM_PLAYBACK,
-			nullptr, // Use the default device.
-			"sound stream", // Description of our stream.
-			&ss, // our sample format.
-			&cm, // channel map
-			&ba, // buffering attributes.
-			&error
+			device_name,
+			this->sample_spec,
+			ba,
+			flags,
+			&request_callback,
+			&this->condition,
+			this->condition
 		);
 
-		if (!this->handle) {
-			utki::log_debug([&](auto& o) {
-				o << "error opening PulseAudio connection (" << pa_strerror(error) << ")" << std::endl;
+		if (duplex_listener) {
+			utki::scope_exit playback_scope_exit([this]() {
+				pulse_context::close_stream(this->playback);
 			});
-			std::stringstream ss;
-			ss << "error opening PulseAudio connection: " << pa_strerror(error);
-			throw std::runtime_error(ss.str());
+
+			// Capture from default source. Capture stream delivers data in fragments of one period,
+			// so that each period can be read as soon as it is captured.
+			this->capture = this->context->open_stream(
+				lock,
+				PA_STREAM_RECORD,
+				{},
+				this->sample_spec,
+				ba,
+				flags,
+				&request_callback,
+				&this->condition,
+				this->condition
+			);
+
+			playback_scope_exit.release();
 		}
 
+		this->update_geometry(buffer_size_frames);
+
+		pa_stream_set_started_callback(this->playback, &started_callback, this);
+
+		this->open_duration = std::chrono::steady_clock::now() - this->open_time;
+
+		lock.unlock();
+
 		this->start();
 	}
 
@@ -113,11 +434,167 @@ public:
 
 	~audio_backend() override
 	{
-		this->quit();
-		this->join();
+		this->stop([this]() {
+			// make the audio thread return from blocking write() or read()
+			auto lock = this->context->mainloop.lock();
+			this->interrupted = true;
+			this->condition.signal();
+		});
+
+		auto lock = this->context->mainloop.lock();
+
+		if (this->capture) {
+			pulse_context::close_stream(this->capture);
+		}
+
+		utki::assert(this->playback, SL);
+		pulse_context::close_stream(this->playback);
+	}
+
+	void set_paused(bool pause)
+	{
+		{
+			auto lock = this->context->mainloop.lock();
+			if (!pause && !this->resume_time) {
+				this->resume_time = std::chrono::steady_clock::now();
+			}
+		}
+		this->write_based::set_paused(pause);
+	}
+
+	std::chrono::microseconds get_startup_latency() const noexcept
+	{
+		return this->startup_latency.load(std::memory_order_relaxed);
+	}
 
-		utki::assert(this->handle, SL);
-		pa_simple_free(this->handle);
+	std::chrono::microseconds get_output_latency()
+	{
+		auto lock = this->context->mainloop.lock();
+
+		// request fresh timing info, since automatic timing updates are only enabled in full-duplex mode
+		if (pa_operation* op =
+				pa_stream_update_timing_info(this->playback, &success_callback, &this->condition))
+		{
+			while (pa_operation_get_state(op) == PA_OPERATION_RUNNING) {
+				this->context->mainloop.wait(lock, this->condition);
+			}
+			pa_operation_unref(op);
+		}
+
+		pa_usec_t latency{};
+		int negative{};
+		if (pa_stream_get_latency(this->playback, &latency, &negative) < 0 || negative) {
+			return {};
+		}
+		return std::chrono::microseconds(latency);
+	}
+
+	void set_buffer_geometry(const audout::buffer_geometry& g)
+	{
+		// Make the audio thread return from blocking write(), so that it picks up the new period right away.
+		// The flag is set before sending the command, the audio thread clears it once the command is handled.
+		// The rest of the interrupted period is written right after that.
+		this->set_period(g.period_frames(), [this]() {
+			auto lock = this->context->mainloop.lock();
+			this->interrupted = true;
+			this->condition.signal();
+		});
+
+		auto lock = this->context->mainloop.lock();
+
+		auto old_buffer_frames = this->geometry.buffer_frames;
+
+		auto ba = to_buffer_attr(g, this->sample_spec);
+		pa_operation* op = pa_stream_set_buffer_attr(
+			this->playback, //
+			&ba,
+			&success_callback,
+			&this->condition
+		);
+		if (!op) {
+			this->context->throw_error("pa_stream_set_buffer_attr(): failed");
+		}
+
+		// wait for the server to apply the new attributes, so that the achieved geometry can be reported
+		while (pa_operation_get_state(op) == PA_OPERATION_RUNNING) {
+			this->context->mainloop.wait(lock, this->condition);
+		}
+		pa_operation_unref(op);
+
+		this->update_geometry(g.period_frames());
+
+		if (this->geometry.buffer_frames < old_buffer_frames) {
+			// drop samples buffered with the bigger buffer, so that lower latency takes effect immediately
+			pulse_context::release(pa_stream_flush(this->playback, nullptr, nullptr));
+		}
+	}
+
+	void reconfigure(
+		audout::format output_format, //
+		uint32_t buffer_size_frames,
+		audout::listener* listener
+	)
+	{
+		if (this->is_duplex()) {
+			throw std::logic_error("PulseAudio: full-duplex mode does not support reconfiguration");
+		}
+
+		pa_sample_spec ss;
+		ss.format = to_pa_sample_format(output_format.sample_type);
+		ss.channels = output_format.num_channels();
+		ss.rate = output_format.frequency();
+
+		auto ba = to_buffer_attr(make_initial_geometry(buffer_size_frames), ss);
+
+		{
+			auto lock = this->context->mainloop.lock();
+
+			// The new stream is kept corked until the old one plays out all the frames written to it,
+			// meanwhile the audio thread fills the new stream's buffer.
+			this->next_playback = this->context->open_stream(
+				lock,
+				PA_STREAM_PLAYBACK,
+				this->device_name,
+				ss,
+				ba,
+				PA_STREAM_ADJUST_LATENCY | PA_STREAM_START_CORKED,
+				&request_callback,
+				&this->condition,
+				this->condition
+			);
+			this->next_sample_spec = ss;
+		}
+
+		// closes the new stream in case of failure, or the old one after it is swapped by the audio thread
+		utki::scope_exit next_playback_scope_exit([this]() {
+			auto lock = this->context->mainloop.lock();
+			pulse_context::close_stream(this->next_playback);
+			this->next_playback = nullptr;
+		});
+
+		this->write_based::reconfigure(listener, output_format, buffer_size_frames);
+
+		auto lock = this->context->mainloop.lock();
+
+		utki::assert(this->next_playback, SL);
+
+		// wait for the old stream to play out, then start the new one right away
+		if (pa_operation* op = pa_stream_drain(this->next_playback, &success_callback, &this->condition)) {
+			while (pa_operation_get_state(op) == PA_OPERATION_RUNNING) {
+				this->context->mainloop.wait(lock, this->condition);
+			}
+			pa_operation_unref(op);
+		}
+
+		pulse_context::release(pa_stream_cork(this->playback, 0, nullptr, nullptr));
+
+		this->update_geometry(buffer_size_frames);
+	}
+
+	audout::buffer_geometry get_buffer_geometry()
+	{
+		auto lock = this->context->mainloop.lock();
+		return this->geometry;
 	}
 };
 
@@ -0,0 +1,258 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <pulse/pulseaudio.h>
+#include <utki/destructable.hpp>
+#include <utki/util.hpp>
+
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#include "poll_mainloop.cxx"
+
+namespace {
+
+// PulseAudio context running on the poll based main loop
+class pulse_context : public utki::destructable
+{
+public:
+	poll_mainloop mainloop;
+
+	// signalled on context state changes
+	poll_mainloop::condition state_condition;
+
+	pa_context* const context;
+
+	pulse_context() :
+		context(pa_context_new(this->mainloop.get_api(), "audout"))
+	{
+		if (!this->context) {
+			throw std::runtime_error("pa_context_new() failed");
+		}
+
+		utki::scope_exit context_scope_exit([this]() {
+			auto lock = this->mainloop.lock();
+			pa_context_unref(this->context);
+		});
+
+		auto lock = this->mainloop.lock();
+
+		pa_context_set_state_callback(
+			this->context,
+			[](pa_context*, void* user_data) {
+				static_cast<poll_mainloop::condition*>(user_data)->signal();
+			},
+			&this->state_condition
+		);
+
+		if (pa_context_connect(this->context, nullptr, PA_CONTEXT_NOFLAGS, nullptr) < 0) {
+			this->throw_error("pa_context_connect() failed");
+		}
+
+		for (;;) {
+			auto state = pa_context_get_state(this->context);
+			if (state == PA_CONTEXT_READY) {
+				break;
+			}
+			if (state == PA_CONTEXT_FAILED || state == PA_CONTEXT_TERMINATED) {
+				this->throw_error("error connecting to PulseAudio server");
+			}
+			this->mainloop.wait(lock, this->state_condition);
+		}
+
+		context_scope_exit.release();
+	}
+
+	pulse_context(const pulse_context&) = delete;
+	pulse_context& operator=(const pulse_context&) = delete;
+
+	pulse_context(pulse_context&&) = delete;
+	pulse_context& operator=(pulse_context&&) = delete;
+
+	~pulse_context() override
+	{
+		auto lock = this->mainloop.lock();
+		pa_context_set_state_callback(this->context, nullptr, nullptr);
+		pa_context_disconnect(this->context);
+		pa_context_unref(this->context);
+	}
+
+	/**
+	 * @brief Get process-wide context.
+	 * The context is created on first call and stays connected until the process exits,
+	 * so that opening a stream does not involve connecting to the server each time.
+	 * In case the connection to the server has been lost, a new context is created.
+	 * @return The shared context.
+	 */
+	static std::shared_ptr<pulse_context> get_shared()
+	{
+		static std::mutex mutex;
+		static std::shared_ptr<pulse_context> instance;
+
+		std::lock_guard lock(mutex);
+
+		if (instance && !instance->is_connected()) {
+			// streams still using the old context keep it alive
+			instance.reset();
+		}
+
+		if (!instance) {
+			instance = std::make_shared<pulse_context>();
+		}
+
+		return instance;
+	}
+
+	bool is_connected()
+	{
+		auto lock = this->mainloop.lock();
+		return pa_context_get_state(this->context) == PA_CONTEXT_READY;
+	}
+
+	[[noreturn]] void throw_error(const char* message)
+	{
+		std::stringstream ss;
+		ss << message << ": " << pa_strerror(pa_context_errno(this->context));
+		throw std::runtime_error(ss.str());
+	}
+
+	/**
+	 * @brief Create stream and connect it to a device.
+	 * Waits until the stream is ready. The stream's state callback signals the given condition.
+	 * @param lock - the main loop lock, must be locked.
+	 * @param direction - stream direction.
+	 * @param device_name - name of the device, empty name means default device.
+	 * @param ss - sample spec.
+	 * @param ba - buffer attributes.
+	 * @param flags - stream flags.
+	 * @param request_callback - write callback for playback streams, read callback for record streams.
+	 * @param user_data - user data for the request callback.
+	 * @param state_condition - condition to signal on stream state changes. Must outlive the stream.
+	 * @return The connected stream.
+	 */
+	pa_stream* open_stream(
+		std::unique_lock<std::mutex>& lock,
+		pa_stream_direction_t direction,
+		const std::string& device_name,
+		const pa_sample_spec& ss,
+		const pa_buffer_attr& ba,
+		pa_stream_flags_t flags,
+		pa_stream_request_cb_t request_callback,
+		void* user_data,
+		poll_mainloop::condition& state_condition
+	)
+	{
+		pa_channel_map cm;
+		pa_channel_map_init_auto(&cm, ss.channels, PA_CHANNEL_MAP_WAVEEX);
+
+		pa_stream* s = pa_stream_new(
+			this->context,
+			direction == PA_STREAM_RECORD ? "capture stream" : "sound stream",
+			&ss,
+			&cm
+		);
+		if (!s) {
+			this->throw_error("pa_stream_new() failed");
+		}
+
+		utki::scope_exit stream_scope_exit([s]() {
+			close_stream(s);
+		});
+
+		pa_stream_set_state_callback(
+			s,
+			[](pa_stream*, void* user_data) {
+				static_cast<poll_mainloop::condition*>(user_data)->signal();
+			},
+			&state_condition
+		);
+
+		// nullptr means default device
+		const char* dev = device_name.empty() ? nullptr : device_name.c_str();
+
+		if (direction == PA_STREAM_RECORD) {
+			pa_stream_set_read_callback(s, request_callback, user_data);
+			if (pa_stream_connect_record(s, dev, &ba, flags) < 0) {
+				this->throw_error("pa_stream_connect_record() failed");
+			}
+		} else {
+			pa_stream_set_write_callback(s, request_callback, user_data);
+			if (pa_stream_connect_playback(s, dev, &ba, flags, nullptr, nullptr) < 0) {
+				this->throw_error("pa_stream_connect_playback() failed");
+			}
+		}
+
+		for (;;) {
+			auto state = pa_stream_get_state(s);
+			if (state == PA_STREAM_READY) {
+				break;
+			}
+			if (state == PA_STREAM_FAILED || state == PA_STREAM_TERMINATED) {
+				this->throw_error("error connecting PulseAudio stream");
+			}
+			this->mainloop.wait(lock, state_condition);
+		}
+
+		stream_scope_exit.release();
+
+		return s;
+	}
+
+	/**
+	 * @brief Disconnect and free stream.
+	 * The main loop lock must be held.
+	 * @param s - stream to close.
+	 */
+	static void close_stream(pa_stream* s)
+	{
+		pa_stream_set_state_callback(s, nullptr, nullptr);
+		pa_stream_set_write_callback(s, nullptr, nullptr);
+		pa_stream_set_read_callback(s, nullptr, nullptr);
+		pa_stream_set_started_callback(s, nullptr, nullptr);
+		pa_stream_disconnect(s);
+		pa_stream_unref(s);
+	}
+
+	/**
+	 * @brief Release PulseAudio operation.
+	 * The operations are not waited for.
+	 * @param o - operation to release, can be nullptr.
+	 */
+	static void release(pa_operation* o)
+	{
+		if (o) {
+			pa_operation_unref(o);
+		}
+	}
+};
+
+} // namespace
@@ -0,0 +1,166 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <pulse/pulseaudio.h>
+#include <utki/debug.hpp>
+#include <utki/destructable.hpp>
+#include <utki/util.hpp>
+
+#include "../realtime.hpp"
+
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#include "fill.cxx"
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#include "pulse_context.cxx"
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#include "pulse_sample_format.cxx"
+
+namespace {
+
+class stream_backend : public utki::destructable
+{
+	poll_mainloop& mainloop;
+
+	audout::listener& listener;
+	const audout::sample_format sample_type;
+	const size_t frame_size;
+
+	// signalled on stream state changes
+	poll_mainloop::condition state_condition;
+
+	pa_stream* stream = nullptr;
+
+	// called from the main loop thread when the server requests more data
+	static void write_callback(pa_stream* s, size_t num_bytes, void* user_data)
+	{
+		auto& self = *static_cast<stream_backend*>(user_data);
+
+		audout::realtime_scope realtime;
+
+		num_bytes -= num_bytes % self.frame_size;
+
+		// the memory block given by pa_stream_begin_write() can be smaller than requested,
+		// so the requested amount is written in several parts
+		while (num_bytes != 0) {
+			void* data = nullptr;
+			size_t n = num_bytes;
+			if (pa_stream_begin_write(s, &data, &n) < 0) {
+				LOG([&](auto& o) {
+					o << "pa_stream_begin_write(): error (" << pa_strerror(pa_context_errno(pa_stream_get_context(s)))
+					  << ")" << std::endl;
+				})
+				return;
+			}
+
+			n = std::min(n, num_bytes);
+			n -= n % self.frame_size;
+			if (n == 0) {
+				pa_stream_cancel_write(s);
+				return;
+			}
+
+			fill(self.listener, self.sample_type, utki::make_span(static_cast<uint8_t*>(data), n));
+
+			if (pa_stream_write(s, data, n, nullptr, 0, PA_SEEK_RELATIVE) < 0) {
+				LOG([&](auto& o) {
+					o << "pa_stream_write(): error (" << pa_strerror(pa_context_errno(pa_stream_get_context(s))) << ")"
+					  << std::endl;
+				})
+				return;
+			}
+
+			num_bytes -= n;
+		}
+	}
+
+public:
+	stream_backend(
+		pulse_context& loop,
+		audout::format output_format,
+		uint32_t num_buffer_frames,
+		audout::listener& listener,
+		const std::string& device_name
+	) :
+		mainloop(loop.mainloop),
+		listener(listener),
+		sample_type(output_format.sample_type),
+		frame_size(output_format.frame_size())
+	{
+		pa_sample_spec ss;
+		ss.format = to_pa_sample_format(output_format.sample_type);
+		ss.channels = output_format.num_channels();
+		ss.rate = output_format.frequency();
+
+		unsigned buffer_size_bytes = num_buffer_frames * output_format.frame_size();
+		pa_buffer_attr ba;
+		ba.tlength = buffer_size_bytes;
+		ba.minreq = std::uint32_t(-1);
+		ba.maxlength = std::uint32_t(-1);
+		ba.prebuf = std::uint32_t(-1);
+		ba.fragsize = std::uint32_t(-1);
+
+		auto lock = this->mainloop.lock();
+
+		this->stream = loop.open_stream(
+			lock,
+			PA_STREAM_PLAYBACK,
+			device_name,
+			ss,
+			ba,
+			PA_STREAM_START_CORKED | PA_STREAM_ADJUST_LATENCY,
+			&write_callback,
+			this,
+			this->state_condition
+		);
+	}
+
+	stream_backend(const stream_backend&) = delete;
+	stream_backend& operator=(const stream_backend&) = delete;
+
+	stream_backend(stream_backend&&) = delete;
+	stream_backend& operator=(stream_backend&&) = delete;
+
+	~stream_backend() override
+	{
+		auto lock = this->mainloop.lock();
+		pulse_context::close_stream(this->stream);
+	}
+
+	void set_paused(bool pause)
+	{
+		auto lock = this->mainloop.lock();
+		pulse_context::release(pa_stream_cork(this->stream, pause ? 1 : 0, nullptr, nullptr));
+	}
+};
+
+} // namespace
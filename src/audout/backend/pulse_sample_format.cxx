@@ -0,0 +1,52 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <stdexcept>
+
+#include <pulse/sample.h>
+
+#include "../format.hpp"
+
+namespace {
+
+pa_sample_format_t to_pa_sample_format(audout::sample_format sample_type)
+{
+	switch (sample_type) {
+		case audout::sample_format::int16:
+			return PA_SAMPLE_S16NE;
+		case audout::sample_format::int24:
+			return PA_SAMPLE_S24LE;
+		case audout::sample_format::int32:
+			return PA_SAMPLE_S32NE;
+		case audout::sample_format::float32:
+			return PA_SAMPLE_FLOAT32NE;
+	}
+	throw std::invalid_argument("unknown sample format");
+}
+
+} // namespace
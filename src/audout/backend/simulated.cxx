@@ -0,0 +1,156 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <utki/destructable.hpp>
+#include <utki/util.hpp>
+
+#include "../latency.hpp"
+#include "../simulated_device.hpp"
+
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#include "write_based.cxx"
+
+namespace {
+
+// Plays to audout::simulated_device, the audio thread is paced by the device's virtual clock.
+class simulated_backend :
+	public write_based, //
+	public utki::destructable
+{
+	audout::simulated_device& device;
+
+	// written by control thread before reconfiguration, read by the audio thread in reconfigured()
+	audout::format next_format;
+
+	// accessed only by the audio thread
+	unsigned frame_size;
+
+	size_t write(utki::span<const uint8_t> buf) override
+	{
+		return size_t(this->device.write(uint32_t(buf.size() / this->frame_size))) * this->frame_size;
+	}
+
+	void reconfigured() override
+	{
+		this->frame_size = this->next_format.frame_size();
+		this->device.set_sampling_rate(this->next_format.frequency());
+		this->device.set_interrupted(false);
+	}
+
+	// Makes the audio thread return from blocking write(), so that it picks up the command right away,
+	// without waiting for the virtual clock to be advanced. Cleared once the audio thread handles the command.
+	void interrupt()
+	{
+		this->device.set_interrupted(true);
+	}
+
+public:
+	simulated_backend(
+		audout::format output_format, //
+		uint32_t buffer_size_frames,
+		audout::listener* listener,
+		audout::duplex_listener* duplex_listener,
+		audout::simulated_device& device
+	) :
+		write_based(
+			listener, //
+			duplex_listener,
+			output_format,
+			buffer_size_frames
+		),
+		device(device),
+		next_format(output_format),
+		frame_size(output_format.frame_size())
+	{
+		this->device.attach(output_format.frequency(), buffer_size_frames);
+		this->start();
+	}
+
+	simulated_backend(const simulated_backend&) = delete;
+	simulated_backend& operator=(const simulated_backend&) = delete;
+
+	simulated_backend(simulated_backend&&) = delete;
+	simulated_backend& operator=(simulated_backend&&) = delete;
+
+	~simulated_backend() override
+	{
+		this->stop([this]() {
+			// make the audio thread return from blocking write()
+			this->device.detach();
+		});
+	}
+
+	void set_paused(bool pause)
+	{
+		this->device.set_running(!pause);
+		this->write_based::set_paused(pause);
+	}
+
+	std::chrono::microseconds get_startup_latency() const
+	{
+		return this->device.get_startup_latency();
+	}
+
+	std::chrono::microseconds get_output_latency() const
+	{
+		return this->device.get_latency();
+	}
+
+	void set_buffer_geometry(const audout::buffer_geometry& g)
+	{
+		this->device.set_geometry(g);
+
+		this->set_period(this->device.get_geometry().period_frames(), [this]() {
+			this->interrupt();
+		});
+	}
+
+	audout::buffer_geometry get_buffer_geometry() const
+	{
+		return this->device.get_geometry();
+	}
+
+	void reconfigure(
+		audout::format output_format, //
+		uint32_t buffer_size_frames,
+		audout::listener* listener
+	)
+	{
+		if (this->is_duplex()) {
+			throw std::logic_error("simulated device: full-duplex mode does not support reconfiguration");
+		}
+
+		this->next_format = output_format;
+
+		this->write_based::reconfigure(listener, output_format, buffer_size_frames, [this]() {
+			this->interrupt();
+		});
+	}
+};
+
+} // namespace
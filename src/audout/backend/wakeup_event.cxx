@@ -0,0 +1,108 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+
+#include <opros/waitable.hpp>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace audout {
+
+// eventfd based event used to wake up a thread without locking and without allocating memory,
+// it is waited for either with opros::wait_set or by blocking in wait()
+class wakeup_event : public opros::waitable
+{
+public:
+	enum class mode {
+		// signal() sets the event, clear() resets it, used with opros::wait_set
+		non_blocking,
+
+		// wait() blocks until the event is signalled and resets it
+		blocking,
+
+		// signal() posts a number of wakeups, wait() blocks until a wakeup is posted and takes one
+		semaphore
+	};
+
+	wakeup_event(mode m = mode::non_blocking) :
+		opros::waitable([m]() {
+			int flags = EFD_CLOEXEC;
+			switch (m) {
+				case mode::non_blocking:
+					flags |= EFD_NONBLOCK;
+					break;
+				case mode::blocking:
+					break;
+				case mode::semaphore:
+					flags |= EFD_SEMAPHORE;
+					break;
+			}
+			int fd = eventfd(0, flags);
+			if (fd < 0) {
+				throw std::system_error(errno, std::generic_category(), "eventfd() failed");
+			}
+			return fd;
+		}())
+	{}
+
+	wakeup_event(const wakeup_event&) = delete;
+	wakeup_event& operator=(const wakeup_event&) = delete;
+
+	wakeup_event(wakeup_event&&) = delete;
+	wakeup_event& operator=(wakeup_event&&) = delete;
+
+	~wakeup_event() override
+	{
+		close(this->handle);
+	}
+
+	void signal(uint64_t num_wakeups = 1) noexcept
+	{
+		// the only possible failure is counter overflow, in which case the event is signalled anyway
+		[[maybe_unused]] auto res = ::write(this->handle, &num_wakeups, sizeof(num_wakeups));
+	}
+
+	void clear() noexcept
+	{
+		uint64_t value{};
+		// fails with EAGAIN if the event is not signalled, which is fine
+		[[maybe_unused]] auto res = ::read(this->handle, &value, sizeof(value));
+	}
+
+	// in blocking and semaphore modes, interruption by a signal is the same as a spurious wakeup
+	void wait() noexcept
+	{
+		uint64_t value{};
+		[[maybe_unused]] auto res = ::read(this->handle, &value, sizeof(value));
+	}
+};
+
+} // namespace audout
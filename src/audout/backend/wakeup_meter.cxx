@@ -0,0 +1,86 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <optional>
+
+namespace {
+
+// measures how often the audio thread wakes up to produce samples
+class wakeup_meter
+{
+	using clock = std::chrono::steady_clock;
+
+	// averaging time of the wakeup interval
+	constexpr static double averaging_time = 2;
+
+	// accessed only by audio thread
+	std::optional<clock::time_point> last_wakeup;
+	double average_interval = 0;
+
+	std::atomic<float> rate{0};
+
+public:
+	// called from audio thread on each wakeup
+	void tick() noexcept
+	{
+		auto now = clock::now();
+
+		if (this->last_wakeup.has_value()) {
+			auto interval = std::chrono::duration<double>(now - *this->last_wakeup).count();
+			if (this->average_interval == 0) {
+				this->average_interval = interval;
+			} else {
+				this->average_interval += (interval - this->average_interval) *
+					std::min(1.0, interval / averaging_time);
+			}
+			if (this->average_interval > 0) {
+				this->rate.store(float(1 / this->average_interval), std::memory_order_relaxed);
+			}
+		}
+
+		this->last_wakeup = now;
+	}
+
+	// called from audio thread when it stops waking up, e.g. on pause
+	void reset() noexcept
+	{
+		this->last_wakeup.reset();
+		this->average_interval = 0;
+		this->rate.store(0, std::memory_order_relaxed);
+	}
+
+	float get_rate() const noexcept
+	{
+		return this->rate.load(std::memory_order_relaxed);
+	}
+};
+
+} // namespace
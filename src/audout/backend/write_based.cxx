@@ -26,35 +26,265 @@ SOFTWARE.
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
 #include <thread>
 #include <vector>
 
 #include <nitki/loop_thread.hpp>
 #include <nitki/queue.hpp>
 
+#include "../command_queue.hpp"
 #include "../player.hpp"
+#include "../realtime.hpp"
+
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#include "fill.cxx"
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#include "wakeup_event.cxx"
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#include "wakeup_meter.cxx"
 
 namespace {
 
+// audio thread configuration which can be changed on the fly
+struct stream_config {
+	audout::listener* listener;
+	audout::sample_format sample_type;
+	unsigned frame_size;
+
+	// index of the play buffer to use
+	unsigned play_buf_index;
+
+	// Offset of the period in the play buffer. The space before the period holds the rest of
+	// the period which was interrupted by the switch to this configuration.
+	size_t period_offset;
+};
+
+// commands to the audio thread, must be trivially copyable
+struct command {
+	enum class type {
+		set_paused,
+		reconfigure
+	};
+
+	type command_type;
+
+	union {
+		bool paused;
+
+		// prepared by control thread, stays valid until the audio thread switches to it
+		const stream_config* config;
+	};
+};
+
 class write_based : public nitki::loop_thread
 {
-	audout::listener* listener;
+	// not nullptr in full-duplex mode
+	audout::duplex_listener* duplex_listener;
+
+	// current configuration, changed by the audio thread only on control thread's command
+	stream_config config;
+
+	// configuration being handed over to the audio thread
+	stream_config next_config{};
+
+	// The play buffer used by the audio thread and the spare one.
+	// On reconfiguration the spare buffer is resized by the control thread and handed over to
+	// the audio thread, so that memory is never allocated or freed in the audio thread.
+	std::array<std::vector<uint8_t>, 2> play_bufs;
+
+	// index of the play buffer used by the audio thread, written by the audio thread
+	std::atomic_uint active_play_buf_index = 0;
+
+	// serializes control threads
+	std::mutex control_mutex;
+
+	// play buffer filled and written each period
+	utki::span<uint8_t> period_buf;
+
+	// part of the play buffer not written yet because the write was interrupted
+	utki::span<const uint8_t> unwritten;
+
+	wakeup_meter wakeups;
+
+	// empty if not in full-duplex mode
+	std::vector<uint8_t> capture_buf;
+
+	constexpr static size_t command_queue_capacity = 64;
+	audout::command_queue<command> commands;
+
+	audout::wakeup_event wakeup;
 
-	std::vector<std::int16_t> play_buf;
+	// set when the backend is being destroyed, so that the audio thread stops filling periods
+	std::atomic_bool stopping = false;
+
+	// Set by control thread while switching the configuration, so that the audio thread does not fill periods
+	// while its writes are interrupted. Cleared by the audio thread once it has switched.
+	std::atomic_bool switching = false;
 
 protected:
 	bool is_paused = true;
 
 	write_based(
 		audout::listener* listener, //
-		size_t play_buf_size_samples
+		audout::duplex_listener* duplex_listener,
+		audout::format format,
+		size_t period_size_frames
 	) :
-		nitki::loop_thread(0),
-		listener(listener),
-		play_buf(play_buf_size_samples)
-	{}
+		nitki::loop_thread(1),
+		duplex_listener(duplex_listener),
+		config{listener, format.sample_type, format.frame_size(), 0, 0},
+		play_bufs({std::vector<uint8_t>(period_size_frames * format.frame_size()), {}}),
+		period_buf(utki::make_span(this->play_bufs.front())),
+		commands(command_queue_capacity)
+	{
+		if (this->duplex_listener) {
+			utki::assert(this->config.sample_type == audout::sample_format::int16, SL);
+			this->capture_buf.resize(this->period_buf.size());
+		}
+		this->wait_set.add(this->wakeup, {opros::ready::read}, &this->wakeup);
+	}
+
+	/**
+	 * @brief Write samples to the device.
+	 * Blocks until the whole buffer is written, unless the write is interrupted, see set_period().
+	 * @param buf - raw interleaved samples in the output format.
+	 * @return Number of bytes written. Less than the buffer size only in case the write was interrupted.
+	 */
+	virtual size_t write(utki::span<const uint8_t> buf) = 0;
+
+	/**
+	 * @brief Read captured samples from the device.
+	 * Called only in full-duplex mode, before filling each period.
+	 * Blocks until the whole buffer is filled.
+	 * Default implementation fills the buffer with silence.
+	 * @param buf - buffer for raw interleaved samples in the output format.
+	 */
+	virtual void read(utki::span<uint8_t> buf)
+	{
+		std::fill(buf.begin(), buf.end(), 0);
+	}
+
+	/**
+	 * @brief Notification of reconfiguration.
+	 * Called from the audio thread once the audio thread has switched to the new configuration,
+	 * i.e. after the last period of the old configuration is written or interrupted and before
+	 * the first period of the new one is filled. The backend is supposed to stop interrupting writes.
+	 */
+	virtual void reconfigured() {}
+
+	/**
+	 * @brief Change period size.
+	 * Called from control thread. See reconfigure().
+	 * The audio thread stops filling periods until it switches to the new period size. In case the write
+	 * of the current period is interrupted, the rest of the period is written before the next period is filled,
+	 * so that no frames are dropped.
+	 * @param num_frames - number of frames to fill at once.
+	 * @param interrupt - function which makes blocking write() return right away, until reconfigured() is called.
+	 * @throw std::logic_error - in case of full-duplex mode, which does not support reconfiguration.
+	 */
+	template <typename function_type>
+	void set_period(size_t num_frames, function_type interrupt)
+	{
+		std::lock_guard lock(this->control_mutex);
+
+		// the current period is not changed by the audio thread without the control mutex
+		auto& buf = this->play_bufs.at(this->config.play_buf_index);
+
+		// the rest of the interrupted period is either in the period or in the space before it
+		auto max_unwritten_size = std::max(this->config.period_offset, buf.size() - this->config.period_offset);
+
+		this->switch_config(
+			this->config.listener, //
+			this->config.sample_type,
+			this->config.frame_size,
+			num_frames,
+			max_unwritten_size,
+			interrupt
+		);
+	}
+
+	/**
+	 * @brief Change listener, sample format and period size.
+	 * Called from control thread. Allocates the play buffer of the new size, sends the new configuration
+	 * to the audio thread and waits until the audio thread switches to it. The backend is supposed to
+	 * reconfigure the device itself, see reconfigured().
+	 * In case the audio thread is blocked writing to the device, it picks up the new configuration once the
+	 * write returns. In case the write is interrupted, the rest of the period is dropped, since it is
+	 * in the old format.
+	 * @param listener - listener to fill the play buffer in the new configuration.
+	 * @param format - new output format.
+	 * @param num_frames - number of frames to fill at once.
+	 * @param interrupt - function which makes blocking write() return right away, until reconfigured() is called.
+	 * @throw std::logic_error - in case of full-duplex mode, which does not support reconfiguration.
+	 */
+	template <typename function_type>
+	void reconfigure(audout::listener* listener, audout::format format, size_t num_frames, function_type interrupt)
+	{
+		std::lock_guard lock(this->control_mutex);
+		this->switch_config(
+			listener, //
+			format.sample_type,
+			format.frame_size(),
+			num_frames,
+			0,
+			interrupt
+		);
+	}
+
+	void reconfigure(audout::listener* listener, audout::format format, size_t num_frames)
+	{
+		this->reconfigure(listener, format, num_frames, []() {});
+	}
+
+	/**
+	 * @brief Get current period size.
+	 * @return Number of frames filled at once.
+	 */
+	size_t get_period() noexcept
+	{
+		std::lock_guard lock(this->control_mutex);
+		return (this->play_bufs.at(this->config.play_buf_index).size() - this->config.period_offset) /
+			this->config.frame_size;
+	}
+
+	/**
+	 * @brief Stop the audio thread.
+	 * To be called from the backend's destructor. Once this function is called, the listener is not
+	 * called anymore and the audio thread waits for the quit message instead of spinning over
+	 * interrupted writes.
+	 * @param interrupt - function which makes blocking write() and read() return right away.
+	 */
+	template <typename function_type>
+	void stop(function_type interrupt)
+	{
+		this->stopping.store(true, std::memory_order_relaxed);
+		interrupt();
+		this->quit();
+		this->join();
+	}
+
+	/**
+	 * @brief Drop captured samples which were not read yet.
+	 * Called in full-duplex mode when playback is resumed after pause, so that samples
+	 * captured while paused do not increase the latency.
+	 */
+	virtual void flush_capture() {}
 
-	virtual void write(const utki::span<int16_t> buf) = 0;
+	bool is_duplex() const noexcept
+	{
+		return this->duplex_listener != nullptr;
+	}
+
+	/**
+	 * @brief Full-duplex latency.
+	 * To be updated by the backend from the audio thread.
+	 */
+	std::atomic<std::chrono::microseconds> duplex_latency{std::chrono::microseconds(0)};
 
 public:
 	write_based(const write_based&) = delete;
@@ -63,19 +293,150 @@ public:
 	write_based(write_based&&) = delete;
 	write_based& operator=(write_based&&) = delete;
 
-	~write_based() override = default;
+	~write_based() override
+	{
+		// the thread is supposed to be joined by now
+		this->wait_set.remove(this->wakeup);
+	}
+
+	/**
+	 * @brief Send command to the audio thread.
+	 * Does not allocate memory. In case the command queue is full, waits for the audio thread to drain it.
+	 * @param c - command to send.
+	 */
+	void send(const command& c)
+	{
+		while (!this->commands.push(c)) {
+			this->wakeup.signal();
+			std::this_thread::yield();
+		}
+		this->wakeup.signal();
+	}
 
 private:
+	// the control mutex must be locked
+	template <typename function_type>
+	void switch_config(
+		audout::listener* listener,
+		audout::sample_format sample_type,
+		unsigned frame_size,
+		size_t num_frames,
+		size_t max_unwritten_size,
+		function_type interrupt
+	)
+	{
+		if (this->is_duplex()) {
+			throw std::logic_error("full-duplex mode does not support reconfiguration");
+		}
+
+		// the spare buffer is not accessed by the audio thread until it receives the command
+		unsigned index = 1 - this->active_play_buf_index.load(std::memory_order_acquire);
+		auto& buf = this->play_bufs.at(index);
+		buf.resize(max_unwritten_size + num_frames * frame_size);
+		buf.shrink_to_fit();
+
+		this->next_config = {listener, sample_type, frame_size, index, max_unwritten_size};
+
+		// the flag is set before interrupting, so that the audio thread does not fill periods which can not be written
+		this->switching.store(true, std::memory_order_release);
+		interrupt();
+
+		command c{};
+		c.command_type = command::type::reconfigure;
+		c.config = &this->next_config;
+		this->send(c);
+
+		// Wait for the audio thread to release the previous buffer, so that next call can reuse it.
+		// Reconfiguration is rare, so just poll.
+		constexpr auto poll_interval = std::chrono::milliseconds(1);
+		while (this->active_play_buf_index.load(std::memory_order_acquire) != index) {
+			std::this_thread::sleep_for(poll_interval);
+		}
+	}
+
+	void handle(const command& c) noexcept
+	{
+		switch (c.command_type) {
+			case command::type::set_paused:
+				if (this->is_paused && !c.paused && this->is_duplex()) {
+					this->flush_capture();
+				}
+				if (c.paused) {
+					this->wakeups.reset();
+				}
+				this->is_paused = c.paused;
+				break;
+			case command::type::reconfigure:
+				{
+					this->config = *c.config;
+					auto buf = utki::make_span(this->play_bufs.at(this->config.play_buf_index));
+					this->period_buf = buf.subspan(this->config.period_offset);
+
+					// move the rest of the interrupted period right before the new period, so that
+					// the previous play buffer can be released
+					auto n = this->unwritten.size();
+					if (n <= this->config.period_offset) {
+						auto dst = buf.subspan(this->config.period_offset - n, n);
+						std::copy(this->unwritten.begin(), this->unwritten.end(), dst.begin());
+						this->unwritten = dst;
+					} else {
+						// the rest of the period in the previous format is dropped
+						this->unwritten = {};
+					}
+
+					this->switching.store(false, std::memory_order_relaxed);
+					this->reconfigured();
+					this->active_play_buf_index.store(this->config.play_buf_index, std::memory_order_release);
+				}
+				break;
+		}
+	}
+
 	std::optional<uint32_t> on_loop() override
 	{
-		if (this->is_paused) {
+		audout::realtime_scope realtime;
+
+		this->wakeup.clear();
+		while (auto c = this->commands.pop()) {
+			this->handle(*c);
+		}
+
+		if (this->is_paused || this->stopping.load(std::memory_order_relaxed) ||
+			this->switching.load(std::memory_order_acquire))
+		{
 			return {};
 		}
 
-		this->listener->fill(utki::make_span(this->play_buf));
+		this->wakeups.tick();
+
+		if (!this->unwritten.empty()) {
+			// this call will block if play buffer is full
+			this->unwritten = this->unwritten.subspan(this->write(this->unwritten));
+			return 0;
+		}
+
+		if (this->is_duplex()) {
+			// this call will block until a period of input is captured
+			this->read(utki::make_span(this->capture_buf));
+
+			// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast, "full-duplex mode is 16-bit only")
+			this->duplex_listener->fill(
+				utki::make_span(
+					reinterpret_cast<const int16_t*>(this->capture_buf.data()),
+					this->capture_buf.size() / sizeof(int16_t)
+				),
+				utki::make_span(
+					reinterpret_cast<int16_t*>(this->period_buf.data()), //
+					this->period_buf.size() / sizeof(int16_t)
+				)
+			);
+			// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+		} else {
+			fill(*this->config.listener, this->config.sample_type, this->period_buf);
+		}
 
 		// this call will block if play buffer is full
-		this->write(utki::make_span(this->play_buf));
+		this->unwritten = this->period_buf.subspan(this->write(this->period_buf));
 
 		return 0;
 	}
@@ -83,9 +444,20 @@ private:
 public:
 	void set_paused(bool pause)
 	{
-		this->push_back([this, pause]() {
-			this->is_paused = pause;
-		});
+		command c{};
+		c.command_type = command::type::set_paused;
+		c.paused = pause;
+		this->send(c);
+	}
+
+	std::chrono::microseconds get_duplex_latency() const noexcept
+	{
+		return this->duplex_latency.load(std::memory_order_relaxed);
+	}
+
+	float get_wakeup_rate() const noexcept
+	{
+		return this->wakeups.get_rate();
 	}
 };
 
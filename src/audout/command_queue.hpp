@@ -0,0 +1,158 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+
+namespace audout {
+
+/**
+ * @brief Fixed capacity lock-free multi-producer single-consumer queue.
+ * Intended for passing commands from control threads to the audio thread.
+ * All memory is allocated at construction time, pushing and popping never allocate
+ * and never block, so the queue can be safely drained from real-time audio thread.
+ * @tparam command_type - type of the command. Must be trivially copyable.
+ */
+template <typename command_type>
+class command_queue
+{
+	static_assert(std::is_trivially_copyable_v<command_type>, "command_type must be trivially copyable");
+
+	constexpr static size_t cache_line_size = 64;
+
+	struct cell {
+		std::atomic<size_t> sequence;
+		command_type command;
+	};
+
+	const size_t mask;
+	std::unique_ptr<cell[]> cells;
+
+	alignas(cache_line_size) std::atomic<size_t> enqueue_pos{0};
+
+	// accessed only by consumer thread
+	alignas(cache_line_size) size_t dequeue_pos = 0;
+
+	static size_t round_up_to_power_of_2(size_t n)
+	{
+		if (n == 0) {
+			throw std::invalid_argument("command_queue::command_queue(): capacity is 0");
+		}
+		size_t ret = 1;
+		while (ret < n) {
+			ret <<= 1;
+		}
+		return ret;
+	}
+
+public:
+	/**
+	 * @brief Create command queue.
+	 * @param capacity - maximum number of commands the queue can hold. Rounded up to the nearest power of 2.
+	 */
+	command_queue(size_t capacity) :
+		mask(round_up_to_power_of_2(capacity) - 1),
+		cells(std::make_unique<cell[]>(this->mask + 1))
+	{
+		for (size_t i = 0; i != this->mask + 1; ++i) {
+			this->cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	command_queue(const command_queue&) = delete;
+	command_queue& operator=(const command_queue&) = delete;
+
+	command_queue(command_queue&&) = delete;
+	command_queue& operator=(command_queue&&) = delete;
+
+	~command_queue() = default;
+
+	size_t capacity() const noexcept
+	{
+		return this->mask + 1;
+	}
+
+	/**
+	 * @brief Push command to the queue.
+	 * Thread-safe, can be called from any number of threads concurrently.
+	 * @param command - command to push.
+	 * @return true if the command was pushed.
+	 * @return false if the queue is full.
+	 */
+	bool push(const command_type& command) noexcept
+	{
+		size_t pos = this->enqueue_pos.load(std::memory_order_relaxed);
+		cell* c = nullptr;
+		for (;;) {
+			c = &this->cells[pos & this->mask];
+			size_t seq = c->sequence.load(std::memory_order_acquire);
+			auto diff = intptr_t(seq) - intptr_t(pos);
+			if (diff == 0) {
+				if (this->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (diff < 0) {
+				// queue is full
+				return false;
+			} else {
+				pos = this->enqueue_pos.load(std::memory_order_relaxed);
+			}
+		}
+
+		c->command = command;
+		c->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * @brief Pop command from the queue.
+	 * Must only be called from the single consumer thread.
+	 * @return The popped command or empty optional if the queue is empty.
+	 */
+	std::optional<command_type> pop() noexcept
+	{
+		cell& c = this->cells[this->dequeue_pos & this->mask];
+		size_t seq = c.sequence.load(std::memory_order_acquire);
+		if (intptr_t(seq) - intptr_t(this->dequeue_pos + 1) < 0) {
+			// queue is empty
+			return {};
+		}
+
+		command_type ret = c.command;
+		c.sequence.store(this->dequeue_pos + this->mask + 1, std::memory_order_release);
+		++this->dequeue_pos;
+		return ret;
+	}
+};
+
+} // namespace audout
@@ -0,0 +1,109 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "format.hpp"
+
+namespace audout {
+
+/**
+ * @brief Convert sample to float.
+ * @param sample - sample to convert.
+ * @return Sample value, full scale is [-1, 1].
+ */
+inline float to_float(int16_t sample) noexcept
+{
+	constexpr float scale = 1.0f / float(1 << 15);
+	return float(sample) * scale;
+}
+
+inline float to_float(int24 sample) noexcept
+{
+	constexpr float scale = 1.0f / float(1 << 23);
+	return float(int32_t(sample)) * scale;
+}
+
+inline float to_float(int32_t sample) noexcept
+{
+	constexpr double scale = 1.0 / double(uint32_t(1) << 31);
+	return float(double(sample) * scale);
+}
+
+inline float to_float(float sample) noexcept
+{
+	return sample;
+}
+
+/**
+ * @brief Convert float to sample.
+ * The value is rounded to nearest integer and clipped to the sample type's range.
+ * @tparam sample_type - type of the sample to convert to.
+ * @param value - value to convert, full scale is [-1, 1].
+ * @return Converted sample.
+ */
+template <typename sample_type>
+sample_type from_float(float value) noexcept;
+
+template <>
+inline int16_t from_float<int16_t>(float value) noexcept
+{
+	return int16_t(std::clamp(
+		std::lrint(value * float(1 << 15)), //
+		long(std::numeric_limits<int16_t>::min()),
+		long(std::numeric_limits<int16_t>::max())
+	));
+}
+
+template <>
+inline int24 from_float<int24>(float value) noexcept
+{
+	constexpr long max_int24 = (1 << 23) - 1;
+	return {int32_t(std::clamp(std::lrint(value * float(1 << 23)), -max_int24 - 1, max_int24))};
+}
+
+template <>
+inline int32_t from_float<int32_t>(float value) noexcept
+{
+	return int32_t(std::clamp(
+		std::llrint(double(value) * double(uint32_t(1) << 31)),
+		(long long)(std::numeric_limits<int32_t>::min()),
+		(long long)(std::numeric_limits<int32_t>::max())
+	));
+}
+
+template <>
+inline float from_float<float>(float value) noexcept
+{
+	return value;
+}
+
+} // namespace audout
@@ -0,0 +1,445 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "convolver.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <utki/debug.hpp>
+
+#if CFG_OS == CFG_OS_LINUX
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#	include "backend/wakeup_event.cxx"
+#endif
+
+#include "convert.hpp"
+
+using namespace audout;
+
+namespace {
+// the tail ring buffers hold this number of tail blocks, the output one is prefilled with two of them
+constexpr size_t tail_ring_blocks = 4;
+
+unsigned check_num_channels(const std::vector<std::vector<float>>& impulse_responses)
+{
+	if (impulse_responses.empty()) {
+		throw std::invalid_argument("convolver::convolver(): no impulse responses given");
+	}
+	if (std::any_of(impulse_responses.begin(), impulse_responses.end(), [](const auto& ir) {
+			return ir.empty();
+		}))
+	{
+		throw std::invalid_argument("convolver::convolver(): impulse response is empty");
+	}
+	return unsigned(impulse_responses.size());
+}
+
+size_t check_block_size(size_t block_size)
+{
+	if (block_size < 2 || (block_size & (block_size - 1)) != 0) {
+		throw std::invalid_argument("convolver::convolver(): block size is not a power of 2 or is less than 2");
+	}
+	return block_size;
+}
+
+size_t get_head_length(size_t block_size)
+{
+	// the tail output is delayed by two tail blocks: one for collecting the input and one for computing
+	return 2 * block_size * convolver::tail_block_ratio;
+}
+
+bool needs_tail(const std::vector<std::vector<float>>& impulse_responses, size_t block_size)
+{
+	auto head_length = get_head_length(block_size);
+	return std::any_of(impulse_responses.begin(), impulse_responses.end(), [&](const auto& ir) {
+		return ir.size() > head_length;
+	});
+}
+
+// complex multiplication is written out, since std::complex operator* handles infinities
+// by calling a library function, which prevents vectorization
+void multiply_accumulate(
+	utki::span<const std::complex<float>> a,
+	utki::span<const std::complex<float>> b,
+	utki::span<std::complex<float>> accumulator
+) noexcept
+{
+	utki::assert(a.size() == accumulator.size(), SL);
+	utki::assert(b.size() == accumulator.size(), SL);
+
+	for (size_t i = 0; i != accumulator.size(); ++i) {
+		const auto& x = a[i];
+		const auto& y = b[i];
+		accumulator[i] += std::complex<float>(
+			x.real() * y.real() - x.imag() * y.imag(), //
+			x.real() * y.imag() + x.imag() * y.real()
+		);
+	}
+}
+
+// planar buffer holds channel blocks of num_frames samples one after another
+void interleave(utki::span<const float> planar, utki::span<float> interleaved, unsigned num_channels) noexcept
+{
+	auto num_frames = planar.size() / num_channels;
+	for (unsigned ch = 0; ch != num_channels; ++ch) {
+		for (size_t i = 0; i != num_frames; ++i) {
+			interleaved[i * num_channels + ch] = planar[ch * num_frames + i];
+		}
+	}
+}
+
+void deinterleave(utki::span<const float> interleaved, utki::span<float> planar, unsigned num_channels) noexcept
+{
+	auto num_frames = planar.size() / num_channels;
+	for (unsigned ch = 0; ch != num_channels; ++ch) {
+		for (size_t i = 0; i != num_frames; ++i) {
+			planar[ch * num_frames + i] = interleaved[i * num_channels + ch];
+		}
+	}
+}
+
+size_t free_space(const ring_buffer<float>& ring) noexcept
+{
+	// called by producer, the consumer can only increase the free space
+	return ring.capacity() - ring.size();
+}
+} // namespace
+
+convolver::partitioned_convolution::partitioned_convolution(
+	utki::span<const float> impulse_response,
+	size_t block_size
+) :
+	block_size(block_size),
+	num_partitions((impulse_response.size() + block_size - 1) / block_size),
+	fft(2 * block_size),
+	ir_spectra(this->num_partitions * (block_size + 1)),
+	input_spectra(this->ir_spectra.size()),
+	input(2 * block_size),
+	accumulator(block_size + 1),
+	output(2 * block_size)
+{
+	auto num_bins = this->accumulator.size();
+
+	// each partition is zero padded to the FFT size, so that the last half of the circular convolution
+	// of two consecutive input blocks with it is the linear convolution of the last block
+	for (size_t p = 0; p != this->num_partitions; ++p) {
+		auto partition = impulse_response.subspan(
+			p * block_size,
+			std::min(block_size, impulse_response.size() - p * block_size)
+		);
+		std::fill(
+			std::copy(partition.begin(), partition.end(), this->output.begin()), //
+			this->output.end(),
+			0.0f
+		);
+		this->fft.forward(this->output, utki::make_span(this->ir_spectra).subspan(p * num_bins, num_bins));
+	}
+}
+
+void convolver::partitioned_convolution::process(utki::span<const float> in, utki::span<float> out) noexcept
+{
+	utki::assert(in.size() == this->block_size, SL);
+	utki::assert(out.size() == this->block_size, SL);
+
+	if (this->num_partitions == 0) {
+		std::fill(out.begin(), out.end(), 0.0f);
+		return;
+	}
+
+	auto num_bins = this->accumulator.size();
+
+	auto current_block = std::next(this->input.begin(), ptrdiff_t(this->block_size));
+	std::copy(current_block, this->input.end(), this->input.begin());
+	std::copy(in.begin(), in.end(), current_block);
+
+	// the delay line goes backwards, so that partition p is multiplied by spectrum at (newest + p)
+	this->newest_input = (this->newest_input == 0 ? this->num_partitions : this->newest_input) - 1;
+
+	auto input_spectra_span = utki::make_span(this->input_spectra);
+	auto ir_spectra_span = utki::make_span(this->ir_spectra);
+
+	this->fft.forward(this->input, input_spectra_span.subspan(this->newest_input * num_bins, num_bins));
+
+	std::fill(this->accumulator.begin(), this->accumulator.end(), std::complex<float>());
+	for (size_t p = 0; p != this->num_partitions; ++p) {
+		auto slot = this->newest_input + p;
+		if (slot >= this->num_partitions) {
+			slot -= this->num_partitions;
+		}
+		multiply_accumulate(
+			input_spectra_span.subspan(slot * num_bins, num_bins),
+			ir_spectra_span.subspan(p * num_bins, num_bins),
+			this->accumulator
+		);
+	}
+
+	this->fft.inverse(this->accumulator, this->output);
+
+	std::copy(std::next(this->output.begin(), ptrdiff_t(this->block_size)), this->output.end(), out.begin());
+}
+
+convolver::convolver(const std::vector<std::vector<float>>& impulse_responses, size_t block_size) :
+	num_channels(check_num_channels(impulse_responses)),
+	block_size(check_block_size(block_size)),
+	tail_block_size(block_size * tail_block_ratio),
+	input_block(this->num_channels * block_size),
+	output_block(this->input_block.size()),
+	interleaved_block(this->input_block.size()),
+	// the ring buffers are not used in case there is no tail
+	tail_input(
+		needs_tail(impulse_responses, block_size) ? tail_ring_blocks * this->tail_block_size * this->num_channels : 1
+	),
+	tail_output(this->tail_input.capacity())
+{
+	auto head_length = get_head_length(block_size);
+
+	this->head.reserve(this->num_channels);
+	for (const auto& ir : impulse_responses) {
+		this->head.emplace_back(utki::make_span(ir.data(), std::min(ir.size(), head_length)), block_size);
+	}
+
+	if (!needs_tail(impulse_responses, block_size)) {
+		return;
+	}
+
+	this->tail.reserve(this->num_channels);
+	for (const auto& ir : impulse_responses) {
+		this->tail.emplace_back(
+			ir.size() > head_length ? utki::make_span(ir).subspan(head_length) : utki::span<const float>(),
+			this->tail_block_size
+		);
+	}
+
+	this->worker_interleaved.resize(this->tail_block_size * this->num_channels);
+	this->worker_input.resize(this->worker_interleaved.size());
+	this->worker_output.resize(this->worker_interleaved.size());
+
+	// the tail output is delayed by the head segment length
+	for (size_t i = 0; i != head_length / this->tail_block_size; ++i) {
+		this->tail_output.write(this->worker_interleaved);
+	}
+
+#if CFG_OS == CFG_OS_LINUX
+	this->wakeup = std::make_unique<wakeup_event>(wakeup_event::mode::blocking);
+#endif
+
+	this->thread = std::thread([this]() {
+		this->run();
+	});
+}
+
+convolver::~convolver()
+{
+	if (!this->thread.joinable()) {
+		return;
+	}
+
+#if CFG_OS == CFG_OS_LINUX
+	this->quit.store(true, std::memory_order_release);
+	this->wake_up_worker();
+	this->thread.join();
+#else
+	{
+		std::lock_guard lock(this->thread_mutex);
+		this->quit.store(true, std::memory_order_release);
+	}
+	this->thread_cv.notify_all();
+	this->thread.join();
+#endif
+}
+
+void convolver::process(utki::span<int16_t> buf) noexcept
+{
+	this->process_samples(buf);
+}
+
+void convolver::process(utki::span<int24> buf) noexcept
+{
+	this->process_samples(buf);
+}
+
+void convolver::process(utki::span<int32_t> buf) noexcept
+{
+	this->process_samples(buf);
+}
+
+void convolver::process(utki::span<float> buf) noexcept
+{
+	this->process_samples(buf);
+}
+
+template <typename sample_type>
+void convolver::process_samples(utki::span<sample_type> buf) noexcept
+{
+	utki::assert(buf.size() % this->num_channels == 0, SL);
+
+	for (auto i = buf.begin(); i != buf.end();) {
+		for (size_t ch = 0; ch != this->num_channels; ++ch, ++i) {
+			auto index = ch * this->block_size + this->block_pos;
+			this->input_block[index] = to_float(*i);
+			*i = from_float<sample_type>(this->output_block[index]);
+		}
+
+		++this->block_pos;
+		if (this->block_pos == this->block_size) {
+			this->block_pos = 0;
+			this->process_block();
+		}
+	}
+}
+
+void convolver::process_block() noexcept
+{
+	auto input = utki::make_span(this->input_block);
+	auto output = utki::make_span(this->output_block);
+
+	for (size_t ch = 0; ch != this->num_channels; ++ch) {
+		this->head[ch].process(
+			input.subspan(ch * this->block_size, this->block_size),
+			output.subspan(ch * this->block_size, this->block_size)
+		);
+	}
+
+	if (!this->tail.empty()) {
+		this->exchange_tail();
+	}
+}
+
+void convolver::exchange_tail() noexcept
+{
+	auto block = utki::make_span(this->interleaved_block);
+
+	// frames which did not fit into the tail input before are replaced with silence to keep the tail aligned
+	std::fill(block.begin(), block.end(), 0.0f);
+	while (this->tail_input_deficit != 0) {
+		auto n = std::min(this->tail_input_deficit, this->block_size);
+		auto zeros = block.subspan(0, n * this->num_channels);
+		if (free_space(this->tail_input) < zeros.size()) {
+			break;
+		}
+		this->tail_input.write(zeros);
+		this->tail_input_deficit -= n;
+	}
+
+	interleave(this->input_block, block, this->num_channels);
+	if (this->tail_input_deficit == 0 && free_space(this->tail_input) >= block.size()) {
+		this->tail_input.write(block);
+	} else {
+		this->tail_input_deficit += this->block_size;
+		this->num_late_frames.fetch_add(this->block_size, std::memory_order_relaxed);
+	}
+
+	if (this->tail_input.size() >= this->worker_interleaved.size()) {
+		this->wake_up_worker();
+	}
+
+	// drop the tail frames which were skipped because the worker thread was late
+	while (this->tail_output_deficit != 0) {
+		auto n = std::min(this->tail_output_deficit, this->block_size);
+		auto skipped = block.subspan(0, n * this->num_channels);
+		if (this->tail_output.size() < skipped.size()) {
+			break;
+		}
+		this->tail_output.read(skipped);
+		this->tail_output_deficit -= n;
+	}
+
+	if (this->tail_output_deficit != 0 || this->tail_output.size() < block.size()) {
+		this->tail_output_deficit += this->block_size;
+		this->num_late_frames.fetch_add(this->block_size, std::memory_order_relaxed);
+		return;
+	}
+
+	this->tail_output.read(block);
+	for (size_t ch = 0; ch != this->num_channels; ++ch) {
+		for (size_t i = 0; i != this->block_size; ++i) {
+			this->output_block[ch * this->block_size + i] += block[i * this->num_channels + ch];
+		}
+	}
+}
+
+void convolver::wake_up_worker() noexcept
+{
+#if CFG_OS == CFG_OS_LINUX
+	this->wakeup->signal();
+#else
+	this->thread_cv.notify_one();
+#endif
+}
+
+void convolver::wait_for_tail_input()
+{
+#if CFG_OS == CFG_OS_LINUX
+	this->wakeup->wait();
+#else
+	std::unique_lock lock(this->thread_mutex);
+	this->thread_cv.wait(lock, [&]() {
+		return this->quit.load(std::memory_order_relaxed) || this->can_process_tail_block();
+	});
+#endif
+}
+
+bool convolver::can_process_tail_block() const noexcept
+{
+	auto tail_block_samples = this->worker_interleaved.size();
+
+	// After the worker thread was late the audio thread drops the output frames computed for the skipped
+	// input, until then the output may not have space for the next block. Writing it partially would
+	// misalign the tail, so the worker thread waits for the audio thread to drain the output.
+	return this->tail_input.size() >= tail_block_samples && free_space(this->tail_output) >= tail_block_samples;
+}
+
+void convolver::run()
+{
+	while (!this->quit.load(std::memory_order_acquire)) {
+		while (this->can_process_tail_block()) {
+			this->process_tail_block();
+		}
+
+		this->wait_for_tail_input();
+	}
+}
+
+void convolver::process_tail_block() noexcept
+{
+	auto input = utki::make_span(this->worker_input);
+	auto output = utki::make_span(this->worker_output);
+
+	this->tail_input.read(this->worker_interleaved);
+	deinterleave(this->worker_interleaved, input, this->num_channels);
+
+	for (size_t ch = 0; ch != this->num_channels; ++ch) {
+		this->tail[ch].process(
+			input.subspan(ch * this->tail_block_size, this->tail_block_size),
+			output.subspan(ch * this->tail_block_size, this->tail_block_size)
+		);
+	}
+
+	interleave(output, this->worker_interleaved, this->num_channels);
+
+	this->tail_output.write(this->worker_interleaved);
+}
@@ -0,0 +1,222 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <atomic>
+#include <complex>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <utki/config.hpp>
+#include <utki/span.hpp>
+
+#include "fft.hpp"
+#include "format.hpp"
+#include "ring_buffer.hpp"
+
+namespace audout {
+
+#if CFG_OS == CFG_OS_LINUX
+class wakeup_event;
+#endif
+
+/**
+ * @brief Partitioned FFT convolution engine.
+ * Convolves each channel with its own impulse response, e.g. for reverb or speaker correction.
+ * The impulse response is split into two segments, each of which is convolved by uniformly partitioned
+ * overlap-save method. The head segment is split into partitions of the block size and is processed
+ * in the audio thread, so the output is delayed by exactly one block. The rest of the impulse response
+ * is split into partitions of tail_block_ratio blocks, and is processed in a background worker thread,
+ * which has time of several blocks to compute each tail block.
+ * In case the worker thread does not keep up, the tail contribution is skipped for the late frames,
+ * which are counted, the audio thread never blocks.
+ *
+ * Typical usage:
+ * @code
+ * audout::convolver reverb({left_ir, right_ir}, 256);
+ * player.set_convolver(&reverb);
+ * @endcode
+ */
+class convolver
+{
+public:
+	/**
+	 * @brief Ratio of tail partition size to the block size.
+	 */
+	constexpr static size_t tail_block_ratio = 8;
+
+private:
+	// uniformly partitioned overlap-save convolution of one channel with one segment of the impulse response
+	class partitioned_convolution
+	{
+		size_t block_size;
+		size_t num_partitions;
+
+		real_fft fft;
+
+		// spectra of the impulse response partitions, block_size + 1 bins each
+		std::vector<std::complex<float>> ir_spectra;
+
+		// spectra of the recent input blocks, same layout, used as circular frequency-domain delay line
+		std::vector<std::complex<float>> input_spectra;
+		size_t newest_input = 0;
+
+		// previous and current input blocks
+		std::vector<float> input;
+
+		std::vector<std::complex<float>> accumulator;
+		std::vector<float> output;
+
+	public:
+		partitioned_convolution(utki::span<const float> impulse_response, size_t block_size);
+
+		// in and out are of block size
+		void process(utki::span<const float> in, utki::span<float> out) noexcept;
+	};
+
+	const unsigned num_channels;
+	const size_t block_size;
+	const size_t tail_block_size;
+
+	std::vector<partitioned_convolution> head;
+
+	// empty in case the impulse responses fit into the head segment
+	std::vector<partitioned_convolution> tail;
+
+	// audio thread state, channel blocks are stored one after another
+	size_t block_pos = 0;
+	std::vector<float> input_block;
+	std::vector<float> output_block;
+	std::vector<float> interleaved_block;
+
+	// number of frames to skip in the tail streams to keep them aligned after the worker thread was late
+	size_t tail_input_deficit = 0;
+	size_t tail_output_deficit = 0;
+
+	std::atomic<uint64_t> num_late_frames = 0;
+
+	// interleaved tail input written by audio thread, tail output written by worker thread
+	ring_buffer<float> tail_input;
+	ring_buffer<float> tail_output;
+
+	// worker thread state, channel blocks are stored one after another
+	std::vector<float> worker_interleaved;
+	std::vector<float> worker_input;
+	std::vector<float> worker_output;
+
+	// The audio thread wakes up the worker thread without locking, when a tail block is ready.
+#if CFG_OS == CFG_OS_LINUX
+	// the worker thread blocks on it
+	std::unique_ptr<wakeup_event> wakeup;
+#else
+	// the notification can be lost, in which case it is repeated with the next block
+	std::mutex thread_mutex;
+	std::condition_variable thread_cv;
+#endif
+	std::atomic_bool quit = false;
+	std::thread thread;
+
+	template <typename sample_type>
+	void process_samples(utki::span<sample_type> buf) noexcept;
+
+	void process_block() noexcept;
+	void exchange_tail() noexcept;
+
+	void wake_up_worker() noexcept;
+	void wait_for_tail_input();
+	bool can_process_tail_block() const noexcept;
+
+	void run();
+	void process_tail_block() noexcept;
+
+public:
+	/**
+	 * @brief Create convolver.
+	 * Computes spectra of the impulse responses and starts the worker thread in case the impulse
+	 * responses are longer than the head segment, which is 2 * tail_block_ratio blocks.
+	 * @param impulse_responses - impulse response for each channel. Number of impulse responses defines
+	 *                            the number of channels. Impulse responses may be of different length.
+	 * @param block_size - size of the head partitions in frames. Must be a power of 2, not less than 2.
+	 *                     It is also the latency the convolver adds, so it is reasonable to use the player's
+	 *                     period size rounded up to a power of 2.
+	 * @throw std::invalid_argument - in case there are no impulse responses, any of them is empty,
+	 *                                or the block size is not a power of 2.
+	 */
+	convolver(const std::vector<std::vector<float>>& impulse_responses, size_t block_size);
+
+	convolver(const convolver&) = delete;
+	convolver& operator=(const convolver&) = delete;
+
+	convolver(convolver&&) = delete;
+	convolver& operator=(convolver&&) = delete;
+
+	/**
+	 * @brief Stop the worker thread.
+	 */
+	~convolver();
+
+	unsigned get_num_channels() const noexcept
+	{
+		return this->num_channels;
+	}
+
+	/**
+	 * @brief Get latency added by the convolver.
+	 * @return Delay of the output in frames, equal to the block size.
+	 */
+	size_t get_latency() const noexcept
+	{
+		return this->block_size;
+	}
+
+	/**
+	 * @brief Convolve samples in place.
+	 * Does not allocate memory and never blocks. Must only be called from a single thread.
+	 * @param buf - interleaved frames of get_num_channels() channels.
+	 */
+	void process(utki::span<int16_t> buf) noexcept;
+	void process(utki::span<int24> buf) noexcept;
+	void process(utki::span<int32_t> buf) noexcept;
+	void process(utki::span<float> buf) noexcept;
+
+	/**
+	 * @brief Get number of frames processed without the tail contribution.
+	 * The tail is skipped for the frames which the worker thread did not compute in time.
+	 * Can be called from any thread.
+	 * @return Number of late frames since the convolver creation.
+	 */
+	uint64_t get_num_late_frames() const noexcept
+	{
+		return this->num_late_frames.load(std::memory_order_relaxed);
+	}
+};
+
+} // namespace audout
@@ -0,0 +1,195 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "dither.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include <utki/debug.hpp>
+
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#	include <arm_neon.h>
+#endif
+
+using namespace audout;
+
+namespace {
+constexpr float full_scale = 32768;
+
+int16_t quantize(float v) noexcept
+{
+	return int16_t(std::clamp(
+		std::lrint(v), //
+		long(std::numeric_limits<int16_t>::min()),
+		long(std::numeric_limits<int16_t>::max())
+	));
+}
+} // namespace
+
+dither::dither(
+	unsigned num_channels, //
+	audout::noise_shaping shaping,
+	uint32_t seed
+) :
+	num_channels(num_channels),
+	shaping(shaping)
+{
+	if (num_channels == 0 || num_channels > max_num_channels) {
+		throw std::invalid_argument("dither::dither(): number of channels is out of supported range");
+	}
+
+	// xorshift state must not be zero, derive lanes from the seed with splitmix-like scrambling
+	for (auto& s : this->random_state) {
+		seed += 0x9e3779b9;
+		uint32_t z = seed;
+		z = (z ^ (z >> 16)) * 0x85ebca6b;
+		z = (z ^ (z >> 13)) * 0xc2b2ae35;
+		z ^= z >> 16;
+		s = z == 0 ? 1 : z;
+	}
+}
+
+void dither::reset() noexcept
+{
+	for (auto& e : this->errors) {
+		e.fill(0);
+	}
+}
+
+void dither::set_noise_shaping(audout::noise_shaping shaping) noexcept
+{
+	this->shaping = shaping;
+	this->reset();
+}
+
+void dither::generate_noise(std::array<float, noise_block_size>& noise) noexcept
+{
+	// the lanes are independent, so the compiler vectorizes the inner loops
+	constexpr auto num_lanes = std::tuple_size_v<decltype(random_state)>;
+	constexpr float scale = 1.0f / float(1 << 16);
+
+	auto state = this->random_state;
+
+	for (size_t i = 0; i != noise_block_size; i += num_lanes) {
+		std::array<uint32_t, num_lanes> a{};
+		for (size_t l = 0; l != num_lanes; ++l) {
+			auto& s = state[l];
+			s ^= s << 13;
+			s ^= s >> 17;
+			s ^= s << 5;
+			a[l] = s;
+		}
+
+		// sum of two uniform distributions makes triangular one, each 16-bit half of the random number
+		// provides a uniform value in range [0, 1), so the result is in range (-1, 1) LSB
+		for (size_t l = 0; l != num_lanes; ++l) {
+			noise[i + l] = float(a[l] >> 16) * scale + float(a[l] & 0xffff) * scale - 1;
+		}
+	}
+
+	this->random_state = state;
+}
+
+void dither::convert(utki::span<const float> src, utki::span<int16_t> dst) noexcept
+{
+	utki::assert(src.size() == dst.size(), SL);
+	utki::assert(src.size() % this->num_channels == 0, SL);
+
+	std::array<float, noise_block_size> noise{};
+
+	// process in blocks of whole frames
+	const size_t block_size = noise_block_size / this->num_channels * this->num_channels;
+
+	for (size_t offset = 0; offset < src.size(); offset += block_size) {
+		size_t n = std::min(block_size, src.size() - offset);
+		const float* s = src.data() + offset;
+		int16_t* d = dst.data() + offset;
+
+		this->generate_noise(noise);
+
+		switch (this->shaping) {
+			case noise_shaping::none:
+				{
+					size_t i = 0;
+#if defined(__SSE2__)
+					__m128 fs = _mm_set1_ps(full_scale);
+					for (; i + 8 <= n; i += 8) {
+						// _mm_cvtps_epi32() rounds to nearest, _mm_packs_epi32() saturates
+						__m128i lo = _mm_cvtps_epi32(
+							_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(s + i), fs), _mm_loadu_ps(noise.data() + i))
+						);
+						__m128i hi = _mm_cvtps_epi32(
+							_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(s + i + 4), fs), _mm_loadu_ps(noise.data() + i + 4))
+						);
+						// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "SIMD store")
+						_mm_storeu_si128(reinterpret_cast<__m128i*>(d + i), _mm_packs_epi32(lo, hi));
+					}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+					float32x4_t fs = vdupq_n_f32(full_scale);
+					for (; i + 8 <= n; i += 8) {
+						int32x4_t lo =
+							vcvtnq_s32_f32(vmlaq_f32(vld1q_f32(noise.data() + i), vld1q_f32(s + i), fs));
+						int32x4_t hi =
+							vcvtnq_s32_f32(vmlaq_f32(vld1q_f32(noise.data() + i + 4), vld1q_f32(s + i + 4), fs));
+						vst1q_s16(d + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+					}
+#endif
+					for (; i != n; ++i) {
+						d[i] = quantize(s[i] * full_scale + noise[i]);
+					}
+				}
+				break;
+			case noise_shaping::first_order:
+			case noise_shaping::second_order:
+				// error feedback is serial within a channel, so this is done sample by sample
+				{
+					bool is_second_order = this->shaping == noise_shaping::second_order;
+					for (size_t i = 0; i != n;) {
+						for (unsigned c = 0; c != this->num_channels; ++c, ++i) {
+							auto& e = this->errors[c];
+
+							// subtract filtered error of previous samples, the error filter is
+							// E(z) = z^-1 for first order and E(z) = 2z^-1 - z^-2 for second order
+							float v = s[i] * full_scale - (is_second_order ? 2 * e[0] - e[1] : e[0]);
+
+							int16_t q = quantize(v + noise[i]);
+							d[i] = q;
+
+							e[1] = e[0];
+							// limit the error in case of clipping, so that the filter does not go unstable
+							e[0] = std::clamp(float(q) - v, -full_scale / 2, full_scale / 2);
+						}
+					}
+				}
+				break;
+		}
+	}
+}
@@ -0,0 +1,124 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <utki/span.hpp>
+
+namespace audout {
+
+enum class noise_shaping {
+	/**
+	 * @brief Plain TPDF dither, white noise spectrum.
+	 */
+	none,
+
+	/**
+	 * @brief First order error feedback, noise rises 6 dB per octave towards high frequencies.
+	 */
+	first_order,
+
+	/**
+	 * @brief Second order error feedback, noise rises 12 dB per octave towards high frequencies.
+	 */
+	second_order
+};
+
+/**
+ * @brief Requantizer from float to 16-bit samples.
+ * Converts float samples to 16-bit ones adding triangular probability density function (TPDF) dither
+ * of 2 LSB peak-to-peak amplitude, optionally shaping the requantization noise towards high frequencies,
+ * where it is less audible.
+ * Keeps per-channel error feedback state between calls, so consecutive buffers of a stream
+ * must be converted by the same object.
+ */
+class dither
+{
+public:
+	constexpr static unsigned max_num_channels = 8;
+
+private:
+	unsigned num_channels;
+	audout::noise_shaping shaping;
+
+	// random generator state, 4 independent xorshift lanes
+	std::array<uint32_t, 4> random_state;
+
+	// per-channel requantization errors of previous two samples
+	std::array<std::array<float, 2>, max_num_channels> errors{};
+
+	constexpr static size_t noise_block_size = 256;
+
+	void generate_noise(std::array<float, noise_block_size>& noise) noexcept;
+
+public:
+	/**
+	 * @brief Create requantizer.
+	 * @param num_channels - number of channels in the stream.
+	 * @param shaping - noise shaping to apply.
+	 * @param seed - seed for the dither noise generator.
+	 * @throw std::invalid_argument - in case number of channels is 0 or greater than max_num_channels.
+	 */
+	dither(
+		unsigned num_channels, //
+		audout::noise_shaping shaping = audout::noise_shaping::none,
+		uint32_t seed = 1
+	);
+
+	/**
+	 * @brief Convert samples.
+	 * @param src - interleaved float samples, full scale is [-1, 1]. Values out of the range are clipped.
+	 * @param dst - buffer for converted interleaved samples. Must be of the same size as src.
+	 */
+	void convert(utki::span<const float> src, utki::span<int16_t> dst) noexcept;
+
+	/**
+	 * @brief Reset error feedback state.
+	 * Should be called when the stream is discontinued.
+	 */
+	void reset() noexcept;
+
+	/**
+	 * @brief Change noise shaping.
+	 * Also resets error feedback state.
+	 * @param shaping - noise shaping to apply.
+	 */
+	void set_noise_shaping(audout::noise_shaping shaping) noexcept;
+
+	/**
+	 * @brief Get noise shaping.
+	 * @return Noise shaping currently applied.
+	 */
+	audout::noise_shaping get_noise_shaping() const noexcept
+	{
+		return this->shaping;
+	}
+};
+
+} // namespace audout
@@ -0,0 +1,85 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "drift_compensator.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace audout;
+
+namespace {
+// Time constant of the measurement noise filter.
+constexpr double filter_time = 0.5;
+
+// The controlled loop is an integrator, the controller gains are chosen so that the loop
+// is critically damped with natural frequency of sqrt(ki), i.e. it settles in some tens
+// of seconds, which makes the ratio changes inaudible.
+constexpr double kp = 0.1;
+constexpr double ki = kp * kp / 4;
+} // namespace
+
+drift_compensator::drift_compensator(unsigned num_channels, size_t num_chunk_frames) :
+	num_channels(num_channels),
+	num_chunk_frames(num_chunk_frames),
+	input((num_chunk_frames + num_history_frames) * num_channels)
+{
+	if (num_channels == 0 || num_chunk_frames < num_history_frames) {
+		throw std::invalid_argument("drift_compensator::drift_compensator(): invalid arguments");
+	}
+	this->reset();
+}
+
+void drift_compensator::control(std::chrono::duration<double> error, std::chrono::duration<double> interval) noexcept
+{
+	auto dt = interval.count();
+
+	this->filtered_error += (error.count() - this->filtered_error) * std::min(1.0, dt / filter_time);
+
+	this->integral += this->filtered_error * dt;
+
+	// anti-windup: the integral term alone must not exceed the allowed deviation
+	this->integral = std::clamp(this->integral, -max_deviation / ki, max_deviation / ki);
+
+	this->ratio = std::clamp(
+		1 + kp * this->filtered_error + ki * this->integral, //
+		1 - max_deviation,
+		1 + max_deviation
+	);
+}
+
+void drift_compensator::reset() noexcept
+{
+	std::fill(this->input.begin(), this->input.end(), 0.0f);
+
+	// make the first process() call pull a chunk right away
+	this->position = double(this->num_chunk_frames + num_history_frames - 2);
+
+	this->ratio = 1;
+	this->num_consumed_frames = 0;
+	this->filtered_error = 0;
+	this->integral = 0;
+}
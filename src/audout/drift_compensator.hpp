@@ -0,0 +1,206 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <utki/debug.hpp>
+#include <utki/span.hpp>
+
+namespace audout {
+
+/**
+ * @brief External reference clock.
+ * A clock to which the playback is to be synchronized, e.g. a network media clock or
+ * a clock of another audio device.
+ */
+class reference_clock
+{
+public:
+	/**
+	 * @brief Get current time of the reference clock.
+	 * Called from the audio thread once per period, so it must not block or allocate memory.
+	 * @return Time elapsed since an arbitrary epoch. Must be monotonic.
+	 */
+	virtual std::chrono::nanoseconds now() noexcept = 0;
+
+	reference_clock() = default;
+
+	reference_clock(const reference_clock&) = delete;
+	reference_clock& operator=(const reference_clock&) = delete;
+
+	reference_clock(reference_clock&&) = delete;
+	reference_clock& operator=(reference_clock&&) = delete;
+
+	virtual ~reference_clock() = default;
+};
+
+/**
+ * @brief Fine-ratio resampler with PI controlled ratio.
+ * Resamples interleaved float frames with cubic interpolation at a ratio close to 1, the ratio
+ * is continuously adjusted by a proportional-integral controller fed with the measured
+ * position error. This way the drift between two clocks is absorbed smoothly, without
+ * dropping or inserting frames.
+ */
+class drift_compensator
+{
+public:
+	/**
+	 * @brief Maximum deviation of the ratio from 1.
+	 * 1000 ppm is well above the tolerance of real-world audio clocks.
+	 */
+	constexpr static double max_deviation = 1e-3;
+
+private:
+	const unsigned num_channels;
+	const size_t num_chunk_frames;
+
+	// number of frames kept from previous chunk for interpolation
+	constexpr static size_t num_history_frames = 3;
+
+	// interleaved input frames, history frames followed by the last pulled chunk
+	std::vector<float> input;
+
+	// read position in the input buffer, in frames
+	double position = 1;
+
+	double ratio = 1;
+
+	double num_consumed_frames = 0;
+
+	// controller state
+	double filtered_error = 0;
+	double integral = 0;
+
+	template <typename pull_type>
+	void pull_chunk(pull_type& pull)
+	{
+		auto frame_size = this->num_channels;
+
+		// move the frames needed for interpolation to the beginning
+		auto history_begin = std::next(this->input.begin(), ptrdiff_t(this->num_chunk_frames * frame_size));
+		std::copy(history_begin, this->input.end(), this->input.begin());
+		this->position -= double(this->num_chunk_frames);
+
+		pull(utki::make_span(
+			std::next(this->input.data(), ptrdiff_t(num_history_frames * frame_size)),
+			this->num_chunk_frames * frame_size
+		));
+	}
+
+public:
+	/**
+	 * @brief Constructor.
+	 * @param num_channels - number of channels.
+	 * @param num_chunk_frames - number of frames to pull from the source at once.
+	 */
+	drift_compensator(unsigned num_channels, size_t num_chunk_frames);
+
+	/**
+	 * @brief Resample.
+	 * @param out - buffer to fill with interleaved resampled frames.
+	 * @param pull - functor called with utki::span<float> argument to fill with next
+	 *               chunk of interleaved source frames.
+	 */
+	template <typename pull_type>
+	void process(utki::span<float> out, pull_type&& pull)
+	{
+		utki::assert(out.size() % this->num_channels == 0, SL);
+
+		auto frame_size = this->num_channels;
+		const double last_position = double(this->num_chunk_frames + num_history_frames - 2);
+
+		for (auto dst = out.begin(); dst != out.end(); dst += frame_size) {
+			// interpolation at the position needs one frame before and two frames after it
+			if (this->position >= last_position) {
+				this->pull_chunk(pull);
+			}
+
+			auto index = size_t(this->position);
+			auto t = float(this->position - double(index));
+
+			auto src = std::next(this->input.data(), ptrdiff_t((index - 1) * frame_size));
+			for (unsigned c = 0; c != frame_size; ++c) {
+				// Catmull-Rom spline
+				float ym1 = src[c];
+				float y0 = src[c + frame_size];
+				float y1 = src[c + 2 * frame_size];
+				float y2 = src[c + 3 * frame_size];
+
+				float c1 = 0.5f * (y1 - ym1);
+				float c2 = ym1 - 2.5f * y0 + 2 * y1 - 0.5f * y2;
+				float c3 = 0.5f * (y2 - ym1) + 1.5f * (y0 - y1);
+
+				dst[c] = ((c3 * t + c2) * t + c1) * t + y0;
+			}
+
+			this->position += this->ratio;
+		}
+
+		this->num_consumed_frames += double(out.size() / frame_size) * this->ratio;
+	}
+
+	/**
+	 * @brief Update the ratio.
+	 * Feeds the controller with position error measurement.
+	 * Normally called after each process() call.
+	 * @param error - how much the consumed source position lags behind the reference position.
+	 *                Positive error speeds up the source consumption, negative slows it down.
+	 * @param interval - time passed since previous update.
+	 */
+	void control(std::chrono::duration<double> error, std::chrono::duration<double> interval) noexcept;
+
+	/**
+	 * @brief Get current ratio.
+	 * @return Number of source frames consumed per output frame.
+	 */
+	double get_ratio() const noexcept
+	{
+		return this->ratio;
+	}
+
+	/**
+	 * @brief Get number of consumed source frames.
+	 * @return Number of source frames consumed since construction or reset(), fractional.
+	 */
+	double get_num_consumed_frames() const noexcept
+	{
+		return this->num_consumed_frames;
+	}
+
+	/**
+	 * @brief Reset to initial state.
+	 * Drops buffered source frames, sets ratio to 1 and clears the controller state.
+	 */
+	void reset() noexcept;
+};
+
+} // namespace audout
@@ -0,0 +1,107 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "event_loop.hpp"
+
+#include <stdexcept>
+
+#include <utki/config.hpp>
+#include <utki/debug.hpp>
+
+#if CFG_OS == CFG_OS_LINUX && CFG_OS_NAME != CFG_OS_NAME_ANDROID
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#	include "backend/pulse_event_loop.cxx"
+#	define AUDOUT_EVENT_LOOP_SUPPORTED
+#endif
+
+using namespace audout;
+
+#ifdef AUDOUT_EVENT_LOOP_SUPPORTED
+
+event_loop::event_loop() :
+	backend(std::make_unique<pulse_context>())
+{}
+
+event_loop::~event_loop() = default;
+
+stream::stream(
+	event_loop& loop,
+	format output_format,
+	uint32_t num_buffer_frames,
+	listener* listener,
+	const std::string& device_name
+) :
+	backend([&]() {
+		if (!listener) {
+			throw std::invalid_argument("stream::stream(): listener is nullptr");
+		}
+		utki::assert(dynamic_cast<pulse_context*>(loop.backend.get()), SL);
+		return std::make_unique<stream_backend>(
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast, "type erasure")
+			*static_cast<pulse_context*>(loop.backend.get()),
+			output_format,
+			num_buffer_frames,
+			*listener,
+			device_name
+		);
+	}())
+{}
+
+stream::~stream() = default;
+
+void stream::set_paused(bool pause)
+{
+	utki::assert(dynamic_cast<stream_backend*>(this->backend.get()), SL);
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast, "type erasure")
+	static_cast<stream_backend*>(this->backend.get())->set_paused(pause);
+}
+
+#else
+
+event_loop::event_loop()
+{
+	throw std::logic_error("event_loop::event_loop(): event loop is not supported by the backend");
+}
+
+event_loop::~event_loop() = default;
+
+stream::stream(
+	event_loop& loop,
+	format output_format,
+	uint32_t num_buffer_frames,
+	listener* listener,
+	const std::string& device_name
+)
+{
+	// event_loop cannot be created, so no stream can be created either
+	utki::assert(false, SL);
+}
+
+stream::~stream() = default;
+
+void stream::set_paused(bool pause) {}
+
+#endif
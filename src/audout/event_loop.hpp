@@ -0,0 +1,114 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <utki/destructable.hpp>
+
+#include "format.hpp"
+#include "player.hpp"
+
+namespace audout {
+
+/**
+ * @brief Event loop driving many streams from a single thread.
+ * Unlike audout::player, which runs a thread per output, the event loop runs one thread which
+ * waits for any of its streams' descriptors to become ready and services only those which are.
+ * All streams of the event loop share a single server connection.
+ * This allows having hundreds of streams per process.
+ * Supported only by PulseAudio backend.
+ */
+class event_loop
+{
+	friend class stream;
+
+	std::unique_ptr<utki::destructable> backend;
+
+public:
+	/**
+	 * @brief Create event loop.
+	 * Starts the event loop thread and connects to the sound server.
+	 * @throw std::runtime_error - in case connecting to the sound server fails.
+	 * @throw std::logic_error - in case the event loop is not supported by the backend.
+	 */
+	event_loop();
+
+	event_loop(const event_loop&) = delete;
+	event_loop& operator=(const event_loop&) = delete;
+
+	event_loop(event_loop&&) = delete;
+	event_loop& operator=(event_loop&&) = delete;
+
+	/**
+	 * @brief Destructor.
+	 * All streams of the event loop must be destroyed before the event loop.
+	 */
+	~event_loop();
+};
+
+/**
+ * @brief Output stream driven by an event loop.
+ * The listener is called from the event loop thread whenever the stream requests more data,
+ * so it must not block, otherwise all streams of the event loop will stall.
+ * The stream is created paused.
+ */
+class stream
+{
+	std::unique_ptr<utki::destructable> backend;
+
+public:
+	/**
+	 * @brief Create stream.
+	 * @param loop - event loop to drive the stream.
+	 * @param output_format - output format.
+	 * @param num_buffer_frames - request for size of playing buffer.
+	 * @param listener - callback for filling playing buffer.
+	 * @param device_name - name of the output device. Empty name means the default device.
+	 * @throw std::runtime_error - in case creating the stream fails.
+	 */
+	stream(
+		event_loop& loop,
+		format output_format,
+		uint32_t num_buffer_frames,
+		listener* listener,
+		const std::string& device_name = std::string()
+	);
+
+	stream(const stream&) = delete;
+	stream& operator=(const stream&) = delete;
+
+	stream(stream&&) = delete;
+	stream& operator=(stream&&) = delete;
+
+	~stream();
+
+	void set_paused(bool pause);
+};
+
+} // namespace audout
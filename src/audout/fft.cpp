@@ -0,0 +1,172 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "fft.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+#include <utki/debug.hpp>
+#include <utki/math.hpp>
+
+using namespace audout;
+
+real_fft::real_fft(size_t size) :
+	n(size),
+	m(size / 2)
+{
+	constexpr size_t min_size = 4;
+	if (size < min_size || (size & (size - 1)) != 0) {
+		throw std::invalid_argument("real_fft::real_fft(): size must be a power of 2, not less than 4");
+	}
+
+	size_t num_bits = 0;
+	while ((size_t(1) << num_bits) < this->m) {
+		++num_bits;
+	}
+
+	this->bit_reversed.resize(this->m);
+	for (size_t i = 0; i != this->m; ++i) {
+		size_t r = 0;
+		for (size_t b = 0; b != num_bits; ++b) {
+			if (i & (size_t(1) << b)) {
+				r |= size_t(1) << (num_bits - 1 - b);
+			}
+		}
+		this->bit_reversed[i] = r;
+	}
+
+	this->twiddle_re.reserve(this->m - 1);
+	this->twiddle_im.reserve(this->m - 1);
+	for (size_t half = 1; half < this->m; half *= 2) {
+		for (size_t j = 0; j != half; ++j) {
+			double angle = -utki::pi * double(j) / double(half);
+			this->twiddle_re.push_back(float(std::cos(angle)));
+			this->twiddle_im.push_back(float(std::sin(angle)));
+		}
+	}
+
+	this->split_twiddles.reserve(this->m + 1);
+	for (size_t k = 0; k <= this->m; ++k) {
+		double angle = -2 * utki::pi * double(k) / double(this->n);
+		this->split_twiddles.emplace_back(float(std::cos(angle)), float(std::sin(angle)));
+	}
+
+	this->re.resize(this->m);
+	this->im.resize(this->m);
+}
+
+void real_fft::transform(bool inverse) noexcept
+{
+	for (size_t i = 0; i != this->m; ++i) {
+		size_t j = this->bit_reversed[i];
+		if (i < j) {
+			std::swap(this->re[i], this->re[j]);
+			std::swap(this->im[i], this->im[j]);
+		}
+	}
+
+	// inverse transform uses conjugate twiddle factors
+	float sign = inverse ? -1.0f : 1.0f;
+
+	for (size_t half = 1; half < this->m; half *= 2) {
+		const float* wr = &this->twiddle_re[half - 1];
+		const float* wi = &this->twiddle_im[half - 1];
+
+		for (size_t block = 0; block < this->m; block += 2 * half) {
+			float* ar = &this->re[block];
+			float* ai = &this->im[block];
+			float* br = ar + half;
+			float* bi = ai + half;
+
+			for (size_t j = 0; j != half; ++j) {
+				float w_im = sign * wi[j];
+				float tr = br[j] * wr[j] - bi[j] * w_im;
+				float ti = br[j] * w_im + bi[j] * wr[j];
+				br[j] = ar[j] - tr;
+				bi[j] = ai[j] - ti;
+				ar[j] += tr;
+				ai[j] += ti;
+			}
+		}
+	}
+}
+
+void real_fft::forward(utki::span<const float> in, utki::span<std::complex<float>> out) noexcept
+{
+	utki::assert(in.size() == this->n, SL);
+	utki::assert(out.size() == this->m + 1, SL);
+
+	// even samples go to real part, odd ones to imaginary part
+	for (size_t i = 0; i != this->m; ++i) {
+		this->re[i] = in[2 * i];
+		this->im[i] = in[2 * i + 1];
+	}
+
+	this->transform(false);
+
+	// X[k] = E[k] + W^k * O[k], where E and O are spectra of even and odd samples,
+	// E[k] = (Z[k] + conj(Z[m - k])) / 2, O[k] = (Z[k] - conj(Z[m - k])) / 2i
+	for (size_t k = 0; k <= this->m; ++k) {
+		size_t a = k % this->m;
+		size_t b = (this->m - k) % this->m;
+		std::complex<float> z(this->re[a], this->im[a]);
+		std::complex<float> zc(this->re[b], -this->im[b]);
+
+		auto e = (z + zc) * 0.5f;
+		auto o = (z - zc) * std::complex<float>(0, -0.5f);
+
+		out[k] = e + this->split_twiddles[k] * o;
+	}
+}
+
+void real_fft::inverse(utki::span<const std::complex<float>> in, utki::span<float> out) noexcept
+{
+	utki::assert(in.size() == this->m + 1, SL);
+	utki::assert(out.size() == this->n, SL);
+
+	// Z[k] = E[k] + i * O[k], where E[k] = (X[k] + conj(X[m - k])) / 2,
+	// O[k] = (X[k] - conj(X[m - k])) * conj(W^k) / 2
+	for (size_t k = 0; k != this->m; ++k) {
+		auto x = in[k];
+		auto xc = std::conj(in[this->m - k]);
+
+		auto e = (x + xc) * 0.5f;
+		auto o = (x - xc) * std::conj(this->split_twiddles[k]) * 0.5f;
+
+		auto z = e + std::complex<float>(0, 1) * o;
+		this->re[k] = z.real();
+		this->im[k] = z.imag();
+	}
+
+	this->transform(true);
+
+	float scale = 1.0f / float(this->m);
+	for (size_t i = 0; i != this->m; ++i) {
+		out[2 * i] = this->re[i] * scale;
+		out[2 * i + 1] = this->im[i] * scale;
+	}
+}
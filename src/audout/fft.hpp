@@ -0,0 +1,98 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+#include <utki/span.hpp>
+
+namespace audout {
+
+/**
+ * @brief Fast Fourier transform of real signals.
+ * The real signal of size n is transformed as a complex signal of size n / 2 by radix-2 FFT,
+ * followed by splitting the result into the spectrum of the real signal.
+ * The complex data is kept as separate arrays of real and imaginary parts, and twiddle factors
+ * of each stage are stored contiguously, so that the butterfly loops are vectorized by the compiler.
+ * All memory is allocated at construction time, the transforms never allocate.
+ * Not thread safe, each thread needs its own object.
+ */
+class real_fft
+{
+	const size_t n;
+
+	// half of the size, the size of the complex transform
+	const size_t m;
+
+	std::vector<size_t> bit_reversed;
+
+	// twiddle factors of all stages of the complex transform, stage with half-size h starts at offset h - 1
+	std::vector<float> twiddle_re;
+	std::vector<float> twiddle_im;
+
+	// factors exp(-2 * pi * i * k / n) for splitting the complex transform into the real one
+	std::vector<std::complex<float>> split_twiddles;
+
+	// work buffers
+	std::vector<float> re;
+	std::vector<float> im;
+
+	void transform(bool inverse) noexcept;
+
+public:
+	/**
+	 * @brief Create FFT object.
+	 * @param size - size of the real signal. Must be a power of 2, not less than 4.
+	 * @throw std::invalid_argument - in case the size is not a power of 2 or is less than 4.
+	 */
+	real_fft(size_t size);
+
+	size_t size() const noexcept
+	{
+		return this->n;
+	}
+
+	/**
+	 * @brief Forward transform.
+	 * @param in - real signal of size() samples.
+	 * @param out - buffer for size() / 2 + 1 complex bins, from 0 to Nyquist frequency.
+	 */
+	void forward(utki::span<const float> in, utki::span<std::complex<float>> out) noexcept;
+
+	/**
+	 * @brief Inverse transform.
+	 * The result is scaled by 1 / size(), so that inverse transform of the forward transform
+	 * gives the original signal.
+	 * @param in - size() / 2 + 1 complex bins, from 0 to Nyquist frequency.
+	 * @param out - buffer for real signal of size() samples.
+	 */
+	void inverse(utki::span<const std::complex<float>> in, utki::span<float> out) noexcept;
+};
+
+} // namespace audout
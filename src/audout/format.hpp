@@ -26,13 +26,22 @@ SOFTWARE.
 
 #pragma once
 
+#include <array>
+#include <cstdint>
+
 // TODO: doxygen all
 
 namespace audout {
 
 enum class frame {
 	mono = 1,
-	stereo = 2
+	stereo = 2,
+
+	/**
+	 * @brief 5.1 surround, channel order is front left, front right, front center, LFE, rear left, rear right.
+	 * The order is the same as in WAVE files.
+	 */
+	surround_5_1 = 6
 };
 
 constexpr inline unsigned num_channels(frame frame_type) noexcept
@@ -47,6 +56,100 @@ enum class rate {
 	hz_48000 = 48000
 };
 
+enum class sample_format {
+	/**
+	 * @brief Signed 16-bit integer, native endian.
+	 */
+	int16,
+
+	/**
+	 * @brief Signed 24-bit integer packed in 3 bytes, little endian (S24_3LE).
+	 */
+	int24,
+
+	/**
+	 * @brief Signed 32-bit integer, native endian.
+	 */
+	int32,
+
+	/**
+	 * @brief 32-bit float, native endian, full scale is [-1, 1].
+	 */
+	float32
+};
+
+/**
+ * @brief Packed 24-bit sample.
+ * Signed 24-bit integer stored in 3 bytes, little endian.
+ */
+struct int24 {
+	std::array<uint8_t, 3> bytes;
+
+	int24() = default;
+
+	int24(int32_t value) noexcept :
+		bytes{uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16)}
+	{}
+
+	operator int32_t() const noexcept
+	{
+		// sign-extend via arithmetic shift of the 24 bits placed in the upper part of 32-bit integer
+		return int32_t(
+				   uint32_t(this->bytes[0]) << 8 | uint32_t(this->bytes[1]) << 16 | uint32_t(this->bytes[2]) << 24
+			   ) >>
+			8;
+	}
+};
+
+static_assert(sizeof(int24) == 3, "int24 must be packed");
+
+constexpr inline unsigned sample_size(sample_format sample_type) noexcept
+{
+	switch (sample_type) {
+		case sample_format::int16:
+			return sizeof(int16_t);
+		case sample_format::int24:
+			return sizeof(int24);
+		case sample_format::int32:
+			return sizeof(int32_t);
+		case sample_format::float32:
+			return sizeof(float);
+	}
+	return 0;
+}
+
+/**
+ * @brief Get sample format corresponding to sample type.
+ * @tparam sample_type - one of int16_t, int24, int32_t and float.
+ * @return Sample format.
+ */
+template <typename sample_type>
+constexpr sample_format sample_format_of() noexcept;
+
+template <>
+constexpr inline sample_format sample_format_of<int16_t>() noexcept
+{
+	return sample_format::int16;
+}
+
+template <>
+constexpr inline sample_format sample_format_of<int24>() noexcept
+{
+	return sample_format::int24;
+}
+
+template <>
+constexpr inline sample_format sample_format_of<int32_t>() noexcept
+{
+	return sample_format::int32;
+}
+
+template <>
+constexpr inline sample_format sample_format_of<float>() noexcept
+{
+	return sample_format::float32;
+}
+
 class format
 {
 public:
@@ -54,11 +157,19 @@ public:
 
 	rate sampling_rate;
 
+	sample_format sample_type = sample_format::int16;
+
 	format(frame frame_type, rate sampling_rate) :
 		frame_type(frame_type),
 		sampling_rate(sampling_rate)
 	{}
 
+	format(frame frame_type, rate sampling_rate, sample_format sample_type) :
+		frame_type(frame_type),
+		sampling_rate(sampling_rate),
+		sample_type(sample_type)
+	{}
+
 	unsigned num_channels() const noexcept
 	{
 		return audout::num_channels(this->frame_type);
@@ -69,9 +180,14 @@ public:
 		return unsigned(this->sampling_rate);
 	}
 
+	unsigned sample_size() const noexcept
+	{
+		return audout::sample_size(this->sample_type);
+	}
+
 	unsigned frame_size() const noexcept
 	{
-		return 2 * this->num_channels();
+		return this->sample_size() * this->num_channels();
 	}
 };
 
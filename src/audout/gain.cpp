@@ -0,0 +1,336 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "gain.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include <utki/debug.hpp>
+
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#	include <arm_neon.h>
+#endif
+
+using namespace audout;
+
+namespace {
+// floor for exponential ramps, which cannot start or end at exact zero, about -100 dB
+constexpr float min_exponential_gain = 1e-5f;
+
+int16_t to_int16(float v) noexcept
+{
+	return int16_t(std::clamp(
+		std::lrint(v), //
+		long(std::numeric_limits<int16_t>::min()),
+		long(std::numeric_limits<int16_t>::max())
+	));
+}
+
+float scale(float sample, float g) noexcept
+{
+	return sample * g;
+}
+
+int16_t scale(int16_t sample, float g) noexcept
+{
+	return to_int16(float(sample) * g);
+}
+
+int24 scale(int24 sample, float g) noexcept
+{
+	constexpr long max_int24 = (1 << 23) - 1;
+	return {int32_t(std::clamp(std::lrint(float(int32_t(sample)) * g), -max_int24 - 1, max_int24))};
+}
+
+int32_t scale(int32_t sample, float g) noexcept
+{
+	// float does not have enough precision for 32-bit samples
+	return int32_t(std::clamp(
+		std::llrint(double(sample) * double(g)),
+		(long long)(std::numeric_limits<int32_t>::min()),
+		(long long)(std::numeric_limits<int32_t>::max())
+	));
+}
+
+// gains for 4 consecutive samples, valid in case number of channels divides 4
+std::array<float, 4> make_gain_pattern(const float* gains, unsigned num_channels) noexcept
+{
+	return {gains[0], gains[1 % num_channels], gains[2 % num_channels], gains[3 % num_channels]};
+}
+
+template <typename sample_type>
+void apply_static(sample_type* buf, size_t num_samples, const float* gains, unsigned num_channels) noexcept
+{
+	for (size_t i = 0; i != num_samples; ++i) {
+		buf[i] = scale(buf[i], gains[i % num_channels]);
+	}
+}
+
+void apply_static(int16_t* buf, size_t num_samples, const float* gains, unsigned num_channels) noexcept
+{
+	size_t i = 0;
+
+#if defined(__SSE2__) || (defined(__aarch64__) && defined(__ARM_NEON))
+	if (4 % num_channels == 0) {
+		auto pattern = make_gain_pattern(gains, num_channels);
+
+#	if defined(__SSE2__)
+		__m128 g = _mm_loadu_ps(pattern.data());
+		for (; i + 8 <= num_samples; i += 8) {
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "SIMD load")
+			__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + i));
+
+			// sign-extend 16-bit samples to 32 bits
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+
+			lo = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(lo), g));
+			hi = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(hi), g));
+
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "SIMD store")
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(buf + i), _mm_packs_epi32(lo, hi));
+		}
+#	else
+		float32x4_t g = vld1q_f32(pattern.data());
+		for (; i + 8 <= num_samples; i += 8) {
+			int16x8_t s = vld1q_s16(buf + i);
+
+			int32x4_t lo = vcvtnq_s32_f32(vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))), g));
+			int32x4_t hi = vcvtnq_s32_f32(vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))), g));
+
+			vst1q_s16(buf + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+		}
+#	endif
+	}
+#endif
+
+	for (; i != num_samples; ++i) {
+		buf[i] = scale(buf[i], gains[i % num_channels]);
+	}
+}
+
+void apply_static(float* buf, size_t num_samples, const float* gains, unsigned num_channels) noexcept
+{
+	size_t i = 0;
+
+#if defined(__SSE2__) || (defined(__aarch64__) && defined(__ARM_NEON))
+	if (4 % num_channels == 0) {
+		auto pattern = make_gain_pattern(gains, num_channels);
+
+#	if defined(__SSE2__)
+		__m128 g = _mm_loadu_ps(pattern.data());
+		for (; i + 4 <= num_samples; i += 4) {
+			_mm_storeu_ps(buf + i, _mm_mul_ps(_mm_loadu_ps(buf + i), g));
+		}
+#	else
+		float32x4_t g = vld1q_f32(pattern.data());
+		for (; i + 4 <= num_samples; i += 4) {
+			vst1q_f32(buf + i, vmulq_f32(vld1q_f32(buf + i), g));
+		}
+#	endif
+	}
+#endif
+
+	for (; i != num_samples; ++i) {
+		buf[i] = scale(buf[i], gains[i % num_channels]);
+	}
+}
+} // namespace
+
+gain::gain() :
+	params(parameters{
+		1, // master
+		0, // pan
+		[]() {
+			std::array<float, max_num_channels> ret{};
+			ret.fill(1);
+			return ret;
+		}(),
+		default_ramp_num_frames,
+		ramp_shape::linear
+	})
+{}
+
+void gain::set_master(float value)
+{
+	this->params.modify([&](auto& p) {
+		p.master = value;
+	});
+}
+
+void gain::set_channel(unsigned channel, float value)
+{
+	if (channel >= max_num_channels) {
+		throw std::out_of_range("gain::set_channel(): channel index is out of range");
+	}
+	this->params.modify([&](auto& p) {
+		p.channel_gains[channel] = value;
+	});
+}
+
+void gain::set_pan(float value)
+{
+	this->params.modify([&](auto& p) {
+		p.pan = std::clamp(value, -1.0f, 1.0f);
+	});
+}
+
+void gain::set_ramp(ramp_shape shape, unsigned num_frames)
+{
+	this->params.modify([&](auto& p) {
+		p.shape = shape;
+		p.ramp_num_frames = num_frames;
+	});
+}
+
+void gain::update_targets(unsigned num_channels) noexcept
+{
+	if (!this->params.update()) {
+		return;
+	}
+
+	const auto& p = this->params.get();
+
+	for (unsigned c = 0; c != num_channels; ++c) {
+		auto& ch = this->channels[c];
+
+		float target = p.master * p.channel_gains[c];
+		if (num_channels == 2) {
+			target *= std::min(1.0f, c == 0 ? 1 - p.pan : 1 + p.pan);
+		}
+
+		if (target == ch.target) {
+			continue;
+		}
+
+		ch.target = target;
+
+		if (p.ramp_num_frames == 0) {
+			ch.value = target;
+			ch.frames_left = 0;
+			continue;
+		}
+
+		ch.frames_left = p.ramp_num_frames;
+		ch.shape = p.shape;
+
+		switch (p.shape) {
+			case ramp_shape::linear:
+				ch.step = (target - ch.value) / float(p.ramp_num_frames);
+				break;
+			case ramp_shape::exponential:
+				ch.value = std::max(ch.value, min_exponential_gain);
+				ch.step = std::pow(
+					std::max(target, min_exponential_gain) / ch.value, //
+					1 / float(p.ramp_num_frames)
+				);
+				break;
+		}
+	}
+
+	this->is_ramping = std::any_of(
+		this->channels.begin(), //
+		std::next(this->channels.begin(), num_channels),
+		[](const auto& ch) {
+			return ch.frames_left != 0;
+		}
+	);
+}
+
+template <typename sample_type>
+void gain::process_samples(utki::span<sample_type> buf, unsigned num_channels) noexcept
+{
+	utki::assert(num_channels != 0 && num_channels <= max_num_channels, SL);
+	utki::assert(buf.size() % num_channels == 0, SL);
+
+	this->update_targets(num_channels);
+
+	sample_type* p = buf.data();
+	size_t num_frames = buf.size() / num_channels;
+
+	for (; this->is_ramping && num_frames != 0; --num_frames) {
+		this->is_ramping = false;
+		for (unsigned c = 0; c != num_channels; ++c, ++p) {
+			auto& ch = this->channels[c];
+			if (ch.frames_left != 0) {
+				--ch.frames_left;
+				if (ch.frames_left == 0) {
+					ch.value = ch.target;
+				} else {
+					if (ch.shape == ramp_shape::linear) {
+						ch.value += ch.step;
+					} else {
+						ch.value *= ch.step;
+					}
+					this->is_ramping = true;
+				}
+			}
+			*p = scale(*p, ch.value);
+		}
+	}
+
+	if (num_frames == 0) {
+		return;
+	}
+
+	std::array<float, max_num_channels> gains{};
+	bool is_unity = true;
+	for (unsigned c = 0; c != num_channels; ++c) {
+		gains[c] = this->channels[c].value;
+		is_unity = is_unity && gains[c] == 1;
+	}
+
+	if (is_unity) {
+		return;
+	}
+
+	apply_static(p, num_frames * num_channels, gains.data(), num_channels);
+}
+
+void gain::process(utki::span<int16_t> buf, unsigned num_channels) noexcept
+{
+	this->process_samples(buf, num_channels);
+}
+
+void gain::process(utki::span<int24> buf, unsigned num_channels) noexcept
+{
+	this->process_samples(buf, num_channels);
+}
+
+void gain::process(utki::span<int32_t> buf, unsigned num_channels) noexcept
+{
+	this->process_samples(buf, num_channels);
+}
+
+void gain::process(utki::span<float> buf, unsigned num_channels) noexcept
+{
+	this->process_samples(buf, num_channels);
+}
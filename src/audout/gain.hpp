@@ -0,0 +1,165 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <utki/span.hpp>
+
+#include "format.hpp"
+#include "parameter_block.hpp"
+
+namespace audout {
+
+enum class ramp_shape {
+	/**
+	 * @brief Gain changes by constant amount each frame.
+	 */
+	linear,
+
+	/**
+	 * @brief Gain changes by constant ratio each frame, i.e. linearly in decibels.
+	 */
+	exponential
+};
+
+/**
+ * @brief Gain and pan stage.
+ * Applies master gain, per-channel gains and stereo pan to interleaved samples.
+ * Gain changes are applied with sample-accurate ramps to avoid zipper noise.
+ * Setters can be called from any thread, the changes are picked up by next process() call.
+ * In case all effective channel gains are exactly 1 and no ramp is in progress, the process() does nothing.
+ */
+class gain
+{
+public:
+	constexpr static unsigned max_num_channels = 8;
+
+private:
+	struct parameters {
+		float master;
+		float pan;
+		std::array<float, max_num_channels> channel_gains;
+		unsigned ramp_num_frames;
+		ramp_shape shape;
+	};
+
+	parameter_block<parameters> params;
+
+	// audio thread state
+	struct channel_state {
+		float value = 1;
+		float target = 1;
+
+		// for linear ramps the step is added to the value each frame, for exponential ones it is a multiplier
+		float step = 0;
+		ramp_shape shape = ramp_shape::linear;
+
+		unsigned frames_left = 0;
+	};
+
+	std::array<channel_state, max_num_channels> channels;
+	bool is_ramping = false;
+
+	void update_targets(unsigned num_channels) noexcept;
+
+	template <typename sample_type>
+	void process_samples(utki::span<sample_type> buf, unsigned num_channels) noexcept;
+
+public:
+	/**
+	 * @brief Default ramp duration in frames.
+	 * About 10 milliseconds at 48kHz.
+	 */
+	constexpr static unsigned default_ramp_num_frames = 480;
+
+	gain();
+
+	/**
+	 * @brief Set master gain.
+	 * @param value - gain factor, 1 means no change.
+	 */
+	void set_master(float value);
+
+	/**
+	 * @brief Set gain of single channel.
+	 * @param channel - index of the channel.
+	 * @param value - gain factor, 1 means no change.
+	 * @throw std::out_of_range - in case channel index is not less than max_num_channels.
+	 */
+	void set_channel(unsigned channel, float value);
+
+	/**
+	 * @brief Set stereo pan.
+	 * Balance law is used, so that centered pan leaves both channels untouched.
+	 * Has no effect on streams which are not stereo.
+	 * @param value - pan position from -1 (left) to 1 (right), 0 is center.
+	 */
+	void set_pan(float value);
+
+	/**
+	 * @brief Set ramp parameters.
+	 * @param shape - shape of the gain change curve.
+	 * @param num_frames - duration of the ramp in frames. 0 means abrupt change.
+	 */
+	void set_ramp(ramp_shape shape, unsigned num_frames);
+
+	/**
+	 * @brief Apply gain to samples.
+	 * Must be called from single thread, normally the audio thread.
+	 * @param buf - interleaved samples.
+	 * @param num_channels - number of channels in the samples. Must not be greater than max_num_channels.
+	 */
+	void process(utki::span<int16_t> buf, unsigned num_channels) noexcept;
+
+	/**
+	 * @brief Apply gain to samples.
+	 * Must be called from single thread, normally the audio thread.
+	 * @param buf - interleaved samples.
+	 * @param num_channels - number of channels in the samples. Must not be greater than max_num_channels.
+	 */
+	void process(utki::span<int24> buf, unsigned num_channels) noexcept;
+
+	/**
+	 * @brief Apply gain to samples.
+	 * Must be called from single thread, normally the audio thread.
+	 * @param buf - interleaved samples.
+	 * @param num_channels - number of channels in the samples. Must not be greater than max_num_channels.
+	 */
+	void process(utki::span<int32_t> buf, unsigned num_channels) noexcept;
+
+	/**
+	 * @brief Apply gain to samples.
+	 * Must be called from single thread, normally the audio thread.
+	 * @param buf - interleaved samples.
+	 * @param num_channels - number of channels in the samples. Must not be greater than max_num_channels.
+	 */
+	void process(utki::span<float> buf, unsigned num_channels) noexcept;
+};
+
+} // namespace audout
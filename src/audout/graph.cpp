@@ -0,0 +1,532 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "graph.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <utki/debug.hpp>
+
+#include "convert.hpp"
+
+#if CFG_OS == CFG_OS_WINDOWS
+#	include <windows.h>
+#else
+#	include <pthread.h>
+#	include <sched.h>
+#	if CFG_OS == CFG_OS_LINUX
+#		include <sys/resource.h>
+#	endif
+#endif
+
+#if CFG_OS == CFG_OS_LINUX
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#	include "backend/wakeup_event.cxx"
+#endif
+
+using namespace audout;
+
+namespace {
+// values of ready slots which do not hold a node id
+constexpr ptrdiff_t unpublished_slot = -1;
+constexpr ptrdiff_t taken_slot = -2;
+
+class bus : public graph::node
+{
+public:
+	void process(utki::span<const float> in, utki::span<float> out) noexcept override
+	{
+		std::copy(in.begin(), in.end(), out.begin());
+	}
+};
+} // namespace
+
+unsigned graph::get_default_num_workers() noexcept
+{
+	// hardware_concurrency() returns 0 in case the number is not known
+	return std::max(std::thread::hardware_concurrency(), 1u) - 1;
+}
+
+graph::graph(unsigned num_channels, size_t max_block_frames, unsigned num_workers) :
+	num_channels(num_channels),
+	max_block_frames(max_block_frames),
+	num_workers(num_workers)
+{
+	if (num_channels == 0) {
+		throw std::invalid_argument("graph::graph(): number of channels is 0");
+	}
+	if (max_block_frames == 0) {
+		throw std::invalid_argument("graph::graph(): maximum block size is 0");
+	}
+
+	this->output = this->add_bus(num_channels);
+}
+
+graph::~graph()
+{
+#if CFG_OS == CFG_OS_LINUX
+	this->quit.store(true, std::memory_order_release);
+	this->wake_up_workers(this->workers.size());
+#else
+	{
+		std::lock_guard lock(this->thread_mutex);
+		this->quit.store(true, std::memory_order_release);
+	}
+	this->thread_cv.notify_all();
+#endif
+	for (auto& w : this->workers) {
+		w.join();
+	}
+}
+
+graph::node_info& graph::get_node(node_id id)
+{
+	if (id >= this->nodes.size()) {
+		throw std::invalid_argument("graph: node does not exist");
+	}
+	return this->nodes[id];
+}
+
+graph::node_id graph::add(node& n, unsigned num_inputs, unsigned num_outputs)
+{
+	if (this->compiled) {
+		throw std::logic_error("graph::add(): graph is already compiled");
+	}
+	if (num_outputs == 0) {
+		throw std::invalid_argument("graph::add(): number of outputs is 0");
+	}
+
+	node_info info;
+	info.n = &n;
+	info.num_inputs = num_inputs;
+	info.num_outputs = num_outputs;
+
+	this->nodes.push_back(std::move(info));
+	return this->nodes.size() - 1;
+}
+
+graph::node_id graph::add_bus(unsigned num_channels)
+{
+	if (num_channels == 0) {
+		throw std::invalid_argument("graph::add_bus(): number of channels is 0");
+	}
+
+	this->buses.push_back(std::make_unique<bus>());
+	return this->add(*this->buses.back(), num_channels, num_channels);
+}
+
+void graph::connect(node_id from, node_id to)
+{
+	if (this->compiled) {
+		throw std::logic_error("graph::connect(): graph is already compiled");
+	}
+
+	const auto& src = this->get_node(from);
+	auto& dst = this->get_node(to);
+
+	if (src.num_outputs != dst.num_inputs) {
+		throw std::invalid_argument("graph::connect(): number of channels does not match");
+	}
+	if (std::any_of(dst.inputs.begin(), dst.inputs.end(), [&](const auto& c) {
+			return c.from == from;
+		}))
+	{
+		throw std::invalid_argument("graph::connect(): nodes are already connected");
+	}
+
+	connection c;
+	c.from = from;
+	dst.inputs.push_back(std::move(c));
+}
+
+void graph::compile()
+{
+	if (this->compiled) {
+		throw std::logic_error("graph::compile(): graph is already compiled");
+	}
+
+	// find the nodes contributing to the output
+	std::vector<bool> active(this->nodes.size());
+	std::vector<node_id> stack = {this->output};
+	active[this->output] = true;
+	while (!stack.empty()) {
+		auto id = stack.back();
+		stack.pop_back();
+		for (const auto& c : this->nodes[id].inputs) {
+			if (!active[c.from]) {
+				active[c.from] = true;
+				stack.push_back(c.from);
+			}
+		}
+	}
+
+	// sort topologically, all inputs of an active node are active
+	std::vector<std::vector<node_id>> successors(this->nodes.size());
+	std::vector<size_t> num_unsorted_inputs(this->nodes.size());
+	std::vector<node_id> order;
+	for (node_id id = 0; id != this->nodes.size(); ++id) {
+		if (!active[id]) {
+			continue;
+		}
+		const auto& n = this->nodes[id];
+		num_unsorted_inputs[id] = n.inputs.size();
+		if (n.inputs.empty()) {
+			order.push_back(id);
+		}
+		for (const auto& c : n.inputs) {
+			successors[c.from].push_back(id);
+		}
+	}
+
+	auto num_sources = order.size();
+
+	for (size_t i = 0; i != order.size(); ++i) {
+		for (auto s : successors[order[i]]) {
+			if (--num_unsorted_inputs[s] == 0) {
+				order.push_back(s);
+			}
+		}
+	}
+
+	if (order.size() != size_t(std::count(active.begin(), active.end(), true))) {
+		throw std::invalid_argument("graph::compile(): graph has cycles");
+	}
+
+	this->num_active = order.size();
+	this->sources.assign(order.begin(), std::next(order.begin(), ptrdiff_t(num_sources)));
+	for (auto id : order) {
+		this->nodes[id].active = true;
+		this->nodes[id].successors = std::move(successors[id]);
+	}
+
+	// delay the inputs of lower latency, so that all inputs of each node are aligned
+	for (auto id : order) {
+		auto& n = this->nodes[id];
+
+		uint32_t input_latency = 0;
+		for (const auto& c : n.inputs) {
+			input_latency = std::max(input_latency, this->nodes[c.from].total_latency);
+		}
+
+		for (auto& c : n.inputs) {
+			c.delay = input_latency - this->nodes[c.from].total_latency;
+			c.delay_line.resize(size_t(c.delay) * n.num_inputs);
+		}
+
+		n.total_latency = input_latency + n.n->get_latency();
+
+		n.in.resize(this->max_block_frames * n.num_inputs);
+		n.out.resize(this->max_block_frames * n.num_outputs);
+	}
+
+	this->num_pending_inputs = std::make_unique<std::atomic<unsigned>[]>(this->nodes.size());
+	this->ready = std::make_unique<std::atomic<ptrdiff_t>[]>(this->num_active);
+
+	this->compiled = true;
+
+	if (this->num_workers == 0) {
+		return;
+	}
+
+#if CFG_OS == CFG_OS_LINUX
+	this->wakeup = std::make_unique<wakeup_event>(wakeup_event::mode::semaphore);
+#endif
+
+	this->workers.reserve(this->num_workers);
+	for (unsigned i = 0; i != this->num_workers; ++i) {
+		this->workers.emplace_back([this]() {
+			this->run_worker();
+		});
+	}
+}
+
+void graph::wake_up_workers(size_t num_wakeups) noexcept
+{
+	if (num_wakeups == 0) {
+		return;
+	}
+#if CFG_OS == CFG_OS_LINUX
+	this->wakeup->signal(num_wakeups);
+#else
+	this->thread_cv.notify_all();
+#endif
+}
+
+void graph::wait_for_period([[maybe_unused]] uint32_t& last_period)
+{
+#if CFG_OS == CFG_OS_LINUX
+	this->wakeup->wait();
+#else
+	std::unique_lock lock(this->thread_mutex);
+	this->thread_cv.wait(lock, [&]() {
+		return this->quit.load(std::memory_order_relaxed) ||
+			this->period.load(std::memory_order_relaxed) != last_period;
+	});
+	last_period = this->period.load(std::memory_order_relaxed);
+#endif
+}
+
+void graph::capture_audio_thread_scheduling() noexcept
+{
+#if CFG_OS == CFG_OS_WINDOWS
+	this->audio_thread_priority.store(GetThreadPriority(GetCurrentThread()), std::memory_order_relaxed);
+#else
+	int policy = SCHED_OTHER;
+	sched_param param{};
+	if (pthread_getschedparam(pthread_self(), &policy, &param) != 0) {
+		return;
+	}
+	this->audio_thread_policy.store(policy, std::memory_order_relaxed);
+	this->audio_thread_priority.store(param.sched_priority, std::memory_order_relaxed);
+#	if CFG_OS == CFG_OS_LINUX
+	// on Linux nice value is per thread, 0 means the calling thread
+	this->audio_thread_nice.store(getpriority(PRIO_PROCESS, 0), std::memory_order_relaxed);
+#	endif
+#endif
+	this->audio_thread_generation.fetch_add(1, std::memory_order_release);
+}
+
+void graph::adopt_audio_thread_scheduling(uint32_t& generation) noexcept
+{
+	auto g = this->audio_thread_generation.load(std::memory_order_acquire);
+	if (g == generation) {
+		return;
+	}
+	generation = g;
+
+	// failures are ignored, e.g. in case the process has no permission for real-time scheduling,
+	// the worker threads still work, only with less guarantees
+#if CFG_OS == CFG_OS_WINDOWS
+	SetThreadPriority(GetCurrentThread(), this->audio_thread_priority.load(std::memory_order_relaxed));
+#else
+	sched_param param{};
+	param.sched_priority = this->audio_thread_priority.load(std::memory_order_relaxed);
+	pthread_setschedparam(pthread_self(), this->audio_thread_policy.load(std::memory_order_relaxed), &param);
+#	if CFG_OS == CFG_OS_LINUX
+	setpriority(PRIO_PROCESS, 0, this->audio_thread_nice.load(std::memory_order_relaxed));
+#	endif
+#endif
+}
+
+void graph::run_worker()
+{
+	uint32_t last_period = 0;
+	uint32_t scheduling_generation = 0;
+
+	for (;;) {
+		this->wait_for_period(last_period);
+		if (this->quit.load(std::memory_order_acquire)) {
+			return;
+		}
+
+		this->adopt_audio_thread_scheduling(scheduling_generation);
+
+		// Take ready nodes while there are nodes left, the nodes the worker thread takes after the period
+		// is over belong to the next one, which is fine, as the node ids are published for that period.
+		while (this->num_taken.load(std::memory_order_relaxed) < this->num_active) {
+			if (!this->run_ready_node()) {
+				std::this_thread::yield();
+			}
+		}
+	}
+}
+
+bool graph::run_ready_node() noexcept
+{
+	auto end = this->num_ready.load(std::memory_order_acquire);
+
+	// the slots are reset before the hint is moved to the next period, so that the taken slots seen
+	// after acquiring the hint are taken in the hint's period
+	auto hint = this->first_untaken.load(std::memory_order_acquire);
+
+	for (auto i = size_t(uint32_t(hint)); i < end; ++i) {
+		auto& slot = this->ready[i];
+
+		auto id = slot.load(std::memory_order_acquire);
+		if (id == taken_slot) {
+			if (i == size_t(uint32_t(hint))) {
+				// The hint is only an optimization, it does not matter if another thread has moved it.
+				// In case the period is over, the hint has another period number and is not moved.
+				if (this->first_untaken.compare_exchange_weak(hint, hint + 1, std::memory_order_acquire)) {
+					++hint;
+				}
+			}
+			continue;
+		}
+
+		// reserved slot which is not published yet, its node can be taken later by any thread
+		if (id == unpublished_slot) {
+			continue;
+		}
+
+		if (!slot.compare_exchange_strong(id, taken_slot, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+			continue;
+		}
+		this->num_taken.fetch_add(1, std::memory_order_relaxed);
+
+		this->process_node(node_id(id));
+
+		this->num_done.fetch_add(1, std::memory_order_release);
+		return true;
+	}
+	return false;
+}
+
+void graph::process_node(node_id id) noexcept
+{
+	auto& n = this->nodes[id];
+
+	auto in = utki::make_span(n.in).subspan(0, this->num_block_frames * n.num_inputs);
+	auto out = utki::make_span(n.out).subspan(0, this->num_block_frames * n.num_outputs);
+
+	std::fill(in.begin(), in.end(), 0.0f);
+	for (auto& c : n.inputs) {
+		auto src = utki::make_span(this->nodes[c.from].out).subspan(0, in.size());
+		if (c.delay_line.empty()) {
+			std::transform(in.begin(), in.end(), src.begin(), in.begin(), [](float a, float b) {
+				return a + b;
+			});
+			continue;
+		}
+
+		// interleaved samples are delayed as a single stream, by delay * num_inputs samples
+		for (size_t i = 0; i != in.size(); ++i) {
+			in[i] += c.delay_line[c.delay_pos];
+			c.delay_line[c.delay_pos] = src[i];
+			if (++c.delay_pos == c.delay_line.size()) {
+				c.delay_pos = 0;
+			}
+		}
+	}
+
+	n.n->process(in, out);
+
+	for (auto s : n.successors) {
+		if (this->num_pending_inputs[s].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			auto slot = this->num_ready.fetch_add(1, std::memory_order_relaxed);
+			utki::assert(slot < this->num_active, SL);
+			this->ready[slot].store(ptrdiff_t(s), std::memory_order_release);
+		}
+	}
+}
+
+utki::span<const float> graph::render(size_t num_frames) noexcept
+{
+	utki::assert(num_frames <= this->max_block_frames, SL);
+
+	// All nodes of the previous period are done, so no other thread processes nodes. Worker threads which
+	// are late from the previous period may still be looking for ready nodes, so all the slots are reset
+	// before the hint is moved to the new period.
+	auto period = this->period.load(std::memory_order_relaxed) + 1;
+
+	this->num_block_frames = num_frames;
+	for (node_id id = 0; id != this->nodes.size(); ++id) {
+		const auto& n = this->nodes[id];
+		if (n.active) {
+			this->num_pending_inputs[id].store(unsigned(n.inputs.size()), std::memory_order_relaxed);
+		}
+	}
+	this->num_taken.store(0, std::memory_order_relaxed);
+	this->num_done.store(0, std::memory_order_relaxed);
+	for (size_t i = 0; i != this->num_active; ++i) {
+		this->ready[i].store(unpublished_slot, std::memory_order_relaxed);
+	}
+	this->num_ready.store(this->sources.size(), std::memory_order_relaxed);
+	this->first_untaken.store(uint64_t(period) << 32, std::memory_order_release);
+
+	// Worker threads which are late from the previous period may take the sources as soon as they are
+	// published, so the sources are published last, after the rest of the state is reset.
+	for (size_t i = 0; i != this->sources.size(); ++i) {
+		this->ready[i].store(ptrdiff_t(this->sources[i]), std::memory_order_release);
+	}
+
+	this->period.store(period, std::memory_order_release);
+
+	if (!this->workers.empty()) {
+		if (std::this_thread::get_id() != this->audio_thread_id) {
+			this->audio_thread_id = std::this_thread::get_id();
+			this->capture_audio_thread_scheduling();
+		}
+
+		this->wake_up_workers(this->workers.size());
+	}
+
+	// the audio thread runs ready nodes until all are done, the worker threads may be processing the last ones
+	while (this->num_done.load(std::memory_order_acquire) != this->num_active) {
+		if (!this->run_ready_node()) {
+			std::this_thread::yield();
+		}
+	}
+
+	return utki::make_span(this->nodes[this->output].out).subspan(0, num_frames * this->num_channels);
+}
+
+template <typename sample_type>
+void graph::fill_samples(utki::span<sample_type> play_buffer) noexcept
+{
+	if (!this->compiled) {
+		std::fill(play_buffer.begin(), play_buffer.end(), from_float<sample_type>(0));
+		return;
+	}
+
+	auto num_frames = play_buffer.size() / this->num_channels;
+	for (size_t frame = 0; frame != num_frames;) {
+		auto n = std::min(this->max_block_frames, num_frames - frame);
+
+		auto out = this->render(n);
+		std::transform(
+			out.begin(),
+			out.end(),
+			std::next(play_buffer.begin(), ptrdiff_t(frame * this->num_channels)),
+			[](float s) {
+				return from_float<sample_type>(s);
+			}
+		);
+
+		frame += n;
+	}
+}
+
+void graph::fill(utki::span<int16_t> play_buffer) noexcept
+{
+	this->fill_samples(play_buffer);
+}
+
+void graph::fill(utki::span<int24> play_buffer) noexcept
+{
+	this->fill_samples(play_buffer);
+}
+
+void graph::fill(utki::span<int32_t> play_buffer) noexcept
+{
+	this->fill_samples(play_buffer);
+}
+
+void graph::fill(utki::span<float> play_buffer) noexcept
+{
+	this->fill_samples(play_buffer);
+}
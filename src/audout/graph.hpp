@@ -0,0 +1,327 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <utki/config.hpp>
+#include <utki/span.hpp>
+
+#include "player.hpp"
+
+namespace audout {
+
+#if CFG_OS == CFG_OS_LINUX
+class wakeup_event;
+#endif
+
+/**
+ * @brief Processing graph.
+ * Renders the output from a directed acyclic graph of processing nodes: sources, effects and buses.
+ * Each node has a number of input and output channels, the outputs of all nodes connected to a node's
+ * input are summed. All buffers are allocated when the graph is compiled.
+ *
+ * Compiling sorts the nodes topologically. Each period the nodes are run as soon as all the nodes they
+ * depend on are done, so that independent branches are processed in parallel by the worker threads
+ * and the audio thread. The audio thread never waits for the worker threads to wake up or to take
+ * a ready node, it runs any nodes which are ready itself. It only waits for the nodes which are being
+ * processed by the worker threads, so the worker threads adopt the audio thread's scheduling policy
+ * and priority.
+ *
+ * Latencies reported by the nodes are compensated: the connections from the branches of lower latency
+ * are delayed, so that all the inputs of a node are aligned in time.
+ *
+ * The graph is a listener, so it can be passed to the player directly.
+ *
+ * Typical usage:
+ * @code
+ * audout::graph g(2);
+ * auto synth = g.add(synth_node, 0, 2);
+ * auto reverb = g.add(reverb_node, 2, 2);
+ * auto bus = g.add_bus(2);
+ * g.connect(synth, reverb);
+ * g.connect(synth, bus);
+ * g.connect(reverb, bus);
+ * g.connect(bus, g.get_output());
+ * g.compile();
+ * audout::player player(format, 256, &g);
+ * @endcode
+ */
+class graph : public listener
+{
+public:
+	/**
+	 * @brief Processing node.
+	 */
+	class node
+	{
+	public:
+		/**
+		 * @brief Process one block.
+		 * Called from the audio thread or one of the worker threads, never concurrently for the same node.
+		 * Must not block and should not allocate memory.
+		 * @param in - interleaved sum of the inputs. Empty for nodes without inputs.
+		 * @param out - buffer to fill with interleaved output of the same number of frames.
+		 */
+		virtual void process(utki::span<const float> in, utki::span<float> out) noexcept = 0;
+
+		/**
+		 * @brief Get latency of the node.
+		 * Queried when the graph is compiled.
+		 * @return Delay of the node's output relative to its input, in frames.
+		 */
+		virtual uint32_t get_latency() const noexcept
+		{
+			return 0;
+		}
+
+		node() = default;
+
+		node(const node&) = delete;
+		node& operator=(const node&) = delete;
+
+		node(node&&) = delete;
+		node& operator=(node&&) = delete;
+
+		virtual ~node() = default;
+	};
+
+	using node_id = size_t;
+
+	/**
+	 * @brief Default maximum number of frames processed at once.
+	 */
+	constexpr static size_t default_max_block_frames = 256;
+
+private:
+	struct connection {
+		node_id from;
+
+		// compensation delay line of delay frames, empty in case no compensation is needed
+		uint32_t delay = 0;
+		std::vector<float> delay_line;
+		size_t delay_pos = 0;
+	};
+
+	struct node_info {
+		graph::node* n;
+		unsigned num_inputs;
+		unsigned num_outputs;
+
+		std::vector<connection> inputs;
+		std::vector<node_id> successors;
+
+		// whether the node contributes to the output, other nodes are not processed
+		bool active = false;
+
+		// output latency of the node including the latencies of the nodes it depends on
+		uint32_t total_latency = 0;
+
+		std::vector<float> in;
+		std::vector<float> out;
+	};
+
+	const unsigned num_channels;
+	const size_t max_block_frames;
+	const unsigned num_workers;
+
+	std::vector<std::unique_ptr<graph::node>> buses;
+	std::vector<node_info> nodes;
+	node_id output;
+
+	bool compiled = false;
+
+	// active nodes without inputs, ready at the start of each period
+	std::vector<node_id> sources;
+	size_t num_active = 0;
+
+	// per period scheduling state
+
+	// number of inputs which are not processed yet, for each node
+	std::unique_ptr<std::atomic<unsigned>[]> num_pending_inputs;
+
+	// Nodes ready to be processed, in order of becoming ready. A slot is reserved by incrementing num_ready
+	// and then published by storing the node id to it. A thread takes a published slot by replacing
+	// the node id with taken_slot, so it never waits for a slot which is reserved by another thread.
+	std::unique_ptr<std::atomic<ptrdiff_t>[]> ready;
+	std::atomic<size_t> num_ready{0};
+
+	// All slots before this one are taken. The slot index is in the low 32 bits, the period number is in
+	// the high 32 bits, so that a thread late from the previous period can not move the hint of the next one.
+	std::atomic<uint64_t> first_untaken{0};
+
+	std::atomic<size_t> num_taken{0};
+	std::atomic<size_t> num_done{0};
+
+	// number of frames in current block, written before the period starts
+	size_t num_block_frames = 0;
+
+	std::atomic<uint32_t> period{0};
+
+	// scheduling of the audio thread, adopted by the worker threads in case the audio thread changes
+	std::thread::id audio_thread_id;
+	std::atomic<int> audio_thread_policy{0};
+	std::atomic<int> audio_thread_priority{0};
+	std::atomic<int> audio_thread_nice{0};
+	std::atomic<uint32_t> audio_thread_generation{0};
+
+	// The audio thread wakes up the worker threads without locking, once per period.
+#if CFG_OS == CFG_OS_LINUX
+	// in semaphore mode, each worker thread takes one wakeup of the number posted each period
+	std::unique_ptr<wakeup_event> wakeup;
+#else
+	// the notification can be lost, in which case the worker thread skips the period
+	std::mutex thread_mutex;
+	std::condition_variable thread_cv;
+#endif
+	std::atomic_bool quit = false;
+	std::vector<std::thread> workers;
+
+	node_info& get_node(node_id id);
+
+	void wake_up_workers(size_t num_wakeups) noexcept;
+	void wait_for_period(uint32_t& last_period);
+	void capture_audio_thread_scheduling() noexcept;
+	void adopt_audio_thread_scheduling(uint32_t& generation) noexcept;
+
+	void run_worker();
+	bool run_ready_node() noexcept;
+	void process_node(node_id id) noexcept;
+	utki::span<const float> render(size_t num_frames) noexcept;
+
+	template <typename sample_type>
+	void fill_samples(utki::span<sample_type> play_buffer) noexcept;
+
+public:
+	/**
+	 * @brief Get default number of worker threads.
+	 * @return One less than the number of hardware threads, so that together with the audio thread
+	 *         all hardware threads are used.
+	 */
+	static unsigned get_default_num_workers() noexcept;
+
+	/**
+	 * @brief Create empty graph.
+	 * The graph initially contains only the output bus.
+	 * @param num_channels - number of output channels.
+	 * @param max_block_frames - maximum number of frames the nodes are asked to process at once.
+	 *                           Larger buffers are rendered in several blocks.
+	 * @param num_workers - number of worker threads. The audio thread processes nodes too,
+	 *                      so 0 means all nodes are processed by the audio thread.
+	 * @throw std::invalid_argument - in case number of channels or maximum block size is 0.
+	 */
+	graph(
+		unsigned num_channels,
+		size_t max_block_frames = default_max_block_frames,
+		unsigned num_workers = get_default_num_workers()
+	);
+
+	/**
+	 * @brief Stop the worker threads.
+	 */
+	~graph() override;
+
+	graph(const graph&) = delete;
+	graph& operator=(const graph&) = delete;
+
+	graph(graph&&) = delete;
+	graph& operator=(graph&&) = delete;
+
+	/**
+	 * @brief Get output bus.
+	 * The sum of the nodes connected to the output bus is the output of the graph.
+	 * @return ID of the output bus.
+	 */
+	node_id get_output() const noexcept
+	{
+		return this->output;
+	}
+
+	/**
+	 * @brief Add node.
+	 * @param n - node to add. It must stay valid while the graph exists.
+	 * @param num_inputs - number of input channels, 0 for sources.
+	 * @param num_outputs - number of output channels.
+	 * @return ID of the added node.
+	 * @throw std::invalid_argument - in case number of outputs is 0.
+	 * @throw std::logic_error - in case the graph is already compiled.
+	 */
+	node_id add(node& n, unsigned num_inputs, unsigned num_outputs);
+
+	/**
+	 * @brief Add bus.
+	 * Bus is a node which outputs the sum of its inputs.
+	 * @param num_channels - number of channels.
+	 * @return ID of the added bus.
+	 * @throw std::invalid_argument - in case number of channels is 0.
+	 * @throw std::logic_error - in case the graph is already compiled.
+	 */
+	node_id add_bus(unsigned num_channels);
+
+	/**
+	 * @brief Connect output of one node to input of another one.
+	 * @param from - node to take the output of.
+	 * @param to - node to add the output to its input.
+	 * @throw std::invalid_argument - in case any of the nodes does not exist, the nodes are already
+	 *                                connected, or number of output channels of the first node does not
+	 *                                match number of input channels of the second one.
+	 * @throw std::logic_error - in case the graph is already compiled.
+	 */
+	void connect(node_id from, node_id to);
+
+	/**
+	 * @brief Compile the graph.
+	 * Sorts the nodes, computes latency compensation, allocates buffers and starts the worker threads.
+	 * No nodes can be added after compilation. The graph renders silence until it is compiled.
+	 * @throw std::invalid_argument - in case the graph has cycles.
+	 * @throw std::logic_error - in case the graph is already compiled.
+	 */
+	void compile();
+
+	/**
+	 * @brief Get latency of the graph.
+	 * Valid after compilation.
+	 * @return Delay of the output in frames, i.e. the largest latency of all paths to the output.
+	 */
+	uint32_t get_latency() const noexcept
+	{
+		return this->nodes[this->output].total_latency;
+	}
+
+	void fill(utki::span<int16_t> play_buffer) noexcept override;
+	void fill(utki::span<int24> play_buffer) noexcept override;
+	void fill(utki::span<int32_t> play_buffer) noexcept override;
+	void fill(utki::span<float> play_buffer) noexcept override;
+};
+
+} // namespace audout
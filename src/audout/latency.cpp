@@ -0,0 +1,90 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "latency.hpp"
+
+#include <stdexcept>
+
+using namespace audout;
+
+buffer_geometry audout::to_buffer_geometry(latency_profile profile, uint32_t sampling_rate)
+{
+	constexpr auto ms_per_second = 1000;
+
+	auto ms_to_frames = [&](uint32_t ms) {
+		return uint32_t(uint64_t(sampling_rate) * ms / ms_per_second);
+	};
+
+	buffer_geometry g;
+
+	switch (profile) {
+		case latency_profile::ultra_low:
+			g.buffer_frames = ms_to_frames(4); // NOLINT(cppcoreguidelines-avoid-magic-numbers, "see profile description")
+			g.num_periods = 2;
+			break;
+		case latency_profile::low:
+			g.buffer_frames = ms_to_frames(20); // NOLINT(cppcoreguidelines-avoid-magic-numbers, "see profile description")
+			g.num_periods = 2;
+			break;
+		case latency_profile::balanced:
+			g.buffer_frames = ms_to_frames(100); // NOLINT(cppcoreguidelines-avoid-magic-numbers, "see profile description")
+			g.num_periods = 4; // NOLINT(cppcoreguidelines-avoid-magic-numbers, "see profile description")
+			break;
+		case latency_profile::throughput:
+			g.buffer_frames = ms_to_frames(4000); // NOLINT(cppcoreguidelines-avoid-magic-numbers, "see profile description")
+			g.num_periods = 4; // NOLINT(cppcoreguidelines-avoid-magic-numbers, "see profile description")
+			break;
+	}
+
+	// request data by whole periods
+	g.min_request_frames = g.period_frames();
+
+	// Do not wait for the whole buffer to be filled to start playing, including after underrun.
+	// Otherwise the first sound would be delayed by the whole buffer length.
+	g.prebuffer_frames = g.period_frames();
+
+	return g;
+}
+
+void audout::validate(const buffer_geometry& geometry)
+{
+	if (geometry.num_periods == 0) {
+		throw std::invalid_argument("buffer_geometry: number of periods must be positive");
+	}
+	if (geometry.period_frames() == 0) {
+		throw std::invalid_argument("buffer_geometry: period must be at least one frame");
+	}
+	if (geometry.min_request_frames != buffer_geometry::backend_default &&
+		geometry.min_request_frames > geometry.buffer_frames)
+	{
+		throw std::invalid_argument("buffer_geometry: minimal request is bigger than the buffer");
+	}
+	if (geometry.prebuffer_frames != buffer_geometry::backend_default &&
+		geometry.prebuffer_frames > geometry.buffer_frames)
+	{
+		throw std::invalid_argument("buffer_geometry: prebuffer is bigger than the buffer");
+	}
+}
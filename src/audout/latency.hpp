@@ -0,0 +1,121 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+namespace audout {
+
+/**
+ * @brief Named latency profiles.
+ * Each profile corresponds to a buffer geometry, see to_buffer_geometry().
+ */
+enum class latency_profile {
+	/**
+	 * @brief About 4 ms buffer of 2 periods.
+	 * Intended for live monitoring and instruments. Prone to underruns on loaded systems.
+	 */
+	ultra_low,
+
+	/**
+	 * @brief About 20 ms buffer of 2 periods.
+	 * Intended for interactive sounds, e.g. games and UI.
+	 */
+	low,
+
+	/**
+	 * @brief About 100 ms buffer of 4 periods.
+	 * Intended for media playback which has to react to user input, e.g. video players.
+	 */
+	balanced,
+
+	/**
+	 * @brief Multi-second buffer filled in large batches.
+	 * Intended for background playback, where CPU wakeups matter more than latency.
+	 * Audio thread wakes up about once per second.
+	 */
+	throughput
+};
+
+/**
+ * @brief Device buffer geometry.
+ * The audio thread fills one period at a time, period size is buffer_frames / num_periods.
+ */
+struct buffer_geometry {
+	/**
+	 * @brief Value of min_request_frames or prebuffer_frames meaning the backend's default.
+	 */
+	constexpr static uint32_t backend_default = std::numeric_limits<uint32_t>::max();
+
+	/**
+	 * @brief Total size of the device buffer in frames.
+	 * This is the target latency of the playback.
+	 */
+	uint32_t buffer_frames = 0;
+
+	/**
+	 * @brief Number of periods in the buffer.
+	 */
+	uint32_t num_periods = 2;
+
+	/**
+	 * @brief Minimal number of frames the device requests at once.
+	 * The device does not request more data until at least this number of frames is free in the buffer.
+	 */
+	uint32_t min_request_frames = backend_default;
+
+	/**
+	 * @brief Number of frames to buffer before starting playback.
+	 * Also applies to restarting playback after an underrun. 0 means to start right away.
+	 */
+	uint32_t prebuffer_frames = backend_default;
+
+	uint32_t period_frames() const noexcept
+	{
+		return this->buffer_frames / this->num_periods;
+	}
+};
+
+/**
+ * @brief Get buffer geometry of a latency profile.
+ * @param profile - latency profile.
+ * @param sampling_rate - sampling rate in Hz.
+ * @return Buffer geometry corresponding to the profile at the given sampling rate.
+ */
+buffer_geometry to_buffer_geometry(latency_profile profile, uint32_t sampling_rate);
+
+/**
+ * @brief Check buffer geometry for consistency.
+ * @param geometry - buffer geometry to check.
+ * @throw std::invalid_argument - in case the buffer is empty, there are no periods,
+ *                                period is shorter than one frame, minimal request or
+ *                                prebuffer is bigger than the buffer.
+ */
+void validate(const buffer_geometry& geometry);
+
+} // namespace audout
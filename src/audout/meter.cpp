@@ -0,0 +1,320 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "meter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <utki/debug.hpp>
+
+#include "convert.hpp"
+
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#	include <arm_neon.h>
+#endif
+
+using namespace audout;
+
+namespace {
+bool is_clipped(int16_t s) noexcept
+{
+	return s == std::numeric_limits<int16_t>::max() || s == std::numeric_limits<int16_t>::min();
+}
+
+bool is_clipped(int24 s) noexcept
+{
+	constexpr int32_t max_int24 = (1 << 23) - 1;
+	auto v = int32_t(s);
+	return v == max_int24 || v == -max_int24 - 1;
+}
+
+bool is_clipped(int32_t s) noexcept
+{
+	return s == std::numeric_limits<int32_t>::max() || s == std::numeric_limits<int32_t>::min();
+}
+
+bool is_clipped(float s) noexcept
+{
+	return std::abs(s) >= 1;
+}
+
+struct accumulator {
+	std::array<float, meter::max_num_channels> peak{};
+	std::array<float, meter::max_num_channels> sum_squares{};
+	std::array<uint32_t, meter::max_num_channels> num_clipped{};
+};
+
+// simd_width lanes of the SIMD accumulators map to channels as lane % num_channels,
+// valid in case number of channels divides the lane count
+constexpr size_t simd_width = 4;
+
+// adds SIMD lane accumulators to the channel accumulators
+void fold_lanes(
+	accumulator& acc,
+	const std::array<float, simd_width>& peak,
+	const std::array<float, simd_width>& sum_squares,
+	const std::array<uint32_t, simd_width>& num_clipped,
+	unsigned num_channels
+) noexcept
+{
+	for (size_t lane = 0; lane != simd_width; ++lane) {
+		auto ch = lane % num_channels;
+		acc.peak[ch] = std::max(acc.peak[ch], peak[lane]);
+		acc.sum_squares[ch] += sum_squares[lane];
+		acc.num_clipped[ch] += num_clipped[lane];
+	}
+}
+
+// returns number of samples accumulated, the rest is to be accumulated by the scalar code
+template <typename sample_type>
+size_t accumulate_simd(accumulator&, const sample_type*, size_t, unsigned) noexcept
+{
+	return 0;
+}
+
+size_t accumulate_simd(accumulator& acc, const float* buf, size_t num_samples, unsigned num_channels) noexcept
+{
+	size_t i = 0;
+
+#if defined(__SSE2__) || (defined(__aarch64__) && defined(__ARM_NEON))
+	if (simd_width % num_channels != 0) {
+		return 0;
+	}
+
+	std::array<float, simd_width> peak{};
+	std::array<float, simd_width> sum_squares{};
+	std::array<uint32_t, simd_width> num_clipped{};
+
+#	if defined(__SSE2__)
+	const __m128 sign_mask = _mm_set1_ps(-0.0f);
+	const __m128 one = _mm_set1_ps(1);
+	__m128 p = _mm_setzero_ps();
+	__m128 s = _mm_setzero_ps();
+	__m128i c = _mm_setzero_si128();
+	for (; i + simd_width <= num_samples; i += simd_width) {
+		__m128 v = _mm_andnot_ps(sign_mask, _mm_loadu_ps(buf + i));
+		p = _mm_max_ps(p, v);
+		s = _mm_add_ps(s, _mm_mul_ps(v, v));
+		// comparison gives all ones, i.e. -1, for clipped samples
+		c = _mm_sub_epi32(c, _mm_castps_si128(_mm_cmpge_ps(v, one)));
+	}
+	_mm_storeu_ps(peak.data(), p);
+	_mm_storeu_ps(sum_squares.data(), s);
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "SIMD store")
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(num_clipped.data()), c);
+#	else
+	const float32x4_t one = vdupq_n_f32(1);
+	float32x4_t p = vdupq_n_f32(0);
+	float32x4_t s = vdupq_n_f32(0);
+	uint32x4_t c = vdupq_n_u32(0);
+	for (; i + simd_width <= num_samples; i += simd_width) {
+		float32x4_t v = vabsq_f32(vld1q_f32(buf + i));
+		p = vmaxq_f32(p, v);
+		s = vmlaq_f32(s, v, v);
+		// comparison gives all ones, i.e. -1, for clipped samples
+		c = vsubq_u32(c, vcgeq_f32(v, one));
+	}
+	vst1q_f32(peak.data(), p);
+	vst1q_f32(sum_squares.data(), s);
+	vst1q_u32(num_clipped.data(), c);
+#	endif
+
+	fold_lanes(acc, peak, sum_squares, num_clipped, num_channels);
+#endif
+
+	return i;
+}
+
+size_t accumulate_simd(accumulator& acc, const int16_t* buf, size_t num_samples, unsigned num_channels) noexcept
+{
+	size_t i = 0;
+
+#if defined(__SSE2__) || (defined(__aarch64__) && defined(__ARM_NEON))
+	if (simd_width % num_channels != 0) {
+		return 0;
+	}
+
+	std::array<float, simd_width> peak{};
+	std::array<float, simd_width> sum_squares{};
+	std::array<uint32_t, simd_width> num_clipped{};
+
+	// each iteration processes 8 samples as two halves of 4, so that lanes map to the same channels
+	constexpr size_t step = 2 * simd_width;
+
+#	if defined(__SSE2__)
+	const __m128 sign_mask = _mm_set1_ps(-0.0f);
+	const __m128 scale = _mm_set1_ps(to_float(int16_t(1)));
+	const __m128i max = _mm_set1_epi32(std::numeric_limits<int16_t>::max());
+	const __m128i min = _mm_set1_epi32(std::numeric_limits<int16_t>::min());
+	__m128 p = _mm_setzero_ps();
+	__m128 s = _mm_setzero_ps();
+	__m128i c = _mm_setzero_si128();
+
+	auto accumulate_half = [&](__m128i half) {
+		// comparisons give all ones, i.e. -1, for clipped samples
+		c = _mm_sub_epi32(c, _mm_or_si128(_mm_cmpeq_epi32(half, max), _mm_cmpeq_epi32(half, min)));
+		__m128 v = _mm_andnot_ps(sign_mask, _mm_mul_ps(_mm_cvtepi32_ps(half), scale));
+		p = _mm_max_ps(p, v);
+		s = _mm_add_ps(s, _mm_mul_ps(v, v));
+	};
+
+	for (; i + step <= num_samples; i += step) {
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "SIMD load")
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + i));
+
+		// sign-extend 16-bit samples to 32 bits
+		accumulate_half(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+		accumulate_half(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+	}
+	_mm_storeu_ps(peak.data(), p);
+	_mm_storeu_ps(sum_squares.data(), s);
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "SIMD store")
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(num_clipped.data()), c);
+#	else
+	const float32x4_t scale = vdupq_n_f32(to_float(int16_t(1)));
+	const int32x4_t max = vdupq_n_s32(std::numeric_limits<int16_t>::max());
+	const int32x4_t min = vdupq_n_s32(std::numeric_limits<int16_t>::min());
+	float32x4_t p = vdupq_n_f32(0);
+	float32x4_t s = vdupq_n_f32(0);
+	uint32x4_t c = vdupq_n_u32(0);
+
+	auto accumulate_half = [&](int32x4_t half) {
+		// comparisons give all ones, i.e. -1, for clipped samples
+		c = vsubq_u32(c, vorrq_u32(vceqq_s32(half, max), vceqq_s32(half, min)));
+		float32x4_t v = vabsq_f32(vmulq_f32(vcvtq_f32_s32(half), scale));
+		p = vmaxq_f32(p, v);
+		s = vmlaq_f32(s, v, v);
+	};
+
+	for (; i + step <= num_samples; i += step) {
+		int16x8_t v = vld1q_s16(buf + i);
+		accumulate_half(vmovl_s16(vget_low_s16(v)));
+		accumulate_half(vmovl_s16(vget_high_s16(v)));
+	}
+	vst1q_f32(peak.data(), p);
+	vst1q_f32(sum_squares.data(), s);
+	vst1q_u32(num_clipped.data(), c);
+#	endif
+
+	fold_lanes(acc, peak, sum_squares, num_clipped, num_channels);
+#endif
+
+	return i;
+}
+} // namespace
+
+template <typename sample_type>
+void meter::process_samples(utki::span<const sample_type> buf, unsigned num_channels) noexcept
+{
+	utki::assert(num_channels != 0 && num_channels <= max_num_channels, SL);
+
+	accumulator acc;
+
+	// SIMD part starts at the beginning of the buffer, so the scalar tail starts at a sample index
+	// which gives the right channel as index % num_channels
+	size_t i = accumulate_simd(acc, buf.data(), buf.size(), num_channels);
+
+	for (; i != buf.size(); ++i) {
+		auto ch = i % num_channels;
+		float v = std::abs(to_float(buf[i]));
+		acc.peak[ch] = std::max(acc.peak[ch], v);
+		acc.sum_squares[ch] += v * v;
+		if (is_clipped(buf[i])) {
+			++acc.num_clipped[ch];
+		}
+	}
+
+	auto num_frames = std::max(size_t(1), buf.size() / num_channels);
+
+	// begin update, the fence keeps the stores below from becoming visible before the odd sequence number
+	auto seq = this->sequence.load(std::memory_order_relaxed);
+	this->sequence.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	this->num_channels.store(num_channels, std::memory_order_relaxed);
+	for (unsigned ch = 0; ch != num_channels; ++ch) {
+		this->total_num_clipped[ch] += acc.num_clipped[ch];
+
+		this->peaks[ch].store(acc.peak[ch], std::memory_order_relaxed);
+		this->rmses[ch].store(std::sqrt(acc.sum_squares[ch] / float(num_frames)), std::memory_order_relaxed);
+		this->nums_clipped[ch].store(this->total_num_clipped[ch], std::memory_order_relaxed);
+	}
+
+	// end update
+	this->sequence.store(seq + 2, std::memory_order_release);
+}
+
+void meter::process(utki::span<const int16_t> buf, unsigned num_channels) noexcept
+{
+	this->process_samples(buf, num_channels);
+}
+
+void meter::process(utki::span<const int24> buf, unsigned num_channels) noexcept
+{
+	this->process_samples(buf, num_channels);
+}
+
+void meter::process(utki::span<const int32_t> buf, unsigned num_channels) noexcept
+{
+	this->process_samples(buf, num_channels);
+}
+
+void meter::process(utki::span<const float> buf, unsigned num_channels) noexcept
+{
+	this->process_samples(buf, num_channels);
+}
+
+meter::snapshot meter::get() const noexcept
+{
+	snapshot ret;
+
+	for (;;) {
+		auto seq = this->sequence.load(std::memory_order_acquire);
+		if (seq % 2 != 0) {
+			// the levels are being updated, the update is short, so just retry
+			continue;
+		}
+
+		ret.num_buffers = seq / 2;
+		ret.num_channels = std::min(this->num_channels.load(std::memory_order_relaxed), max_num_channels);
+		for (unsigned ch = 0; ch != ret.num_channels; ++ch) {
+			auto& c = ret.channels[ch];
+			c.peak = this->peaks[ch].load(std::memory_order_relaxed);
+			c.rms = this->rmses[ch].load(std::memory_order_relaxed);
+			c.num_clipped = this->nums_clipped[ch].load(std::memory_order_relaxed);
+		}
+
+		// the fence keeps the loads above from being reordered after the sequence check
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (this->sequence.load(std::memory_order_relaxed) == seq) {
+			return ret;
+		}
+	}
+}
@@ -0,0 +1,152 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include <utki/span.hpp>
+
+#include "format.hpp"
+
+namespace audout {
+
+/**
+ * @brief Output level meter.
+ * Computes per-channel peak, RMS and number of clipped samples of each processed buffer
+ * and publishes them as a snapshot.
+ * The processing side is wait-free, it never blocks, allocates or waits for readers.
+ * Readers can poll the snapshot from any thread, in case the snapshot is being updated
+ * at the moment, the reader retries.
+ */
+class meter
+{
+public:
+	constexpr static unsigned max_num_channels = 8;
+
+	struct channel_levels {
+		/**
+		 * @brief Peak absolute sample value over the last processed buffer.
+		 * Full scale is 1.
+		 */
+		float peak = 0;
+
+		/**
+		 * @brief RMS of sample values over the last processed buffer.
+		 * Full scale is 1.
+		 */
+		float rms = 0;
+
+		/**
+		 * @brief Number of clipped samples since the meter creation.
+		 * Sample is considered clipped in case it is at the limit of the integer sample type's range,
+		 * or its absolute value is not less than 1 for float samples.
+		 */
+		uint32_t num_clipped = 0;
+	};
+
+	struct snapshot {
+		/**
+		 * @brief Number of buffers processed since the meter creation.
+		 * Allows pollers to tell whether the levels have been updated since last poll.
+		 */
+		uint32_t num_buffers = 0;
+
+		unsigned num_channels = 0;
+
+		std::array<channel_levels, max_num_channels> channels;
+	};
+
+private:
+	// Sequence lock, odd value means the writer is updating the levels.
+	// Incremented twice per update, so it is twice the number of processed buffers.
+	std::atomic<uint32_t> sequence{0};
+
+	std::atomic<unsigned> num_channels{0};
+	std::array<std::atomic<float>, max_num_channels> peaks{};
+	std::array<std::atomic<float>, max_num_channels> rmses{};
+	std::array<std::atomic<uint32_t>, max_num_channels> nums_clipped{};
+
+	// processing side state
+	std::array<uint32_t, max_num_channels> total_num_clipped{};
+
+	template <typename sample_type>
+	void process_samples(utki::span<const sample_type> buf, unsigned num_channels) noexcept;
+
+public:
+	meter() = default;
+
+	meter(const meter&) = delete;
+	meter& operator=(const meter&) = delete;
+
+	meter(meter&&) = delete;
+	meter& operator=(meter&&) = delete;
+
+	~meter() = default;
+
+	/**
+	 * @brief Measure levels of samples.
+	 * Must be called from single thread, normally the audio thread.
+	 * @param buf - interleaved samples.
+	 * @param num_channels - number of channels in the samples. Must not be greater than max_num_channels.
+	 */
+	void process(utki::span<const int16_t> buf, unsigned num_channels) noexcept;
+
+	/**
+	 * @brief Measure levels of samples.
+	 * Must be called from single thread, normally the audio thread.
+	 * @param buf - interleaved samples.
+	 * @param num_channels - number of channels in the samples. Must not be greater than max_num_channels.
+	 */
+	void process(utki::span<const int24> buf, unsigned num_channels) noexcept;
+
+	/**
+	 * @brief Measure levels of samples.
+	 * Must be called from single thread, normally the audio thread.
+	 * @param buf - interleaved samples.
+	 * @param num_channels - number of channels in the samples. Must not be greater than max_num_channels.
+	 */
+	void process(utki::span<const int32_t> buf, unsigned num_channels) noexcept;
+
+	/**
+	 * @brief Measure levels of samples.
+	 * Must be called from single thread, normally the audio thread.
+	 * @param buf - interleaved samples.
+	 * @param num_channels - number of channels in the samples. Must not be greater than max_num_channels.
+	 */
+	void process(utki::span<const float> buf, unsigned num_channels) noexcept;
+
+	/**
+	 * @brief Get levels measured from the last processed buffer.
+	 * Lock-free, can be called from any thread.
+	 * @return Snapshot of the levels.
+	 */
+	snapshot get() const noexcept;
+};
+
+} // namespace audout
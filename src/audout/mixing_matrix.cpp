@@ -0,0 +1,299 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "mixing_matrix.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <utki/debug.hpp>
+
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#	include <arm_neon.h>
+#endif
+
+using namespace audout;
+
+namespace {
+// channel indices of 5.1 layout
+enum surround_channel {
+	front_left,
+	front_right,
+	front_center,
+	lfe,
+	rear_left,
+	rear_right
+};
+
+constexpr unsigned num_surround_channels = 6;
+
+std::vector<float> make_default_coefficients(frame input, frame output)
+{
+	auto num_inputs = num_channels(input);
+	auto num_outputs = num_channels(output);
+
+	std::vector<float> c(size_t(num_inputs) * num_outputs, 0);
+	auto at = [&](unsigned out, unsigned in) -> float& {
+		return c[size_t(out) * num_inputs + in];
+	};
+
+	if (input == output) {
+		for (unsigned i = 0; i != num_inputs; ++i) {
+			at(i, i) = 1;
+		}
+		return c;
+	}
+
+	// ITU-R BS.775 downmix weight of center and rear channels
+	const float k = float(1 / std::sqrt(2.0));
+
+	// scale of the stereo downmix, so that full scale input does not clip
+	const float downmix_scale = 1 / (1 + 2 * k);
+
+	switch (input) {
+		case frame::mono:
+			if (output == frame::stereo) {
+				at(0, 0) = 1;
+				at(1, 0) = 1;
+			} else {
+				at(front_center, 0) = 1;
+			}
+			break;
+		case frame::stereo:
+			if (output == frame::mono) {
+				at(0, 0) = 0.5f;
+				at(0, 1) = 0.5f;
+			} else {
+				at(front_left, 0) = 1;
+				at(front_right, 1) = 1;
+			}
+			break;
+		case frame::surround_5_1:
+			if (output == frame::stereo) {
+				at(0, front_left) = downmix_scale;
+				at(0, front_center) = k * downmix_scale;
+				at(0, rear_left) = k * downmix_scale;
+				at(1, front_right) = downmix_scale;
+				at(1, front_center) = k * downmix_scale;
+				at(1, rear_right) = k * downmix_scale;
+			} else {
+				// average of the stereo downmix channels
+				at(0, front_left) = 0.5f * downmix_scale;
+				at(0, front_right) = 0.5f * downmix_scale;
+				at(0, front_center) = k * downmix_scale;
+				at(0, rear_left) = 0.5f * k * downmix_scale;
+				at(0, rear_right) = 0.5f * k * downmix_scale;
+			}
+			break;
+	}
+
+	return c;
+}
+} // namespace
+
+mixing_matrix::mixing_matrix(unsigned num_inputs, unsigned num_outputs, std::vector<float> coefficients) :
+	num_inputs(num_inputs),
+	num_outputs(num_outputs),
+	coefficients(std::move(coefficients))
+{
+	if (num_inputs == 0 || num_inputs > max_num_channels || num_outputs == 0 || num_outputs > max_num_channels) {
+		throw std::invalid_argument("mixing_matrix::mixing_matrix(): number of channels is out of range");
+	}
+	if (this->coefficients.size() != size_t(num_inputs) * num_outputs) {
+		throw std::invalid_argument("mixing_matrix::mixing_matrix(): number of coefficients does not match");
+	}
+	this->fast_path = this->find_fast_path();
+}
+
+mixing_matrix::mixing_matrix(frame input, frame output) :
+	mixing_matrix(num_channels(input), num_channels(output), make_default_coefficients(input, output))
+{}
+
+mixing_matrix::path mixing_matrix::find_fast_path() const noexcept
+{
+	auto is = [this](unsigned num_inputs, unsigned num_outputs, auto coefficient) {
+		if (this->num_inputs != num_inputs || this->num_outputs != num_outputs) {
+			return false;
+		}
+		for (unsigned o = 0; o != num_outputs; ++o) {
+			for (unsigned i = 0; i != num_inputs; ++i) {
+				if (this->coefficients[size_t(o) * num_inputs + i] != coefficient(o, i)) {
+					return false;
+				}
+			}
+		}
+		return true;
+	};
+
+	if (is(this->num_inputs, this->num_inputs, [](unsigned o, unsigned i) {
+			return o == i ? 1.0f : 0.0f;
+		}))
+	{
+		return path::identity;
+	}
+	if (is(1, 2, [](unsigned, unsigned) {
+			return 1.0f;
+		}))
+	{
+		return path::mono_to_stereo;
+	}
+	if (is(2, 1, [](unsigned, unsigned) {
+			return 0.5f;
+		}))
+	{
+		return path::stereo_to_mono;
+	}
+	if (is(2, num_surround_channels, [](unsigned o, unsigned i) {
+			return o == i ? 1.0f : 0.0f;
+		}))
+	{
+		return path::stereo_to_5_1;
+	}
+	return path::generic;
+}
+
+namespace {
+// fast paths process as many frames as possible with vector instructions and the rest one by one
+
+void duplicate_mono(const float* in, float* out, size_t num_frames) noexcept
+{
+	size_t frame = 0;
+#if defined(__SSE2__)
+	for (; frame + 4 <= num_frames; frame += 4) {
+		__m128 v = _mm_loadu_ps(in + frame);
+		_mm_storeu_ps(out + 2 * frame, _mm_unpacklo_ps(v, v));
+		_mm_storeu_ps(out + 2 * frame + 4, _mm_unpackhi_ps(v, v));
+	}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	for (; frame + 4 <= num_frames; frame += 4) {
+		float32x4_t v = vld1q_f32(in + frame);
+		vst2q_f32(out + 2 * frame, float32x4x2_t{v, v});
+	}
+#endif
+	for (; frame != num_frames; ++frame) {
+		out[2 * frame] = in[frame];
+		out[2 * frame + 1] = in[frame];
+	}
+}
+
+void average_stereo(const float* in, float* out, size_t num_frames) noexcept
+{
+	size_t frame = 0;
+#if defined(__SSE2__)
+	const __m128 half = _mm_set1_ps(0.5f);
+	for (; frame + 4 <= num_frames; frame += 4) {
+		__m128 a = _mm_loadu_ps(in + 2 * frame);
+		__m128 b = _mm_loadu_ps(in + 2 * frame + 4);
+		// NOLINTBEGIN(hicpp-signed-bitwise, "_MM_SHUFFLE macro")
+		__m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+		// NOLINTEND(hicpp-signed-bitwise)
+		_mm_storeu_ps(out + frame, _mm_mul_ps(_mm_add_ps(left, right), half));
+	}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	for (; frame + 4 <= num_frames; frame += 4) {
+		float32x4x2_t v = vld2q_f32(in + 2 * frame);
+		vst1q_f32(out + frame, vmulq_n_f32(vaddq_f32(v.val[0], v.val[1]), 0.5f));
+	}
+#endif
+	for (; frame != num_frames; ++frame) {
+		out[frame] = (in[2 * frame] + in[2 * frame + 1]) * 0.5f;
+	}
+}
+
+void stereo_to_front(const float* in, float* out, size_t num_frames) noexcept
+{
+	size_t frame = 0;
+#if defined(__SSE2__)
+	const __m128 zero = _mm_setzero_ps();
+	for (; frame + 2 <= num_frames; frame += 2) {
+		// two stereo frames make three vectors of two 5.1 frames
+		__m128 v = _mm_loadu_ps(in + 2 * frame);
+		float* dst = out + num_surround_channels * frame;
+		_mm_storeu_ps(dst, _mm_movelh_ps(v, zero));
+		// NOLINTNEXTLINE(hicpp-signed-bitwise, "_MM_SHUFFLE macro")
+		_mm_storeu_ps(dst + 4, _mm_shuffle_ps(zero, v, _MM_SHUFFLE(3, 2, 1, 0)));
+		_mm_storeu_ps(dst + 8, zero);
+	}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	const float32x2_t zero = vdup_n_f32(0);
+	for (; frame + 2 <= num_frames; frame += 2) {
+		float32x4_t v = vld1q_f32(in + 2 * frame);
+		float* dst = out + num_surround_channels * frame;
+		vst1q_f32(dst, vcombine_f32(vget_low_f32(v), zero));
+		vst1q_f32(dst + 4, vcombine_f32(zero, vget_high_f32(v)));
+		vst1q_f32(dst + 8, vdupq_n_f32(0));
+	}
+#endif
+	for (; frame != num_frames; ++frame) {
+		float* dst = out + num_surround_channels * frame;
+		dst[front_left] = in[2 * frame];
+		dst[front_right] = in[2 * frame + 1];
+		std::fill(dst + front_center, dst + num_surround_channels, 0.0f);
+	}
+}
+} // namespace
+
+void mixing_matrix::process(utki::span<const float> in, utki::span<float> out) const noexcept
+{
+	utki::assert(in.size() % this->num_inputs == 0, SL);
+
+	auto num_frames = in.size() / this->num_inputs;
+	utki::assert(out.size() == num_frames * this->num_outputs, SL);
+
+	switch (this->fast_path) {
+		case path::identity:
+			std::copy(in.begin(), in.end(), out.begin());
+			return;
+		case path::mono_to_stereo:
+			duplicate_mono(in.data(), out.data(), num_frames);
+			return;
+		case path::stereo_to_mono:
+			average_stereo(in.data(), out.data(), num_frames);
+			return;
+		case path::stereo_to_5_1:
+			stereo_to_front(in.data(), out.data(), num_frames);
+			return;
+		case path::generic:
+			break;
+	}
+
+	for (size_t frame = 0; frame != num_frames; ++frame) {
+		const float* src = in.data() + frame * this->num_inputs;
+		float* dst = out.data() + frame * this->num_outputs;
+		const float* row = this->coefficients.data();
+		for (unsigned o = 0; o != this->num_outputs; ++o, row += this->num_inputs) {
+			float sum = 0;
+			for (unsigned i = 0; i != this->num_inputs; ++i) {
+				sum += row[i] * src[i];
+			}
+			dst[o] = sum;
+		}
+	}
+}
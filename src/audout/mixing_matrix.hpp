@@ -0,0 +1,107 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <vector>
+
+#include <utki/span.hpp>
+
+#include "format.hpp"
+
+namespace audout {
+
+/**
+ * @brief Channel mixing matrix.
+ * Mixes interleaved frames of one number of channels into frames of another number of channels.
+ * Each output channel is a weighted sum of the input channels.
+ * Duplicating mono to stereo, averaging stereo to mono and putting stereo to front channels of 5.1
+ * have dedicated vectorized implementations, which are used whenever the coefficients match.
+ */
+class mixing_matrix
+{
+public:
+	constexpr static unsigned max_num_channels = 8;
+
+private:
+	unsigned num_inputs;
+	unsigned num_outputs;
+
+	// coefficient of input channel i in output channel o is at index o * num_inputs + i
+	std::vector<float> coefficients;
+
+	enum class path {
+		generic,
+		identity,
+		mono_to_stereo,
+		stereo_to_mono,
+		stereo_to_5_1
+	} fast_path;
+
+	path find_fast_path() const noexcept;
+
+public:
+	/**
+	 * @brief Create mixing matrix with given coefficients.
+	 * @param num_inputs - number of input channels.
+	 * @param num_outputs - number of output channels.
+	 * @param coefficients - num_outputs rows of num_inputs coefficients each. The coefficient of input
+	 *                       channel i in output channel o is at index o * num_inputs + i.
+	 * @throw std::invalid_argument - in case number of channels is 0 or greater than max_num_channels,
+	 *                                or number of coefficients does not match.
+	 */
+	mixing_matrix(unsigned num_inputs, unsigned num_outputs, std::vector<float> coefficients);
+
+	/**
+	 * @brief Create default mixing matrix between standard channel layouts.
+	 * Same layouts are passed through. Mono is duplicated to stereo and goes to the center of 5.1.
+	 * Stereo is averaged to mono and goes to the front channels of 5.1.
+	 * 5.1 is downmixed as recommended by ITU-R BS.775 without LFE, scaled down so that it does not clip.
+	 * @param input - channel layout of the input.
+	 * @param output - channel layout of the output.
+	 */
+	mixing_matrix(frame input, frame output);
+
+	unsigned get_num_inputs() const noexcept
+	{
+		return this->num_inputs;
+	}
+
+	unsigned get_num_outputs() const noexcept
+	{
+		return this->num_outputs;
+	}
+
+	/**
+	 * @brief Mix frames.
+	 * Does not allocate memory.
+	 * @param in - interleaved input frames.
+	 * @param out - buffer for the same number of interleaved output frames.
+	 */
+	void process(utki::span<const float> in, utki::span<float> out) const noexcept;
+};
+
+} // namespace audout
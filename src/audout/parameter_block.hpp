@@ -0,0 +1,186 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+
+namespace audout {
+
+/**
+ * @brief Parameters shared between control threads and the audio thread.
+ * Triple buffered block of parameters. Control threads publish new parameter values,
+ * audio thread picks up the latest published values once per period, normally at the beginning
+ * of audio::listener::fill().
+ * The audio thread side is wait-free, it never blocks, allocates or waits for control threads,
+ * so there is no priority inversion. Intermediate values published between two updates
+ * on the audio side are skipped, only the latest ones are picked up.
+ *
+ * Typical usage:
+ * @code
+ * struct synth_params{
+ *     float frequency;
+ *     float gain;
+ * };
+ *
+ * audout::parameter_block<synth_params> params({440, 1});
+ *
+ * // in control thread
+ * params.publish({880, 0.5f});
+ *
+ * // in listener::fill()
+ * params.update();
+ * const auto& p = params.get();
+ * @endcode
+ *
+ * See also audout::ramp for per-sample interpolation between old and new values.
+ *
+ * @tparam parameters_type - type of the parameters block. Must be trivially copyable.
+ */
+template <typename parameters_type>
+class parameter_block
+{
+	static_assert(
+		std::is_trivially_copyable_v<parameters_type>,
+		"parameters_type must be trivially copyable, so that copying never allocates"
+	);
+
+	std::array<parameters_type, 3> buffers;
+
+	constexpr static uint8_t index_mask = 0x3;
+	constexpr static uint8_t fresh_bit = 0x4;
+
+	// index of the buffer exchanged between writer and reader, and the flag telling that it holds
+	// values which were not yet picked up by the reader
+	std::atomic<uint8_t> middle{1};
+
+	// accessed only by control threads under the writer mutex
+	std::mutex writer_mutex;
+	uint8_t back = 2;
+	parameters_type latest;
+
+	// accessed only by audio thread
+	uint8_t front = 0;
+	parameters_type previous;
+
+public:
+	/**
+	 * @brief Create parameter block.
+	 * @param initial - initial values of the parameters.
+	 */
+	parameter_block(const parameters_type& initial = parameters_type{}) :
+		buffers{initial, initial, initial},
+		latest(initial),
+		previous(initial)
+	{}
+
+	parameter_block(const parameter_block&) = delete;
+	parameter_block& operator=(const parameter_block&) = delete;
+
+	parameter_block(parameter_block&&) = delete;
+	parameter_block& operator=(parameter_block&&) = delete;
+
+	~parameter_block() = default;
+
+	/**
+	 * @brief Publish new parameter values.
+	 * Can be called from any number of control threads. Must not be called from the audio thread.
+	 * @param values - new parameter values.
+	 */
+	void publish(const parameters_type& values)
+	{
+		std::lock_guard<std::mutex> lock(this->writer_mutex);
+		this->latest = values;
+		this->publish_latest();
+	}
+
+	/**
+	 * @brief Modify latest published parameter values.
+	 * Atomically, with respect to other control threads, calls the function on copy of latest published
+	 * values and publishes the result.
+	 * Can be called from any number of control threads. Must not be called from the audio thread.
+	 * @param modify - function taking reference to parameters_type to modify.
+	 */
+	template <typename function_type>
+	void modify(function_type&& modify)
+	{
+		std::lock_guard<std::mutex> lock(this->writer_mutex);
+		modify(this->latest);
+		this->publish_latest();
+	}
+
+	/**
+	 * @brief Pick up latest published parameter values.
+	 * Wait-free. Must be called only from the audio thread.
+	 * After the call, get_previous() returns values which were current before the call.
+	 * @return true if new values were picked up.
+	 * @return false if no new values were published since last update, current values remain unchanged.
+	 */
+	bool update() noexcept
+	{
+		this->previous = this->buffers[this->front];
+
+		if (!(this->middle.load(std::memory_order_relaxed) & fresh_bit)) {
+			return false;
+		}
+
+		this->front = this->middle.exchange(this->front, std::memory_order_acq_rel) & index_mask;
+		return true;
+	}
+
+	/**
+	 * @brief Get current parameter values.
+	 * Must be called only from the audio thread.
+	 * @return Parameter values picked up by last update().
+	 */
+	const parameters_type& get() const noexcept
+	{
+		return this->buffers[this->front];
+	}
+
+	/**
+	 * @brief Get previous parameter values.
+	 * Must be called only from the audio thread.
+	 * @return Parameter values which were current before last update().
+	 */
+	const parameters_type& get_previous() const noexcept
+	{
+		return this->previous;
+	}
+
+private:
+	void publish_latest() noexcept
+	{
+		this->buffers[this->back] = this->latest;
+		this->back = this->middle.exchange(uint8_t(this->back | fresh_bit), std::memory_order_acq_rel) & index_mask;
+	}
+};
+
+} // namespace audout
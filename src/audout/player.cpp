@@ -26,9 +26,16 @@ SOFTWARE.
 
 #include "player.hpp"
 
+#include <algorithm>
+#include <array>
+#include <thread>
+#include <type_traits>
+
 #include <utki/config.hpp>
 #include <utki/debug.hpp>
 
+#include "convert.hpp"
+
 #if CFG_OS == CFG_OS_WINDOWS
 #	include "backend/direct_sound.cxx"
 #elif CFG_OS == CFG_OS_LINUX
@@ -45,12 +52,90 @@ SOFTWARE.
 #	error "Unknown OS"
 #endif
 
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#include "backend/fan_out.cxx"
+
+#if CFG_OS == CFG_OS_LINUX
+// NOLINTNEXTLINE(bugprone-suspicious-include, "not a suspicious include")
+#	include "backend/simulated.cxx"
+#endif
+
 #ifdef assert
 #	undef assert
 #endif
 
 using namespace audout;
 
+namespace {
+template <typename sample_type, typename convert_type>
+void fill_via_int16(listener& l, utki::span<sample_type> play_buffer, convert_type convert) noexcept
+{
+	// 840 is divisible by any number of channels from 1 to 8, so chunks consist of whole frames
+	std::array<int16_t, 840> chunk{};
+
+	for (auto dst = play_buffer.begin(); dst != play_buffer.end();) {
+		auto n = std::min(chunk.size(), size_t(std::distance(dst, play_buffer.end())));
+		auto src = utki::make_span(chunk.data(), n);
+		l.fill(src);
+		for (auto s : src) {
+			*dst = convert(s);
+			++dst;
+		}
+	}
+}
+
+// calls the function with the backend downcasted to its actual type
+template <typename function_type>
+decltype(auto) visit_backend(utki::destructable* backend, function_type f)
+{
+	if (auto fo = dynamic_cast<fan_out*>(backend)) {
+		return f(*fo);
+	}
+
+#if CFG_OS == CFG_OS_LINUX
+	if (auto sb = dynamic_cast<simulated_backend*>(backend)) {
+		return f(*sb);
+	}
+#endif
+
+	utki::assert(dynamic_cast<audio_backend*>(backend), SL);
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast, "type erasure")
+	return f(*static_cast<audio_backend*>(backend));
+}
+
+// mixing is done by chunks of this number of frames, so that the buffers do not depend on the period size
+constexpr size_t mix_chunk_frames = 256;
+
+size_t get_drift_chunk_frames(uint32_t num_buffer_frames)
+{
+	// drift compensator needs at least several frames per chunk for interpolation
+	constexpr size_t min_chunk_frames = 4;
+	return std::max(size_t(num_buffer_frames), min_chunk_frames);
+}
+} // namespace
+
+void listener::fill(utki::span<int24> play_buffer) noexcept
+{
+	fill_via_int16(*this, play_buffer, [](int16_t s) {
+		return int24(int32_t(s) * (1 << 8));
+	});
+}
+
+void listener::fill(utki::span<int32_t> play_buffer) noexcept
+{
+	fill_via_int16(*this, play_buffer, [](int16_t s) {
+		return int32_t(s) * (1 << 16);
+	});
+}
+
+void listener::fill(utki::span<float> play_buffer) noexcept
+{
+	fill_via_int16(*this, play_buffer, [](int16_t s) {
+		constexpr float scale = 1.0f / float(1 << 15);
+		return float(s) * scale;
+	});
+}
+
 utki::intrusive_singleton<player>::instance_type player::instance = nullptr;
 
 player::player(
@@ -58,16 +143,525 @@ player::player(
 	uint32_t num_buffer_frames,
 	audout::listener* listener
 ) :
+	current_pipeline(std::make_unique<pipeline>(
+		listener, //
+		nullptr,
+		output_format,
+		num_buffer_frames,
+		this->controls
+	)),
 	backend(std::make_unique<audio_backend>(
 		output_format, //
 		num_buffer_frames,
-		listener
+		this->current_pipeline.get(),
+		nullptr,
+		std::string()
 	))
 {}
 
+player::player(
+	format output_format, //
+	uint32_t num_buffer_frames,
+	audout::listener* listener,
+	const std::vector<std::string>& device_names
+) :
+	current_pipeline(std::make_unique<pipeline>(
+		listener, //
+		nullptr,
+		output_format,
+		num_buffer_frames,
+		this->controls
+	)),
+	backend(std::make_unique<fan_out>(
+		output_format, //
+		num_buffer_frames,
+		*this->current_pipeline,
+		device_names
+	))
+{}
+
+player::player(
+	format output_format, //
+	uint32_t num_buffer_frames,
+	audout::listener* listener,
+	simulated_device& device
+) :
+	current_pipeline(std::make_unique<pipeline>(
+		listener, //
+		nullptr,
+		output_format,
+		num_buffer_frames,
+		this->controls
+	)),
+	backend([&]() -> std::unique_ptr<utki::destructable> {
+#if CFG_OS == CFG_OS_LINUX
+		return std::make_unique<simulated_backend>(
+			output_format, //
+			num_buffer_frames,
+			this->current_pipeline.get(),
+			nullptr,
+			device
+		);
+#else
+		throw std::logic_error("player::player(): simulated device is not supported on this platform");
+#endif
+	}())
+{}
+
+player::player(
+	format output_format, //
+	uint32_t num_buffer_frames,
+	audout::duplex_listener* listener
+) :
+	current_pipeline(std::make_unique<pipeline>(
+		nullptr, //
+		listener,
+		output_format,
+		num_buffer_frames,
+		this->controls
+	)),
+	backend([&]() {
+		if (output_format.sample_type != sample_format::int16) {
+			throw std::invalid_argument("player::player(): full-duplex mode only supports 16-bit samples");
+		}
+		return std::make_unique<audio_backend>(
+			output_format, //
+			num_buffer_frames,
+			this->current_pipeline.get(),
+			this->current_pipeline.get(),
+			std::string()
+		);
+	}())
+{}
+
+player::pipeline::pipeline(
+	audout::listener* listener, //
+	audout::duplex_listener* duplex_listener,
+	format output_format,
+	uint32_t num_buffer_frames,
+	struct controls& controls
+) :
+	listener(listener),
+	duplex_listener(duplex_listener),
+	output_format(output_format),
+	controls(controls),
+	drift(output_format.num_channels(), get_drift_chunk_frames(num_buffer_frames)),
+	// large enough for float samples, as dithered 16-bit output is rendered to float
+	source_buffer(
+		listener ? get_drift_chunk_frames(num_buffer_frames) * output_format.num_channels() * sizeof(float) : 0
+	),
+	resampled_buffer(listener ? get_drift_chunk_frames(num_buffer_frames) * output_format.num_channels() : 0),
+	mix_input_buffer(listener ? mix_chunk_frames * mixing_matrix::max_num_channels : 0),
+	mix_output_buffer(listener ? mix_chunk_frames * output_format.num_channels() : 0),
+	ditherer(output_format.num_channels()),
+	dither_buffer(listener ? mix_chunk_frames * output_format.num_channels() : 0)
+{}
+
+void player::pipeline::fill(utki::span<const int16_t> capture_buffer, utki::span<int16_t> play_buffer) noexcept
+{
+	this->duplex_listener->fill(capture_buffer, play_buffer);
+
+	this->convolve(play_buffer);
+
+	this->controls.gain.process(play_buffer, this->output_format.num_channels());
+
+	this->tap<int16_t>(play_buffer);
+}
+
+template <typename sample_type>
+void player::pipeline::tap(utki::span<const sample_type> play_buffer) noexcept
+{
+	if (this->controls.metering_enabled.load(std::memory_order_relaxed)) {
+		this->controls.meter.process(play_buffer, this->output_format.num_channels());
+	}
+
+	// the taps are loaded after the sequence becomes odd, so that a control thread which replaced them
+	// sees either the odd sequence or the audio thread seeing the replacement, see player::release_taps()
+	this->controls.tap_sequence.fetch_add(1, std::memory_order_seq_cst);
+
+	if (auto analyser = this->controls.analyser.load(std::memory_order_seq_cst)) {
+		analyser->push(play_buffer, this->output_format.num_channels());
+	}
+
+	if (auto recorder = this->controls.recorder.load(std::memory_order_seq_cst)) {
+		recorder->push(play_buffer, this->output_format.num_channels());
+	}
+
+	this->controls.tap_sequence.fetch_add(1, std::memory_order_release);
+}
+
+template <typename sample_type>
+void player::pipeline::fill_from_listener(utki::span<sample_type> play_buffer) noexcept
+{
+	auto matrix = this->controls.mixing.load(std::memory_order_acquire);
+	if (!matrix) {
+		this->listener->fill(play_buffer);
+		return;
+	}
+
+	auto num_inputs = matrix->get_num_inputs();
+	auto num_outputs = this->output_format.num_channels();
+	utki::assert(matrix->get_num_outputs() == num_outputs, SL);
+
+	auto num_frames = play_buffer.size() / num_outputs;
+	for (size_t frame = 0; frame != num_frames;) {
+		auto n = std::min(mix_chunk_frames, num_frames - frame);
+
+		auto input = utki::make_span(this->mix_input_buffer.data(), n * num_inputs);
+		this->listener->fill(input);
+
+		auto dst = play_buffer.subspan(frame * num_outputs, n * num_outputs);
+		if constexpr (std::is_same_v<sample_type, float>) {
+			matrix->process(input, dst);
+		} else {
+			auto mixed = utki::make_span(this->mix_output_buffer.data(), dst.size());
+			matrix->process(input, mixed);
+			std::transform(mixed.begin(), mixed.end(), dst.begin(), [](float s) {
+				return from_float<sample_type>(s);
+			});
+		}
+
+		frame += n;
+	}
+}
+
+template <typename sample_type>
+bool player::pipeline::compensate_drift(utki::span<sample_type> play_buffer) noexcept
+{
+	auto clock = this->controls.requested_clock.load(std::memory_order_acquire);
+	if (this->controls.resync_requested.exchange(false, std::memory_order_acq_rel) || clock != this->clock) {
+		this->clock = clock;
+		this->drift.reset();
+		this->num_played_frames = 0;
+		this->controls.drift_ratio.store(1, std::memory_order_relaxed);
+		if (this->clock) {
+			this->start_time = this->clock->now();
+		}
+	}
+
+	if (!this->clock) {
+		return false;
+	}
+
+	auto num_channels = this->output_format.num_channels();
+
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "buffer is allocated for the largest sample type")
+	auto source = utki::make_span(reinterpret_cast<sample_type*>(this->source_buffer.data()), this->resampled_buffer.size());
+
+	for (auto dst = play_buffer.begin(); dst != play_buffer.end();) {
+		auto resampled = utki::make_span(
+			this->resampled_buffer.data(),
+			std::min(this->resampled_buffer.size(), size_t(std::distance(dst, play_buffer.end())))
+		);
+
+		this->drift.process(resampled, [&](utki::span<float> input) {
+			this->fill_from_listener(source);
+			std::transform(source.begin(), source.end(), input.begin(), [](sample_type s) {
+				return to_float(s);
+			});
+		});
+
+		dst = std::transform(resampled.begin(), resampled.end(), dst, [](float s) {
+			return from_float<sample_type>(s);
+		});
+	}
+
+	auto rate = double(this->output_format.frequency());
+	auto num_frames = play_buffer.size() / num_channels;
+	this->num_played_frames += num_frames;
+
+	std::chrono::duration<double> elapsed = this->clock->now() - this->start_time;
+	auto error = elapsed - std::chrono::duration<double>(this->drift.get_num_consumed_frames() / rate);
+
+	// Filling runs ahead of the actual playback by the amount of buffered frames, and the backend
+	// prefills its buffers right after start, so the steady error is latched during the first second.
+	if (this->num_played_frames < this->output_format.frequency()) {
+		this->error_offset = error;
+	}
+
+	this->drift.control(error - this->error_offset, std::chrono::duration<double>(double(num_frames) / rate));
+	this->controls.drift_ratio.store(this->drift.get_ratio(), std::memory_order_relaxed);
+
+	return true;
+}
+
+template <typename sample_type>
+void player::pipeline::convolve(utki::span<sample_type> play_buffer) noexcept
+{
+	if (auto convolver = this->controls.convolver.load(std::memory_order_acquire)) {
+		utki::assert(convolver->get_num_channels() == this->output_format.num_channels(), SL);
+		convolver->process(play_buffer);
+	}
+}
+
+template <typename sample_type>
+void player::pipeline::render(utki::span<sample_type> play_buffer) noexcept
+{
+	if (!this->compensate_drift(play_buffer)) {
+		this->fill_from_listener(play_buffer);
+	}
+
+	this->convolve(play_buffer);
+
+	this->controls.gain.process(play_buffer, this->output_format.num_channels());
+}
+
+void player::pipeline::render_dithered(utki::span<int16_t> play_buffer) noexcept
+{
+	auto shaping = this->controls.dither_shaping.load(std::memory_order_relaxed);
+	if (!this->dithering || shaping != this->ditherer.get_noise_shaping()) {
+		// error feedback of the previous stream does not relate to the new one
+		this->ditherer.set_noise_shaping(shaping);
+		this->dithering = true;
+	}
+
+	for (auto dst = play_buffer.begin(); dst != play_buffer.end();) {
+		auto rendered = utki::make_span(
+			this->dither_buffer.data(),
+			std::min(this->dither_buffer.size(), size_t(std::distance(dst, play_buffer.end())))
+		);
+
+		this->render(rendered);
+
+		auto quantized = utki::make_span(&*dst, rendered.size());
+		this->ditherer.convert(rendered, quantized);
+		dst += ptrdiff_t(rendered.size());
+	}
+}
+
+template <typename sample_type>
+void player::pipeline::process(utki::span<sample_type> play_buffer) noexcept
+{
+	if constexpr (std::is_same_v<sample_type, int16_t>) {
+		if (this->controls.dithering_enabled.load(std::memory_order_acquire)) {
+			this->render_dithered(play_buffer);
+			this->tap<sample_type>(play_buffer);
+			return;
+		}
+		this->dithering = false;
+	}
+
+	this->render(play_buffer);
+
+	this->tap<sample_type>(play_buffer);
+}
+
+void player::pipeline::fill(utki::span<int16_t> play_buffer) noexcept
+{
+	this->process(play_buffer);
+}
+
+void player::pipeline::fill(utki::span<int24> play_buffer) noexcept
+{
+	this->process(play_buffer);
+}
+
+void player::pipeline::fill(utki::span<int32_t> play_buffer) noexcept
+{
+	this->process(play_buffer);
+}
+
+void player::pipeline::fill(utki::span<float> play_buffer) noexcept
+{
+	this->process(play_buffer);
+}
+
 void player::set_paused(bool pause)
 {
-	utki::assert(dynamic_cast<audio_backend*>(this->backend.get()), SL);
-	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-static-cast-downcast, "type erasure")
-	static_cast<audio_backend*>(this->backend.get())->set_paused(pause);
+	visit_backend(this->backend.get(), [&](auto& b) {
+		b.set_paused(pause);
+	});
+
+	if (!pause) {
+		// the reference clock kept running during the pause
+		this->controls.resync_requested.store(true, std::memory_order_release);
+	}
+}
+
+std::chrono::microseconds player::get_duplex_latency() const noexcept
+{
+	return visit_backend(this->backend.get(), [](auto& b) {
+		return b.get_duplex_latency();
+	});
+}
+
+std::chrono::microseconds player::get_startup_latency() const noexcept
+{
+	return visit_backend(this->backend.get(), [](auto& b) {
+		return b.get_startup_latency();
+	});
+}
+
+std::chrono::microseconds player::get_output_latency() const
+{
+	return visit_backend(this->backend.get(), [](auto& b) {
+		return b.get_output_latency();
+	});
+}
+
+void player::set_latency_profile(latency_profile profile)
+{
+	this->set_buffer_geometry(to_buffer_geometry(profile, this->current_pipeline->output_format.frequency()));
+}
+
+void player::set_buffer_geometry(const buffer_geometry& geometry)
+{
+	validate(geometry);
+
+	visit_backend(this->backend.get(), [&](auto& b) {
+		b.set_buffer_geometry(geometry);
+	});
+}
+
+void player::reconfigure(format output_format, uint32_t num_buffer_frames)
+{
+	if (this->current_pipeline->duplex_listener) {
+		throw std::logic_error("player::reconfigure(): full-duplex mode does not support reconfiguration");
+	}
+
+	if (auto matrix = this->controls.mixing.load(std::memory_order_relaxed);
+		matrix && matrix->get_num_outputs() != output_format.num_channels())
+	{
+		throw std::invalid_argument("player::reconfigure(): number of mixing matrix outputs does not match output format"
+		);
+	}
+
+	if (auto convolver = this->controls.convolver.load(std::memory_order_relaxed);
+		convolver && convolver->get_num_channels() != output_format.num_channels())
+	{
+		throw std::invalid_argument("player::reconfigure(): number of convolver channels does not match output format");
+	}
+
+	auto p = std::make_unique<pipeline>(
+		this->current_pipeline->listener, //
+		nullptr,
+		output_format,
+		num_buffer_frames,
+		this->controls
+	);
+
+	visit_backend(this->backend.get(), [&](auto& b) {
+		b.reconfigure(output_format, num_buffer_frames, p.get());
+	});
+
+	// the audio thread does not use the old pipeline anymore
+	this->current_pipeline = std::move(p);
+}
+
+buffer_geometry player::get_buffer_geometry() const
+{
+	return visit_backend(this->backend.get(), [](auto& b) {
+		return b.get_buffer_geometry();
+	});
+}
+
+float player::get_wakeup_rate() const noexcept
+{
+	return visit_backend(this->backend.get(), [](auto& b) {
+		return b.get_wakeup_rate();
+	});
+}
+
+void player::set_gain(float gain)
+{
+	this->controls.gain.set_master(gain);
+}
+
+void player::set_channel_gain(unsigned channel, float gain)
+{
+	this->controls.gain.set_channel(channel, gain);
+}
+
+void player::set_pan(float pan)
+{
+	this->controls.gain.set_pan(pan);
+}
+
+void player::set_gain_ramp(ramp_shape shape, uint32_t num_frames)
+{
+	this->controls.gain.set_ramp(shape, num_frames);
+}
+
+void player::set_metering(bool enable)
+{
+	this->controls.metering_enabled.store(enable, std::memory_order_relaxed);
+}
+
+meter::snapshot player::get_levels() const noexcept
+{
+	return this->controls.meter.get();
+}
+
+void player::release_taps()
+{
+	// in case the audio thread is pushing to the taps, it may be using the replaced ones,
+	// wait until it leaves. Taps pushed after that see the replacements.
+	auto sequence = this->controls.tap_sequence.load(std::memory_order_seq_cst);
+	if (sequence % 2 == 0) {
+		return;
+	}
+	while (this->controls.tap_sequence.load(std::memory_order_acquire) == sequence) {
+		std::this_thread::yield();
+	}
+}
+
+void player::set_spectrum_analyser(spectrum_analyser* analyser)
+{
+	this->controls.analyser.store(analyser, std::memory_order_seq_cst);
+	this->release_taps();
+}
+
+void player::set_recorder(audout::recorder* recorder)
+{
+	if (recorder) {
+		const auto& f = recorder->get_format();
+		const auto& output_format = this->current_pipeline->output_format;
+		if (f.frame_type != output_format.frame_type || f.sampling_rate != output_format.sampling_rate ||
+			f.sample_type != output_format.sample_type)
+		{
+			throw std::invalid_argument("player::set_recorder(): recorder format differs from output format");
+		}
+	}
+
+	this->controls.recorder.store(recorder, std::memory_order_seq_cst);
+	this->release_taps();
+}
+
+void player::set_mixing_matrix(const mixing_matrix* matrix)
+{
+	if (!this->current_pipeline->listener) {
+		throw std::logic_error("player::set_mixing_matrix(): mixing is not supported in full-duplex mode");
+	}
+	if (matrix && matrix->get_num_outputs() != this->current_pipeline->output_format.num_channels()) {
+		throw std::invalid_argument("player::set_mixing_matrix(): number of matrix outputs does not match output format"
+		);
+	}
+	this->controls.mixing.store(matrix, std::memory_order_release);
+}
+
+void player::set_convolver(audout::convolver* convolver)
+{
+	if (convolver && convolver->get_num_channels() != this->current_pipeline->output_format.num_channels()) {
+		throw std::invalid_argument("player::set_convolver(): number of convolver channels does not match output format");
+	}
+	this->controls.convolver.store(convolver, std::memory_order_release);
+}
+
+void player::set_dithering(bool enable, noise_shaping shaping)
+{
+	this->controls.dither_shaping.store(shaping, std::memory_order_relaxed);
+	this->controls.dithering_enabled.store(enable, std::memory_order_release);
+}
+
+void player::set_reference_clock(reference_clock* clock)
+{
+	if (!this->current_pipeline->listener) {
+		throw std::logic_error("player::set_reference_clock(): drift compensation is not supported in full-duplex mode");
+	}
+	this->controls.requested_clock.store(clock, std::memory_order_release);
+}
+
+double player::get_drift_ratio() const noexcept
+{
+	return this->controls.drift_ratio.load(std::memory_order_relaxed);
 }
@@ -26,11 +26,27 @@ SOFTWARE.
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <utki/destructable.hpp>
 #include <utki/singleton.hpp>
 #include <utki/span.hpp>
 
+#include "drift_compensator.hpp"
 #include "format.hpp"
+#include "gain.hpp"
+#include "latency.hpp"
+#include "meter.hpp"
+#include "convolver.hpp"
+#include "dither.hpp"
+#include "mixing_matrix.hpp"
+#include "recorder.hpp"
+#include "simulated_device.hpp"
+#include "spectrum_analyser.hpp"
 
 namespace audout {
 
@@ -40,6 +56,33 @@ class listener
 public:
 	virtual void fill(utki::span<int16_t> play_buffer) noexcept = 0;
 
+	/**
+	 * @brief Fill buffer of packed 24-bit samples.
+	 * Called when output format's sample type is sample_format::int24.
+	 * Default implementation calls the 16-bit fill() in chunks of whole frames and widens the samples.
+	 * Override to avoid the conversion.
+	 * @param play_buffer - buffer to fill with interleaved samples.
+	 */
+	virtual void fill(utki::span<int24> play_buffer) noexcept;
+
+	/**
+	 * @brief Fill buffer of 32-bit samples.
+	 * Called when output format's sample type is sample_format::int32.
+	 * Default implementation calls the 16-bit fill() in chunks of whole frames and widens the samples.
+	 * Override to avoid the conversion.
+	 * @param play_buffer - buffer to fill with interleaved samples.
+	 */
+	virtual void fill(utki::span<int32_t> play_buffer) noexcept;
+
+	/**
+	 * @brief Fill buffer of float samples.
+	 * Called when output format's sample type is sample_format::float32.
+	 * Default implementation calls the 16-bit fill() in chunks of whole frames and converts the samples.
+	 * Override to avoid the conversion.
+	 * @param play_buffer - buffer to fill with interleaved samples.
+	 */
+	virtual void fill(utki::span<float> play_buffer) noexcept;
+
 	listener() = default;
 
 	listener(const listener&) = delete;
@@ -51,12 +94,146 @@ public:
 	virtual ~listener() = default;
 };
 
+/**
+ * @brief Full-duplex listener.
+ * Listener which receives captured input along with the output buffer to fill.
+ * Only 16-bit samples are supported in full-duplex mode.
+ */
+class duplex_listener
+{
+public:
+	/**
+	 * @brief Process one period.
+	 * Called from the audio thread once per period.
+	 * @param capture_buffer - captured interleaved samples. It has the same format and number of frames
+	 *                         as the play buffer.
+	 * @param play_buffer - buffer to fill with interleaved samples to play.
+	 */
+	virtual void fill(utki::span<const int16_t> capture_buffer, utki::span<int16_t> play_buffer) noexcept = 0;
+
+	duplex_listener() = default;
+
+	duplex_listener(const duplex_listener&) = delete;
+	duplex_listener& operator=(const duplex_listener&) = delete;
+
+	duplex_listener(duplex_listener&&) = delete;
+	duplex_listener& operator=(duplex_listener&&) = delete;
+
+	virtual ~duplex_listener() = default;
+};
+
 // TODO: doxygen
 class player : public utki::intrusive_singleton<player>
 {
 	friend class utki::intrusive_singleton<player>;
 	static utki::intrusive_singleton<player>::instance_type instance;
 
+	// settings of the processing stages, kept across reconfigurations
+	struct controls {
+		audout::gain gain;
+
+		// set by control thread, picked up by audio thread on next period
+		std::atomic<reference_clock*> requested_clock = nullptr;
+		std::atomic_bool resync_requested = false;
+
+		std::atomic<double> drift_ratio = 1;
+
+		std::atomic<const mixing_matrix*> mixing = nullptr;
+
+		std::atomic<audout::convolver*> convolver = nullptr;
+
+		std::atomic_bool dithering_enabled = false;
+		std::atomic<noise_shaping> dither_shaping = noise_shaping::none;
+
+		std::atomic_bool metering_enabled = false;
+		audout::meter meter;
+
+		std::atomic<spectrum_analyser*> analyser = nullptr;
+		std::atomic<audout::recorder*> recorder = nullptr;
+
+		// incremented by the audio thread before and after pushing to the taps, i.e. odd while it pushes
+		std::atomic<uint32_t> tap_sequence = 0;
+	} controls;
+
+	// waits until the audio thread does not use the taps which were replaced before the call
+	void release_taps();
+
+	// processing stages applied between the listener and the backend, bound to the output format
+	class pipeline :
+		public audout::listener, //
+		public audout::duplex_listener
+	{
+	public:
+		audout::listener* const listener;
+		audout::duplex_listener* const duplex_listener;
+		const format output_format;
+
+		struct controls& controls;
+
+		pipeline(
+			audout::listener* listener, //
+			audout::duplex_listener* duplex_listener,
+			format output_format,
+			uint32_t num_buffer_frames,
+			struct controls& controls
+		);
+
+	private:
+		// audio thread state of drift compensation
+		reference_clock* clock = nullptr;
+		std::chrono::nanoseconds start_time{};
+		uint64_t num_played_frames = 0;
+		std::chrono::duration<double> error_offset{};
+		drift_compensator drift;
+		std::vector<uint8_t> source_buffer;
+		std::vector<float> resampled_buffer;
+
+		// listener channels and mixed channels of one chunk, in case mixing matrix is set
+		std::vector<float> mix_input_buffer;
+		std::vector<float> mix_output_buffer;
+
+		// audio thread state of dithering, in case it is enabled the 16-bit output is rendered
+		// to float by chunks and requantized by the ditherer
+		bool dithering = false;
+		audout::dither ditherer;
+		std::vector<float> dither_buffer;
+
+		// fills the buffer from the listener, mixing the listener channels to the output channels if needed
+		template <typename sample_type>
+		void fill_from_listener(utki::span<sample_type> play_buffer) noexcept;
+
+		template <typename sample_type>
+		bool compensate_drift(utki::span<sample_type> play_buffer) noexcept;
+
+		template <typename sample_type>
+		void convolve(utki::span<sample_type> play_buffer) noexcept;
+
+	public:
+
+		void fill(utki::span<const int16_t> capture_buffer, utki::span<int16_t> play_buffer) noexcept override;
+		void fill(utki::span<int16_t> play_buffer) noexcept override;
+		void fill(utki::span<int24> play_buffer) noexcept override;
+		void fill(utki::span<int32_t> play_buffer) noexcept override;
+		void fill(utki::span<float> play_buffer) noexcept override;
+
+	private:
+		// fills the buffer from the listener and applies all processing stages except the taps
+		template <typename sample_type>
+		void render(utki::span<sample_type> play_buffer) noexcept;
+
+		void render_dithered(utki::span<int16_t> play_buffer) noexcept;
+
+		template <typename sample_type>
+		void process(utki::span<sample_type> play_buffer) noexcept;
+
+		// taps applied to the final samples which go to the backend
+		template <typename sample_type>
+		void tap(utki::span<const sample_type> play_buffer) noexcept;
+	};
+
+	// replaced on reconfiguration
+	std::unique_ptr<pipeline> current_pipeline;
+
 	std::unique_ptr<utki::destructable> backend;
 
 public:
@@ -73,6 +250,65 @@ public:
 		listener* listener
 	);
 
+	/**
+	 * @brief Create a singleton player object playing to several output devices.
+	 * The listener is called once per period by a separate render thread paced by the monotonic clock,
+	 * the rendered frames are passed to each device through its own ring buffer. Each device's clock
+	 * drift is compensated by resampling, see audout::drift_compensator. A device which stalls does not
+	 * block the rendering and other devices, the frames which do not fit into its ring buffer are dropped.
+	 * Fan-out adds latency of two periods.
+	 * The listener is always called with float samples, see listener::fill(utki::span<float>).
+	 * @param output_format - output format of all devices.
+	 * @param num_buffer_frames - request for size of playing buffer of each device, also the render period.
+	 * @param listener - callback for filling playing buffer.
+	 * @param device_names - names of the output devices. Empty name means the default device.
+	 *                       Device names are backend specific, e.g. PulseAudio sink names.
+	 * @throw std::invalid_argument - in case the list of device names is empty.
+	 * @throw std::logic_error - in case device selection is not supported by the backend.
+	 */
+	player(
+		format output_format, //
+		uint32_t num_buffer_frames,
+		listener* listener,
+		const std::vector<std::string>& device_names
+	);
+
+	/**
+	 * @brief Create a singleton player object playing to a simulated device.
+	 * The audio thread runs the same logic as with a real device, but it is paced by the device's
+	 * virtual clock, see audout::simulated_device. Intended for testing.
+	 * Supported only on Linux.
+	 * @param output_format - output format.
+	 * @param num_buffer_frames - size of playing buffer.
+	 * @param listener - callback for filling playing buffer.
+	 * @param device - simulated device to play to. It must stay valid while the player exists.
+	 * @throw std::logic_error - in case the simulated device is not supported on the platform
+	 *                           or the device is already used by another player.
+	 */
+	player(
+		format output_format, //
+		uint32_t num_buffer_frames,
+		listener* listener,
+		simulated_device& device
+	);
+
+	/**
+	 * @brief Create a singleton full-duplex player object.
+	 * Capture and playback streams are run by the same audio thread, each period the listener
+	 * gets the captured samples along with the buffer to fill.
+	 * Supported only by PulseAudio backend and only with 16-bit samples.
+	 * @param output_format - format of both output and input.
+	 * @param num_buffer_frames - request for size of playing and capturing buffers.
+	 * @param listener - callback for processing captured samples and filling playing buffer.
+	 * @throw std::logic_error - in case full-duplex is not supported by the backend.
+	 * @throw std::invalid_argument - in case sample format is not sample_format::int16.
+	 */
+	player(
+		format output_format, //
+		uint32_t num_buffer_frames,
+		duplex_listener* listener
+	);
+
 public:
 	player(const player&) = delete;
 	player& operator=(const player&) = delete;
@@ -83,6 +319,239 @@ public:
 	~player() override = default;
 
 	void set_paused(bool pause);
+
+	/**
+	 * @brief Get full-duplex latency.
+	 * The latency is the time between a sample arrives to the capture device and the sample filled
+	 * into the play buffer of the same period leaves the output device.
+	 * It is measured by the audio thread each period.
+	 * @return Latency of full-duplex player.
+	 * @return 0 if the player is not full-duplex, or the latency is not measured yet.
+	 */
+	std::chrono::microseconds get_duplex_latency() const noexcept;
+
+	/**
+	 * @brief Get startup latency.
+	 * The startup latency is the time from the beginning of the player construction to the moment
+	 * the first frame becomes audible. The time the player was kept paused after construction is not counted.
+	 * It is measured once, after the playback starts for the first time.
+	 * Only measured by PulseAudio backend. In fan-out mode it is the startup latency of the first device.
+	 * @return Startup latency.
+	 * @return 0 if the latency is not measured yet or not supported by the backend.
+	 */
+	std::chrono::microseconds get_startup_latency() const noexcept;
+
+	/**
+	 * @brief Get output latency.
+	 * The output latency is the time it takes for a sample written to the device now to be played,
+	 * as reported by the backend.
+	 * Only measured by PulseAudio backend and simulated device. In fan-out mode it is the output latency
+	 * of the first device, not counting the fan-out's own latency.
+	 * @return Output latency.
+	 * @return 0 if the latency is not known or not supported by the backend.
+	 */
+	std::chrono::microseconds get_output_latency() const;
+
+	/**
+	 * @brief Set latency profile.
+	 * Same as set_buffer_geometry() with the geometry of the profile at the output sampling rate.
+	 * Can be called from any thread.
+	 * @param profile - latency profile to switch to.
+	 * @throw std::logic_error - in case changing buffer geometry is not supported by the backend or in
+	 *                           full-duplex and fan-out modes.
+	 */
+	void set_latency_profile(latency_profile profile);
+
+	/**
+	 * @brief Set buffer geometry.
+	 * The device is reconfigured as close to the requested geometry as it supports, the achieved geometry
+	 * can be queried with get_buffer_geometry(). Shrinking the buffer drops the samples buffered by the device,
+	 * so that the lower latency takes effect immediately.
+	 * Initial geometry is a single period of the size requested on construction.
+	 * Blocks until the audio thread switches to the new period size.
+	 * Can be called from any thread.
+	 * Supported by PulseAudio backend and simulated device.
+	 * @param geometry - buffer geometry to switch to.
+	 * @throw std::invalid_argument - in case the geometry is inconsistent, see audout::validate().
+	 * @throw std::logic_error - in case changing buffer geometry is not supported by the backend or in
+	 *                           full-duplex and fan-out modes.
+	 */
+	void set_buffer_geometry(const buffer_geometry& geometry);
+
+	/**
+	 * @brief Change output format and buffer size.
+	 * The audio thread keeps running and the connection to the device is reused, e.g. with PulseAudio
+	 * only a new stream is opened. The new stream starts as soon as the old one plays out all the frames
+	 * filled before the switch, so there is no gap or overlap of the two streams, except for the server's
+	 * reaction time.
+	 * Blocks until the old stream plays out, i.e. about the buffer length.
+	 * The buffer geometry is reset to a single period of the requested size.
+	 * The gain settings are kept. Drift compensation restarts from the beginning.
+	 * Must not be called concurrently with other player methods except gain setters.
+	 * Supported by PulseAudio backend and simulated device.
+	 * @param output_format - new output format.
+	 * @param num_buffer_frames - request for size of playing buffer.
+	 * @throw std::logic_error - in case reconfiguration is not supported by the backend or in
+	 *                           full-duplex and fan-out modes.
+	 * @throw std::invalid_argument - in case the mixing matrix or the convolver is set and the number
+	 *                                of its channels does not match the new output format.
+	 */
+	void reconfigure(format output_format, uint32_t num_buffer_frames);
+
+	/**
+	 * @brief Get buffer geometry achieved by the device.
+	 * In fan-out mode returns the geometry of the first device.
+	 * @return Buffer geometry.
+	 */
+	buffer_geometry get_buffer_geometry() const;
+
+	/**
+	 * @brief Get wakeup rate.
+	 * It is the number of times per second the audio thread wakes up to fill the buffer,
+	 * averaged over last couple of seconds.
+	 * @return Wakeup rate in Hz.
+	 * @return 0 if the player is paused or the rate is not measured yet.
+	 */
+	float get_wakeup_rate() const noexcept;
+
+	/**
+	 * @brief Set master gain.
+	 * Gain changes are applied smoothly, see set_gain_ramp().
+	 * In case all resulting channel gains are 1, the gain stage is skipped.
+	 * Can be called from any thread.
+	 * @param gain - gain factor, 1 means no change.
+	 */
+	void set_gain(float gain);
+
+	/**
+	 * @brief Set gain of a single channel.
+	 * Can be called from any thread.
+	 * @param channel - index of the channel.
+	 * @param gain - gain factor, 1 means no change.
+	 */
+	void set_channel_gain(unsigned channel, float gain);
+
+	/**
+	 * @brief Set stereo pan.
+	 * Has no effect for mono output.
+	 * Can be called from any thread.
+	 * @param pan - pan position from -1 (left) to 1 (right), 0 is center.
+	 */
+	void set_pan(float pan);
+
+	/**
+	 * @brief Set how gain changes are applied.
+	 * Can be called from any thread.
+	 * @param shape - shape of the gain change curve.
+	 * @param num_frames - duration of gain changes in frames. 0 means abrupt change.
+	 */
+	void set_gain_ramp(ramp_shape shape, uint32_t num_frames);
+
+	/**
+	 * @brief Enable or disable output level metering.
+	 * The levels are measured on the samples passed to the backend, i.e. after all processing stages.
+	 * Metering is disabled initially.
+	 * Can be called from any thread.
+	 * @param enable - whether to enable metering.
+	 */
+	void set_metering(bool enable);
+
+	/**
+	 * @brief Get output levels.
+	 * Lock-free, never blocks the audio thread. Can be called from any thread.
+	 * @return Levels of the last period measured while metering was enabled.
+	 */
+	meter::snapshot get_levels() const noexcept;
+
+	/**
+	 * @brief Attach spectrum analyser.
+	 * The samples passed to the backend, i.e. after all processing stages, are pushed to the analyser.
+	 * The analyser must be constructed with the player's sampling rate.
+	 * Can be called from any thread.
+	 * Once the call returns, the audio thread does not use the previously attached analyser anymore,
+	 * so it can be destroyed.
+	 * @param analyser - spectrum analyser. It must stay valid until it is detached or the player is destroyed.
+	 *                   nullptr detaches the analyser.
+	 */
+	void set_spectrum_analyser(spectrum_analyser* analyser);
+
+	/**
+	 * @brief Attach output recorder.
+	 * The samples passed to the backend, i.e. after all processing stages, are pushed to the recorder.
+	 * The recorder must be constructed with the player's format, in case the player is reconfigured
+	 * to another format, the frames are counted as dropped by the recorder.
+	 * Can be called from any thread.
+	 * Once the call returns, the audio thread does not use the previously attached recorder anymore,
+	 * so it can be destroyed.
+	 * @param recorder - output recorder. It must stay valid until it is detached or the player is destroyed.
+	 *                   nullptr detaches the recorder.
+	 * @throw std::invalid_argument - in case the recorder's format differs from the player's output format.
+	 */
+	void set_recorder(audout::recorder* recorder);
+
+	/**
+	 * @brief Set mixing of listener channels to output channels.
+	 * Allows the listener to fill only the channels it really has, e.g. mono sources played to a stereo
+	 * device. Once set, the listener is called with buffers of float samples of matrix.get_num_inputs()
+	 * channels, which are mixed to the output channels before the rest of the processing stages.
+	 * The change takes effect starting from the next period.
+	 * Can be called from any thread.
+	 * @param matrix - mixing matrix. Number of its outputs must be equal to the number of output channels.
+	 *                 It must stay valid while the player exists. nullptr disables mixing.
+	 * @throw std::invalid_argument - in case number of the matrix outputs does not match the output format.
+	 * @throw std::logic_error - in case the player is full-duplex.
+	 */
+	void set_mixing_matrix(const mixing_matrix* matrix);
+
+	/**
+	 * @brief Attach convolver.
+	 * Convolves the output channels with the convolver's impulse responses, e.g. for reverb or speaker
+	 * correction. The convolution is applied to the listener output, after mixing and drift compensation,
+	 * and before the gain. The output is delayed by the convolver's latency.
+	 * The convolver keeps the state of the stream, so it must not be attached to several players at once.
+	 * The change takes effect starting from the next period.
+	 * Can be called from any thread.
+	 * @param convolver - convolver. Number of its channels must be equal to the number of output channels.
+	 *                    It must stay valid while the player exists. nullptr detaches the convolver.
+	 * @throw std::invalid_argument - in case number of the convolver channels does not match the output format.
+	 */
+	void set_convolver(audout::convolver* convolver);
+
+	/**
+	 * @brief Enable or disable dithering of 16-bit output.
+	 * Once enabled, the listener output is processed by mixing, drift compensation, convolution and gain
+	 * stages in float samples and requantized to 16 bits only once, by audout::dither, instead of
+	 * plain rounding at each stage which produces float samples. The listener is called with float
+	 * samples then, see listener::fill(utki::span<float>).
+	 * Has no effect for other sample formats and in full-duplex mode.
+	 * Dithering is disabled initially.
+	 * The change takes effect starting from the next period.
+	 * Can be called from any thread.
+	 * @param enable - whether to enable dithering.
+	 * @param shaping - noise shaping to apply to the requantization noise.
+	 */
+	void set_dithering(bool enable, noise_shaping shaping = noise_shaping::none);
+
+	/**
+	 * @brief Synchronize playback to external reference clock.
+	 * The listener output is resampled with continuously adjusted ratio, so that it is consumed
+	 * at the nominal sampling rate as measured by the reference clock, regardless of the output
+	 * device's clock drift. The drift is absorbed smoothly, no frames are dropped or inserted.
+	 * The position error is measured relatively to the one established during the first second
+	 * after setting the clock or resuming from pause.
+	 * Can be called from any thread.
+	 * @param clock - reference clock. It must stay valid while the player exists.
+	 *                nullptr disables drift compensation.
+	 * @throw std::logic_error - in case the player is full-duplex.
+	 */
+	void set_reference_clock(reference_clock* clock);
+
+	/**
+	 * @brief Get current drift compensation ratio.
+	 * @return Number of listener frames consumed per output frame.
+	 * @return 1 in case drift compensation is disabled.
+	 */
+	double get_drift_ratio() const noexcept;
 };
 
 } // namespace audout
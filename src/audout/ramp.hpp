@@ -0,0 +1,101 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+namespace audout {
+
+/**
+ * @brief Per-sample parameter smoothing.
+ * Moves value towards target value over given number of frames, advancing one step per frame.
+ * Intended for interpolating parameters picked up by audout::parameter_block::update()
+ * to avoid zipper noise on abrupt changes.
+ */
+class ramp
+{
+	float value;
+	float target;
+	float step = 0;
+	unsigned frames_left = 0;
+
+public:
+	ramp(float value = 0) :
+		value(value),
+		target(value)
+	{}
+
+	/**
+	 * @brief Start ramping to a new target value.
+	 * @param target - value to arrive to.
+	 * @param num_frames - number of frames to arrive to the target value in.
+	 *                     If 0, then the target value is set immediately.
+	 */
+	void set_target(float target, unsigned num_frames) noexcept
+	{
+		this->target = target;
+		if (num_frames == 0) {
+			this->value = target;
+			this->frames_left = 0;
+			return;
+		}
+		this->step = (target - this->value) / float(num_frames);
+		this->frames_left = num_frames;
+	}
+
+	/**
+	 * @brief Advance one frame.
+	 * @return Value for the current frame.
+	 */
+	float next() noexcept
+	{
+		if (this->frames_left != 0) {
+			--this->frames_left;
+			if (this->frames_left == 0) {
+				this->value = this->target;
+			} else {
+				this->value += this->step;
+			}
+		}
+		return this->value;
+	}
+
+	float get() const noexcept
+	{
+		return this->value;
+	}
+
+	float get_target() const noexcept
+	{
+		return this->target;
+	}
+
+	bool is_ramping() const noexcept
+	{
+		return this->frames_left != 0;
+	}
+};
+
+} // namespace audout
@@ -0,0 +1,225 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "realtime.hpp"
+
+#include <cstdlib>
+#include <new>
+
+#include <utki/config.hpp>
+#include <utki/debug.hpp>
+
+#if defined(AUDOUT_ASSERT_NO_REALTIME_ALLOCATIONS) && CFG_OS == CFG_OS_WINDOWS
+#	include <malloc.h>
+#endif
+
+using namespace audout;
+
+namespace {
+thread_local unsigned realtime_depth = 0;
+} // namespace
+
+realtime_scope::realtime_scope() noexcept
+{
+	++realtime_depth;
+}
+
+realtime_scope::~realtime_scope() noexcept
+{
+	utki::assert(realtime_depth != 0, SL);
+	--realtime_depth;
+}
+
+bool realtime_scope::is_active() noexcept
+{
+	return realtime_depth != 0;
+}
+
+#ifdef AUDOUT_ASSERT_NO_REALTIME_ALLOCATIONS
+
+namespace {
+void check_not_realtime()
+{
+	if (realtime_depth != 0) {
+		// leave real-time section, so that assertion handling is free to allocate
+		realtime_depth = 0;
+		utki::assert(false, [](auto& o) {
+			o << "heap allocation within real-time section";
+		}, SL);
+	}
+}
+
+void* checked_alloc(std::size_t size)
+{
+	check_not_realtime();
+
+	if (size == 0) {
+		size = 1;
+	}
+
+	// NOLINTNEXTLINE(cppcoreguidelines-no-malloc, "implementing operator new")
+	void* p = std::malloc(size);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+// used for types with alignment greater than __STDCPP_DEFAULT_NEW_ALIGNMENT__, e.g. cache line aligned members
+void* checked_aligned_alloc(std::size_t size, std::align_val_t alignment)
+{
+	check_not_realtime();
+
+	if (size == 0) {
+		size = 1;
+	}
+
+#	if CFG_OS == CFG_OS_WINDOWS
+	void* p = _aligned_malloc(size, std::size_t(alignment));
+#	else
+	void* p = nullptr;
+	if (posix_memalign(&p, std::size_t(alignment), size) != 0) {
+		p = nullptr;
+	}
+#	endif
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void aligned_free(void* p) noexcept
+{
+#	if CFG_OS == CFG_OS_WINDOWS
+	_aligned_free(p);
+#	else
+	// NOLINTNEXTLINE(cppcoreguidelines-no-malloc, "implementing operator delete")
+	std::free(p);
+#	endif
+}
+} // namespace
+
+void* operator new(std::size_t size)
+{
+	return checked_alloc(size);
+}
+
+void* operator new[](std::size_t size)
+{
+	return checked_alloc(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	try {
+		return checked_alloc(size);
+	} catch (std::bad_alloc&) {
+		return nullptr;
+	}
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	try {
+		return checked_alloc(size);
+	} catch (std::bad_alloc&) {
+		return nullptr;
+	}
+}
+
+void operator delete(void* p) noexcept
+{
+	// NOLINTNEXTLINE(cppcoreguidelines-no-malloc, "implementing operator delete")
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	// NOLINTNEXTLINE(cppcoreguidelines-no-malloc, "implementing operator delete")
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	// NOLINTNEXTLINE(cppcoreguidelines-no-malloc, "implementing operator delete")
+	std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	// NOLINTNEXTLINE(cppcoreguidelines-no-malloc, "implementing operator delete")
+	std::free(p);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	return checked_aligned_alloc(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return checked_aligned_alloc(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	try {
+		return checked_aligned_alloc(size, alignment);
+	} catch (std::bad_alloc&) {
+		return nullptr;
+	}
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	try {
+		return checked_aligned_alloc(size, alignment);
+	} catch (std::bad_alloc&) {
+		return nullptr;
+	}
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+	aligned_free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+	aligned_free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+	aligned_free(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+	aligned_free(p);
+}
+
+#endif
@@ -0,0 +1,63 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+namespace audout {
+
+/**
+ * @brief Real-time section marker.
+ * Marks the current thread as executing real-time code for the lifetime of the object.
+ * Real-time sections can be nested.
+ *
+ * When the library is built with AUDOUT_ASSERT_NO_REALTIME_ALLOCATIONS macro defined
+ * (see config/rtcheck.mk), the library replaces global operator new and any heap allocation
+ * made through it within a real-time section triggers assertion failure.
+ * Otherwise the marker has no effect apart from is_active() reporting.
+ *
+ * The audio backends enter real-time section each time they call audout::listener::fill().
+ */
+class realtime_scope
+{
+public:
+	realtime_scope() noexcept;
+
+	realtime_scope(const realtime_scope&) = delete;
+	realtime_scope& operator=(const realtime_scope&) = delete;
+
+	realtime_scope(realtime_scope&&) = delete;
+	realtime_scope& operator=(realtime_scope&&) = delete;
+
+	~realtime_scope() noexcept;
+
+	/**
+	 * @brief Check if current thread is within real-time section.
+	 * @return true if current thread is within real-time section.
+	 */
+	static bool is_active() noexcept;
+};
+
+} // namespace audout
@@ -0,0 +1,292 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "recorder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <limits>
+#include <system_error>
+
+#include <utki/debug.hpp>
+
+using namespace audout;
+
+namespace {
+// the writer thread wakes up this often, so that it writes in large chunks
+constexpr auto write_interval = std::chrono::milliseconds(100);
+
+constexpr size_t max_write_size = 256 * 1024;
+
+// sizes of fmt chunk contents: WAVEFORMAT with bits per sample, WAVEFORMATEX and WAVEFORMATEXTENSIBLE
+constexpr uint32_t wav_fmt_pcm_size = 16;
+constexpr uint32_t wav_fmt_ex_size = 18;
+constexpr uint32_t wav_fmt_extensible_size = 40;
+
+// bytes of the KSDATAFORMAT_SUBTYPE_* GUIDs following the format tag
+constexpr std::array<uint8_t, 12> subformat_guid_tail =
+	{0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71};
+
+uint32_t get_channel_mask(frame frame_type)
+{
+	constexpr uint32_t speaker_front_left = 0x1;
+	constexpr uint32_t speaker_front_right = 0x2;
+	constexpr uint32_t speaker_front_center = 0x4;
+	constexpr uint32_t speaker_low_frequency = 0x8;
+	constexpr uint32_t speaker_back_left = 0x10;
+	constexpr uint32_t speaker_back_right = 0x20;
+
+	switch (frame_type) {
+		case frame::mono:
+			return speaker_front_center;
+		case frame::stereo:
+			return speaker_front_left | speaker_front_right;
+		case frame::surround_5_1:
+			return speaker_front_left | speaker_front_right | speaker_front_center | speaker_low_frequency |
+				speaker_back_left | speaker_back_right;
+	}
+	return 0;
+}
+
+template <typename value_type>
+void write_le(std::vector<uint8_t>& buf, value_type value)
+{
+	for (size_t i = 0; i != sizeof(value_type); ++i) {
+		buf.push_back(uint8_t(value >> (i * 8)));
+	}
+}
+
+void write_tag(std::vector<uint8_t>& buf, const char* tag)
+{
+	buf.insert(buf.end(), tag, std::next(tag, 4));
+}
+
+uint32_t clamp_to_uint32(uint64_t value)
+{
+	return uint32_t(std::min(value, uint64_t(std::numeric_limits<uint32_t>::max())));
+}
+} // namespace
+
+recorder::recorder(
+	const std::string& file_name,
+	audout::format format,
+	container container_type,
+	size_t ring_capacity_frames
+) :
+	format(format),
+	container_type(container_type),
+	file(file_name, std::ios::binary | std::ios::trunc),
+	ring(
+		(ring_capacity_frames == 0 ? size_t(format.frequency()) * default_ring_duration_seconds
+								   : ring_capacity_frames) *
+		format.frame_size()
+	),
+	write_buffer(std::min(this->ring.capacity(), max_write_size) / format.frame_size() * format.frame_size())
+{
+	if (!this->file) {
+		throw std::system_error(errno, std::generic_category(), "recorder::recorder(): could not open file");
+	}
+
+	if (this->container_type == container::wav) {
+		// sizes are not known yet, they are updated when recording stops
+		this->write_wav_header(0);
+		if (!this->file) {
+			throw std::system_error(errno, std::generic_category(), "recorder::recorder(): could not write file");
+		}
+	}
+
+	this->thread = std::thread([this]() {
+		this->run();
+	});
+}
+
+recorder::~recorder()
+{
+	{
+		std::lock_guard lock(this->thread_mutex);
+		this->quit = true;
+	}
+	this->thread_cv.notify_all();
+	this->thread.join();
+
+	if (this->container_type == container::wav && !this->write_failed) {
+		this->file.seekp(0);
+		this->write_wav_header(this->num_written_frames.load(std::memory_order_relaxed));
+	}
+}
+
+void recorder::write_wav_header(uint64_t num_frames)
+{
+	auto data_size = num_frames * this->format.frame_size();
+
+	constexpr uint16_t wave_format_pcm = 1;
+	constexpr uint16_t wave_format_ieee_float = 3;
+	constexpr uint16_t wave_format_extensible = 0xfffe;
+
+	bool is_float = this->format.sample_type == sample_format::float32;
+	uint16_t format_tag = is_float ? wave_format_ieee_float : wave_format_pcm;
+	auto bits_per_sample = uint16_t(this->format.sample_size() * 8);
+
+	// Without WAVE_FORMAT_EXTENSIBLE readers have to guess the channel layout of more than 2 channels
+	// and the container size of integer samples of more than 16 bits.
+	bool is_extensible = this->format.num_channels() > 2 || (!is_float && bits_per_sample > 16);
+
+	std::vector<uint8_t> buf;
+
+	write_tag(buf, "RIFF");
+	write_le(buf, uint32_t(0)); // set below, when the header size is known
+	write_tag(buf, "WAVE");
+
+	write_tag(buf, "fmt ");
+	write_le(buf, uint32_t(is_extensible ? wav_fmt_extensible_size : is_float ? wav_fmt_ex_size : wav_fmt_pcm_size));
+	write_le(buf, is_extensible ? wave_format_extensible : format_tag);
+	write_le(buf, uint16_t(this->format.num_channels()));
+	write_le(buf, uint32_t(this->format.frequency()));
+	write_le(buf, uint32_t(this->format.frequency() * this->format.frame_size()));
+	write_le(buf, uint16_t(this->format.frame_size()));
+	write_le(buf, bits_per_sample);
+
+	if (is_extensible) {
+		write_le(buf, uint16_t(wav_fmt_extensible_size - wav_fmt_ex_size));
+		write_le(buf, bits_per_sample); // valid bits per sample
+		write_le(buf, get_channel_mask(this->format.frame_type));
+
+		// KSDATAFORMAT_SUBTYPE_PCM or KSDATAFORMAT_SUBTYPE_IEEE_FLOAT, the GUIDs differ only in the first field
+		write_le(buf, uint32_t(format_tag));
+		buf.insert(buf.end(), subformat_guid_tail.begin(), subformat_guid_tail.end());
+	} else if (is_float) {
+		write_le(buf, uint16_t(0)); // size of the format extension
+	}
+
+	if (is_float) {
+		// non-PCM formats require the number of frames in a fact chunk
+		write_tag(buf, "fact");
+		write_le(buf, uint32_t(sizeof(uint32_t)));
+		write_le(buf, clamp_to_uint32(num_frames));
+	}
+
+	write_tag(buf, "data");
+	write_le(buf, clamp_to_uint32(data_size));
+
+	auto riff_size = clamp_to_uint32(data_size + buf.size() - 8);
+	for (size_t i = 0; i != sizeof(riff_size); ++i) {
+		buf[4 + i] = uint8_t(riff_size >> (i * 8));
+	}
+
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "writing raw bytes")
+	this->file.write(reinterpret_cast<const char*>(buf.data()), std::streamsize(buf.size()));
+}
+
+template <typename sample_type>
+void recorder::push_samples(utki::span<const sample_type> buf, unsigned num_channels) noexcept
+{
+	auto num_frames = buf.size() / num_channels;
+
+	if (sample_format_of<sample_type>() != this->format.sample_type || num_channels != this->format.num_channels())
+	{
+		this->num_dropped_frames.fetch_add(num_frames, std::memory_order_relaxed);
+		return;
+	}
+
+	// write only whole frames, so that the byte stream stays frame aligned
+	auto frame_size = this->format.frame_size();
+	auto num_free_frames = (this->ring.capacity() - this->ring.size()) / frame_size;
+	auto n = std::min(num_frames, num_free_frames);
+
+	this->ring.write(utki::make_span(
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "samples are recorded as raw bytes")
+		reinterpret_cast<const uint8_t*>(buf.data()),
+		n * frame_size
+	));
+
+	if (n != num_frames) {
+		this->num_dropped_frames.fetch_add(num_frames - n, std::memory_order_relaxed);
+	}
+}
+
+void recorder::push(utki::span<const int16_t> buf, unsigned num_channels) noexcept
+{
+	this->push_samples(buf, num_channels);
+}
+
+void recorder::push(utki::span<const int24> buf, unsigned num_channels) noexcept
+{
+	this->push_samples(buf, num_channels);
+}
+
+void recorder::push(utki::span<const int32_t> buf, unsigned num_channels) noexcept
+{
+	this->push_samples(buf, num_channels);
+}
+
+void recorder::push(utki::span<const float> buf, unsigned num_channels) noexcept
+{
+	this->push_samples(buf, num_channels);
+}
+
+void recorder::run()
+{
+	std::unique_lock lock(this->thread_mutex);
+	while (!this->quit) {
+		lock.unlock();
+		this->drain();
+		lock.lock();
+
+		this->thread_cv.wait_for(lock, write_interval, [this]() {
+			return this->quit;
+		});
+	}
+	lock.unlock();
+
+	// write what has been pushed before stopping
+	this->drain();
+}
+
+void recorder::drain()
+{
+	// the producer writes and the write buffer holds only whole frames, so only whole frames are read
+	for (;;) {
+		auto n = this->ring.read(utki::make_span(this->write_buffer));
+		if (n == 0) {
+			break;
+		}
+
+		if (!this->write_failed) {
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "writing raw bytes")
+			this->file.write(reinterpret_cast<const char*>(this->write_buffer.data()), std::streamsize(n));
+			this->write_failed = !this->file;
+		}
+
+		auto num_frames = n / this->format.frame_size();
+		if (this->write_failed) {
+			this->num_dropped_frames.fetch_add(num_frames, std::memory_order_relaxed);
+		} else {
+			this->num_written_frames.fetch_add(num_frames, std::memory_order_relaxed);
+		}
+	}
+}
@@ -0,0 +1,184 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <utki/span.hpp>
+
+#include "format.hpp"
+#include "ring_buffer.hpp"
+
+namespace audout {
+
+/**
+ * @brief Output recorder.
+ * Records the samples passed to it to a file, intended for capturing exactly what was sent to the device.
+ * The audio thread only copies the samples to a preallocated lock-free ring buffer. A separate writer
+ * thread drains the ring buffer to the file in large sequential writes. In case the writer thread falls
+ * behind, the frames which do not fit into the ring buffer are dropped and counted, the audio thread
+ * never blocks.
+ *
+ * Samples are written in the byte order they are passed in, which is native. The WAV header
+ * is finalized when the recorder is destroyed. Files of more than 2 channels or of integer samples
+ * wider than 16 bits are written in WAVE_FORMAT_EXTENSIBLE format with the channel mask of the frame type.
+ *
+ * Typical usage:
+ * @code
+ * audout::recorder rec("capture.wav", player_format);
+ * player.set_recorder(&rec);
+ * @endcode
+ */
+class recorder
+{
+public:
+	enum class container {
+		/**
+		 * @brief RIFF WAVE file.
+		 */
+		wav,
+
+		/**
+		 * @brief Raw interleaved samples without any header.
+		 */
+		raw
+	};
+
+private:
+	const audout::format format;
+	const container container_type;
+
+	std::ofstream file;
+
+	// written by audio thread, read by writer thread
+	ring_buffer<uint8_t> ring;
+
+	std::atomic<uint64_t> num_dropped_frames = 0;
+	std::atomic<uint64_t> num_written_frames = 0;
+
+	// writer thread state
+	std::vector<uint8_t> write_buffer;
+	bool write_failed = false;
+
+	std::mutex thread_mutex;
+	std::condition_variable thread_cv;
+	bool quit = false;
+	std::thread thread;
+
+	template <typename sample_type>
+	void push_samples(utki::span<const sample_type> buf, unsigned num_channels) noexcept;
+
+	void run();
+	void drain();
+	void write_wav_header(uint64_t num_frames);
+
+public:
+	/**
+	 * @brief Default duration of the ring buffer in seconds.
+	 */
+	constexpr static uint32_t default_ring_duration_seconds = 2;
+
+	/**
+	 * @brief Create recorder.
+	 * Opens the file and starts the writer thread.
+	 * @param file_name - name of the file to record to. Existing file is overwritten.
+	 * @param format - format of the samples to record. Buffers in other format are dropped.
+	 * @param container_type - type of the file to write.
+	 * @param ring_capacity_frames - capacity of the ring buffer in frames,
+	 *                               0 means default_ring_duration_seconds of audio.
+	 * @throw std::system_error - in case the file could not be opened.
+	 */
+	recorder(
+		const std::string& file_name,
+		audout::format format,
+		container container_type = container::wav,
+		size_t ring_capacity_frames = 0
+	);
+
+	recorder(const recorder&) = delete;
+	recorder& operator=(const recorder&) = delete;
+
+	recorder(recorder&&) = delete;
+	recorder& operator=(recorder&&) = delete;
+
+	/**
+	 * @brief Stop recording.
+	 * Writes the frames remaining in the ring buffer, finalizes the file header and closes the file.
+	 */
+	~recorder();
+
+	/**
+	 * @brief Push samples for recording.
+	 * Wait-free, does not allocate. Must only be called from a single thread.
+	 * @param buf - interleaved samples.
+	 * @param num_channels - number of channels in the buffer.
+	 */
+	void push(utki::span<const int16_t> buf, unsigned num_channels) noexcept;
+	void push(utki::span<const int24> buf, unsigned num_channels) noexcept;
+	void push(utki::span<const int32_t> buf, unsigned num_channels) noexcept;
+	void push(utki::span<const float> buf, unsigned num_channels) noexcept;
+
+	/**
+	 * @brief Get number of lost frames.
+	 * Frames are lost in case the ring buffer is full, the pushed buffer's format differs from the
+	 * recorder's one or writing to the file has failed.
+	 * Can be called from any thread.
+	 * @return Number of frames lost since the recorder creation.
+	 */
+	uint64_t get_num_dropped_frames() const noexcept
+	{
+		return this->num_dropped_frames.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Get format of the recorded samples.
+	 * @return Format the recorder was created with.
+	 */
+	const audout::format& get_format() const noexcept
+	{
+		return this->format;
+	}
+
+	/**
+	 * @brief Get number of frames written to the file.
+	 * Can be called from any thread.
+	 * @return Number of frames written since the recorder creation.
+	 */
+	uint64_t get_num_written_frames() const noexcept
+	{
+		return this->num_written_frames.load(std::memory_order_relaxed);
+	}
+};
+
+} // namespace audout
@@ -0,0 +1,164 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+#include <utki/span.hpp>
+
+namespace audout {
+
+/**
+ * @brief Fixed capacity lock-free single-producer single-consumer ring buffer.
+ * Intended for passing samples between two real-time threads.
+ * All memory is allocated at construction time, reading and writing never allocate
+ * and never block.
+ * @tparam element_type - type of the element. Must be trivially copyable.
+ */
+template <typename element_type>
+class ring_buffer
+{
+	static_assert(std::is_trivially_copyable_v<element_type>, "element_type must be trivially copyable");
+
+	constexpr static size_t cache_line_size = 64;
+
+	const size_t mask;
+	std::unique_ptr<element_type[]> elements;
+
+	// positions grow monotonically, wrapping around is handled by unsigned arithmetic
+
+	// written only by producer thread
+	alignas(cache_line_size) std::atomic<size_t> write_pos{0};
+
+	// written only by consumer thread
+	alignas(cache_line_size) std::atomic<size_t> read_pos{0};
+
+	static size_t round_up_to_power_of_2(size_t n)
+	{
+		if (n == 0) {
+			throw std::invalid_argument("ring_buffer::ring_buffer(): capacity is 0");
+		}
+		size_t ret = 1;
+		while (ret < n) {
+			ret <<= 1;
+		}
+		return ret;
+	}
+
+	// copy elements between linear buffer and ring buffer starting at given position,
+	// with wrapping around the end of the ring
+	template <typename copy_type>
+	void for_each_part(size_t pos, size_t n, copy_type copy) const noexcept
+	{
+		size_t begin = pos & this->mask;
+		size_t first = std::min(n, this->capacity() - begin);
+		copy(begin, 0, first);
+		copy(0, first, n - first);
+	}
+
+public:
+	/**
+	 * @brief Create ring buffer.
+	 * @param capacity - maximum number of elements the buffer can hold. Rounded up to the nearest power of 2.
+	 */
+	ring_buffer(size_t capacity) :
+		mask(round_up_to_power_of_2(capacity) - 1),
+		elements(std::make_unique<element_type[]>(this->mask + 1))
+	{}
+
+	ring_buffer(const ring_buffer&) = delete;
+	ring_buffer& operator=(const ring_buffer&) = delete;
+
+	ring_buffer(ring_buffer&&) = delete;
+	ring_buffer& operator=(ring_buffer&&) = delete;
+
+	~ring_buffer() = default;
+
+	size_t capacity() const noexcept
+	{
+		return this->mask + 1;
+	}
+
+	/**
+	 * @brief Get number of elements available for reading.
+	 * Can be called from any thread, the value may be outdated by the time it is returned.
+	 * @return Number of elements in the buffer.
+	 */
+	size_t size() const noexcept
+	{
+		return this->write_pos.load(std::memory_order_acquire) - this->read_pos.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * @brief Write elements.
+	 * Must only be called from the single producer thread.
+	 * @param buf - elements to write.
+	 * @return Number of elements written, less than buffer size in case the ring buffer got full.
+	 */
+	size_t write(utki::span<const element_type> buf) noexcept
+	{
+		size_t wp = this->write_pos.load(std::memory_order_relaxed);
+		size_t rp = this->read_pos.load(std::memory_order_acquire);
+
+		size_t n = std::min(buf.size(), this->capacity() - (wp - rp));
+
+		this->for_each_part(wp, n, [&](size_t ring_index, size_t buf_index, size_t count) {
+			std::copy_n(std::next(buf.begin(), ptrdiff_t(buf_index)), count, &this->elements[ring_index]);
+		});
+
+		this->write_pos.store(wp + n, std::memory_order_release);
+		return n;
+	}
+
+	/**
+	 * @brief Read elements.
+	 * Must only be called from the single consumer thread.
+	 * @param buf - buffer to read elements to.
+	 * @return Number of elements read, less than buffer size in case the ring buffer got empty.
+	 */
+	size_t read(utki::span<element_type> buf) noexcept
+	{
+		size_t rp = this->read_pos.load(std::memory_order_relaxed);
+		size_t wp = this->write_pos.load(std::memory_order_acquire);
+
+		size_t n = std::min(buf.size(), wp - rp);
+
+		this->for_each_part(rp, n, [&](size_t ring_index, size_t buf_index, size_t count) {
+			std::copy_n(&this->elements[ring_index], count, std::next(buf.begin(), ptrdiff_t(buf_index)));
+		});
+
+		this->read_pos.store(rp + n, std::memory_order_release);
+		return n;
+	}
+};
+
+} // namespace audout
@@ -0,0 +1,524 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "shared_memory_source.hpp"
+
+#if CFG_OS == CFG_OS_LINUX
+
+#	include <algorithm>
+#	include <array>
+#	include <cerrno>
+#	include <cstring>
+#	include <ctime>
+#	include <new>
+#	include <stdexcept>
+#	include <system_error>
+#	include <thread>
+
+#	include <fcntl.h>
+#	include <linux/futex.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+
+#	include <utki/debug.hpp>
+#	include <utki/util.hpp>
+
+namespace audout {
+
+// plain part of the header, written once by the source before the descriptor is passed to the producer
+struct shared_ring_layout {
+	std::array<char, 8> magic;
+	uint32_t version;
+	uint32_t frame_type;
+	uint32_t sampling_rate;
+	uint32_t sample_type;
+
+	// power of 2
+	uint32_t capacity_frames;
+
+	uint32_t producer_timeout_ms;
+};
+
+struct shared_ring_header {
+	constexpr static size_t cache_line_size = 64;
+
+	shared_ring_layout layout;
+
+	// positions in frames grow monotonically, written only by producer and only by source respectively
+	alignas(cache_line_size) std::atomic<uint64_t> write_pos;
+	alignas(cache_line_size) std::atomic<uint64_t> read_pos;
+
+	// futex word incremented by the source after each read, the producer sleeps on it when the ring is full
+	std::atomic<uint32_t> read_seq;
+
+	// set by the producer while it sleeps, so that the source makes the wake up system call only when needed
+	std::atomic<uint32_t> writer_waiting;
+
+	// identifier of the attached producer, 0 if none
+	alignas(cache_line_size) std::atomic<uint64_t> writer_id;
+
+	// number of attaches, each attaching producer takes the next value as its identifier
+	std::atomic<uint64_t> num_attaches;
+
+	// incremented by the producer on each commit and wait for space, stands still in case the producer is dead
+	std::atomic<uint32_t> heartbeat;
+};
+
+} // namespace audout
+
+using namespace audout;
+
+namespace {
+constexpr std::array<char, 8> magic = {'A', 'U', 'D', 'O', 'U', 'T', 'S', 'M'};
+constexpr uint32_t version = 3;
+
+// the atomics are accessed from two processes, so they must not use locks
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "64-bit atomics must be lock-free");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "32-bit atomics must be lock-free");
+static_assert(sizeof(pid_t) == sizeof(int32_t), "process id must fit into 32 bits");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be 32-bit");
+
+constexpr size_t data_offset = (sizeof(shared_ring_header) + shared_ring_header::cache_line_size - 1) /
+	shared_ring_header::cache_line_size * shared_ring_header::cache_line_size;
+
+// capacity is limited, so that the size of the memory fits into the layout
+constexpr uint32_t max_capacity_frames = uint32_t(1) << 24;
+
+constexpr std::chrono::milliseconds max_producer_timeout = std::chrono::minutes(1);
+
+uint32_t round_up_to_power_of_2(uint32_t n)
+{
+	if (n == 0) {
+		throw std::invalid_argument("shared_memory_source::shared_memory_source(): capacity is 0");
+	}
+	if (n > max_capacity_frames) {
+		throw std::invalid_argument("shared_memory_source::shared_memory_source(): capacity is too big");
+	}
+	uint32_t ret = 1;
+	while (ret < n) {
+		ret <<= 1;
+	}
+	return ret;
+}
+
+std::chrono::milliseconds check_producer_timeout(std::chrono::milliseconds timeout)
+{
+	if (timeout <= std::chrono::milliseconds::zero() || timeout > max_producer_timeout) {
+		throw std::invalid_argument("shared_memory_source::shared_memory_source(): producer timeout is out of range");
+	}
+	return timeout;
+}
+
+size_t get_memory_size(const format& f, uint64_t capacity_frames)
+{
+	return data_offset + size_t(capacity_frames) * f.frame_size();
+}
+
+shared_ring_header* map_memory(int fd, size_t size)
+{
+	void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED) {
+		throw std::system_error(errno, std::generic_category(), "mmap() failed");
+	}
+	return static_cast<shared_ring_header*>(p);
+}
+
+uint8_t* get_data(shared_ring_header* header)
+{
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "ring buffer data follows the header")
+	return std::next(reinterpret_cast<uint8_t*>(header), ptrdiff_t(data_offset));
+}
+
+long futex(std::atomic<uint32_t>& word, int op, uint32_t value, const timespec* timeout) noexcept
+{
+	// the futex is in shared memory, so the process-private futex operations are not used
+	return syscall(
+		SYS_futex,
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "futex operates on the atomic's value")
+		reinterpret_cast<uint32_t*>(&word),
+		op,
+		value,
+		timeout,
+		nullptr,
+		0
+	);
+}
+
+// the layout is written by the source, but is verified since the producer may be run by an untrusted party
+// which passes an arbitrary descriptor
+format to_format(const shared_ring_layout& layout)
+{
+	if (layout.magic != magic) {
+		throw std::invalid_argument("shared_memory_writer::shared_memory_writer(): not a shared memory source");
+	}
+	if (layout.version != version) {
+		throw std::invalid_argument("shared_memory_writer::shared_memory_writer(): unsupported version");
+	}
+
+	switch (frame(layout.frame_type)) {
+		case frame::mono:
+		case frame::stereo:
+		case frame::surround_5_1:
+			break;
+		default:
+			throw std::invalid_argument("shared_memory_writer::shared_memory_writer(): invalid frame type");
+	}
+
+	switch (rate(layout.sampling_rate)) {
+		case rate::hz_11025:
+		case rate::hz_22050:
+		case rate::hz_44100:
+		case rate::hz_48000:
+			break;
+		default:
+			throw std::invalid_argument("shared_memory_writer::shared_memory_writer(): invalid sampling rate");
+	}
+
+	if (layout.sample_type > uint32_t(sample_format::float32)) {
+		throw std::invalid_argument("shared_memory_writer::shared_memory_writer(): invalid sample format");
+	}
+
+	return {frame(layout.frame_type), rate(layout.sampling_rate), sample_format(layout.sample_type)};
+}
+
+shared_ring_layout read_layout(int fd)
+{
+	shared_ring_layout layout{};
+
+	auto res = pread(fd, &layout, sizeof(layout), 0);
+	if (res < 0) {
+		throw std::system_error(errno, std::generic_category(), "pread() failed");
+	}
+	if (size_t(res) != sizeof(layout)) {
+		throw std::invalid_argument("shared_memory_writer::shared_memory_writer(): memory is too small");
+	}
+
+	auto f = to_format(layout);
+
+	auto capacity = layout.capacity_frames;
+	if (capacity == 0 || capacity > max_capacity_frames || (capacity & (capacity - 1)) != 0) {
+		throw std::invalid_argument("shared_memory_writer::shared_memory_writer(): invalid capacity");
+	}
+
+	if (layout.producer_timeout_ms == 0 || layout.producer_timeout_ms > max_producer_timeout.count()) {
+		throw std::invalid_argument("shared_memory_writer::shared_memory_writer(): invalid producer timeout");
+	}
+
+	struct stat st {};
+	if (fstat(fd, &st) != 0) {
+		throw std::system_error(errno, std::generic_category(), "fstat() failed");
+	}
+	if (size_t(st.st_size) < get_memory_size(f, capacity)) {
+		throw std::invalid_argument("shared_memory_writer::shared_memory_writer(): memory is too small");
+	}
+
+	return layout;
+}
+} // namespace
+
+shared_memory_source::shared_memory_source(
+	audout::format format, //
+	uint32_t capacity_frames,
+	std::chrono::milliseconds producer_timeout
+) :
+	format(format),
+	capacity_frames(round_up_to_power_of_2(capacity_frames)),
+	producer_timeout(check_producer_timeout(producer_timeout)),
+	fd(memfd_create("audout_shared_memory_source", MFD_CLOEXEC | MFD_ALLOW_SEALING)),
+	size(get_memory_size(format, this->capacity_frames))
+{
+	if (this->fd < 0) {
+		throw std::system_error(errno, std::generic_category(), "memfd_create() failed");
+	}
+
+	utki::scope_exit fd_scope_exit([this]() {
+		close(this->fd);
+	});
+
+	if (ftruncate(this->fd, off_t(this->size)) != 0) {
+		throw std::system_error(errno, std::generic_category(), "ftruncate() failed");
+	}
+
+	// the producer must not be able to shrink the memory, which would make the source's reads fault
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, "fcntl() is a vararg function")
+	if (fcntl(this->fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+		throw std::system_error(errno, std::generic_category(), "fcntl(F_ADD_SEALS) failed");
+	}
+
+	// the memory file is zero-filled, so the atomics start from zero
+	this->header = new (map_memory(this->fd, this->size)) shared_ring_header();
+	this->data = get_data(this->header);
+
+	auto& layout = this->header->layout;
+	layout.magic = magic;
+	layout.version = version;
+	layout.frame_type = uint32_t(format.frame_type);
+	layout.sampling_rate = uint32_t(format.sampling_rate);
+	layout.sample_type = uint32_t(format.sample_type);
+	layout.capacity_frames = uint32_t(this->capacity_frames);
+	layout.producer_timeout_ms = uint32_t(this->producer_timeout.count());
+
+	fd_scope_exit.release();
+}
+
+shared_memory_source::~shared_memory_source()
+{
+	munmap(this->header, this->size);
+	close(this->fd);
+}
+
+bool shared_memory_source::is_producer_alive(uint64_t writer_id) const noexcept
+{
+	auto heartbeat = this->header->heartbeat.load(std::memory_order_relaxed);
+	auto now = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(this->heartbeat_mutex);
+
+	if (writer_id != this->observed_writer_id || heartbeat != this->observed_heartbeat) {
+		this->observed_writer_id = writer_id;
+		this->observed_heartbeat = heartbeat;
+		this->observed_time = now;
+		return true;
+	}
+
+	return now - this->observed_time < this->producer_timeout;
+}
+
+auto shared_memory_source::get_producer_state() const noexcept -> producer_state
+{
+	auto writer_id = this->header->writer_id.load(std::memory_order_acquire);
+	if (writer_id == 0) {
+		return producer_state::detached;
+	}
+	if (!this->is_producer_alive(writer_id)) {
+		return producer_state::dead;
+	}
+	return this->starving.load(std::memory_order_relaxed) ? producer_state::stalled : producer_state::active;
+}
+
+void shared_memory_source::fill(utki::span<int16_t> play_buffer) noexcept
+{
+	this->fill_samples(play_buffer);
+}
+
+void shared_memory_source::fill(utki::span<int24> play_buffer) noexcept
+{
+	this->fill_samples(play_buffer);
+}
+
+void shared_memory_source::fill(utki::span<int32_t> play_buffer) noexcept
+{
+	this->fill_samples(play_buffer);
+}
+
+void shared_memory_source::fill(utki::span<float> play_buffer) noexcept
+{
+	this->fill_samples(play_buffer);
+}
+
+template <typename sample_type>
+void shared_memory_source::fill_samples(utki::span<sample_type> play_buffer) noexcept
+{
+	auto num_channels = this->format.num_channels();
+	auto num_frames = play_buffer.size() / num_channels;
+
+	uint64_t n = 0;
+
+	if (sample_format_of<sample_type>() == this->format.sample_type) {
+		auto write_pos = this->header->write_pos.load(std::memory_order_acquire);
+
+		// in case the producer has corrupted its position, skip to it
+		auto available = write_pos - this->read_pos;
+		if (available > this->capacity_frames) {
+			this->read_pos = write_pos;
+			available = 0;
+		}
+
+		n = std::min(available, uint64_t(num_frames));
+
+		auto frame_size = this->format.frame_size();
+		auto begin = this->read_pos & (this->capacity_frames - 1);
+		auto first = std::min(n, this->capacity_frames - begin);
+
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "samples are copied as bytes")
+		auto dst = reinterpret_cast<uint8_t*>(play_buffer.data());
+		std::memcpy(dst, std::next(this->data, ptrdiff_t(begin * frame_size)), size_t(first * frame_size));
+		std::memcpy(std::next(dst, ptrdiff_t(first * frame_size)), this->data, size_t((n - first) * frame_size));
+
+		this->read_pos += n;
+		this->header->read_pos.store(this->read_pos, std::memory_order_release);
+
+		this->header->read_seq.fetch_add(1, std::memory_order_seq_cst);
+		if (this->header->writer_waiting.load(std::memory_order_seq_cst) != 0) {
+			futex(this->header->read_seq, FUTEX_WAKE, 1, nullptr);
+		}
+	}
+
+	std::fill(std::next(play_buffer.begin(), ptrdiff_t(n * num_channels)), play_buffer.end(), sample_type(0));
+
+	this->starving.store(n != num_frames, std::memory_order_relaxed);
+	if (n != num_frames) {
+		this->num_underrun_frames.fetch_add(num_frames - n, std::memory_order_relaxed);
+	}
+}
+
+shared_memory_writer::shared_memory_writer(int fd) :
+	shared_memory_writer(fd, read_layout(fd))
+{}
+
+shared_memory_writer::shared_memory_writer(int fd, const shared_ring_layout& layout) :
+	format(to_format(layout)),
+	capacity_frames(layout.capacity_frames),
+	producer_timeout(layout.producer_timeout_ms),
+	size(get_memory_size(this->format, this->capacity_frames)),
+	header(map_memory(fd, this->size)),
+	data(get_data(this->header)),
+	pid(getpid())
+{
+	utki::scope_exit memory_scope_exit([this]() {
+		munmap(this->header, this->size);
+	});
+
+	auto owner = this->header->writer_id.load(std::memory_order_acquire);
+	if (owner != 0) {
+		// take over the ring buffer only from a producer whose heartbeat stands still for the timeout
+		constexpr auto num_checks = 16;
+		auto heartbeat = this->header->heartbeat.load(std::memory_order_relaxed);
+		auto deadline = std::chrono::steady_clock::now() + this->producer_timeout;
+		while (std::chrono::steady_clock::now() < deadline) {
+			std::this_thread::sleep_for(this->producer_timeout / num_checks);
+
+			auto id = this->header->writer_id.load(std::memory_order_acquire);
+			if (id == 0) {
+				// the producer has detached
+				owner = 0;
+				break;
+			}
+			if (id != owner || this->header->heartbeat.load(std::memory_order_relaxed) != heartbeat) {
+				throw std::logic_error("shared_memory_writer::shared_memory_writer(): another producer is attached");
+			}
+		}
+	}
+
+	this->id = this->header->num_attaches.fetch_add(1, std::memory_order_relaxed) + 1;
+	while (!this->header->writer_id.compare_exchange_strong(owner, this->id, std::memory_order_acq_rel)) {
+		// in case the dead producer's identifier was replaced with 0, it has detached in the meantime
+		if (owner != 0) {
+			throw std::logic_error("shared_memory_writer::shared_memory_writer(): another producer is attached");
+		}
+	}
+	this->beat();
+
+	memory_scope_exit.release();
+}
+
+shared_memory_writer::~shared_memory_writer()
+{
+	// only the attaching process detaches, and only in case the writer was not taken over
+	if (getpid() == this->pid) {
+		auto id = this->id;
+		this->header->writer_id.compare_exchange_strong(id, 0, std::memory_order_acq_rel);
+	}
+	munmap(this->header, this->size);
+}
+
+void shared_memory_writer::beat() noexcept
+{
+	this->header->heartbeat.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t shared_memory_writer::get_num_free_frames() const noexcept
+{
+	auto write_pos = this->header->write_pos.load(std::memory_order_relaxed);
+	auto read_pos = this->header->read_pos.load(std::memory_order_acquire);
+
+	auto used = write_pos - read_pos;
+	if (used > this->capacity_frames) {
+		return 0;
+	}
+	return size_t(this->capacity_frames - used);
+}
+
+utki::span<uint8_t> shared_memory_writer::get_write_buffer() noexcept
+{
+	auto begin = this->header->write_pos.load(std::memory_order_relaxed) & (this->capacity_frames - 1);
+	auto n = std::min(uint64_t(this->get_num_free_frames()), this->capacity_frames - begin);
+
+	auto frame_size = this->format.frame_size();
+	return utki::make_span(std::next(this->data, ptrdiff_t(begin * frame_size)), size_t(n * frame_size));
+}
+
+void shared_memory_writer::commit(size_t num_frames) noexcept
+{
+	utki::assert(num_frames <= this->get_num_free_frames(), SL);
+
+	auto write_pos = this->header->write_pos.load(std::memory_order_relaxed);
+	this->header->write_pos.store(write_pos + num_frames, std::memory_order_release);
+
+	this->beat();
+}
+
+bool shared_memory_writer::wait_for_space(size_t num_frames, std::chrono::nanoseconds timeout) noexcept
+{
+	num_frames = std::min(num_frames, size_t(this->capacity_frames));
+
+	auto deadline = std::chrono::steady_clock::now() + timeout;
+
+	// the sleep is split, so that the heartbeat does not stand still for the producer timeout
+	constexpr auto num_beats_per_timeout = 4;
+	auto max_sleep = std::chrono::duration_cast<std::chrono::nanoseconds>(this->producer_timeout) /
+		num_beats_per_timeout;
+
+	for (;;) {
+		this->beat();
+
+		// the source increments the sequence after updating its position, so in case the position changes
+		// after the check, the futex value does not match and the wait returns immediately
+		auto seq = this->header->read_seq.load(std::memory_order_acquire);
+		if (this->get_num_free_frames() >= num_frames) {
+			return true;
+		}
+
+		auto remaining = deadline - std::chrono::steady_clock::now();
+		if (remaining <= std::chrono::nanoseconds::zero()) {
+			return false;
+		}
+		remaining = std::min<std::chrono::nanoseconds>(remaining, max_sleep);
+
+		auto seconds = std::chrono::duration_cast<std::chrono::seconds>(remaining);
+		timespec ts{};
+		ts.tv_sec = time_t(seconds.count());
+		ts.tv_nsec = long(std::chrono::duration_cast<std::chrono::nanoseconds>(remaining - seconds).count());
+
+		this->header->writer_waiting.store(1, std::memory_order_seq_cst);
+		futex(this->header->read_seq, FUTEX_WAIT, seq, &ts);
+		this->header->writer_waiting.store(0, std::memory_order_relaxed);
+	}
+}
+
+#endif
@@ -0,0 +1,284 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+#include <utki/config.hpp>
+#include <utki/span.hpp>
+
+#include "format.hpp"
+#include "player.hpp"
+
+#if CFG_OS == CFG_OS_LINUX
+
+namespace audout {
+
+struct shared_ring_layout;
+struct shared_ring_header;
+
+/**
+ * @brief Source of samples written by another process.
+ * Receives frames through a lock-free ring buffer in shared memory, so that a producer in another
+ * process, e.g. a sandboxed synthesis engine, writes the samples directly to the memory
+ * the player's fill() reads them from, without any copying through sockets or pipes.
+ *
+ * The source creates an anonymous memory file (memfd) of fixed size, sealed against resizing.
+ * Its file descriptor is passed to the producer process, e.g. over a Unix domain socket or by inheritance,
+ * where it is used to create the audout::shared_memory_writer.
+ *
+ * The source never blocks and never trusts the shared memory contents: in case the producer stalls or dies,
+ * the missing frames are played as silence and counted, in case the producer corrupts the ring buffer
+ * positions, the source skips to the producer's write position. The producer increments a heartbeat counter
+ * in the shared memory each time it commits frames or waits for space, a producer whose counter stands still
+ * for the producer timeout is considered dead, e.g. crashed without detaching, so that a new producer can
+ * take over. The check does not use process ids, so it works with producers in other pid namespaces.
+ *
+ * Supported only on Linux.
+ */
+class shared_memory_source : public listener
+{
+	const audout::format format;
+	const uint64_t capacity_frames;
+	const std::chrono::milliseconds producer_timeout;
+
+	int fd;
+	size_t size;
+	shared_ring_header* header;
+	uint8_t* data;
+
+	// the source keeps its own read position, so that the producer can not make it read out of order
+	uint64_t read_pos = 0;
+
+	std::atomic<uint64_t> num_underrun_frames = 0;
+	std::atomic_bool starving = false;
+
+	// last seen heartbeat of the producer and when it was seen to change
+	mutable std::mutex heartbeat_mutex;
+	mutable uint64_t observed_writer_id = 0;
+	mutable uint32_t observed_heartbeat = 0;
+	mutable std::chrono::steady_clock::time_point observed_time;
+
+	bool is_producer_alive(uint64_t writer_id) const noexcept;
+
+	template <typename sample_type>
+	void fill_samples(utki::span<sample_type> play_buffer) noexcept;
+
+public:
+	/**
+	 * @brief Create shared memory source.
+	 * @param format - format of the frames, the producer writes frames in this format.
+	 *                 Must be the player's output format.
+	 * @param capacity_frames - capacity of the ring buffer in frames. Rounded up to the nearest power of 2.
+	 * @param producer_timeout - time after which a producer which neither committed frames nor waited for space
+	 *                           is considered dead.
+	 * @throw std::invalid_argument - in case capacity is 0 or the producer timeout is out of range
+	 *                                from 1 millisecond to 1 minute.
+	 * @throw std::system_error - in case creating or mapping the memory file fails.
+	 */
+	shared_memory_source(
+		audout::format format, //
+		uint32_t capacity_frames,
+		std::chrono::milliseconds producer_timeout = std::chrono::seconds(1)
+	);
+
+	shared_memory_source(const shared_memory_source&) = delete;
+	shared_memory_source& operator=(const shared_memory_source&) = delete;
+
+	shared_memory_source(shared_memory_source&&) = delete;
+	shared_memory_source& operator=(shared_memory_source&&) = delete;
+
+	~shared_memory_source() override;
+
+	/**
+	 * @brief Get file descriptor of the shared memory.
+	 * The descriptor stays owned by the source and is closed on its destruction.
+	 * It has close-on-exec flag set.
+	 * @return File descriptor to pass to the producer process.
+	 */
+	int get_fd() const noexcept
+	{
+		return this->fd;
+	}
+
+	enum class producer_state {
+		/**
+		 * @brief No producer is attached or the producer has detached.
+		 */
+		detached,
+
+		/**
+		 * @brief The producer is attached and the last period was filled completely.
+		 */
+		active,
+
+		/**
+		 * @brief The producer is attached, but the last period was not filled completely.
+		 */
+		stalled,
+
+		/**
+		 * @brief The producer has neither committed frames nor waited for space for the producer timeout.
+		 * E.g. its process has exited without detaching. A new producer can take over the ring buffer.
+		 */
+		dead
+	};
+
+	/**
+	 * @brief Get state of the producer.
+	 * The producer's heartbeat is sampled on each call, so the producer is reported dead only in case
+	 * its heartbeat has not changed between the calls made at least the producer timeout apart.
+	 * Can be called from any thread.
+	 * @return State of the producer.
+	 */
+	producer_state get_producer_state() const noexcept;
+
+	/**
+	 * @brief Get number of frames played as silence.
+	 * Frames are played as silence in case the ring buffer does not have enough frames,
+	 * or the player's sample type differs from the source's one.
+	 * Can be called from any thread.
+	 * @return Number of frames played as silence since the source creation.
+	 */
+	uint64_t get_num_underrun_frames() const noexcept
+	{
+		return this->num_underrun_frames.load(std::memory_order_relaxed);
+	}
+
+	void fill(utki::span<int16_t> play_buffer) noexcept override;
+	void fill(utki::span<int24> play_buffer) noexcept override;
+	void fill(utki::span<int32_t> play_buffer) noexcept override;
+	void fill(utki::span<float> play_buffer) noexcept override;
+};
+
+/**
+ * @brief Producer side of the shared memory source.
+ * Used in the producer process to write frames to the ring buffer shared with audout::shared_memory_source.
+ * Frames are written directly to the shared memory: get_write_buffer() gives the free part of the ring buffer,
+ * commit() makes the written frames available to the source. Only one writer may be attached at a time,
+ * a new writer takes over only from a dead writer, i.e. the one which has neither committed frames
+ * nor waited for space for the source's producer timeout. An idle producer keeps itself alive
+ * by calling wait_for_space() with 0 frames.
+ *
+ * Typical usage:
+ * @code
+ * audout::shared_memory_writer writer(fd);
+ * while (running) {
+ *     writer.wait_for_space(period_frames, std::chrono::milliseconds(100));
+ *     auto buf = writer.get_write_buffer();
+ *     auto num_frames = render(buf);
+ *     writer.commit(num_frames);
+ * }
+ * @endcode
+ */
+class shared_memory_writer
+{
+	const audout::format format;
+	const uint64_t capacity_frames;
+	const std::chrono::milliseconds producer_timeout;
+
+	size_t size;
+	shared_ring_header* header;
+	uint8_t* data;
+
+	uint64_t id = 0;
+
+	// process which attached, a copy of the writer inherited by a forked child does not detach
+	int32_t pid;
+
+	shared_memory_writer(int fd, const shared_ring_layout& layout);
+
+	size_t get_num_free_frames() const noexcept;
+
+	void beat() noexcept;
+
+public:
+	/**
+	 * @brief Attach to shared memory source.
+	 * In case another producer is attached, blocks for up to the source's producer timeout
+	 * watching its heartbeat to find out whether it is dead.
+	 * @param fd - file descriptor of the shared memory, obtained from shared_memory_source::get_fd().
+	 *             The descriptor is not closed, it can be closed right after the writer is created.
+	 * @throw std::system_error - in case mapping the memory fails.
+	 * @throw std::invalid_argument - in case the memory is not a shared memory source's ring buffer.
+	 * @throw std::logic_error - in case another producer, which is alive, is attached.
+	 */
+	shared_memory_writer(int fd);
+
+	shared_memory_writer(const shared_memory_writer&) = delete;
+	shared_memory_writer& operator=(const shared_memory_writer&) = delete;
+
+	shared_memory_writer(shared_memory_writer&&) = delete;
+	shared_memory_writer& operator=(shared_memory_writer&&) = delete;
+
+	/**
+	 * @brief Detach from the shared memory source.
+	 */
+	~shared_memory_writer();
+
+	/**
+	 * @brief Get format of the frames to write.
+	 * @return Format of the source.
+	 */
+	const audout::format& get_format() const noexcept
+	{
+		return this->format;
+	}
+
+	/**
+	 * @brief Get free part of the ring buffer.
+	 * Does not block. The returned buffer ends at the end of the free space or the end of the ring buffer,
+	 * whichever comes first, so the rest of the free space is returned after the written frames are committed.
+	 * @return Buffer of whole frames to write the samples to, in the source's format.
+	 */
+	utki::span<uint8_t> get_write_buffer() noexcept;
+
+	/**
+	 * @brief Make written frames available to the source.
+	 * @param num_frames - number of frames written to the beginning of the buffer
+	 *                     returned by get_write_buffer().
+	 */
+	void commit(size_t num_frames) noexcept;
+
+	/**
+	 * @brief Wait until the ring buffer has free space.
+	 * Sleeps on a futex in the shared memory, which the source wakes after reading frames.
+	 * The producer's heartbeat is kept going while waiting.
+	 * @param num_frames - number of free frames to wait for. Clamped to the ring buffer capacity.
+	 * @param timeout - maximum time to wait.
+	 * @return true in case the requested number of frames is free.
+	 * @return false in case the timeout has expired.
+	 */
+	bool wait_for_space(size_t num_frames, std::chrono::nanoseconds timeout) noexcept;
+};
+
+} // namespace audout
+
+#endif
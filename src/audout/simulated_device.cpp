@@ -0,0 +1,317 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "simulated_device.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace audout;
+
+simulated_device::simulated_device(parameters params) :
+	params(params),
+	random(params.seed)
+{
+	if (params.geometry.buffer_frames != 0) {
+		validate(params.geometry);
+	}
+}
+
+buffer_geometry simulated_device::resolve(buffer_geometry g) const
+{
+	if (g.buffer_frames == 0) {
+		g.buffer_frames = this->num_player_buffer_frames * 2;
+		g.num_periods = 2;
+	}
+	if (g.min_request_frames == buffer_geometry::backend_default) {
+		g.min_request_frames = g.period_frames();
+	}
+	if (g.prebuffer_frames == buffer_geometry::backend_default) {
+		g.prebuffer_frames = g.buffer_frames;
+	}
+	validate(g);
+	return g;
+}
+
+std::chrono::nanoseconds simulated_device::get_period_duration() const noexcept
+{
+	return std::chrono::nanoseconds(
+		uint64_t(this->geometry.period_frames()) * std::nano::den / std::max(this->sampling_rate, uint32_t(1))
+	);
+}
+
+uint32_t simulated_device::get_required_free_frames(uint32_t num_frames) const noexcept
+{
+	// writes bigger than the buffer are done in parts
+	return std::max(std::min(num_frames, this->geometry.buffer_frames), this->geometry.min_request_frames);
+}
+
+void simulated_device::tick()
+{
+	if (!this->running || this->now < this->stall_end) {
+		return;
+	}
+
+	auto& s = this->stats;
+
+	if (!this->started) {
+		// in case the player's period does not divide the buffer, the prebuffer may be unreachable
+		bool buffer_full = this->writer_blocked &&
+			this->geometry.buffer_frames - s.num_buffered_frames < this->get_required_free_frames(this->writer_request);
+		if (s.num_buffered_frames < this->geometry.prebuffer_frames && !buffer_full) {
+			return;
+		}
+		this->started = true;
+		if (this->resume_time.has_value()) {
+			this->startup_latency =
+				std::chrono::duration_cast<std::chrono::microseconds>(this->now - this->resume_time.value());
+			this->resume_time.reset();
+		}
+	}
+
+	auto period = this->geometry.period_frames();
+	if (s.num_buffered_frames >= period) {
+		s.num_buffered_frames -= period;
+		s.num_played_frames += period;
+	} else {
+		// play what is left and silence, then wait for the prebuffer to fill again
+		s.num_played_frames += s.num_buffered_frames;
+		s.num_underrun_frames += period - s.num_buffered_frames;
+		++s.num_underruns;
+		s.num_buffered_frames = 0;
+		this->started = false;
+	}
+
+	this->schedule_wakeup();
+}
+
+void simulated_device::schedule_wakeup()
+{
+	if (!this->writer_blocked || this->writer_released || this->writer_wake_time.has_value()) {
+		return;
+	}
+
+	auto num_free_frames = this->geometry.buffer_frames - this->stats.num_buffered_frames;
+	if (num_free_frames < this->get_required_free_frames(this->writer_request)) {
+		return;
+	}
+
+	std::uniform_int_distribution<int64_t> jitter(0, this->params.wakeup_jitter.count());
+	this->writer_wake_time = this->now + std::chrono::microseconds(jitter(this->random));
+}
+
+void simulated_device::wait_settled(std::unique_lock<std::mutex>& lock)
+{
+	this->settled_cv.wait(lock, [this]() {
+		return !this->attached || this->interrupted || !this->running ||
+			(this->writer_blocked && !this->writer_released);
+	});
+}
+
+void simulated_device::advance(std::chrono::microseconds duration)
+{
+	std::unique_lock lock(this->mutex);
+
+	auto end = this->now + duration;
+
+	this->wait_settled(lock);
+
+	while (this->attached) {
+		auto event_time = this->next_tick;
+		if (this->writer_wake_time.has_value()) {
+			event_time = std::min(event_time, this->writer_wake_time.value());
+		}
+		if (event_time > end) {
+			break;
+		}
+
+		this->now = event_time;
+
+		if (this->now == this->next_tick) {
+			this->tick();
+			this->next_tick += this->get_period_duration();
+		}
+
+		if (this->writer_wake_time.has_value() && this->now >= this->writer_wake_time.value()) {
+			this->writer_wake_time.reset();
+			this->writer_released = true;
+			this->writer_cv.notify_all();
+			this->wait_settled(lock);
+		}
+	}
+
+	this->now = end;
+}
+
+void simulated_device::stall(std::chrono::microseconds duration)
+{
+	std::lock_guard lock(this->mutex);
+	this->stall_end = this->now + duration;
+}
+
+std::chrono::microseconds simulated_device::get_time() const
+{
+	std::lock_guard lock(this->mutex);
+	return std::chrono::duration_cast<std::chrono::microseconds>(this->now);
+}
+
+simulated_device::statistics simulated_device::get_statistics() const
+{
+	std::lock_guard lock(this->mutex);
+	return this->stats;
+}
+
+std::chrono::microseconds simulated_device::get_latency() const
+{
+	std::lock_guard lock(this->mutex);
+	return std::chrono::microseconds(
+		uint64_t(this->stats.num_buffered_frames) * std::micro::den / std::max(this->sampling_rate, uint32_t(1))
+	);
+}
+
+void simulated_device::attach(uint32_t sampling_rate, uint32_t num_buffer_frames)
+{
+	std::lock_guard lock(this->mutex);
+	if (this->attached) {
+		throw std::logic_error("simulated_device::attach(): the device is already attached to a player");
+	}
+
+	this->sampling_rate = sampling_rate;
+	this->num_player_buffer_frames = num_buffer_frames;
+	this->geometry = this->resolve(this->params.geometry);
+
+	this->attached = true;
+	this->running = false;
+	this->started = false;
+	this->stats.num_buffered_frames = 0;
+	this->next_tick = this->now + this->get_period_duration();
+}
+
+void simulated_device::detach()
+{
+	{
+		std::lock_guard lock(this->mutex);
+		this->attached = false;
+	}
+	this->writer_cv.notify_all();
+	this->settled_cv.notify_all();
+}
+
+uint32_t simulated_device::write(uint32_t num_frames)
+{
+	std::unique_lock lock(this->mutex);
+
+	uint32_t num_written = 0;
+
+	while (num_written != num_frames && this->attached) {
+		auto& buffered = this->stats.num_buffered_frames;
+
+		auto num_left = num_frames - num_written;
+
+		auto num_free_frames = this->geometry.buffer_frames - buffered;
+		if (num_free_frames >= this->get_required_free_frames(num_left)) {
+			auto n = std::min(num_left, num_free_frames);
+			buffered += n;
+			num_written += n;
+			continue;
+		}
+
+		if (this->interrupted) {
+			// write what fits and return right away
+			auto n = std::min(num_left, num_free_frames);
+			buffered += n;
+			num_written += n;
+			break;
+		}
+
+		// wait until the advancing thread wakes us up
+		this->writer_request = num_frames;
+		this->writer_blocked = true;
+		this->settled_cv.notify_all();
+
+		this->writer_cv.wait(lock, [this]() {
+			return this->writer_released || !this->attached || this->interrupted;
+		});
+
+		this->writer_released = false;
+		this->writer_blocked = false;
+	}
+
+	return num_written;
+}
+
+void simulated_device::set_interrupted(bool interrupted)
+{
+	{
+		std::lock_guard lock(this->mutex);
+		this->interrupted = interrupted;
+	}
+	this->writer_cv.notify_all();
+	this->settled_cv.notify_all();
+}
+
+void simulated_device::set_running(bool running)
+{
+	{
+		std::lock_guard lock(this->mutex);
+		if (running && !this->running) {
+			this->resume_time = this->now;
+			this->next_tick = this->now + this->get_period_duration();
+		}
+		this->running = running;
+	}
+	this->settled_cv.notify_all();
+}
+
+void simulated_device::set_sampling_rate(uint32_t sampling_rate)
+{
+	std::lock_guard lock(this->mutex);
+	this->sampling_rate = sampling_rate;
+}
+
+void simulated_device::set_geometry(const buffer_geometry& geometry)
+{
+	std::lock_guard lock(this->mutex);
+
+	this->geometry = this->resolve(geometry);
+
+	auto& buffered = this->stats.num_buffered_frames;
+	buffered = std::min(buffered, this->geometry.buffer_frames);
+
+	this->schedule_wakeup();
+}
+
+buffer_geometry simulated_device::get_geometry() const
+{
+	std::lock_guard lock(this->mutex);
+	return this->geometry;
+}
+
+std::chrono::microseconds simulated_device::get_startup_latency() const
+{
+	std::lock_guard lock(this->mutex);
+	return this->startup_latency;
+}
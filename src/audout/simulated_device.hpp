@@ -0,0 +1,287 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <random>
+
+#include "latency.hpp"
+
+namespace audout {
+
+/**
+ * @brief Simulated output device driven by a virtual clock.
+ * Allows running the real player and audio thread logic deterministically and faster than real time,
+ * e.g. for reproducing underruns, late wakeups of the audio thread and stalls of the device in tests.
+ *
+ * The device consumes one period of frames from its buffer on each period tick of the virtual clock.
+ * The virtual clock only moves when advance() is called. After each event the device waits until the
+ * audio thread has reacted to it, i.e. has filled the buffer and blocked again, so that the outcome
+ * does not depend on real time scheduling.
+ *
+ * The device is passed to the player's constructor, see audout::player. It must outlive the player.
+ *
+ * Typical usage:
+ * @code
+ * audout::simulated_device device;
+ * audout::player p(format, num_frames, &listener, device);
+ * p.set_paused(false);
+ * device.advance(std::chrono::seconds(10));
+ * ASSERT(device.get_statistics().num_underruns == 0)
+ * @endcode
+ */
+class simulated_device
+{
+public:
+	struct parameters {
+		/**
+		 * @brief Device buffer geometry.
+		 * Zero buffer_frames means the buffer of 2 periods of the player's buffer size.
+		 * Default minimal request is one period, default prebuffer is the whole buffer.
+		 */
+		buffer_geometry geometry;
+
+		/**
+		 * @brief Maximal delay of the audio thread wakeup.
+		 * Once there is enough free space in the device buffer, the audio thread is woken up
+		 * after a random delay, uniformly distributed between 0 and this value.
+		 */
+		std::chrono::microseconds wakeup_jitter{0};
+
+		/**
+		 * @brief Seed of the random delay generator.
+		 */
+		uint32_t seed = 1;
+	};
+
+	struct statistics {
+		/**
+		 * @brief Number of frames consumed by the device, not counting silence played on underruns.
+		 */
+		uint64_t num_played_frames = 0;
+
+		/**
+		 * @brief Number of periods when the device had not enough frames to play.
+		 */
+		uint32_t num_underruns = 0;
+
+		/**
+		 * @brief Number of frames of silence played on underruns.
+		 */
+		uint64_t num_underrun_frames = 0;
+
+		/**
+		 * @brief Number of frames currently in the device buffer.
+		 */
+		uint32_t num_buffered_frames = 0;
+	};
+
+private:
+	const parameters params;
+
+	mutable std::mutex mutex;
+
+	// woken up when the virtual time moves or the device is detached
+	std::condition_variable writer_cv;
+
+	// woken up when the audio thread blocks
+	std::condition_variable settled_cv;
+
+	std::minstd_rand random;
+
+	// virtual time
+	std::chrono::nanoseconds now{0};
+
+	bool attached = false;
+
+	// makes write() return right away, so that the audio thread can pick up commands
+	bool interrupted = false;
+	uint32_t sampling_rate = 0;
+	uint32_t num_player_buffer_frames = 0;
+	buffer_geometry geometry;
+
+	// playback is resumed
+	bool running = false;
+
+	// device is consuming the frames, set when buffered frames reach the prebuffer
+	bool started = false;
+
+	std::chrono::nanoseconds next_tick{0};
+	std::chrono::nanoseconds stall_end{0};
+
+	// set on resume, reset once the startup latency is measured
+	std::optional<std::chrono::nanoseconds> resume_time;
+
+	std::chrono::microseconds startup_latency{0};
+
+	// state of the audio thread's write
+	bool writer_blocked = false;
+	bool writer_released = false;
+	uint32_t writer_request = 0;
+	std::optional<std::chrono::nanoseconds> writer_wake_time;
+
+	statistics stats;
+
+	buffer_geometry resolve(buffer_geometry g) const;
+	std::chrono::nanoseconds get_period_duration() const noexcept;
+	uint32_t get_required_free_frames(uint32_t num_frames) const noexcept;
+	void tick();
+	void schedule_wakeup();
+	void wait_settled(std::unique_lock<std::mutex>& lock);
+
+public:
+	/**
+	 * @brief Create simulated device.
+	 * @param params - device parameters.
+	 * @throw std::invalid_argument - in case the buffer geometry is invalid.
+	 */
+	simulated_device(parameters params);
+
+	simulated_device() :
+		simulated_device(parameters())
+	{}
+
+	simulated_device(const simulated_device&) = delete;
+	simulated_device& operator=(const simulated_device&) = delete;
+
+	simulated_device(simulated_device&&) = delete;
+	simulated_device& operator=(simulated_device&&) = delete;
+
+	~simulated_device() = default;
+
+	/**
+	 * @brief Advance the virtual clock.
+	 * Processes all period ticks and audio thread wakeups which happen during the given time,
+	 * waiting for the audio thread to react to each of them.
+	 * Must be called from a single control thread, not from the audio thread.
+	 * @param duration - virtual time to advance by.
+	 */
+	void advance(std::chrono::microseconds duration);
+
+	/**
+	 * @brief Stall the device.
+	 * The device stops consuming frames for the given virtual time starting from now, like a slow
+	 * consumer would. The audio thread stays blocked while the buffer is full, which is not an underrun.
+	 * @param duration - virtual time to stall for.
+	 */
+	void stall(std::chrono::microseconds duration);
+
+	/**
+	 * @brief Get virtual time.
+	 * @return Virtual time passed since the device creation.
+	 */
+	std::chrono::microseconds get_time() const;
+
+	/**
+	 * @brief Get playback statistics.
+	 * @return Statistics accumulated since the device creation.
+	 */
+	statistics get_statistics() const;
+
+	/**
+	 * @brief Get latency of the buffered frames.
+	 * @return Duration of the frames currently in the device buffer.
+	 */
+	std::chrono::microseconds get_latency() const;
+
+	// The following methods are called by the player's backend.
+
+	/**
+	 * @brief Attach the device to a player.
+	 * Called by the player's backend.
+	 * @param sampling_rate - sampling rate of the player.
+	 * @param num_buffer_frames - player's buffer size, used for the default geometry.
+	 * @throw std::logic_error - in case the device is already attached to a player.
+	 */
+	void attach(uint32_t sampling_rate, uint32_t num_buffer_frames);
+
+	/**
+	 * @brief Detach the device from the player.
+	 * Called by the player's backend. Blocked write() returns right away, frames which do not fit
+	 * into the device buffer are dropped.
+	 */
+	void detach();
+
+	/**
+	 * @brief Write frames to the device buffer.
+	 * Called by the player's audio thread. Blocks until all frames fit into the device buffer
+	 * and the audio thread's wakeup time comes on the virtual clock.
+	 * @param num_frames - number of frames to write.
+	 * @return Number of frames written. Less than requested only in case writing is interrupted or
+	 *         the device is detached.
+	 */
+	uint32_t write(uint32_t num_frames);
+
+	/**
+	 * @brief Interrupt writing.
+	 * Called by the player's backend. While interrupted, write() writes only the frames which fit into
+	 * the device buffer and returns right away, so that the audio thread can handle commands without
+	 * the virtual clock moving.
+	 * @param interrupted - whether writing is interrupted.
+	 */
+	void set_interrupted(bool interrupted);
+
+	/**
+	 * @brief Pause or resume consuming frames.
+	 * Called by the player's backend.
+	 * @param running - whether the playback is resumed.
+	 */
+	void set_running(bool running);
+
+	/**
+	 * @brief Change sampling rate.
+	 * Called by the player's audio thread on reconfiguration.
+	 * @param sampling_rate - new sampling rate.
+	 */
+	void set_sampling_rate(uint32_t sampling_rate);
+
+	/**
+	 * @brief Change buffer geometry.
+	 * Called by the player's backend. Frames which do not fit into the new buffer are dropped.
+	 * @param geometry - new geometry. backend_default fields are replaced by the device's defaults.
+	 * @throw std::invalid_argument - in case the buffer geometry is invalid.
+	 */
+	void set_geometry(const buffer_geometry& geometry);
+
+	/**
+	 * @brief Get buffer geometry.
+	 * @return Current buffer geometry with the defaults resolved.
+	 */
+	buffer_geometry get_geometry() const;
+
+	/**
+	 * @brief Get startup latency.
+	 * @return Virtual time between the last resume and the device starting to consume frames.
+	 */
+	std::chrono::microseconds get_startup_latency() const;
+};
+
+} // namespace audout
@@ -0,0 +1,405 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "sound_bank.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#include <utki/config.hpp>
+#include <utki/debug.hpp>
+#include <utki/util.hpp>
+
+#if CFG_OS == CFG_OS_WINDOWS
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+using namespace audout;
+
+namespace {
+constexpr std::array<char, 8> magic = {'A', 'U', 'D', 'O', 'U', 'T', 'S', 'B'};
+constexpr uint32_t version = 1;
+
+constexpr size_t header_size_bytes = magic.size() + sizeof(uint32_t) * 2;
+constexpr size_t index_entry_size_bytes = sizeof(uint64_t) * 2 + sizeof(uint32_t) * 4;
+
+template <typename integer_type>
+integer_type read_le(const uint8_t* p) noexcept
+{
+	integer_type ret = 0;
+	for (size_t i = 0; i != sizeof(integer_type); ++i) {
+		ret |= integer_type(p[i]) << (i * 8);
+	}
+	return ret;
+}
+
+template <typename integer_type>
+void write_le(std::vector<uint8_t>& buf, integer_type v)
+{
+	for (size_t i = 0; i != sizeof(integer_type); ++i) {
+		buf.push_back(uint8_t(v >> (i * 8)));
+	}
+}
+
+struct index_entry {
+	uint64_t data_offset;
+	uint64_t num_frames;
+	uint32_t num_channels;
+	uint32_t sampling_rate;
+	uint32_t name_offset;
+	uint32_t name_length;
+
+	index_entry(utki::span<const uint8_t> bank, size_t index) noexcept
+	{
+		const uint8_t* p = bank.data() + header_size_bytes + index * index_entry_size_bytes;
+
+		this->data_offset = read_le<uint64_t>(p);
+		p += sizeof(uint64_t);
+		this->num_frames = read_le<uint64_t>(p);
+		p += sizeof(uint64_t);
+		this->num_channels = read_le<uint32_t>(p);
+		p += sizeof(uint32_t);
+		this->sampling_rate = read_le<uint32_t>(p);
+		p += sizeof(uint32_t);
+		this->name_offset = read_le<uint32_t>(p);
+		p += sizeof(uint32_t);
+		this->name_length = read_le<uint32_t>(p);
+	}
+};
+
+class mapped_file
+{
+#if CFG_OS == CFG_OS_WINDOWS
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#endif
+
+public:
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+
+	mapped_file(const std::string& file_name)
+	{
+#if CFG_OS == CFG_OS_WINDOWS
+		this->file = CreateFileA(
+			file_name.c_str(),
+			GENERIC_READ,
+			FILE_SHARE_READ,
+			nullptr,
+			OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL,
+			nullptr
+		);
+		if (this->file == INVALID_HANDLE_VALUE) {
+			throw std::system_error(int(GetLastError()), std::system_category(), "CreateFile() failed");
+		}
+		utki::scope_exit file_scope_exit([this]() {
+			CloseHandle(this->file);
+		});
+
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(this->file, &file_size)) {
+			throw std::system_error(int(GetLastError()), std::system_category(), "GetFileSizeEx() failed");
+		}
+		this->size = size_t(file_size.QuadPart);
+
+		if (this->size != 0) {
+			this->mapping = CreateFileMappingA(this->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!this->mapping) {
+				throw std::system_error(int(GetLastError()), std::system_category(), "CreateFileMapping() failed");
+			}
+			utki::scope_exit mapping_scope_exit([this]() {
+				CloseHandle(this->mapping);
+			});
+
+			this->data = static_cast<const uint8_t*>(MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0));
+			if (!this->data) {
+				throw std::system_error(int(GetLastError()), std::system_category(), "MapViewOfFile() failed");
+			}
+
+			mapping_scope_exit.release();
+		}
+
+		file_scope_exit.release();
+#else
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg, "open() is a vararg function")
+		int fd = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			throw std::system_error(errno, std::generic_category(), "open() failed");
+		}
+
+		// the mapping stays valid after closing the file descriptor
+		utki::scope_exit fd_scope_exit([fd]() {
+			close(fd);
+		});
+
+		struct stat st {};
+		if (fstat(fd, &st) != 0) {
+			throw std::system_error(errno, std::generic_category(), "fstat() failed");
+		}
+		this->size = size_t(st.st_size);
+
+		if (this->size != 0) {
+			void* p = mmap(nullptr, this->size, PROT_READ, MAP_SHARED, fd, 0);
+			if (p == MAP_FAILED) {
+				throw std::system_error(errno, std::generic_category(), "mmap() failed");
+			}
+			this->data = static_cast<const uint8_t*>(p);
+		}
+#endif
+	}
+
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+	mapped_file(mapped_file&&) = delete;
+	mapped_file& operator=(mapped_file&&) = delete;
+
+	~mapped_file()
+	{
+#if CFG_OS == CFG_OS_WINDOWS
+		if (this->data) {
+			UnmapViewOfFile(this->data);
+			CloseHandle(this->mapping);
+		}
+		CloseHandle(this->file);
+#else
+		if (this->data) {
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast, "munmap() takes non-const pointer")
+			munmap(const_cast<uint8_t*>(this->data), this->size);
+		}
+#endif
+	}
+};
+} // namespace
+
+sound_bank::sound_bank(const std::string& file_name)
+{
+	auto mf = std::make_shared<mapped_file>(file_name);
+	this->data = utki::make_span(mf->data, mf->size);
+	this->mapping = std::move(mf);
+
+	if (this->data.size() < header_size_bytes ||
+		!std::equal(magic.begin(), magic.end(), this->data.begin()))
+	{
+		throw std::invalid_argument("sound_bank::sound_bank(): not a sound bank file");
+	}
+
+	if (read_le<uint32_t>(this->data.data() + magic.size()) != version) {
+		throw std::invalid_argument("sound_bank::sound_bank(): unsupported sound bank version");
+	}
+
+	this->num_clips = read_le<uint32_t>(this->data.data() + magic.size() + sizeof(uint32_t));
+
+	if ((this->data.size() - header_size_bytes) / index_entry_size_bytes < this->num_clips) {
+		throw std::invalid_argument("sound_bank::sound_bank(): sound bank index is truncated");
+	}
+
+	// validate the index, this only touches the index pages, PCM data pages are not loaded
+	for (size_t i = 0; i != this->num_clips; ++i) {
+		index_entry e(this->data, i);
+
+		if (e.num_channels == 0 || e.data_offset % blob_alignment != 0 || e.data_offset > this->data.size() ||
+			e.num_frames > (this->data.size() - e.data_offset) / (e.num_channels * sizeof(int16_t)) ||
+			e.name_offset > this->data.size() || e.name_length > this->data.size() - e.name_offset)
+		{
+			throw std::invalid_argument("sound_bank::sound_bank(): sound bank index is corrupted");
+		}
+	}
+}
+
+std::string_view sound_bank::get_name(size_t index) const noexcept
+{
+	index_entry e(this->data, index);
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "names are stored as raw bytes")
+	return {reinterpret_cast<const char*>(this->data.data() + e.name_offset), e.name_length};
+}
+
+pcm_clip sound_bank::get(size_t index) const
+{
+	if (index >= this->num_clips) {
+		throw std::out_of_range("sound_bank::get(): index is out of range");
+	}
+
+	index_entry e(this->data, index);
+
+	return {
+		this->mapping,
+		utki::make_span(
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "blobs are aligned 16-bit samples")
+			reinterpret_cast<const int16_t*>(this->data.data() + e.data_offset),
+			size_t(e.num_frames * e.num_channels)
+		),
+		e.num_channels,
+		e.sampling_rate
+	};
+}
+
+pcm_clip sound_bank::get(std::string_view name) const
+{
+	// index is sorted by name, so do binary search
+	size_t begin = 0;
+	size_t end = this->num_clips;
+	while (begin != end) {
+		size_t mid = begin + (end - begin) / 2;
+		auto n = this->get_name(mid);
+		if (n == name) {
+			return this->get(mid);
+		} else if (n < name) {
+			begin = mid + 1;
+		} else {
+			end = mid;
+		}
+	}
+
+	std::stringstream ss;
+	ss << "sound_bank::get(): clip '" << name << "' not found";
+	throw std::out_of_range(ss.str());
+}
+
+void sound_bank::write(const std::string& file_name, utki::span<const entry> entries)
+{
+	std::vector<const entry*> sorted;
+	sorted.reserve(entries.size());
+	for (const auto& e : entries) {
+		if (e.num_channels == 0 || e.samples.size() % e.num_channels != 0) {
+			throw std::invalid_argument("sound_bank::write(): clip data does not consist of whole frames");
+		}
+		sorted.push_back(&e);
+	}
+
+	std::sort(sorted.begin(), sorted.end(), [](const entry* a, const entry* b) {
+		return a->name < b->name;
+	});
+
+	if (std::adjacent_find(
+			sorted.begin(),
+			sorted.end(),
+			[](const entry* a, const entry* b) {
+				return a->name == b->name;
+			}
+		) != sorted.end())
+	{
+		throw std::invalid_argument("sound_bank::write(): duplicate clip names");
+	}
+
+	auto align = [](size_t offset) {
+		return (offset + blob_alignment - 1) / blob_alignment * blob_alignment;
+	};
+
+	size_t names_offset = header_size_bytes + index_entry_size_bytes * sorted.size();
+
+	size_t data_offset = names_offset;
+	for (auto e : sorted) {
+		data_offset += e->name.size();
+	}
+
+	std::vector<uint8_t> buf;
+	buf.insert(buf.end(), magic.begin(), magic.end());
+	write_le(buf, version);
+	write_le(buf, uint32_t(sorted.size()));
+
+	size_t name_offset = names_offset;
+	for (auto e : sorted) {
+		data_offset = align(data_offset);
+
+		write_le(buf, uint64_t(data_offset));
+		write_le(buf, uint64_t(e->samples.size() / e->num_channels));
+		write_le(buf, uint32_t(e->num_channels));
+		write_le(buf, uint32_t(e->sampling_rate));
+		write_le(buf, uint32_t(name_offset));
+		write_le(buf, uint32_t(e->name.size()));
+
+		name_offset += e->name.size();
+		data_offset += e->samples.size_bytes();
+	}
+
+	for (auto e : sorted) {
+		buf.insert(buf.end(), e->name.begin(), e->name.end());
+	}
+
+	for (auto e : sorted) {
+		buf.resize(align(buf.size()), 0);
+		for (auto s : e->samples) {
+			write_le(buf, uint16_t(s));
+		}
+	}
+
+	std::ofstream f(file_name, std::ios::binary | std::ios::trunc);
+	if (!f) {
+		throw std::system_error(errno, std::generic_category(), "sound_bank::write(): could not open file");
+	}
+
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "writing raw bytes")
+	f.write(reinterpret_cast<const char*>(buf.data()), std::streamsize(buf.size()));
+	if (!f) {
+		throw std::system_error(errno, std::generic_category(), "sound_bank::write(): could not write file");
+	}
+}
+
+void pcm_voice::seek(size_t frame) noexcept
+{
+	this->cur_frame = std::min(frame, this->clip.get_num_frames());
+}
+
+size_t pcm_voice::fill(utki::span<int16_t> buf) noexcept
+{
+	unsigned num_channels = this->clip.get_num_channels();
+
+	// default constructed clip has no samples
+	if (num_channels == 0) {
+		return 0;
+	}
+
+	utki::assert(buf.size() % num_channels == 0, SL);
+
+	size_t num_frames = std::min(buf.size() / num_channels, this->clip.get_num_frames() - this->cur_frame);
+
+	std::memcpy(
+		buf.data(),
+		this->clip.get_samples().data() + this->cur_frame * num_channels,
+		num_frames * num_channels * sizeof(int16_t)
+	);
+
+	this->cur_frame += num_frames;
+
+	return num_frames;
+}
@@ -0,0 +1,217 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <utki/span.hpp>
+
+namespace audout {
+
+/**
+ * @brief View of PCM clip stored in a sound bank.
+ * The clip does not own the samples, they reside in the memory mapped sound bank file.
+ * The clip holds a reference to the mapping, so the mapping stays alive while there are clips
+ * referring to it, even if the sound_bank object itself has been destroyed.
+ * Copying the clip is cheap, it only increments the reference counter.
+ */
+class pcm_clip
+{
+	friend class sound_bank;
+
+	std::shared_ptr<const void> mapping;
+
+	utki::span<const int16_t> samples;
+
+	unsigned num_channels = 0;
+	unsigned sampling_rate = 0;
+
+	pcm_clip(
+		std::shared_ptr<const void> mapping, //
+		utki::span<const int16_t> samples,
+		unsigned num_channels,
+		unsigned sampling_rate
+	) :
+		mapping(std::move(mapping)),
+		samples(samples),
+		num_channels(num_channels),
+		sampling_rate(sampling_rate)
+	{}
+
+public:
+	pcm_clip() = default;
+
+	/**
+	 * @brief Get clip samples.
+	 * @return Interleaved 16-bit PCM samples of the clip.
+	 */
+	utki::span<const int16_t> get_samples() const noexcept
+	{
+		return this->samples;
+	}
+
+	unsigned get_num_channels() const noexcept
+	{
+		return this->num_channels;
+	}
+
+	unsigned get_sampling_rate() const noexcept
+	{
+		return this->sampling_rate;
+	}
+
+	size_t get_num_frames() const noexcept
+	{
+		if (this->num_channels == 0) {
+			return 0;
+		}
+		return this->samples.size() / this->num_channels;
+	}
+};
+
+/**
+ * @brief Playback cursor over PCM clip.
+ * Copies samples from the clip right into the buffer being filled, no intermediate copies are made.
+ */
+class pcm_voice
+{
+	pcm_clip clip;
+
+	size_t cur_frame = 0;
+
+public:
+	pcm_voice(pcm_clip clip) :
+		clip(std::move(clip))
+	{}
+
+	/**
+	 * @brief Fill buffer with next portion of the clip's samples.
+	 * Intended to be called from within audout::listener::fill().
+	 * @param buf - buffer to fill with interleaved samples.
+	 *              The number of channels is the same as the one of the clip.
+	 * @return Number of frames written to the buffer. Less than the buffer can hold
+	 *         in case end of the clip has been reached.
+	 */
+	size_t fill(utki::span<int16_t> buf) noexcept;
+
+	/**
+	 * @brief Set playing position.
+	 * @param frame - index of the frame to continue playing from.
+	 */
+	void seek(size_t frame) noexcept;
+
+	size_t get_position() const noexcept
+	{
+		return this->cur_frame;
+	}
+
+	bool is_finished() const noexcept
+	{
+		return this->cur_frame >= this->clip.get_num_frames();
+	}
+};
+
+/**
+ * @brief Memory mapped sound bank.
+ * Sound bank is a file which packs a number of named PCM clips.
+ * The file is memory mapped read-only, so its pages are loaded lazily on first access
+ * and shared among all processes which map the same file.
+ *
+ * The file layout is (all numbers are little-endian):
+ * - header: 8 bytes magic "AUDOUTSB", uint32 version, uint32 number of clips;
+ * - index: array of entries sorted by clip name, each entry is uint64 data offset, uint64 number of frames,
+ *   uint32 number of channels, uint32 sampling rate, uint32 name offset, uint32 name length;
+ * - clip names;
+ * - PCM data blobs of interleaved 16-bit samples, each blob is aligned to blob_alignment bytes.
+ */
+class sound_bank
+{
+	std::shared_ptr<const void> mapping;
+
+	utki::span<const uint8_t> data;
+
+	uint32_t num_clips;
+
+	std::string_view get_name(size_t index) const noexcept;
+
+public:
+	constexpr static size_t blob_alignment = 64;
+
+	/**
+	 * @brief Description of a clip to be written to a sound bank file.
+	 */
+	struct entry {
+		std::string_view name;
+		utki::span<const int16_t> samples;
+		unsigned num_channels;
+		unsigned sampling_rate;
+	};
+
+	/**
+	 * @brief Map sound bank file.
+	 * @param file_name - name of the sound bank file.
+	 * @throw std::system_error - in case opening or mapping the file fails.
+	 * @throw std::invalid_argument - in case the file is not a valid sound bank.
+	 */
+	sound_bank(const std::string& file_name);
+
+	size_t size() const noexcept
+	{
+		return this->num_clips;
+	}
+
+	/**
+	 * @brief Get clip by index.
+	 * Clips are ordered by name.
+	 * @param index - index of the clip.
+	 * @return The clip.
+	 * @throw std::out_of_range - in case index is out of range.
+	 */
+	pcm_clip get(size_t index) const;
+
+	/**
+	 * @brief Find clip by name.
+	 * @param name - name of the clip.
+	 * @return The clip.
+	 * @throw std::out_of_range - in case clip with given name is not found.
+	 */
+	pcm_clip get(std::string_view name) const;
+
+	/**
+	 * @brief Write sound bank file.
+	 * @param file_name - name of the file to write.
+	 * @param entries - clips to write. Clip names must be unique.
+	 * @throw std::invalid_argument - in case of duplicate clip names or malformed clip data.
+	 * @throw std::system_error - in case writing the file fails.
+	 */
+	static void write(const std::string& file_name, utki::span<const entry> entries);
+};
+
+} // namespace audout
@@ -0,0 +1,235 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "spectrum_analyser.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+
+#include <utki/config.hpp>
+#include <utki/math.hpp>
+
+#include "convert.hpp"
+
+#if CFG_OS == CFG_OS_WINDOWS
+#	include <windows.h>
+#elif CFG_OS == CFG_OS_LINUX
+#	include <sys/resource.h>
+#endif
+
+using namespace audout;
+
+namespace {
+// the ring buffer holds at least a second of samples, so that periods of any latency profile fit into it
+constexpr size_t min_ring_fft_sizes = 4;
+
+void lower_thread_priority() noexcept
+{
+#if CFG_OS == CFG_OS_WINDOWS
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif CFG_OS == CFG_OS_LINUX
+	// on Linux nice value is per thread, 0 means the calling thread
+	constexpr int background_nice_value = 10;
+	setpriority(PRIO_PROCESS, 0, background_nice_value);
+#endif
+}
+} // namespace
+
+spectrum_analyser::spectrum_analyser(uint32_t sampling_rate, size_t fft_size, size_t hop_size) :
+	sampling_rate(sampling_rate),
+	hop_size(hop_size == 0 ? std::max(size_t(1), fft_size / 2) : hop_size),
+	ring(std::max(fft_size * min_ring_fft_sizes, size_t(sampling_rate))),
+	fft(fft_size),
+	window(fft_size),
+	history(fft_size),
+	hop_buffer(this->hop_size),
+	windowed(fft_size),
+	bins(fft_size / 2 + 1)
+{
+	// Hann window
+	for (size_t i = 0; i != fft_size; ++i) {
+		this->window[i] = float(0.5 - 0.5 * std::cos(2 * utki::pi * double(i) / double(fft_size)));
+	}
+
+	this->latest.bin_width = float(sampling_rate) / float(fft_size);
+	this->latest.magnitudes.resize(this->bins.size());
+
+	this->thread = std::thread([this]() {
+		this->run();
+	});
+}
+
+spectrum_analyser::~spectrum_analyser()
+{
+	{
+		std::lock_guard lock(this->thread_mutex);
+		this->quit = true;
+	}
+	this->thread_cv.notify_all();
+	this->thread.join();
+}
+
+template <typename sample_type>
+void spectrum_analyser::push_samples(utki::span<const sample_type> buf, unsigned num_channels) noexcept
+{
+	// downmix to mono by chunks, so that no memory is allocated
+	constexpr size_t chunk_size = 256;
+	std::array<float, chunk_size> chunk{};
+
+	float scale = 1.0f / float(num_channels);
+
+	auto num_frames = buf.size() / num_channels;
+	for (size_t frame = 0; frame != num_frames;) {
+		size_t n = std::min(chunk_size, num_frames - frame);
+		for (size_t i = 0; i != n; ++i, ++frame) {
+			float sum = 0;
+			for (unsigned ch = 0; ch != num_channels; ++ch) {
+				sum += to_float(buf[frame * num_channels + ch]);
+			}
+			chunk[i] = sum * scale;
+		}
+
+		auto num_written = this->ring.write(utki::make_span(chunk.data(), n));
+		if (num_written != n) {
+			this->num_dropped_samples.fetch_add(uint32_t(n - num_written), std::memory_order_relaxed);
+		}
+	}
+}
+
+void spectrum_analyser::push(utki::span<const int16_t> buf, unsigned num_channels) noexcept
+{
+	this->push_samples(buf, num_channels);
+}
+
+void spectrum_analyser::push(utki::span<const int24> buf, unsigned num_channels) noexcept
+{
+	this->push_samples(buf, num_channels);
+}
+
+void spectrum_analyser::push(utki::span<const int32_t> buf, unsigned num_channels) noexcept
+{
+	this->push_samples(buf, num_channels);
+}
+
+void spectrum_analyser::push(utki::span<const float> buf, unsigned num_channels) noexcept
+{
+	this->push_samples(buf, num_channels);
+}
+
+void spectrum_analyser::run()
+{
+	lower_thread_priority();
+
+	// poll the ring buffer about twice per hop
+	auto poll_interval = std::chrono::duration<double>(double(this->hop_size) / double(this->sampling_rate) / 2);
+
+	std::unique_lock lock(this->thread_mutex);
+	while (!this->quit) {
+		lock.unlock();
+
+		for (;;) {
+			auto n = this->ring.read(utki::make_span(this->hop_buffer).subspan(this->hop_buffer_size));
+			this->hop_buffer_size += n;
+			if (this->hop_buffer_size != this->hop_buffer.size()) {
+				// ring buffer is drained
+				break;
+			}
+			this->hop_buffer_size = 0;
+
+			// slide the analysed window by one hop
+			auto& h = this->history;
+			if (this->hop_size < h.size()) {
+				std::move(std::next(h.begin(), ptrdiff_t(this->hop_size)), h.end(), h.begin());
+				std::copy(this->hop_buffer.begin(), this->hop_buffer.end(), std::prev(h.end(), ptrdiff_t(this->hop_size)));
+			} else {
+				std::copy(std::prev(this->hop_buffer.end(), ptrdiff_t(h.size())), this->hop_buffer.end(), h.begin());
+			}
+
+			this->analyse();
+		}
+
+		lock.lock();
+		this->thread_cv.wait_for(lock, poll_interval, [this]() {
+			return this->quit;
+		});
+	}
+}
+
+void spectrum_analyser::analyse()
+{
+	std::transform(
+		this->history.begin(),
+		this->history.end(),
+		this->window.begin(),
+		this->windowed.begin(),
+		[](float s, float w) {
+			return s * w;
+		}
+	);
+
+	this->fft.forward(utki::make_span(this->windowed), utki::make_span(this->bins));
+
+	// a sine wave of amplitude A gives magnitude of A * sum(window) / 2 in its bin
+	float scale = 2 / std::accumulate(this->window.begin(), this->window.end(), 0.0f);
+
+	std::lock_guard lock(this->spectrum_mutex);
+	std::transform(this->bins.begin(), this->bins.end(), this->latest.magnitudes.begin(), [&](auto b) {
+		return std::abs(b) * scale;
+	});
+	++this->latest.num_spectra;
+}
+
+spectrum_analyser::spectrum spectrum_analyser::get() const
+{
+	std::lock_guard lock(this->spectrum_mutex);
+	return this->latest;
+}
+
+float spectrum_analyser::get_peak_frequency() const
+{
+	auto s = this->get();
+	if (s.num_spectra == 0) {
+		return 0;
+	}
+
+	const auto& m = s.magnitudes;
+
+	// skip DC and Nyquist bins, so that there are neighbours for interpolation
+	auto peak = std::max_element(std::next(m.begin()), std::prev(m.end()));
+	auto k = size_t(std::distance(m.begin(), peak));
+
+	float a = m[k - 1];
+	float b = m[k];
+	float c = m[k + 1];
+
+	float denominator = a - 2 * b + c;
+	float delta = denominator == 0 ? 0 : 0.5f * (a - c) / denominator;
+
+	return (float(k) + delta) * s.bin_width;
+}
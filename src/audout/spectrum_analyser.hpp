@@ -0,0 +1,195 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <atomic>
+#include <complex>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <utki/span.hpp>
+
+#include "fft.hpp"
+#include "format.hpp"
+#include "ring_buffer.hpp"
+
+namespace audout {
+
+/**
+ * @brief Spectrum analyser.
+ * The audio thread only downmixes the pushed samples to mono and copies them to a lock-free ring buffer.
+ * A separate low priority analysis thread takes windowed FFTs of the signal each hop_size samples and
+ * publishes the magnitude spectrum. In case the analysis thread falls behind, the samples which do not
+ * fit into the ring buffer are dropped.
+ *
+ * Typical usage:
+ * @code
+ * audout::spectrum_analyser analyser(48000);
+ * player.set_spectrum_analyser(&analyser);
+ *
+ * // in any thread
+ * auto frequency = analyser.get_peak_frequency();
+ * @endcode
+ */
+class spectrum_analyser
+{
+public:
+	constexpr static size_t default_fft_size = 4096;
+
+	struct spectrum {
+		/**
+		 * @brief Magnitudes of fft_size / 2 + 1 frequency bins from 0 to Nyquist frequency.
+		 * Scaled so that a full scale sine wave gives magnitude of about 1 in its bin.
+		 */
+		std::vector<float> magnitudes;
+
+		/**
+		 * @brief Width of a frequency bin in Hz.
+		 */
+		float bin_width = 0;
+
+		/**
+		 * @brief Number of spectra computed since the analyser creation.
+		 * Allows pollers to tell whether the spectrum has been updated since last poll.
+		 */
+		uint32_t num_spectra = 0;
+	};
+
+private:
+	const uint32_t sampling_rate;
+	const size_t hop_size;
+
+	ring_buffer<float> ring;
+
+	std::atomic<uint32_t> num_dropped_samples{0};
+
+	// analysis thread state
+	real_fft fft;
+	std::vector<float> window;
+	std::vector<float> history;
+	std::vector<float> hop_buffer;
+	size_t hop_buffer_size = 0;
+	std::vector<float> windowed;
+	std::vector<std::complex<float>> bins;
+
+	mutable std::mutex spectrum_mutex;
+	spectrum latest;
+
+	std::mutex thread_mutex;
+	std::condition_variable thread_cv;
+	bool quit = false;
+
+	std::thread thread;
+
+	template <typename sample_type>
+	void push_samples(utki::span<const sample_type> buf, unsigned num_channels) noexcept;
+
+	void run();
+
+	void analyse();
+
+public:
+	/**
+	 * @brief Create spectrum analyser.
+	 * Starts the analysis thread.
+	 * @param sampling_rate - sampling rate of the analysed signal, used for converting bins to Hz.
+	 * @param fft_size - size of the FFT, i.e. the number of samples in each analysed window. Must be a power of 2.
+	 * @param hop_size - number of samples between starts of consecutive analysed windows. 0 means fft_size / 2.
+	 * @throw std::invalid_argument - in case fft_size is not a power of 2 or is less than 4.
+	 */
+	spectrum_analyser(uint32_t sampling_rate, size_t fft_size = default_fft_size, size_t hop_size = 0);
+
+	spectrum_analyser(const spectrum_analyser&) = delete;
+	spectrum_analyser& operator=(const spectrum_analyser&) = delete;
+
+	spectrum_analyser(spectrum_analyser&&) = delete;
+	spectrum_analyser& operator=(spectrum_analyser&&) = delete;
+
+	~spectrum_analyser();
+
+	/**
+	 * @brief Push samples for analysis.
+	 * Wait-free, never allocates. Must be called from single thread, normally the audio thread.
+	 * @param buf - interleaved samples.
+	 * @param num_channels - number of channels in the samples.
+	 */
+	void push(utki::span<const int16_t> buf, unsigned num_channels) noexcept;
+
+	/**
+	 * @brief Push samples for analysis.
+	 * Wait-free, never allocates. Must be called from single thread, normally the audio thread.
+	 * @param buf - interleaved samples.
+	 * @param num_channels - number of channels in the samples.
+	 */
+	void push(utki::span<const int24> buf, unsigned num_channels) noexcept;
+
+	/**
+	 * @brief Push samples for analysis.
+	 * Wait-free, never allocates. Must be called from single thread, normally the audio thread.
+	 * @param buf - interleaved samples.
+	 * @param num_channels - number of channels in the samples.
+	 */
+	void push(utki::span<const int32_t> buf, unsigned num_channels) noexcept;
+
+	/**
+	 * @brief Push samples for analysis.
+	 * Wait-free, never allocates. Must be called from single thread, normally the audio thread.
+	 * @param buf - interleaved samples.
+	 * @param num_channels - number of channels in the samples.
+	 */
+	void push(utki::span<const float> buf, unsigned num_channels) noexcept;
+
+	/**
+	 * @brief Get latest spectrum.
+	 * Can be called from any thread except the audio thread, as it copies the spectrum under a mutex.
+	 * @return Copy of the latest spectrum.
+	 */
+	spectrum get() const;
+
+	/**
+	 * @brief Get frequency of the strongest spectral component.
+	 * The frequency is refined by parabolic interpolation of the magnitudes around the strongest bin.
+	 * Can be called from any thread except the audio thread.
+	 * @return Frequency in Hz.
+	 * @return 0 if no spectrum has been computed yet.
+	 */
+	float get_peak_frequency() const;
+
+	/**
+	 * @brief Get number of samples dropped because the analysis thread fell behind.
+	 * @return Number of dropped mono samples.
+	 */
+	uint32_t get_num_dropped_samples() const noexcept
+	{
+		return this->num_dropped_samples.load(std::memory_order_relaxed);
+	}
+};
+
+} // namespace audout
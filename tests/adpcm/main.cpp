@@ -0,0 +1,224 @@
+// Tests IMA-ADPCM codec against a straightforward reference implementation of the IMA algorithm,
+// and playback of the clips by voices with various buffer sizes and starting positions.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <utki/debug.hpp>
+
+#include "../../src/audout/adpcm.hpp"
+
+namespace {
+
+// step table from the IMA ADPCM specification
+constexpr std::array<int, 89> reference_steps = {
+	7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,
+	31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+	130,   143,   157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,
+	544,   598,   658,   724,   796,   876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+	2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,
+	9493,  10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+constexpr std::array<int, 8> reference_index_adjustments = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+struct reference_state {
+	int predictor = 0;
+	int index = 0;
+
+	void decode(unsigned code)
+	{
+		int step = reference_steps[size_t(this->index)];
+
+		int diff = step >> 3;
+		if (code & 4) {
+			diff += step;
+		}
+		if (code & 2) {
+			diff += step >> 1;
+		}
+		if (code & 1) {
+			diff += step >> 2;
+		}
+
+		if (code & 8) {
+			this->predictor -= diff;
+		} else {
+			this->predictor += diff;
+		}
+
+		this->predictor = std::clamp(this->predictor, -32768, 32767);
+		this->index = std::clamp(this->index + reference_index_adjustments[code & 7], 0, 88);
+	}
+
+	unsigned encode(int sample)
+	{
+		int diff = sample - this->predictor;
+		unsigned code = 0;
+		if (diff < 0) {
+			code = 8;
+			diff = -diff;
+		}
+
+		int step = reference_steps[size_t(this->index)];
+		for (unsigned bit = 4; bit != 0; bit >>= 1) {
+			if (diff >= step) {
+				code |= bit;
+				diff -= step;
+			}
+			step >>= 1;
+		}
+
+		this->decode(code);
+		return code;
+	}
+};
+
+// encodes and decodes the PCM with the same block layout the clip uses:
+// each block starts from its first sample, the step index is carried on from the previous block
+std::vector<int16_t> reference_round_trip(const std::vector<int16_t>& pcm, unsigned num_channels, unsigned block_frames)
+{
+	auto num_frames = pcm.size() / num_channels;
+	std::vector<int16_t> ret(pcm.size());
+
+	for (unsigned c = 0; c != num_channels; ++c) {
+		reference_state encoder;
+		for (size_t block = 0; block < num_frames; block += block_frames) {
+			auto end = std::min(num_frames, block + block_frames);
+
+			encoder.predictor = pcm[block * num_channels + c];
+			reference_state decoder = encoder;
+			ret[block * num_channels + c] = int16_t(decoder.predictor);
+
+			for (size_t i = block + 1; i != end; ++i) {
+				decoder.decode(encoder.encode(pcm[i * num_channels + c]));
+				ret[i * num_channels + c] = int16_t(decoder.predictor);
+			}
+		}
+	}
+
+	return ret;
+}
+
+std::vector<int16_t> make_pcm(size_t num_frames, unsigned num_channels)
+{
+	std::mt19937 rng(num_frames);
+	std::uniform_int_distribution<int> noise(-2000, 2000);
+
+	std::vector<int16_t> ret(num_frames * num_channels);
+	for (size_t i = 0; i != num_frames; ++i) {
+		for (unsigned c = 0; c != num_channels; ++c) {
+			constexpr double amplitude = 20000;
+			// a loud sine with noise, and a full scale square wave to hit the step table limits and clamping
+			double v = amplitude * std::sin(0.01 * double(i * (c + 1))) + noise(rng);
+			if ((i / 500) % 4 == 3) {
+				v = (i / 7) % 2 == 0 ? 32767 : -32768;
+			}
+			ret[i * num_channels + c] = int16_t(std::clamp(v, -32768.0, 32767.0));
+		}
+	}
+	return ret;
+}
+
+std::vector<int16_t> decode_all(const audout::adpcm_clip& clip)
+{
+	std::vector<int16_t> ret(clip.get_num_frames() * clip.get_num_channels());
+	for (size_t b = 0; b != clip.get_num_blocks(); ++b) {
+		auto offset = b * clip.get_num_block_frames() * clip.get_num_channels();
+		clip.decode(b, utki::make_span(ret).subspan(offset, size_t(clip.get_num_frames(b)) * clip.get_num_channels()));
+	}
+	return ret;
+}
+
+void check_voice(
+	const std::shared_ptr<const audout::adpcm_clip>& clip,
+	const std::vector<int16_t>& expected,
+	size_t start_frame,
+	size_t chunk_frames
+)
+{
+	auto num_channels = clip->get_num_channels();
+
+	audout::adpcm_voice voice(clip);
+	voice.seek(start_frame);
+
+	std::vector<int16_t> buf(chunk_frames * num_channels);
+
+	// seeking past the end stops at the end
+	size_t frame = std::min(start_frame, clip->get_num_frames());
+	utki::assert(voice.get_position() == frame, SL);
+
+	while (!voice.is_finished()) {
+		auto n = voice.fill(utki::make_span(buf));
+		utki::assert(n == std::min(chunk_frames, clip->get_num_frames() - frame), SL);
+		utki::assert(
+			std::equal(
+				buf.begin(),
+				std::next(buf.begin(), ptrdiff_t(n * num_channels)),
+				std::next(expected.begin(), ptrdiff_t(frame * num_channels))
+			),
+			[&](auto& o) {
+				o << "start = " << start_frame << ", chunk = " << chunk_frames << ", frame = " << frame;
+			},
+			SL
+		);
+		frame += n;
+	}
+	utki::assert(frame == clip->get_num_frames(), SL);
+	utki::assert(voice.fill(utki::make_span(buf)) == 0, SL);
+}
+
+void test_codec(unsigned num_channels, unsigned block_frames, size_t num_frames)
+{
+	auto pcm = make_pcm(num_frames, num_channels);
+	auto clip = std::make_shared<audout::adpcm_clip>(pcm, num_channels, block_frames);
+
+	utki::assert(clip->get_num_frames() == num_frames, SL);
+
+	auto decoded = decode_all(*clip);
+	auto reference = reference_round_trip(pcm, num_channels, block_frames);
+	utki::assert(decoded == reference, [&](auto& o) {
+		o << "channels = " << num_channels << ", block = " << block_frames << ", frames = " << num_frames;
+	}, SL);
+
+	// the codec tracks the signal, apart from the full scale square wave parts it can not follow
+	double error = 0;
+	double energy = 0;
+	for (size_t i = 0; i != pcm.size(); ++i) {
+		if ((i / num_channels / 500) % 4 == 3) {
+			continue;
+		}
+		error += std::pow(double(pcm[i]) - double(decoded[i]), 2);
+		energy += std::pow(double(pcm[i]), 2);
+	}
+	constexpr double min_snr_db = 20;
+	utki::assert(10 * std::log10(energy / error) > min_snr_db, SL);
+
+	// whole blocks, partial blocks through the cache, and starts in the middle of a block
+	for (size_t chunk : {size_t(1), size_t(7), size_t(block_frames), size_t(block_frames + 3), num_frames}) {
+		for (size_t start : {size_t(0), size_t(1), size_t(block_frames / 2), size_t(block_frames), num_frames - 1}) {
+			check_voice(clip, decoded, start, chunk);
+		}
+	}
+}
+
+} // namespace
+
+int main()
+{
+	for (unsigned num_channels : {1, 2}) {
+		// even and odd block sizes, clips with partial last blocks of even and odd size
+		test_codec(num_channels, audout::adpcm_clip::default_num_block_frames, 10000);
+		test_codec(num_channels, 32, 1000);
+		test_codec(num_channels, 33, 1001);
+		test_codec(num_channels, 33, 1003);
+		test_codec(num_channels, 64, 1);
+	}
+
+	return 0;
+}
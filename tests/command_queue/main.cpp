@@ -0,0 +1,104 @@
+// Tests multi-producer single-consumer command queue.
+// Several producer threads push sequences of numbered commands concurrently, retrying while the queue is full,
+// while the consumer pops them. Checks that every command arrives exactly once and in order per producer.
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <utki/debug.hpp>
+
+#include "../../src/audout/command_queue.hpp"
+
+namespace {
+
+struct command {
+	uint32_t producer;
+	uint32_t sequence;
+};
+
+void test_single_thread()
+{
+	audout::command_queue<command> queue(5);
+	utki::assert(queue.capacity() == 8, SL);
+
+	utki::assert(!queue.pop().has_value(), SL);
+
+	// fill and drain several times, so that the positions wrap around the cells
+	for (uint32_t round = 0; round != 3; ++round) {
+		for (uint32_t i = 0; i != queue.capacity(); ++i) {
+			utki::assert(queue.push({round, i}), SL);
+		}
+		utki::assert(!queue.push({round, 0}), SL);
+
+		for (uint32_t i = 0; i != queue.capacity(); ++i) {
+			auto c = queue.pop();
+			utki::assert(c.has_value() && c->producer == round && c->sequence == i, SL);
+		}
+		utki::assert(!queue.pop().has_value(), SL);
+	}
+}
+
+void test_concurrent(unsigned num_producers, uint32_t num_commands, size_t capacity)
+{
+	audout::command_queue<command> queue(capacity);
+
+	std::atomic_bool start = false;
+
+	std::vector<std::thread> producers;
+	for (unsigned p = 0; p != num_producers; ++p) {
+		producers.emplace_back([&, p]() {
+			while (!start.load(std::memory_order_acquire)) {
+				std::this_thread::yield();
+			}
+			for (uint32_t i = 0; i != num_commands; ++i) {
+				while (!queue.push({p, i})) {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	std::vector<uint32_t> next_sequence(num_producers, 0);
+	uint64_t num_received = 0;
+	uint64_t num_expected = uint64_t(num_producers) * num_commands;
+
+	start.store(true, std::memory_order_release);
+
+	while (num_received != num_expected) {
+		auto c = queue.pop();
+		if (!c.has_value()) {
+			std::this_thread::yield();
+			continue;
+		}
+		utki::assert(c->producer < num_producers, SL);
+		utki::assert(c->sequence == next_sequence[c->producer], [&](auto& o) {
+			o << "producer = " << c->producer << ", expected = " << next_sequence[c->producer]
+			  << ", got = " << c->sequence;
+		}, SL);
+		++next_sequence[c->producer];
+		++num_received;
+	}
+
+	for (auto& t : producers) {
+		t.join();
+	}
+
+	utki::assert(!queue.pop().has_value(), SL);
+}
+
+} // namespace
+
+int main()
+{
+	test_single_thread();
+
+	// small queue is full most of the time, large one is not
+	constexpr uint32_t num_commands = 100000;
+	test_concurrent(4, num_commands, 4);
+	test_concurrent(4, num_commands, 1024);
+	test_concurrent(1, num_commands, 2);
+
+	return 0;
+}
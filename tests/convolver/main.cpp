@@ -0,0 +1,194 @@
+// Tests convolver.
+// Checks that the output is the input convolved with the impulse responses and delayed by the reported latency,
+// for impulse responses shorter and longer than the head segment, i.e. with and without the tail processed
+// by the worker thread. The frames are passed by chunks which are not multiples of the block size.
+// Then makes the worker thread late by a burst of frames and checks that once it catches up the tail
+// is aligned with the head again.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <utki/debug.hpp>
+
+#include "../../src/audout/convolver.hpp"
+
+namespace {
+
+// the worker thread is given time to process the tail, chunks are still passed faster than real time
+constexpr auto chunk_interval = std::chrono::milliseconds(1);
+
+std::vector<float> make_noise(std::mt19937& rng, size_t size, float amplitude)
+{
+	std::normal_distribution<float> dist(0, amplitude);
+	std::vector<float> ret(size);
+	for (auto& s : ret) {
+		s = dist(rng);
+	}
+	return ret;
+}
+
+void process_paced(audout::convolver& c, utki::span<float> buf, size_t chunk_frames)
+{
+	auto chunk_samples = chunk_frames * c.get_num_channels();
+	for (size_t pos = 0; pos < buf.size(); pos += chunk_samples) {
+		c.process(buf.subspan(pos, std::min(chunk_samples, buf.size() - pos)));
+		std::this_thread::sleep_for(chunk_interval);
+	}
+}
+
+// direct form FIR of each channel, delayed by the latency
+std::vector<float> convolve_directly(
+	const std::vector<float>& in, //
+	const std::vector<std::vector<float>>& impulse_responses,
+	size_t latency
+)
+{
+	auto num_channels = impulse_responses.size();
+	auto num_frames = in.size() / num_channels;
+
+	std::vector<float> out(in.size(), 0);
+	for (size_t ch = 0; ch != num_channels; ++ch) {
+		const auto& ir = impulse_responses[ch];
+		for (size_t frame = latency; frame < num_frames; ++frame) {
+			size_t input_frame = frame - latency;
+			double sum = 0;
+			for (size_t k = 0; k != std::min(ir.size(), input_frame + 1); ++k) {
+				sum += double(ir[k]) * double(in[(input_frame - k) * num_channels + ch]);
+			}
+			out[frame * num_channels + ch] = float(sum);
+		}
+	}
+	return out;
+}
+
+void check_equal(const std::vector<float>& expected, const std::vector<float>& actual, size_t begin, const char* what)
+{
+	utki::assert(expected.size() == actual.size(), SL);
+	for (size_t i = begin; i != expected.size(); ++i) {
+		utki::assert(std::abs(expected[i] - actual[i]) < 1e-4f, [&](auto& o) {
+			o << what << ": sample " << i << ", expected = " << expected[i] << ", actual = " << actual[i];
+		}, SL);
+	}
+}
+
+void test_delay()
+{
+	constexpr size_t block_size = 64;
+	audout::convolver c({{1}, {0, 1}}, block_size);
+	utki::assert(c.get_num_channels() == 2, SL);
+	utki::assert(c.get_latency() == block_size, SL);
+
+	constexpr size_t num_frames = 1000;
+	std::vector<int16_t> in(num_frames * 2);
+	for (size_t i = 0; i != in.size(); ++i) {
+		in[i] = int16_t(i * 31 % 2000 - 1000);
+	}
+
+	auto out = in;
+	for (size_t pos = 0; pos < out.size(); pos += 2 * 45) {
+		c.process(utki::make_span(out).subspan(pos, std::min(size_t(2 * 45), out.size() - pos)));
+	}
+
+	for (size_t frame = 0; frame != num_frames; ++frame) {
+		for (size_t ch = 0; ch != 2; ++ch) {
+			size_t delay = block_size + ch;
+			int16_t expected = frame < delay ? 0 : in[(frame - delay) * 2 + ch];
+			utki::assert(out[frame * 2 + ch] == expected, [&](auto& o) {
+				o << "frame = " << frame << ", channel = " << ch << ", expected = " << expected
+				  << ", actual = " << out[frame * 2 + ch];
+			}, SL);
+		}
+	}
+}
+
+void test_fir(size_t block_size, size_t ir_length)
+{
+	std::mt19937 rng{std::mt19937::result_type(ir_length)};
+
+	// channels have different lengths, the second one is shorter than the head segment
+	std::vector<std::vector<float>> irs = {
+		make_noise(rng, ir_length, 0.05f),
+		make_noise(rng, std::min(ir_length, block_size * 3), 0.05f),
+		make_noise(rng, ir_length + 13, 0.05f)
+	};
+
+	audout::convolver c(irs, block_size);
+
+	constexpr size_t num_frames = 6000;
+	auto in = make_noise(rng, num_frames * irs.size(), 0.1f);
+
+	auto out = in;
+	// chunks are not larger than the block size, as with the player's period
+	process_paced(c, utki::make_span(out), block_size - 5);
+
+	utki::assert(c.get_num_late_frames() == 0, [&](auto& o) {
+		o << "ir_length = " << ir_length << ", late frames = " << c.get_num_late_frames();
+	}, SL);
+
+	check_equal(convolve_directly(in, irs, c.get_latency()), out, 0, "fir");
+}
+
+void test_realignment()
+{
+	constexpr size_t block_size = 16;
+	constexpr size_t ir_length = 4096;
+	constexpr size_t chunk_frames = block_size - 5;
+
+	std::mt19937 rng(1);
+	std::vector<std::vector<float>> irs = {make_noise(rng, ir_length, 0.01f)};
+
+	audout::convolver c(irs, block_size);
+
+	// the tail is much more expensive than the head, so the worker thread cannot keep up with the burst
+	auto burst = make_noise(rng, 10 * ir_length, 0.1f);
+	for (size_t pos = 0; pos < burst.size(); pos += chunk_frames) {
+		c.process(utki::make_span(burst).subspan(pos, std::min(chunk_frames, burst.size() - pos)));
+	}
+	utki::assert(c.get_num_late_frames() != 0, SL);
+
+	// let the contribution of the burst die out
+	std::vector<float> silence(ir_length + 16 * audout::convolver::tail_block_ratio * block_size, 0);
+	process_paced(c, utki::make_span(silence), chunk_frames);
+
+	auto num_late_frames = c.get_num_late_frames();
+
+	constexpr size_t num_frames = 4096;
+	auto in = make_noise(rng, num_frames, 0.1f);
+	auto out = in;
+	process_paced(c, utki::make_span(out), chunk_frames);
+
+	utki::assert(c.get_num_late_frames() == num_late_frames, SL);
+
+	// the output starts with the latency delayed remains of the silence
+	auto expected = convolve_directly(in, irs, c.get_latency());
+	check_equal(expected, out, 0, "realigned");
+}
+
+} // namespace
+
+int main()
+{
+	test_delay();
+
+	constexpr size_t block_size = 64;
+	constexpr size_t head_length = 2 * audout::convolver::tail_block_ratio * block_size;
+
+	// head only
+	test_fir(block_size, 1);
+	test_fir(block_size, 100);
+	test_fir(block_size, head_length);
+
+	// with tail
+	test_fir(block_size, head_length + 1);
+	test_fir(block_size, 3 * head_length + 5);
+	test_fir(16, 5000);
+
+	test_realignment();
+
+	return 0;
+}
@@ -0,0 +1,189 @@
+// Tests processing graph and benchmarks its parallel rendering.
+// Builds a graph of a source feeding many effect branches mixed by a bus, plus a branch
+// through a delay node, and checks that the output is aligned by latency compensation.
+// Then reports the render time per block with different numbers of worker threads.
+// The first argument is the number of branches, 64 by default.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <utki/debug.hpp>
+
+#include "../../src/audout/graph.hpp"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr unsigned num_channels = 2;
+constexpr size_t block_frames = 256;
+constexpr uint32_t delay_frames = 100;
+constexpr float branch_gain = 0.01f;
+
+float source_value(uint64_t frame, unsigned channel)
+{
+	constexpr float step = 0.01f;
+	return std::sin(step * float(frame) + float(channel));
+}
+
+class source : public audout::graph::node
+{
+	uint64_t frame = 0;
+
+public:
+	void process(utki::span<const float>, utki::span<float> out) noexcept override
+	{
+		for (auto i = out.begin(); i != out.end(); ++this->frame) {
+			for (unsigned ch = 0; ch != num_channels; ++ch, ++i) {
+				*i = source_value(this->frame, ch);
+			}
+		}
+	}
+};
+
+// delays the input and reports the delay as latency
+class delay : public audout::graph::node
+{
+	std::vector<float> line = std::vector<float>(size_t(delay_frames) * num_channels);
+	size_t pos = 0;
+
+public:
+	void process(utki::span<const float> in, utki::span<float> out) noexcept override
+	{
+		for (size_t i = 0; i != in.size(); ++i) {
+			out[i] = this->line[this->pos];
+			this->line[this->pos] = in[i];
+			this->pos = (this->pos + 1) % this->line.size();
+		}
+	}
+
+	uint32_t get_latency() const noexcept override
+	{
+		return delay_frames;
+	}
+};
+
+// one-pole lowpass applied many times to have some load, the output converges to the input
+class branch : public audout::graph::node
+{
+	std::vector<float> state = std::vector<float>(num_channels);
+
+public:
+	void process(utki::span<const float> in, utki::span<float> out) noexcept override
+	{
+		constexpr unsigned num_iterations = 64;
+		constexpr float coefficient = 0.5f;
+
+		for (size_t i = 0; i != in.size(); ++i) {
+			auto& s = this->state[i % num_channels];
+			for (unsigned k = 0; k != num_iterations; ++k) {
+				s += (in[i] - s) * coefficient;
+			}
+			out[i] = s * branch_gain;
+		}
+	}
+};
+
+struct rig {
+	source src;
+	delay dly;
+	std::vector<std::unique_ptr<branch>> branches;
+	audout::graph g;
+
+	rig(unsigned num_branches, unsigned num_workers) :
+		g(num_channels, block_frames, num_workers)
+	{
+		auto src_id = this->g.add(this->src, 0, num_channels);
+		auto dly_id = this->g.add(this->dly, num_channels, num_channels);
+		auto bus_id = this->g.add_bus(num_channels);
+
+		this->g.connect(src_id, dly_id);
+		this->g.connect(dly_id, this->g.get_output());
+		this->g.connect(bus_id, this->g.get_output());
+
+		for (unsigned i = 0; i != num_branches; ++i) {
+			this->branches.push_back(std::make_unique<branch>());
+			auto id = this->g.add(*this->branches.back(), num_channels, num_channels);
+			this->g.connect(src_id, id);
+			this->g.connect(id, bus_id);
+		}
+
+		this->g.compile();
+	}
+};
+
+void check_alignment(unsigned num_branches)
+{
+	rig r(num_branches, audout::graph::get_default_num_workers());
+	utki::assert(r.g.get_latency() == delay_frames, SL);
+
+	// the direct branches are delayed to match the delay node, so the output is the delayed source
+	// with the gain of 1 + number of branches times branch gain
+	auto gain = 1 + float(num_branches) * branch_gain;
+
+	// the lowpass branches need a few frames to converge
+	constexpr uint64_t settle_frames = 16;
+	constexpr float tolerance = 1e-3f;
+
+	std::vector<float> buf(block_frames * num_channels);
+	uint64_t frame = 0;
+	for (unsigned b = 0; b != 16; ++b) {
+		r.g.fill(utki::make_span(buf));
+		for (size_t i = 0; i != block_frames; ++i, ++frame) {
+			if (frame < delay_frames + settle_frames) {
+				continue;
+			}
+			for (unsigned ch = 0; ch != num_channels; ++ch) {
+				auto expected = source_value(frame - delay_frames, ch) * gain;
+				utki::assert(std::abs(buf[i * num_channels + ch] - expected) < tolerance, [&](auto& o) {
+					o << "frame = " << frame << ", expected = " << expected
+					  << ", got = " << buf[i * num_channels + ch];
+				}, SL);
+			}
+		}
+	}
+}
+
+void benchmark(unsigned num_branches, unsigned num_workers)
+{
+	rig r(num_branches, num_workers);
+
+	constexpr unsigned num_blocks = 2000;
+
+	std::vector<float> buf(block_frames * num_channels);
+
+	auto start = clock_type::now();
+	for (unsigned i = 0; i != num_blocks; ++i) {
+		r.g.fill(utki::make_span(buf));
+	}
+	std::chrono::duration<double, std::micro> elapsed = clock_type::now() - start;
+
+	utki::log([&](auto& o) {
+		o << num_workers << " workers: " << elapsed.count() / num_blocks << " us per block of " << block_frames
+		  << " frames" << std::endl;
+	});
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	unsigned num_branches = argc > 1 ? unsigned(std::stoul(argv[1])) : 64;
+
+	check_alignment(num_branches);
+
+	benchmark(num_branches, 0);
+	for (unsigned n = 1; n < audout::graph::get_default_num_workers(); n *= 2) {
+		benchmark(num_branches, n);
+	}
+	if (audout::graph::get_default_num_workers() != 0) {
+		benchmark(num_branches, audout::graph::get_default_num_workers());
+	}
+
+	return 0;
+}
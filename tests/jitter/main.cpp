@@ -0,0 +1,243 @@
+// Measures the audio callback jitter and output latency.
+// For each format and buffer size opens a player, timestamps each listener::fill() call with the
+// monotonic clock and reports the distribution of intervals between the calls along with the output
+// latency reported by the backend.
+// On Linux plays to the PulseAudio sink given as the first argument, "auto_null" by default,
+// which is the null sink PulseAudio creates when there are no other sinks. It can also be created with
+// pactl load-module module-null-sink sink_name=auto_null
+// The intervals are measured until at least 1000 of them are collected, so the long periods at low rates
+// take minutes each.
+// Only built by the test target, it is run manually, as it needs a sound server and takes long.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <utki/config.hpp>
+#include <utki/debug.hpp>
+
+#include "../../src/audout/player.hpp"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// the intervals are measured until at least this number of them is collected, so that the high percentiles
+// are meaningful also for long periods
+constexpr size_t min_num_intervals = 1000;
+
+// but at least for this time, so that short periods are measured over many scheduler ticks
+constexpr auto min_measuring_duration = std::chrono::seconds(1);
+
+// callbacks during this time after resuming are not measured, since the device buffer is being prefilled
+constexpr auto warmup_duration = std::chrono::milliseconds(250);
+
+const std::array<uint32_t, 3> buffer_sizes_frames = {256, 1024, 4096};
+
+class timestamping_listener : public audout::listener
+{
+	// preallocated, so that the callback never allocates
+	std::vector<clock_type::time_point> timestamps;
+	std::atomic<size_t> num_timestamps = 0;
+
+	template <typename sample_type>
+	void fill_silence(utki::span<sample_type> buf) noexcept
+	{
+		auto now = clock_type::now();
+
+		auto i = this->num_timestamps.load(std::memory_order_relaxed);
+		if (i != this->timestamps.size()) {
+			this->timestamps[i] = now;
+			this->num_timestamps.store(i + 1, std::memory_order_release);
+		}
+
+		std::fill(buf.begin(), buf.end(), sample_type{});
+	}
+
+public:
+	timestamping_listener(size_t max_num_timestamps) :
+		timestamps(max_num_timestamps)
+	{}
+
+	void fill(utki::span<int16_t> buf) noexcept override
+	{
+		this->fill_silence(buf);
+	}
+
+	void fill(utki::span<audout::int24> buf) noexcept override
+	{
+		this->fill_silence(buf);
+	}
+
+	void fill(utki::span<int32_t> buf) noexcept override
+	{
+		this->fill_silence(buf);
+	}
+
+	void fill(utki::span<float> buf) noexcept override
+	{
+		this->fill_silence(buf);
+	}
+
+	std::vector<clock_type::time_point> get_timestamps() const
+	{
+		auto n = this->num_timestamps.load(std::memory_order_acquire);
+		return {this->timestamps.begin(), std::next(this->timestamps.begin(), ptrdiff_t(n))};
+	}
+};
+
+const char* to_string(audout::sample_format sample_type)
+{
+	switch (sample_type) {
+		case audout::sample_format::int16:
+			return "int16";
+		case audout::sample_format::int24:
+			return "int24";
+		case audout::sample_format::int32:
+			return "int32";
+		case audout::sample_format::float32:
+			return "float32";
+	}
+	return "unknown";
+}
+
+// nearest-rank percentile of sorted values
+double percentile(const std::vector<double>& sorted, double p)
+{
+	utki::assert(!sorted.empty(), SL);
+	auto rank = size_t(std::ceil(p / 100 * double(sorted.size())));
+	return sorted[std::clamp(rank, size_t(1), sorted.size()) - 1];
+}
+
+// intervals in microseconds between the callbacks made after the warmup
+std::vector<double> get_intervals(
+	const std::vector<clock_type::time_point>& timestamps, //
+	clock_type::time_point start_time
+)
+{
+	std::vector<double> intervals;
+	for (size_t i = 1; i < timestamps.size(); ++i) {
+		if (timestamps[i - 1] < start_time + warmup_duration) {
+			continue;
+		}
+		intervals.push_back(
+			std::chrono::duration<double, std::micro>(timestamps[i] - timestamps[i - 1]).count() //
+		);
+	}
+	return intervals;
+}
+
+void measure(audout::format format, uint32_t num_buffer_frames)
+{
+	auto period = std::chrono::duration<double, std::micro>(
+		double(num_buffer_frames) / double(format.frequency()) * std::micro::den
+	);
+
+	auto measuring_duration = std::chrono::duration_cast<clock_type::duration>(
+		std::max<std::chrono::duration<double, std::micro>>(min_measuring_duration, period * double(min_num_intervals))
+	);
+
+	// callbacks can come late, so the measuring is extended up to twice the expected duration
+	auto max_measuring_duration = 2 * measuring_duration;
+
+	// reserve for callbacks coming several times more often than once per period
+	constexpr size_t max_callbacks_per_period = 4;
+	auto max_num_timestamps = size_t(
+		max_callbacks_per_period * (max_measuring_duration + warmup_duration) / period + max_callbacks_per_period
+	);
+
+	timestamping_listener listener(max_num_timestamps);
+
+	audout::player p(format, num_buffer_frames, &listener);
+
+	auto start_time = clock_type::now();
+	p.set_paused(false);
+
+	std::this_thread::sleep_for(warmup_duration + measuring_duration);
+
+	auto deadline = start_time + warmup_duration + max_measuring_duration;
+	while (get_intervals(listener.get_timestamps(), start_time).size() < min_num_intervals &&
+		   clock_type::now() < deadline)
+	{
+		constexpr auto poll_interval = std::chrono::milliseconds(100);
+		std::this_thread::sleep_for(poll_interval);
+	}
+
+	auto output_latency = p.get_output_latency();
+	auto wakeup_rate = p.get_wakeup_rate();
+	auto geometry = p.get_buffer_geometry();
+
+	p.set_paused(true);
+
+	auto intervals = get_intervals(listener.get_timestamps(), start_time);
+	std::sort(intervals.begin(), intervals.end());
+
+	utki::log([&](auto& o) {
+		o << std::fixed << std::setprecision(0);
+		o << to_string(format.sample_type) << " " << format.num_channels() << "ch " << format.frequency() << " Hz, "
+		  << num_buffer_frames << " frames (" << period.count() << " us): ";
+		if (intervals.empty()) {
+			o << "no callbacks" << std::endl;
+			return;
+		}
+		o << "callbacks = " << intervals.size() + 1 //
+		  << ", interval us: min = " << intervals.front() //
+		  << ", p50 = " << percentile(intervals, 50) //
+		  << ", p99 = " << percentile(intervals, 99) //
+		  << ", p99.9 = " << percentile(intervals, 99.9) //
+		  << ", max = " << intervals.back() //
+		  << "; output latency = " << output_latency.count() << " us" //
+		  << ", device buffer = " << geometry.buffer_frames << " frames" //
+		  << ", wakeups = " << std::setprecision(1) << wakeup_rate << "/s" << std::endl;
+	});
+}
+
+} // namespace
+
+int main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[])
+{
+#if CFG_OS == CFG_OS_LINUX && CFG_OS_NAME != CFG_OS_NAME_ANDROID
+	// PulseAudio clients play to the sink from this variable when no device is specified
+	setenv("PULSE_SINK", argc > 1 ? argv[1] : "auto_null", 1);
+#endif
+
+	std::vector<audout::format> formats;
+
+	// all channel layouts and rates with 16-bit samples
+	for (auto frame_type : {audout::frame::mono, audout::frame::stereo}) {
+		for (auto rate : {
+				 audout::rate::hz_11025,
+				 audout::rate::hz_22050,
+				 audout::rate::hz_44100,
+				 audout::rate::hz_48000
+			 })
+		{
+			formats.emplace_back(frame_type, rate);
+		}
+	}
+
+	// the rest of sample formats
+	for (auto sample_type : {
+			 audout::sample_format::int24,
+			 audout::sample_format::int32,
+			 audout::sample_format::float32
+		 })
+	{
+		formats.emplace_back(audout::frame::stereo, audout::rate::hz_48000, sample_type);
+	}
+
+	for (const auto& f : formats) {
+		for (auto num_frames : buffer_sizes_frames) {
+			measure(f, num_frames);
+		}
+	}
+
+	return 0;
+}
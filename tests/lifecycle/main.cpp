@@ -0,0 +1,143 @@
+// Benchmarks player construction and destruction.
+// Creates and destroys a player many times and reports the latency distribution of each phase:
+// construction, time from resuming to the first listener::fill() call and destruction of the playing player.
+// The first argument is the number of cycles, 1000 by default.
+// On Linux the cycles are also run with the simulated device, which shows the library's own overhead
+// without the sound server.
+// Only built by the test target, it is run manually, as it needs a sound server and takes long.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <utki/config.hpp>
+#include <utki/debug.hpp>
+
+#include "../../src/audout/player.hpp"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+const audout::format format(audout::frame::stereo, audout::rate::hz_48000);
+
+constexpr uint32_t num_buffer_frames = 1024;
+
+class first_fill_listener : public audout::listener
+{
+	// written by the audio thread before setting the flag
+	clock_type::time_point first_fill_time;
+	std::atomic_bool filled = false;
+
+public:
+	void fill(utki::span<int16_t> buf) noexcept override
+	{
+		if (!this->filled.load(std::memory_order_relaxed)) {
+			this->first_fill_time = clock_type::now();
+			this->filled.store(true, std::memory_order_release);
+		}
+		std::fill(buf.begin(), buf.end(), 0);
+	}
+
+	clock_type::time_point wait_first_fill()
+	{
+		while (!this->filled.load(std::memory_order_acquire)) {
+			std::this_thread::yield();
+		}
+		return this->first_fill_time;
+	}
+};
+
+struct phase {
+	const char* name;
+	std::vector<double> durations_us;
+
+	void add(clock_type::duration d)
+	{
+		this->durations_us.push_back(std::chrono::duration<double, std::micro>(d).count());
+	}
+
+	void report()
+	{
+		utki::assert(!this->durations_us.empty(), SL);
+
+		auto& v = this->durations_us;
+		std::sort(v.begin(), v.end());
+
+		// nearest-rank percentile
+		auto percentile = [&](double p) {
+			auto rank = size_t(std::ceil(p / 100 * double(v.size())));
+			return v[std::clamp(rank, size_t(1), v.size()) - 1];
+		};
+
+		utki::log([&](auto& o) {
+			o << "  " << this->name << " us: min = " << v.front() << ", p50 = " << percentile(50)
+			  << ", p99 = " << percentile(99) << ", max = " << v.back() << std::endl;
+		});
+	}
+};
+
+// make_player constructs a player playing to the given listener
+void run_cycles(
+	const char* title,
+	unsigned num_cycles,
+	const std::function<std::unique_ptr<audout::player>(audout::listener&)>& make_player
+)
+{
+	phase construction{"construction", {}};
+	phase first_fill{"first fill", {}};
+	phase destruction{"destruction", {}};
+
+	for (unsigned i = 0; i != num_cycles; ++i) {
+		first_fill_listener listener;
+
+		auto start = clock_type::now();
+		auto p = make_player(listener);
+		auto constructed = clock_type::now();
+
+		p->set_paused(false);
+		auto filled = listener.wait_first_fill();
+
+		auto destroy_start = clock_type::now();
+		p.reset();
+		auto destroyed = clock_type::now();
+
+		construction.add(constructed - start);
+		first_fill.add(filled - constructed);
+		destruction.add(destroyed - destroy_start);
+	}
+
+	utki::log([&](auto& o) {
+		o << title << ", " << num_cycles << " cycles:" << std::endl;
+	});
+	construction.report();
+	first_fill.report();
+	destruction.report();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	unsigned num_cycles = argc > 1 ? unsigned(std::stoul(argv[1])) : 1000;
+
+	run_cycles("default device", num_cycles, [](audout::listener& l) {
+		return std::make_unique<audout::player>(format, num_buffer_frames, &l);
+	});
+
+#if CFG_OS == CFG_OS_LINUX
+	audout::simulated_device device;
+	run_cycles("simulated device", num_cycles, [&](audout::listener& l) {
+		return std::make_unique<audout::player>(format, num_buffer_frames, &l, device);
+	});
+#endif
+
+	return 0;
+}
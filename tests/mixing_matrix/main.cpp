@@ -0,0 +1,128 @@
+// Tests mixing matrix.
+// Each fast path, i.e. identity, mono to stereo, stereo to mono and stereo to 5.1, as well as the generic path,
+// is checked against straightforward multiplication by the coefficients. The frame counts are not multiples
+// of the vector size, so that both the vectorized loops and the tails are exercised. Also checks that nothing
+// is written past the output frames.
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <utki/debug.hpp>
+
+#include "../../src/audout/mixing_matrix.hpp"
+
+namespace {
+
+constexpr float canary = 12345.0f;
+
+std::vector<float> make_input(size_t num_samples)
+{
+	std::vector<float> ret(num_samples);
+	uint32_t state = 1;
+	for (auto& s : ret) {
+		state = state * 1664525 + 1013904223;
+		s = float(state >> 8) / float(1 << 24) * 2 - 1;
+	}
+	return ret;
+}
+
+std::vector<float> make_identity(unsigned num_channels)
+{
+	std::vector<float> ret(size_t(num_channels) * num_channels, 0);
+	for (unsigned i = 0; i != num_channels; ++i) {
+		ret[size_t(i) * num_channels + i] = 1;
+	}
+	return ret;
+}
+
+void check(
+	const char* name, //
+	unsigned num_inputs,
+	unsigned num_outputs,
+	const std::vector<float>& coefficients,
+	const audout::mixing_matrix& matrix
+)
+{
+	utki::assert(matrix.get_num_inputs() == num_inputs, SL);
+	utki::assert(matrix.get_num_outputs() == num_outputs, SL);
+
+	for (size_t num_frames : {0, 1, 2, 3, 5, 6, 7, 9, 13, 255, 257}) {
+		auto in = make_input(num_frames * num_inputs);
+
+		// extra samples after the output frames are to detect overruns
+		constexpr size_t num_canaries = 8;
+		std::vector<float> out(num_frames * num_outputs + num_canaries, canary);
+
+		matrix.process(utki::make_span(in), utki::make_span(out.data(), num_frames * num_outputs));
+
+		for (size_t frame = 0; frame != num_frames; ++frame) {
+			for (unsigned o = 0; o != num_outputs; ++o) {
+				float expected = 0;
+				for (unsigned i = 0; i != num_inputs; ++i) {
+					expected += coefficients[size_t(o) * num_inputs + i] * in[frame * num_inputs + i];
+				}
+				float actual = out[frame * num_outputs + o];
+				utki::assert(std::abs(actual - expected) <= 1e-6f, [&](auto& o_) {
+					o_ << name << ": num_frames = " << num_frames << ", frame = " << frame << ", channel = " << o
+					   << ", expected = " << expected << ", actual = " << actual;
+				}, SL);
+			}
+		}
+
+		for (size_t i = num_frames * num_outputs; i != out.size(); ++i) {
+			utki::assert(out[i] == canary, [&](auto& o_) {
+				o_ << name << ": num_frames = " << num_frames << ", overrun at " << i;
+			}, SL);
+		}
+	}
+}
+
+void check(const char* name, unsigned num_inputs, unsigned num_outputs, const std::vector<float>& coefficients)
+{
+	audout::mixing_matrix matrix(num_inputs, num_outputs, coefficients);
+	check(name, num_inputs, num_outputs, coefficients, matrix);
+}
+
+} // namespace
+
+int main()
+{
+	using audout::frame;
+
+	// fast paths, both given by coefficients and by the default matrices between layouts
+
+	check("identity 1", 1, 1, make_identity(1));
+	check("identity 2", 2, 2, make_identity(2));
+	check("identity 5.1", 6, 6, make_identity(6));
+	check(
+		"default 5.1 to 5.1",
+		6,
+		6,
+		make_identity(6),
+		audout::mixing_matrix(frame::surround_5_1, frame::surround_5_1)
+	);
+
+	const std::vector<float> mono_to_stereo = {1, 1};
+	check("mono to stereo", 1, 2, mono_to_stereo);
+	check("default mono to stereo", 1, 2, mono_to_stereo, audout::mixing_matrix(frame::mono, frame::stereo));
+
+	const std::vector<float> stereo_to_mono = {0.5f, 0.5f};
+	check("stereo to mono", 2, 1, stereo_to_mono);
+	check("default stereo to mono", 2, 1, stereo_to_mono, audout::mixing_matrix(frame::stereo, frame::mono));
+
+	const std::vector<float> stereo_to_5_1 = {1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0};
+	check("stereo to 5.1", 2, 6, stereo_to_5_1);
+	check("default stereo to 5.1", 2, 6, stereo_to_5_1, audout::mixing_matrix(frame::stereo, frame::surround_5_1));
+
+	// the same shapes with other coefficients go through the generic path
+
+	check("generic 2 to 2", 2, 2, {1, 0.25f, 0, 1});
+	check("generic 1 to 2", 1, 2, {1, 0.5f});
+	check("generic 2 to 1", 2, 1, {0.5f, 0.25f});
+	check("generic 2 to 5.1", 2, 6, {1, 0, 0, 1, 0.5f, 0.5f, 0, 0, 0, 0, 0, 0});
+	check("generic 6 to 2", 6, 2, {0.5f, 0, 0.35f, 0, 0.35f, 0, 0, 0.5f, 0.35f, 0, 0, 0.35f});
+	check("generic 3 to 8", 3, 8, make_input(3 * 8));
+
+	return 0;
+}
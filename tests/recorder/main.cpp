@@ -0,0 +1,277 @@
+// Tests output recorder.
+// Records known buffers in different formats and checks that the file consists of a WAV header
+// describing the format, i.e. WAVEFORMATEX with fact chunk for float samples and WAVE_FORMAT_EXTENSIBLE
+// with channel mask for more than 2 channels or integer samples wider than 16 bits, followed by
+// exactly the pushed samples.
+// Then attaches recorders to a player playing to a simulated device and checks that the player
+// rejects a recorder of another format and passes all the played frames to the recorder of its format.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <utki/config.hpp>
+#include <utki/debug.hpp>
+
+#include "../../src/audout/player.hpp"
+#include "../../src/audout/recorder.hpp"
+
+namespace {
+
+const char* const file_name = "recorder_test.wav";
+
+constexpr uint16_t wave_format_pcm = 1;
+constexpr uint16_t wave_format_ieee_float = 3;
+constexpr uint16_t wave_format_extensible = 0xfffe;
+
+constexpr size_t num_frames = 1000;
+
+std::vector<uint8_t> read_file()
+{
+	std::ifstream f(file_name, std::ios::binary);
+	utki::assert(bool(f), SL);
+	return {std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>()};
+}
+
+uint32_t read_le(const std::vector<uint8_t>& buf, size_t offset, size_t size)
+{
+	utki::assert(offset + size <= buf.size(), SL);
+	uint32_t ret = 0;
+	for (size_t i = 0; i != size; ++i) {
+		ret |= uint32_t(buf[offset + i]) << (i * 8);
+	}
+	return ret;
+}
+
+bool is_tag(const std::vector<uint8_t>& buf, size_t offset, const char* tag)
+{
+	return offset + 4 <= buf.size() && std::memcmp(buf.data() + offset, tag, 4) == 0;
+}
+
+struct expected_header {
+	uint16_t format_tag;
+	uint32_t fmt_size;
+	uint16_t subformat = 0;
+	uint32_t channel_mask = 0;
+	bool has_fact = false;
+};
+
+template <typename sample_type>
+void test_format(audout::format format, const expected_header& expected)
+{
+	std::vector<sample_type> samples(num_frames * format.num_channels());
+	for (size_t i = 0; i != samples.size(); ++i) {
+		if constexpr (std::is_same_v<sample_type, float>) {
+			samples[i] = float(i % 199) / 199.0f - 0.5f;
+		} else {
+			samples[i] = sample_type(int32_t(i * 7919 % 65521) - 32760);
+		}
+	}
+
+	{
+		audout::recorder rec(file_name, format);
+
+		// push in several buffers of whole frames
+		auto num_channels = format.num_channels();
+		for (size_t frame = 0; frame != num_frames;) {
+			auto n = std::min(size_t(300), num_frames - frame);
+			rec.push(utki::make_span(samples).subspan(frame * num_channels, n * num_channels), num_channels);
+			frame += n;
+		}
+
+		// samples of other format are dropped
+		if constexpr (std::is_same_v<sample_type, float>) {
+			std::vector<int16_t> other(num_channels);
+			rec.push(utki::make_span(other), num_channels);
+		} else {
+			std::vector<float> other(num_channels);
+			rec.push(utki::make_span(other), num_channels);
+		}
+	}
+
+	auto file = read_file();
+	std::remove(file_name);
+
+	auto data_size = num_frames * format.frame_size();
+
+	utki::assert(is_tag(file, 0, "RIFF"), SL);
+	utki::assert(read_le(file, 4, 4) == file.size() - 8, SL);
+	utki::assert(is_tag(file, 8, "WAVE"), SL);
+
+	utki::assert(is_tag(file, 12, "fmt "), SL);
+	utki::assert(read_le(file, 16, 4) == expected.fmt_size, SL);
+
+	size_t fmt = 20;
+	utki::assert(read_le(file, fmt, 2) == expected.format_tag, SL);
+	utki::assert(read_le(file, fmt + 2, 2) == format.num_channels(), SL);
+	utki::assert(read_le(file, fmt + 4, 4) == format.frequency(), SL);
+	utki::assert(read_le(file, fmt + 8, 4) == format.frequency() * format.frame_size(), SL);
+	utki::assert(read_le(file, fmt + 12, 2) == format.frame_size(), SL);
+	utki::assert(read_le(file, fmt + 14, 2) == format.sample_size() * 8, SL);
+
+	if (expected.fmt_size > 16) {
+		// cbSize
+		utki::assert(read_le(file, fmt + 16, 2) == expected.fmt_size - 18, SL);
+	}
+
+	if (expected.format_tag == wave_format_extensible) {
+		utki::assert(read_le(file, fmt + 18, 2) == format.sample_size() * 8, SL);
+		utki::assert(read_le(file, fmt + 20, 4) == expected.channel_mask, SL);
+
+		const std::vector<uint8_t> guid_tail =
+			{0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71};
+		utki::assert(read_le(file, fmt + 24, 4) == expected.subformat, SL);
+		utki::assert(
+			std::equal(guid_tail.begin(), guid_tail.end(), std::next(file.begin(), ptrdiff_t(fmt + 28))),
+			SL
+		);
+	}
+
+	size_t pos = fmt + expected.fmt_size;
+
+	if (expected.has_fact) {
+		utki::assert(is_tag(file, pos, "fact"), SL);
+		utki::assert(read_le(file, pos + 4, 4) == 4, SL);
+		utki::assert(read_le(file, pos + 8, 4) == num_frames, SL);
+		pos += 12;
+	}
+
+	utki::assert(is_tag(file, pos, "data"), SL);
+	utki::assert(read_le(file, pos + 4, 4) == data_size, SL);
+	pos += 8;
+
+	utki::assert(file.size() == pos + data_size, [&](auto& o) {
+		o << "file.size() = " << file.size() << ", expected = " << pos + data_size;
+	}, SL);
+	utki::assert(std::memcmp(file.data() + pos, samples.data(), data_size) == 0, SL);
+}
+
+void test_raw()
+{
+	audout::format format(audout::frame::stereo, audout::rate::hz_48000);
+
+	std::vector<int16_t> samples(num_frames * format.num_channels());
+	for (size_t i = 0; i != samples.size(); ++i) {
+		samples[i] = int16_t(i);
+	}
+
+	{
+		audout::recorder rec(file_name, format, audout::recorder::container::raw);
+		rec.push(utki::make_span(samples), format.num_channels());
+	}
+
+	auto file = read_file();
+	std::remove(file_name);
+
+	utki::assert(file.size() == samples.size() * sizeof(int16_t), SL);
+	utki::assert(std::memcmp(file.data(), samples.data(), file.size()) == 0, SL);
+}
+
+#if CFG_OS == CFG_OS_LINUX
+struct silence_player : public audout::listener {
+	void fill(utki::span<int16_t> buf) noexcept override
+	{
+		std::fill(buf.begin(), buf.end(), 0);
+	}
+};
+
+void test_player()
+{
+	const audout::format format(audout::frame::stereo, audout::rate::hz_48000, audout::sample_format::int32);
+	constexpr uint32_t num_buffer_frames = 480;
+
+	audout::simulated_device device;
+	silence_player pl;
+	audout::player p(format, num_buffer_frames, &pl, device);
+
+	{
+		audout::recorder rec(file_name, {format.frame_type, format.sampling_rate});
+		bool thrown = false;
+		try {
+			p.set_recorder(&rec);
+		} catch (std::invalid_argument&) {
+			thrown = true;
+		}
+		utki::assert(thrown, SL);
+	}
+
+	{
+		audout::recorder rec(file_name, format);
+		p.set_recorder(&rec);
+		p.set_paused(false);
+
+		device.advance(std::chrono::seconds(1));
+
+		// detach while playing, the recorder is destroyed right after
+		p.set_recorder(nullptr);
+
+		utki::assert(rec.get_num_dropped_frames() == 0, SL);
+	}
+
+	device.advance(std::chrono::seconds(1));
+	p.set_paused(true);
+
+	// the played frames are written after the header
+	constexpr size_t extensible_header_size = 68;
+	utki::assert(read_file().size() > extensible_header_size, SL);
+}
+#endif
+
+} // namespace
+
+int main()
+{
+	using audout::frame;
+	using audout::rate;
+	using audout::sample_format;
+
+	constexpr uint32_t mask_mono = 0x4;
+	constexpr uint32_t mask_stereo = 0x3;
+	constexpr uint32_t mask_5_1 = 0x3f;
+
+	// plain PCM
+	test_format<int16_t>({frame::mono, rate::hz_44100}, {wave_format_pcm, 16});
+	test_format<int16_t>({frame::stereo, rate::hz_48000}, {wave_format_pcm, 16});
+
+	// float needs cbSize and fact chunk
+	test_format<float>(
+		{frame::stereo, rate::hz_48000, sample_format::float32},
+		{wave_format_ieee_float, 18, 0, 0, true}
+	);
+
+	// integer samples wider than 16 bits
+	test_format<audout::int24>(
+		{frame::stereo, rate::hz_48000, sample_format::int24},
+		{wave_format_extensible, 40, wave_format_pcm, mask_stereo}
+	);
+	test_format<int32_t>(
+		{frame::mono, rate::hz_48000, sample_format::int32},
+		{wave_format_extensible, 40, wave_format_pcm, mask_mono}
+	);
+
+	// more than 2 channels
+	test_format<int16_t>(
+		{frame::surround_5_1, rate::hz_48000},
+		{wave_format_extensible, 40, wave_format_pcm, mask_5_1}
+	);
+	test_format<float>(
+		{frame::surround_5_1, rate::hz_48000, sample_format::float32},
+		{wave_format_extensible, 40, wave_format_ieee_float, mask_5_1, true}
+	);
+
+	test_raw();
+
+#if CFG_OS == CFG_OS_LINUX
+	test_player();
+#endif
+
+	return 0;
+}
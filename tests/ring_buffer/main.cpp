@@ -0,0 +1,181 @@
+// Tests single-producer single-consumer ring buffer.
+// Checks capacity rounding, partial writes and reads when the buffer gets full or empty, and that
+// the data is intact when it wraps around the end of the ring. Then a producer thread writes a numbered
+// sequence by chunks of varying sizes while the consumer reads it by chunks of other sizes, checking
+// that every element arrives exactly once and in order.
+
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <utki/debug.hpp>
+
+#include "../../src/audout/ring_buffer.hpp"
+
+namespace {
+
+void test_capacity()
+{
+	utki::assert(audout::ring_buffer<int>(1).capacity() == 1, SL);
+	utki::assert(audout::ring_buffer<int>(5).capacity() == 8, SL);
+	utki::assert(audout::ring_buffer<int>(64).capacity() == 64, SL);
+
+	bool thrown = false;
+	try {
+		audout::ring_buffer<int> rb(0);
+	} catch (std::invalid_argument&) {
+		thrown = true;
+	}
+	utki::assert(thrown, SL);
+}
+
+void test_full_and_empty()
+{
+	audout::ring_buffer<uint32_t> rb(8);
+
+	std::vector<uint32_t> buf(10);
+
+	utki::assert(rb.size() == 0, SL);
+	utki::assert(rb.read(utki::make_span(buf)) == 0, SL);
+
+	// only the elements which fit are written
+	for (size_t i = 0; i != buf.size(); ++i) {
+		buf[i] = uint32_t(i);
+	}
+	utki::assert(rb.write(utki::make_span(buf)) == 8, SL);
+	utki::assert(rb.size() == 8, SL);
+	utki::assert(rb.write(utki::make_span(buf)) == 0, SL);
+
+	// only the elements which are there are read
+	std::vector<uint32_t> out(10, 0xffff);
+	utki::assert(rb.read(utki::make_span(out)) == 8, SL);
+	utki::assert(rb.size() == 0, SL);
+	for (size_t i = 0; i != 8; ++i) {
+		utki::assert(out[i] == i, SL);
+	}
+	utki::assert(out[8] == 0xffff, SL);
+}
+
+void test_wraparound()
+{
+	audout::ring_buffer<uint32_t> rb(8);
+
+	uint32_t next_written = 0;
+	uint32_t next_read = 0;
+
+	// chunk sizes are coprime with the capacity, so that the wrap point moves through all ring positions
+	for (size_t round = 0; round != 100; ++round) {
+		std::vector<uint32_t> in(3 + round % 3);
+		for (auto& e : in) {
+			e = next_written++;
+		}
+		utki::assert(rb.write(utki::make_span(in)) == in.size(), SL);
+
+		std::vector<uint32_t> out(in.size());
+		utki::assert(rb.read(utki::make_span(out)) == out.size(), SL);
+		for (auto e : out) {
+			utki::assert(e == next_read, [&](auto& o) {
+				o << "e = " << e << ", expected = " << next_read;
+			}, SL);
+			++next_read;
+		}
+
+		utki::assert(rb.size() == 0, SL);
+	}
+
+	// keep the buffer partially filled, so that both positions wrap with data straddling the end
+	std::vector<uint32_t> in(5);
+	for (auto& e : in) {
+		e = next_written++;
+	}
+	utki::assert(rb.write(utki::make_span(in)) == 5, SL);
+	for (size_t round = 0; round != 100; ++round) {
+		std::vector<uint32_t> out(3);
+		utki::assert(rb.read(utki::make_span(out)) == 3, SL);
+		for (auto e : out) {
+			utki::assert(e == next_read++, SL);
+		}
+
+		std::vector<uint32_t> more(6);
+		for (auto& e : more) {
+			e = next_written++;
+		}
+		// 2 elements remain, so 6 of 6 fit
+		utki::assert(rb.write(utki::make_span(more)) == 6, SL);
+		utki::assert(rb.size() == 8, SL);
+
+		std::vector<uint32_t> rest(5);
+		utki::assert(rb.read(utki::make_span(rest)) == 5, SL);
+		for (auto e : rest) {
+			utki::assert(e == next_read++, SL);
+		}
+
+		std::vector<uint32_t> refill(2);
+		for (auto& e : refill) {
+			e = next_written++;
+		}
+		utki::assert(rb.write(utki::make_span(refill)) == 2, SL);
+		utki::assert(rb.size() == 5, SL);
+	}
+}
+
+void test_concurrent(size_t capacity)
+{
+	constexpr uint32_t num_elements = 1000000;
+
+	audout::ring_buffer<uint32_t> rb(capacity);
+
+	std::thread producer([&]() {
+		std::vector<uint32_t> chunk(13);
+		uint32_t next = 0;
+		size_t chunk_size = 1;
+		while (next != num_elements) {
+			chunk_size = chunk_size % chunk.size() + 1;
+			auto n = std::min(size_t(num_elements - next), chunk_size);
+			for (size_t i = 0; i != n; ++i) {
+				chunk[i] = next + uint32_t(i);
+			}
+			auto written = rb.write(utki::make_span(chunk.data(), n));
+			next += uint32_t(written);
+			if (written == 0) {
+				std::this_thread::yield();
+			}
+		}
+	});
+
+	std::vector<uint32_t> chunk(7);
+	uint32_t expected = 0;
+	size_t chunk_size = 1;
+	while (expected != num_elements) {
+		chunk_size = chunk_size % chunk.size() + 1;
+		auto n = rb.read(utki::make_span(chunk.data(), chunk_size));
+		for (size_t i = 0; i != n; ++i) {
+			utki::assert(chunk[i] == expected, [&](auto& o) {
+				o << "chunk[i] = " << chunk[i] << ", expected = " << expected;
+			}, SL);
+			++expected;
+		}
+		if (n == 0) {
+			std::this_thread::yield();
+		}
+	}
+
+	producer.join();
+
+	utki::assert(rb.size() == 0, SL);
+}
+
+} // namespace
+
+int main()
+{
+	test_capacity();
+	test_full_and_empty();
+	test_wraparound();
+
+	test_concurrent(4);
+	test_concurrent(1024);
+
+	return 0;
+}
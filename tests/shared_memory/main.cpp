@@ -0,0 +1,181 @@
+// Tests shared memory source with a producer in another process.
+// A forked child process writes a sequence of counter values through the shared memory writer,
+// waiting for free space when the ring buffer is full, and then exits without detaching,
+// as if it crashed. The parent reads the frames as the player would and checks that the sequence
+// arrives intact, that no other producer can attach while the child is alive, and that the source plays silence
+// and reports the producer as dead once its heartbeat stands still, so that a new producer can take over.
+
+#include <utki/config.hpp>
+
+#if CFG_OS == CFG_OS_LINUX
+
+#	include <atomic>
+#	include <chrono>
+#	include <cstdlib>
+#	include <stdexcept>
+#	include <thread>
+#	include <vector>
+
+#	include <sys/wait.h>
+#	include <unistd.h>
+
+#	include <utki/debug.hpp>
+
+#	include "../../src/audout/shared_memory_source.hpp"
+
+namespace {
+
+const audout::format format(audout::frame::stereo, audout::rate::hz_48000);
+
+constexpr uint32_t capacity_frames = 1024;
+constexpr size_t period_frames = 256;
+constexpr uint64_t num_frames = 48000;
+constexpr std::chrono::milliseconds producer_timeout(200);
+
+// counter values are never 0, so that they differ from silence
+int16_t counter_value(uint64_t frame)
+{
+	constexpr uint64_t modulus = 30000;
+	return int16_t(frame % modulus + 1);
+}
+
+[[noreturn]] void run_producer(int fd)
+{
+	audout::shared_memory_writer writer(fd);
+
+	uint64_t frame = 0;
+	while (frame != num_frames) {
+		if (!writer.wait_for_space(period_frames, std::chrono::seconds(1))) {
+			std::_Exit(1);
+		}
+
+		auto buf = writer.get_write_buffer();
+
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "the source format is int16")
+		auto samples = utki::make_span(reinterpret_cast<int16_t*>(buf.data()), buf.size() / sizeof(int16_t));
+
+		size_t n = 0;
+		for (auto i = samples.begin(); i != samples.end() && frame != num_frames; ++n, ++frame) {
+			for (unsigned ch = 0; ch != format.num_channels(); ++ch, ++i) {
+				*i = counter_value(frame);
+			}
+		}
+		writer.commit(n);
+	}
+
+	// exit without detaching, as if the producer crashed
+	std::_Exit(0);
+}
+
+} // namespace
+
+int main()
+{
+	audout::shared_memory_source source(format, capacity_frames, producer_timeout);
+
+	utki::assert(source.get_producer_state() == audout::shared_memory_source::producer_state::detached, SL);
+
+	pid_t pid = fork();
+	utki::assert(pid >= 0, SL);
+	if (pid == 0) {
+		run_producer(source.get_fd());
+	}
+
+	std::vector<int16_t> buf(period_frames * format.num_channels());
+
+	uint64_t frame = 0;
+	while (frame != num_frames) {
+		source.fill(utki::make_span(buf));
+
+		for (size_t i = 0; i != buf.size(); i += format.num_channels()) {
+			if (buf[i] == 0) {
+				// underrun, the rest of the period is silence
+				utki::assert(buf[buf.size() - 1] == 0, SL);
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				break;
+			}
+			utki::assert(buf[i] == counter_value(frame), [&](auto& o) {
+				o << "frame = " << frame << ", got = " << buf[i];
+			}, SL);
+			utki::assert(buf[i + 1] == buf[i], SL);
+			if (frame == 0) {
+				// the child has attached, it is alive, so another producer can not attach
+				bool thrown = false;
+				try {
+					audout::shared_memory_writer writer(source.get_fd());
+				} catch (std::logic_error&) {
+					thrown = true;
+				}
+				utki::assert(thrown, SL);
+			}
+			++frame;
+			if (frame == num_frames) {
+				break;
+			}
+		}
+	}
+
+	int status = 0;
+	utki::assert(waitpid(pid, &status, 0) == pid, SL);
+	utki::assert(WIFEXITED(status) && WEXITSTATUS(status) == 0, SL);
+
+	// the producer is gone without detaching, the source plays silence
+	source.fill(utki::make_span(buf));
+	for (auto s : buf) {
+		utki::assert(s == 0, SL);
+	}
+
+	// the producer is reported dead once its heartbeat stands still for the timeout
+	{
+		constexpr auto max_num_timeouts = 10;
+		auto deadline = std::chrono::steady_clock::now() + producer_timeout * max_num_timeouts;
+		while (source.get_producer_state() != audout::shared_memory_source::producer_state::dead) {
+			utki::assert(std::chrono::steady_clock::now() < deadline, SL);
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	}
+
+	// a new producer can take over
+	{
+		audout::shared_memory_writer writer(source.get_fd());
+		utki::assert(writer.get_format().frame_size() == format.frame_size(), SL);
+		utki::assert(source.get_producer_state() != audout::shared_memory_source::producer_state::dead, SL);
+
+		// the new producer is idle, but keeps itself alive, so it can not be taken over
+		std::atomic_bool quit = false;
+		std::thread keep_alive([&]() {
+			while (!quit.load()) {
+				writer.wait_for_space(0, std::chrono::seconds(0));
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+		});
+
+		bool thrown = false;
+		try {
+			audout::shared_memory_writer other(source.get_fd());
+		} catch (std::logic_error&) {
+			thrown = true;
+		}
+
+		quit.store(true);
+		keep_alive.join();
+
+		utki::assert(thrown, SL);
+	}
+	utki::assert(source.get_producer_state() == audout::shared_memory_source::producer_state::detached, SL);
+
+	utki::log([&](auto& o) {
+		o << "frames = " << num_frames << ", underrun frames = " << source.get_num_underrun_frames() << std::endl;
+	});
+
+	return 0;
+}
+
+#else
+
+int main()
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <utki/config.hpp>
+#include <utki/debug.hpp>
+
+#include "../../src/audout/player.hpp"
+
+namespace {
+struct silence_player : public audout::listener {
+	void fill(utki::span<std::int16_t> buf) noexcept override
+	{
+		std::fill(buf.begin(), buf.end(), 0);
+	}
+};
+
+// counts the filled frames, so that the frames dropped on the way to the device can be detected
+struct counting_player : public audout::listener {
+	std::atomic<uint64_t> num_filled_frames = 0;
+
+	void fill(utki::span<std::int16_t> buf) noexcept override
+	{
+		std::fill(buf.begin(), buf.end(), 0);
+		this->num_filled_frames.fetch_add(buf.size() / 2, std::memory_order_relaxed);
+	}
+};
+
+const audout::format format(audout::frame::stereo, audout::rate::hz_48000);
+
+constexpr uint32_t num_buffer_frames = 480;
+
+audout::simulated_device::statistics play(const audout::simulated_device::parameters& params)
+{
+	audout::simulated_device device(params);
+
+	silence_player pl;
+	audout::player p(format, num_buffer_frames, &pl, device);
+	p.set_paused(false);
+
+	device.advance(std::chrono::seconds(10));
+
+	return device.get_statistics();
+}
+} // namespace
+
+int main()
+{
+#if CFG_OS == CFG_OS_LINUX
+	// no jitter, buffer of 2 periods is enough
+	{
+		auto stats = play({});
+		utki::assert(stats.num_underruns == 0, SL);
+		utki::assert(stats.num_played_frames == 10 * format.frequency(), SL);
+	}
+
+	// wakeups delayed less than the buffer duration are absorbed
+	{
+		audout::simulated_device::parameters params;
+		params.wakeup_jitter = std::chrono::milliseconds(15);
+		auto stats = play(params);
+		utki::assert(stats.num_underruns == 0, SL);
+	}
+
+	// wakeups delayed more than the buffer duration cause underruns, the same number each run
+	{
+		audout::simulated_device::parameters params;
+		params.wakeup_jitter = std::chrono::milliseconds(35);
+		auto stats = play(params);
+		utki::assert(stats.num_underruns != 0, SL);
+		utki::assert(play(params).num_underruns == stats.num_underruns, SL);
+	}
+
+	// stalled device blocks the audio thread, but does not underrun
+	{
+		audout::simulated_device device;
+
+		silence_player pl;
+		audout::player p(format, num_buffer_frames, &pl, device);
+		p.set_paused(false);
+
+		device.advance(std::chrono::seconds(1));
+		device.stall(std::chrono::milliseconds(500));
+		device.advance(std::chrono::seconds(1));
+
+		auto stats = device.get_statistics();
+		utki::assert(stats.num_underruns == 0, SL);
+		utki::assert(device.get_latency() == std::chrono::milliseconds(20), SL);
+	}
+
+	// changing buffer geometry while the audio thread is blocked does not drop filled frames
+	{
+		audout::simulated_device device;
+
+		counting_player pl;
+		audout::player p(format, num_buffer_frames, &pl, device);
+		p.set_paused(false);
+
+		device.advance(std::chrono::seconds(1));
+
+		for (auto g : {
+				 audout::buffer_geometry{3840, 4},
+				 audout::buffer_geometry{7680, 2},
+				 audout::buffer_geometry{7680, 8},
+				 audout::buffer_geometry{9600, 10}
+		})
+		{
+			p.set_buffer_geometry(g);
+			device.advance(std::chrono::milliseconds(700));
+		}
+
+		auto stats = device.get_statistics();
+		utki::assert(stats.num_underruns == 0, SL);
+
+		// the audio thread is blocked writing at most one period
+		auto num_written_frames = stats.num_played_frames + stats.num_buffered_frames;
+		auto num_filled_frames = pl.num_filled_frames.load(std::memory_order_relaxed);
+		utki::assert(num_filled_frames >= num_written_frames, SL);
+		utki::assert(num_filled_frames - num_written_frames <= device.get_geometry().period_frames(), [&](auto& o) {
+			o << "filled = " << num_filled_frames << ", written = " << num_written_frames;
+		}, SL);
+	}
+#endif
+
+	return 0;
+}
@@ -1,28 +1,33 @@
 #include <chrono>
+#include <memory>
 #include <ratio>
+#include <vector>
 
 #include <nitki/thread.hpp>
 #include <utki/config.hpp>
 #include <utki/math.hpp>
 
+#include "../../src/audout/event_loop.hpp"
 #include "../../src/audout/player.hpp"
 
 #if CFG_OS_NAME == CFG_OS_NAME_ANDROID
 #	include <jni.h>
 #endif
 
+constexpr auto sine_freq = 220.0f;
+
 struct sine_player : public audout::listener {
 	double time = 0;
 
+	double amplitude = 1;
+
 	audout::format format;
 
 	void fill(utki::span<std::int16_t> buf) noexcept override
 	{
-		constexpr auto sine_freq = 220.0f;
-
 		for (auto dst = buf.begin(); dst != buf.end();) {
 			auto v = int16_t(
-				decltype(this->time)(std::numeric_limits<int16_t>::max()) *
+				this->amplitude * decltype(this->time)(std::numeric_limits<int16_t>::max()) *
 				std::sin(this->time * 2 * utki::pi * sine_freq)
 			);
 			this->time += 1 / decltype(this->time)(format.frequency());
@@ -43,16 +48,69 @@ constexpr auto play_buffer_size_frames = 1000;
 
 void play(audout::format format)
 {
-	sine_player pl(format);
+	// render only one channel, the player mixes it to all output channels
+	sine_player pl(audout::format(audout::frame::mono, format.sampling_rate));
+
+	// analyser and mixing matrix must outlive the player
+	audout::spectrum_analyser analyser(format.frequency());
+	audout::mixing_matrix mono_to_output(audout::frame::mono, format.frame_type);
+
 	audout::player p(
 		format, //
 		play_buffer_size_frames,
 		&pl
 	);
+	p.set_mixing_matrix(&mono_to_output);
+	p.set_metering(true);
+	p.set_spectrum_analyser(&analyser);
 	p.set_paused(false);
 
 	std::this_thread::sleep_for(std::chrono::milliseconds(2 * std::milli::den));
+
+	auto levels = p.get_levels();
+
+	utki::log([&](auto& o) {
+		o << "startup latency = " << p.get_startup_latency().count() << " us" << std::endl;
+		for (unsigned ch = 0; ch != levels.num_channels; ++ch) {
+			const auto& l = levels.channels.at(ch);
+			o << "channel " << ch << ": peak = " << l.peak << ", rms = " << l.rms << ", clipped = " << l.num_clipped
+			  << std::endl;
+		}
+		o << "peak frequency = " << analyser.get_peak_frequency() << " Hz" << std::endl;
+	});
+
+	// one bin width is within the interpolation error
+	auto peak_freq = analyser.get_peak_frequency();
+	utki::assert(std::abs(peak_freq - sine_freq) < analyser.get().bin_width, [&](auto& o) {
+		o << "peak_freq = " << peak_freq;
+	}, SL);
+}
+
+#if CFG_OS == CFG_OS_LINUX && CFG_OS_NAME != CFG_OS_NAME_ANDROID
+void play_event_loop(audout::format format, unsigned num_streams)
+{
+	std::vector<std::unique_ptr<sine_player>> listeners;
+	for (unsigned i = 0; i != num_streams; ++i) {
+		listeners.push_back(std::make_unique<sine_player>(format));
+		listeners.back()->amplitude = 1 / double(num_streams);
+	}
+
+	audout::event_loop loop;
+
+	std::vector<std::unique_ptr<audout::stream>> streams;
+	for (auto& l : listeners) {
+		streams.push_back(std::make_unique<audout::stream>(
+			loop, //
+			format,
+			play_buffer_size_frames,
+			l.get()
+		));
+		streams.back()->set_paused(false);
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(2 * std::milli::den));
 }
+#endif
 
 void test()
 {
@@ -114,6 +172,29 @@ void test()
 		});
 		play(audout::format(audout::frame::stereo, audout::rate::hz_48000));
 	}
+
+	{
+		utki::log([&](auto& o) {
+			o << "Opening audio playback device: Stereo 48000 24-bit" << std::endl;
+		});
+		play(audout::format(audout::frame::stereo, audout::rate::hz_48000, audout::sample_format::int24));
+	}
+
+	{
+		utki::log([&](auto& o) {
+			o << "Opening audio playback device: Stereo 48000 float" << std::endl;
+		});
+		play(audout::format(audout::frame::stereo, audout::rate::hz_48000, audout::sample_format::float32));
+	}
+
+#if CFG_OS == CFG_OS_LINUX && CFG_OS_NAME != CFG_OS_NAME_ANDROID
+	{
+		utki::log([&](auto& o) {
+			o << "Opening event loop: 16 streams Stereo 48000" << std::endl;
+		});
+		play_event_loop(audout::format(audout::frame::stereo, audout::rate::hz_48000), 16);
+	}
+#endif
 }
 
 #if CFG_OS_NAME == CFG_OS_NAME_ANDROID
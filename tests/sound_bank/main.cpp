@@ -0,0 +1,215 @@
+// Tests sound bank writing and reading back, and rejection of corrupted sound bank files.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <utki/debug.hpp>
+
+#include "../../src/audout/sound_bank.hpp"
+
+namespace {
+
+const std::string bank_file_name = "test_sound_bank.bin";
+const std::string corrupted_file_name = "test_sound_bank_corrupted.bin";
+
+constexpr size_t header_size = 16;
+constexpr size_t index_entry_size = 32;
+
+std::vector<uint8_t> read_file(const std::string& name)
+{
+	std::ifstream f(name, std::ios::binary);
+	return {std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>()};
+}
+
+void write_file(const std::string& name, const std::vector<uint8_t>& data)
+{
+	std::ofstream f(name, std::ios::binary | std::ios::trunc);
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "writing raw bytes")
+	f.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+}
+
+template <typename exception_type>
+void check_throws(const std::function<void()>& f)
+{
+	try {
+		f();
+	} catch (const exception_type&) {
+		return;
+	}
+	utki::assert(false, SL);
+}
+
+void check_corrupted(const std::vector<uint8_t>& data)
+{
+	write_file(corrupted_file_name, data);
+	check_throws<std::invalid_argument>([]() {
+		audout::sound_bank bank(corrupted_file_name);
+	});
+}
+
+void test_round_trip()
+{
+	std::vector<int16_t> stereo = {1, -1, 2, -2, 3, -3, 32767, -32768};
+	std::vector<int16_t> mono = {10, 20, 30};
+	std::vector<int16_t> odd = {7, 8, 9, 10, 11};
+
+	std::vector<audout::sound_bank::entry> entries = {
+		{"stereo", stereo, 2, 48000},
+		{"mono", mono, 1, 22050},
+		{"odd", odd, 1, 44100},
+		{"empty", {}, 1, 48000},
+	};
+
+	audout::sound_bank::write(bank_file_name, entries);
+
+	audout::pcm_clip mono_clip;
+	{
+		audout::sound_bank bank(bank_file_name);
+		utki::assert(bank.size() == entries.size(), SL);
+
+		// the clips are sorted by name
+		utki::assert(bank.get(0).get_num_frames() == 0, SL);
+		utki::assert(bank.get(1).get_sampling_rate() == 22050, SL);
+
+		for (const auto& e : entries) {
+			auto clip = bank.get(e.name);
+			utki::assert(clip.get_num_channels() == e.num_channels, SL);
+			utki::assert(clip.get_sampling_rate() == e.sampling_rate, SL);
+			utki::assert(clip.get_num_frames() == e.samples.size() / e.num_channels, SL);
+			utki::assert(std::equal(e.samples.begin(), e.samples.end(), clip.get_samples().begin()), SL);
+
+			// blobs are aligned
+			utki::assert(
+				clip.get_num_frames() == 0 ||
+					// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, "checking address alignment")
+					reinterpret_cast<uintptr_t>(clip.get_samples().data()) % audout::sound_bank::blob_alignment == 0,
+				SL
+			);
+		}
+
+		check_throws<std::out_of_range>([&]() {
+			bank.get("missing");
+		});
+		check_throws<std::out_of_range>([&]() {
+			bank.get(entries.size());
+		});
+
+		mono_clip = bank.get("mono");
+	}
+
+	// the clip keeps the mapping alive after the bank is destroyed
+	audout::pcm_voice voice(mono_clip);
+	std::vector<int16_t> buf(2);
+	utki::assert(voice.fill(buf) == 2, SL);
+	utki::assert(buf[0] == 10 && buf[1] == 20, SL);
+	utki::assert(voice.fill(buf) == 1, SL);
+	utki::assert(buf[0] == 30, SL);
+	utki::assert(voice.is_finished(), SL);
+	utki::assert(voice.fill(buf) == 0, SL);
+
+	// default constructed clip plays nothing
+	audout::pcm_voice empty_voice{audout::pcm_clip()};
+	utki::assert(empty_voice.fill(buf) == 0, SL);
+	utki::assert(empty_voice.is_finished(), SL);
+
+	check_throws<std::invalid_argument>([&]() {
+		std::vector<audout::sound_bank::entry> duplicates = {
+			{"a", mono, 1, 48000},
+			{"a", odd, 1, 48000}
+		};
+		audout::sound_bank::write(bank_file_name, duplicates);
+	});
+
+	check_throws<std::invalid_argument>([&]() {
+		std::vector<audout::sound_bank::entry> partial_frame = {
+			{"a", odd, 2, 48000}
+		};
+		audout::sound_bank::write(bank_file_name, partial_frame);
+	});
+}
+
+void test_corrupted()
+{
+	auto data = read_file(bank_file_name);
+	utki::assert(data.size() > header_size + 4 * index_entry_size, SL);
+
+	// bad magic
+	{
+		auto d = data;
+		d[0] = 'X';
+		check_corrupted(d);
+	}
+
+	// unsupported version
+	{
+		auto d = data;
+		d[8] = 2;
+		check_corrupted(d);
+	}
+
+	// shorter than header
+	check_corrupted(std::vector<uint8_t>(data.begin(), std::next(data.begin(), header_size - 1)));
+
+	// index is truncated
+	check_corrupted(std::vector<uint8_t>(data.begin(), std::next(data.begin(), header_size + index_entry_size * 3 + 5)));
+
+	// misaligned data offset of the first entry
+	{
+		auto d = data;
+		d[header_size] += 2;
+		check_corrupted(d);
+	}
+
+	// data offset past the end of file
+	{
+		auto d = data;
+		d[header_size + 3] = 0x7f;
+		check_corrupted(d);
+	}
+
+	// number of frames exceeds the file
+	{
+		auto d = data;
+		d[header_size + index_entry_size + 8 + 4] = 1;
+		check_corrupted(d);
+	}
+
+	// zero channels
+	{
+		auto d = data;
+		for (size_t i = 0; i != 4; ++i) {
+			d[header_size + 16 + i] = 0;
+		}
+		check_corrupted(d);
+	}
+
+	// name out of file
+	{
+		auto d = data;
+		d[header_size + 24 + 3] = 0x7f;
+		check_corrupted(d);
+	}
+
+	// data of the last clip is cut off
+	check_corrupted(std::vector<uint8_t>(data.begin(), std::prev(data.end())));
+}
+
+} // namespace
+
+int main()
+{
+	test_round_trip();
+	test_corrupted();
+
+	std::remove(bank_file_name.c_str());
+	std::remove(corrupted_file_name.c_str());
+
+	return 0;
+}